@@ -12,10 +12,12 @@
 */
 
 #include "shared.h"
+#include "pak.h"
 
 #define CM_MAX_BUFFER_SIZE 2048
 #define CM_CVAR_MAX_STRING_LEN 512
 #define CM_INVALID_LIST_ID std::wstring::npos
+#define CM_NAME_INDEX_SLOTS 64
 
 #if defined(_WIN32) || defined(_WIN64)
 	#define CM_DIR_CHAR '\\'
@@ -25,6 +27,149 @@
 
 /* Config interpreter and management */
 namespace ConfigMgr {
+	inline std::string ToUtf8(const std::wstring& szName)
+	{
+		//Convert name to UTF-8
+
+		int iLength = WideCharToMultiByte(CP_UTF8, 0, szName.c_str(), (int)szName.length(), nullptr, 0, nullptr, nullptr);
+		if (iLength <= 0)
+			return std::string();
+
+		std::string szResult((size_t)iLength, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, szName.c_str(), (int)szName.length(), &szResult[0], iLength, nullptr, nullptr);
+
+		return szResult;
+	}
+
+	inline size_t HashName(const std::string& szName)
+	{
+		//FNV-1a hash of UTF-8 name
+
+		size_t uiHash = 2166136261U;
+
+		for (size_t i = 0; i < szName.length(); i++) {
+			uiHash = (uiHash ^ (unsigned char)szName[i]) * 16777619U;
+		}
+
+		return uiHash;
+	}
+
+	inline size_t HashName(const std::wstring& szName)
+	{
+		//FNV-1a hash of wide name. Yields the same value as the UTF-8 name for ASCII names
+
+		size_t uiHash = 2166136261U;
+
+		for (size_t i = 0; i < szName.length(); i++) {
+			if (szName[i] >= 0x80)
+				return HashName(ToUtf8(szName));
+
+			uiHash = (uiHash ^ (unsigned char)szName[i]) * 16777619U;
+		}
+
+		return uiHash;
+	}
+
+	/* Open addressing index from name hashes to list IDs of a registry */
+	class CNameIndex {
+	private:
+		struct slot_s {
+			size_t uiHash;
+			size_t uiEntry; //CM_INVALID_LIST_ID if slot is empty
+		};
+
+		std::vector<slot_s> m_vSlots;
+		size_t m_uiCount;
+
+		void InsertSlot(const size_t uiHash, const size_t uiEntry)
+		{
+			//Store entry in the first free slot of its probe sequence
+
+			size_t uiMask = this->m_vSlots.size() - 1;
+
+			for (size_t i = uiHash & uiMask; ; i = (i + 1) & uiMask) {
+				if (this->m_vSlots[i].uiEntry == CM_INVALID_LIST_ID) {
+					this->m_vSlots[i].uiHash = uiHash;
+					this->m_vSlots[i].uiEntry = uiEntry;
+					return;
+				}
+			}
+		}
+
+		void Rebuild(const size_t uiSlotCount, const size_t uiRemovedEntry)
+		{
+			//Reinsert all entries into a table of the given size. The removed entry is dropped and
+			//IDs behind it are shifted down as the registry list erases it
+
+			std::vector<slot_s> vOldSlots;
+			vOldSlots.swap(this->m_vSlots);
+
+			slot_s sEmpty = { 0, CM_INVALID_LIST_ID };
+			this->m_vSlots.resize(uiSlotCount, sEmpty);
+			this->m_uiCount = 0;
+
+			for (size_t i = 0; i < vOldSlots.size(); i++) {
+				if ((vOldSlots[i].uiEntry == CM_INVALID_LIST_ID) || (vOldSlots[i].uiEntry == uiRemovedEntry))
+					continue;
+
+				this->InsertSlot(vOldSlots[i].uiHash, (vOldSlots[i].uiEntry > uiRemovedEntry) ? vOldSlots[i].uiEntry - 1 : vOldSlots[i].uiEntry);
+				this->m_uiCount++;
+			}
+		}
+	public:
+		CNameIndex() : m_uiCount(0) {}
+		~CNameIndex() { this->Clear(); }
+
+		void Insert(const size_t uiHash, const size_t uiEntry)
+		{
+			//Insert entry. The table is kept at most half full so that probing stays short and always ends
+
+			if ((this->m_uiCount + 1) * 2 > this->m_vSlots.size()) {
+				this->Rebuild((this->m_vSlots.size()) ? this->m_vSlots.size() * 2 : CM_NAME_INDEX_SLOTS, CM_INVALID_LIST_ID);
+			}
+
+			this->InsertSlot(uiHash, uiEntry);
+			this->m_uiCount++;
+		}
+
+		void Remove(const size_t uiEntry)
+		{
+			//Remove entry and shift the IDs of the following entries
+
+			if (this->m_vSlots.size())
+				this->Rebuild(this->m_vSlots.size(), uiEntry);
+		}
+
+		template <typename TMatch>
+		size_t Find(const size_t uiHash, const TMatch& rMatch) const
+		{
+			//Find entry with the given hash that is accepted by the match function
+
+			if (!this->m_vSlots.size())
+				return CM_INVALID_LIST_ID;
+
+			size_t uiMask = this->m_vSlots.size() - 1;
+
+			for (size_t i = uiHash & uiMask; ; i = (i + 1) & uiMask) {
+				const slot_s& rSlot = this->m_vSlots[i];
+
+				if (rSlot.uiEntry == CM_INVALID_LIST_ID)
+					return CM_INVALID_LIST_ID;
+
+				if ((rSlot.uiHash == uiHash) && (rMatch(rSlot.uiEntry)))
+					return rSlot.uiEntry;
+			}
+		}
+
+		void Clear(void)
+		{
+			//Remove all entries
+
+			this->m_vSlots.clear();
+			this->m_uiCount = 0;
+		}
+	};
+
 	class CCVar {
 	public: 
 		enum cvar_type_e {
@@ -37,6 +182,7 @@ namespace ConfigMgr {
 
 		struct cvar_s {
 			std::wstring szName;
+			std::string szNameUtf8;
 			cvar_type_e eType;
 			union {
 				bool bValue;
@@ -62,6 +208,7 @@ namespace ConfigMgr {
 		};
 	private:
 		std::vector<cvar_s*> m_vCVars;
+		CNameIndex m_oIndex; //Name hash index of m_vCVars
 
 		size_t GetCVarId(const cvar_s* pCvar)
 		{
@@ -78,15 +225,13 @@ namespace ConfigMgr {
 
 		size_t GetCVarId(const std::wstring& szName)
 		{
-			//Get CVar ID by pointer
+			//Get CVar ID by name
 
-			for (size_t i = 0; i < this->m_vCVars.size(); i++) { //Iterate through list
-				//Compare names and return ID if equal
-				if (this->m_vCVars[i]->szName == szName)
-					return i;
-			}
+			cvar_s* pCVar = this->Find(szName);
+			if (!pCVar)
+				return CM_INVALID_LIST_ID;
 
-			return CM_INVALID_LIST_ID;
+			return this->GetCVarId(pCVar);
 		}
 
 		void Release(void)
@@ -100,6 +245,7 @@ namespace ConfigMgr {
 
 			//Clear list
 			this->m_vCVars.clear();
+			this->m_oIndex.Clear();
 		}
 	public:
 		CCVar() {}
@@ -123,6 +269,7 @@ namespace ConfigMgr {
 
 			//Save data
 			pCVar->szName = szName;
+			pCVar->szNameUtf8 = ToUtf8(szName);
 			pCVar->eType = eType;
 
 			//Set initial value
@@ -150,6 +297,7 @@ namespace ConfigMgr {
 
 			//Add to list
 			this->m_vCVars.push_back(pCVar);
+			this->m_oIndex.Insert(HashName(pCVar->szNameUtf8), this->m_vCVars.size() - 1);
 
 			//Return pointer to data
 			return pCVar;
@@ -157,19 +305,57 @@ namespace ConfigMgr {
 
 		cvar_s* Find(const std::wstring& szName)
 		{
-			//Find CVar in list
+			//Find CVar in hash index
+
+			return this->Find(szName, HashName(szName));
+		}
+
+		cvar_s* Find(const std::wstring& szName, const size_t uiHash)
+		{
+			//Find CVar by wide name with precomputed hash
 
 			if (!szName.length())
 				return nullptr;
 
-			//Search in list
-			for (size_t i = 0; i < this->m_vCVars.size(); i++) {
-				if ((this->m_vCVars[i]) && (this->m_vCVars[i]->szName == szName)) {
-					return this->m_vCVars[i];
-				}
-			}
+			size_t uiListId = this->m_oIndex.Find(uiHash, [&](size_t uiEntry) { return this->m_vCVars[uiEntry]->szName == szName; });
+			if (uiListId == CM_INVALID_LIST_ID)
+				return nullptr;
 
-			return nullptr;
+			return this->m_vCVars[uiListId];
+		}
+
+		cvar_s* Find(const std::string& szName)
+		{
+			//Find CVar by UTF-8 name without converting it
+
+			if (!szName.length())
+				return nullptr;
+
+			size_t uiListId = this->m_oIndex.Find(HashName(szName), [&](size_t uiEntry) { return this->m_vCVars[uiEntry]->szNameUtf8 == szName; });
+			if (uiListId == CM_INVALID_LIST_ID)
+				return nullptr;
+
+			return this->m_vCVars[uiListId];
+		}
+
+		size_t FindId(const std::string& szName)
+		{
+			//Find list ID of CVar by UTF-8 name. IDs stay valid while running since CVars are only removed on release
+
+			if (!szName.length())
+				return CM_INVALID_LIST_ID;
+
+			return this->m_oIndex.Find(HashName(szName), [&](size_t uiEntry) { return this->m_vCVars[uiEntry]->szNameUtf8 == szName; });
+		}
+
+		cvar_s* GetById(size_t uiListId)
+		{
+			//Get CVar by list ID. Unknown IDs yield nullptr
+
+			if (uiListId >= this->m_vCVars.size())
+				return nullptr;
+
+			return this->m_vCVars[uiListId];
 		}
 
 		bool Set(const std::wstring& szName, const bool bValue)
@@ -241,7 +427,14 @@ namespace ConfigMgr {
 		{
 			//Set casted value
 
-			cvar_s* pCVar = this->Find(szName);
+			return this->SetCast(szName, HashName(szName), szValue);
+		}
+
+		bool SetCast(const std::wstring& szName, const size_t uiHash, const std::wstring& szValue)
+		{
+			//Set casted value of CVar with precomputed name hash
+
+			cvar_s* pCVar = this->Find(szName, uiHash);
 			if (!pCVar)
 				return false;
 
@@ -273,10 +466,11 @@ namespace ConfigMgr {
 		{
 			//Delete CVar by cvar list ID
 
-			if (uiListId == CM_INVALID_LIST_ID)
+			if ((uiListId == CM_INVALID_LIST_ID) || (uiListId >= this->m_vCVars.size()))
 				return false;
 
-			//Free memory
+			//Remove from index and free memory
+			this->m_oIndex.Remove(uiListId);
 			delete this->m_vCVars[uiListId];
 
 			//Erase from list
@@ -323,26 +517,32 @@ namespace ConfigMgr {
 		};
 	private:
 		std::vector<command_s> m_vCmds;
+		CNameIndex m_oIndex; //Name hash index of m_vCmds
 
 	protected:
 		bool Find(const std::wstring& szName, size_t* pEntryId)
 		{
 			//Check if a command exists
 
-			for (size_t i = 0; i < this->m_vCmds.size(); i++) {
-				if (this->m_vCmds[i].szName == szName) {
-					if (pEntryId)
-						*pEntryId = i;
+			return this->Find(szName, HashName(szName), pEntryId);
+		}
 
-					return true;
-				}
-			}
+		bool Find(const std::wstring& szName, const size_t uiHash, size_t* pEntryId)
+		{
+			//Check if a command exists by precomputed name hash
 
-			return false;
+			size_t uiCmdId = this->m_oIndex.Find(uiHash, [&](size_t uiEntry) { return this->m_vCmds[uiEntry].szName == szName; });
+			if (uiCmdId == CM_INVALID_LIST_ID)
+				return false;
+
+			if (pEntryId)
+				*pEntryId = uiCmdId;
+
+			return true;
 		}
 	public:
 		CCommand() {}
-		~CCommand() { this->m_vCmds.clear(); }
+		~CCommand() { this->m_vCmds.clear(); this->m_oIndex.Clear(); }
 
 		bool Add(const std::wstring& szName, const std::wstring& szDescription, const TCommandCallback pRoutine)
 		{
@@ -363,6 +563,7 @@ namespace ConfigMgr {
 
 			//Add to list
 			this->m_vCmds.push_back(sData);
+			this->m_oIndex.Insert(HashName(szName), this->m_vCmds.size() - 1);
 			
 			return true;
 		}
@@ -381,6 +582,7 @@ namespace ConfigMgr {
 				return false;
 
 			//Erase from list
+			this->m_oIndex.Remove(uiListId);
 			this->m_vCmds.erase(this->m_vCmds.begin() + uiListId);
 
 			return true;
@@ -390,10 +592,17 @@ namespace ConfigMgr {
 		{
 			//Check if command exists and if so call event function
 
+			return this->Handle(szName, HashName(szName));
+		}
+
+		bool Handle(const std::wstring& szName, const size_t uiHash)
+		{
+			//Handle command by precomputed name hash
+
 			size_t uiCmdId;
 
 			//Attempt to find entry and retrieve id
-			if (!this->Find(szName, &uiCmdId))
+			if (!this->Find(szName, uiHash, &uiCmdId))
 				return false;
 
 			//Check pointer
@@ -564,6 +773,8 @@ namespace ConfigMgr {
 	typedef void(*TUnknownExpression)(const std::wstring& szExpression);
 
 	class CScriptParser : public CCmdLine, public CCommand {
+	public:
+		typedef std::vector<std::wstring> TExpression;
 	private:
 		struct script_var_s {
 			std::wstring szName;
@@ -578,29 +789,55 @@ namespace ConfigMgr {
 		static const char C_BRACKET_END_CHAR = ']';
 		static const char C_COMMENT_CHAR = '#';
 		static const char C_ITEMS_DELIM = ';';
+		static const char C_VARIABLE_CHAR = '%';
 
-		std::vector<std::wstring> m_vExpressionItems; //Items for current handled expression
+		std::vector<std::wstring> m_vExpressionItems; //Items for current handled expression. Strings are recycled between expressions
+		size_t m_uiExpressionItemCount; //Amount of valid items in m_vExpressionItems
+		std::wstring m_szEmptyItem; //Returned for out of range items
 		std::vector<script_var_s> m_vScriptVars; //Script variables
+		bool m_bDispatch; //Whether parsed expressions are handled or only tokenized
+		std::vector<TExpression>* m_pCapture; //If set, parsed expressions are stored here instead of being handled
 
 		TUnknownExpression m_pfnUnknownExpressionInform; //Function to call when encountered an unknown expression
 
 		void HandleCurrentItem(bool bClear = false)
 		{
-			if (this->m_vExpressionItems.size()) { //Check if not empty
+			if (this->m_uiExpressionItemCount) { //Check if not empty
+				//Store expression if captured
+				if (this->m_pCapture) {
+					this->m_pCapture->push_back(TExpression(this->m_vExpressionItems.begin(), this->m_vExpressionItems.begin() + this->m_uiExpressionItemCount));
+
+					if (bClear)
+						this->m_uiExpressionItemCount = 0;
+
+					return;
+				}
+
+				//Only tokenize if desired
+				if (!this->m_bDispatch) {
+					if (bClear)
+						this->m_uiExpressionItemCount = 0;
+
+					return;
+				}
+
+				//Hash the identifier once for both registries
+				const size_t uiHash = HashName(this->m_vExpressionItems[0]);
+
 				//Handle cvar if it is one
-				if ((this->m_vExpressionItems.size() > 1) && (CCVar::SetCast(this->m_vExpressionItems[0], this->m_vExpressionItems[1]))) {
+				if ((this->m_uiExpressionItemCount > 1) && (CCVar::SetCast(this->m_vExpressionItems[0], uiHash, this->m_vExpressionItems[1]))) {
 					//Clear list if desired
 					if (bClear)
-						this->m_vExpressionItems.clear();
+						this->m_uiExpressionItemCount = 0;
 
 					return;
 				}
 
 				//Handle command if it is one
-				if (CCommand::Handle(this->m_vExpressionItems[0])) {
+				if (CCommand::Handle(this->m_vExpressionItems[0], uiHash)) {
 					//Clear list if desired
 					if (bClear)
-						this->m_vExpressionItems.clear();
+						this->m_uiExpressionItemCount = 0;
 
 					return;
 				}
@@ -611,8 +848,22 @@ namespace ConfigMgr {
 
 				//Clear list if desired
 				if (bClear)
-					this->m_vExpressionItems.clear();
+					this->m_uiExpressionItemCount = 0;
+			}
+		}
+
+		std::wstring& BeginExpressionItem(void)
+		{
+			//Get the next recycled item string
+
+			if (this->m_uiExpressionItemCount == this->m_vExpressionItems.size()) {
+				this->m_vExpressionItems.push_back(std::wstring());
 			}
+
+			std::wstring& rItem = this->m_vExpressionItems[this->m_uiExpressionItemCount];
+			rItem.clear();
+
+			return rItem;
 		}
 
 		size_t FindScriptVariable(const std::wstring& szName)
@@ -627,12 +878,52 @@ namespace ConfigMgr {
 
 			return std::wstring::npos;
 		}
+
+		size_t FindScriptVariable(const wchar_t* pszName, size_t uiLen)
+		{
+			//Find script variable by name range
+
+			for (size_t i = 0; i < this->m_vScriptVars.size(); i++) {
+				if ((this->m_vScriptVars[i].szName.length() == uiLen) && (!wmemcmp(this->m_vScriptVars[i].szName.data(), pszName, uiLen))) {
+					return i;
+				}
+			}
+
+			return std::wstring::npos;
+		}
+	protected:
+		const bool HasScriptVariables(void) const { return this->m_vScriptVars.size() > 0; }
+
+		void ReplaceVariables(const wchar_t* pszExpression, size_t uiLen, std::wstring& szResult)
+		{
+			//Replace variable values in a single scan
+
+			szResult.clear();
+
+			for (size_t i = 0; i < uiLen; i++) {
+				if (pszExpression[i] == C_VARIABLE_CHAR) {
+					//Check if the range up to the next variable char names a script variable
+					const wchar_t* pszEnd = wmemchr(&pszExpression[i + 1], C_VARIABLE_CHAR, uiLen - i - 1);
+					if (pszEnd) {
+						size_t uiNameLen = pszEnd - &pszExpression[i + 1];
+						size_t uiScriptVar = this->FindScriptVariable(&pszExpression[i + 1], uiNameLen);
+						if (uiScriptVar != std::wstring::npos) {
+							szResult += this->m_vScriptVars[uiScriptVar].szReplacer;
+							i += uiNameLen + 1;
+							continue;
+						}
+					}
+				}
+
+				szResult += pszExpression[i];
+			}
+		}
 	public:
-		CScriptParser() : m_pfnUnknownExpressionInform(nullptr) {}
+		CScriptParser() : m_uiExpressionItemCount(0), m_bDispatch(true), m_pCapture(nullptr), m_pfnUnknownExpressionInform(nullptr) {}
 
-		CScriptParser(const TUnknownExpression pfnFunction) : m_pfnUnknownExpressionInform(pfnFunction) {}
+		CScriptParser(const TUnknownExpression pfnFunction) : m_uiExpressionItemCount(0), m_bDispatch(true), m_pCapture(nullptr), m_pfnUnknownExpressionInform(pfnFunction) {}
 
-		CScriptParser(const TUnknownExpression pfnFunction, const std::wstring& szExpression) : m_pfnUnknownExpressionInform(pfnFunction)
+		CScriptParser(const TUnknownExpression pfnFunction, const std::wstring& szExpression) : m_uiExpressionItemCount(0), m_bDispatch(true), m_pCapture(nullptr), m_pfnUnknownExpressionInform(pfnFunction)
 		{
 			this->Parse(szExpression);
 		}
@@ -651,6 +942,39 @@ namespace ConfigMgr {
 			return true;
 		}
 
+		void SetDispatch(bool bValue)
+		{
+			//Set whether expressions are handled or only tokenized
+
+			this->m_bDispatch = bValue;
+		}
+
+		void SetCapture(std::vector<TExpression>* pExpressions)
+		{
+			//Set list to store parsed expressions in instead of handling them. Pass nullptr to stop capturing
+
+			this->m_pCapture = pExpressions;
+		}
+
+		bool HandleExpression(const TExpression& vItems)
+		{
+			//Handle an already tokenized expression
+
+			if (!vItems.size())
+				return false;
+
+			this->m_uiExpressionItemCount = 0;
+
+			for (size_t i = 0; i < vItems.size(); i++) {
+				this->BeginExpressionItem().assign(vItems[i]);
+				this->m_uiExpressionItemCount++;
+			}
+
+			this->HandleCurrentItem(true);
+
+			return true;
+		}
+
 		void SetScriptVariable(const std::wstring& szName, const std::wstring& szValue)
 		{
 			//Set script variable
@@ -670,36 +994,42 @@ namespace ConfigMgr {
 		{
 			//Replace variable values
 
-			std::wstring szResult = szExpression;
+			if (!this->m_vScriptVars.size())
+				return szExpression;
 
-			for (size_t i = 0; i < this->m_vScriptVars.size(); i++) {
-				size_t uiExprPos = szResult.find(L"%" + this->m_vScriptVars[i].szName + L"%");
-				while (uiExprPos != std::wstring::npos) {
-					szResult = szResult.replace(szResult.begin() + uiExprPos, szResult.begin() + uiExprPos + this->m_vScriptVars[i].szName.length() + 2, this->m_vScriptVars[i].szReplacer);
-					uiExprPos = szResult.find(L"%" + this->m_vScriptVars[i].szName + L"%");
-				}
-			}
+			std::wstring szResult;
+			this->ReplaceVariables(szExpression.data(), szExpression.length(), szResult);
 
 			return szResult;
 		}
 
-		bool Parse(const std::wstring szExpression)
+		bool Parse(const std::wstring& szExpression)
 		{
 			//Parse expression
 
-			if (!szExpression.length())
+			return this->Parse(szExpression.data(), szExpression.length());
+		}
+
+		bool Parse(const wchar_t* pszExpression, size_t uiLen)
+		{
+			//Parse expression in place. Item chars are tracked as a source range and only copied
+			//into the recycled item string when the range ends, so no per-char appends are needed
+
+			if ((!pszExpression) || (!uiLen))
 				return false;
 
 			bool bInQuotes = false; //Whether in-quote context is true or false
-			bool bGotNonSpaceChar = false; //Whether if a non-space char has been encountered
 			short swBracketCounter = 0; //Bracket counter
-			std::wstring szTemp(L""); //Temporary string
-			
-			this->m_vExpressionItems.clear();
-			
-			for (size_t i = 0; i <= szExpression.length(); i++) { //Loop through string chars
+			size_t uiRangeStart = 0, uiRangeEnd = 0; //Pending source range of the current item
+			std::wstring* pItem = nullptr; //Current item string if one has been started
+
+			this->m_uiExpressionItemCount = 0;
+
+			for (size_t i = 0; i <= uiLen; i++) { //Loop through string chars including the terminating position
+				const wchar_t wcCur = (i < uiLen) ? pszExpression[i] : 0;
+
 				//If current char is a quote char then toggle indicator value
-				if (szExpression[i] == C_QUOTE_CHAR) {
+				if (wcCur == C_QUOTE_CHAR) {
 					bInQuotes = !bInQuotes;
 
 					//Ignore only if not in brackets
@@ -707,29 +1037,22 @@ namespace ConfigMgr {
 						continue;
 				}
 
-				//Set indicator to true if case is true
-				if (((!bGotNonSpaceChar) && ((szExpression[i] != C_SPACE_CHAR) || (szExpression[i] != C_TAB_CHAR)))) {
-					bGotNonSpaceChar = true;
-				}
-
-				//Ignore leading spaces
-				if (!bGotNonSpaceChar)
-					continue;
-
 				if (!bInQuotes) { //Outside of an expression item
+					const wchar_t wcNext = (i + 1 < uiLen) ? pszExpression[i + 1] : 0;
+
 					//If current char is a space/tab char and also the next char then ignore current char
-					if (((szExpression[i] == C_SPACE_CHAR) || (szExpression[i] == C_TAB_CHAR)) && ((szExpression[i + 1] == C_SPACE_CHAR) || (szExpression[i + 1] == C_TAB_CHAR))) {
+					if (((wcCur == C_SPACE_CHAR) || (wcCur == C_TAB_CHAR)) && ((wcNext == C_SPACE_CHAR) || (wcNext == C_TAB_CHAR))) {
 						continue;
 					}
 
 					//Check for brackets
-					if (szExpression[i] == C_BRACKET_START_CHAR) {
+					if (wcCur == C_BRACKET_START_CHAR) {
 						swBracketCounter++; //Increment counter
 
 						//Ignore only if this is the first one
 						if (swBracketCounter == 1)
 							continue;
-					} else if (szExpression[i] == C_BRACKET_END_CHAR) {
+					} else if (wcCur == C_BRACKET_END_CHAR) {
 						swBracketCounter--; //Decrement counter
 
 						//Ignore only if this is the last one
@@ -738,32 +1061,54 @@ namespace ConfigMgr {
 					}
 
 					//Check if a delimiter char has been found or comment or end of string reached
-					if  ((!swBracketCounter) && ((szExpression[i] == C_SPACE_CHAR) || (szExpression[i] == C_TAB_CHAR) || (szExpression[i] == C_BRACKET_END_CHAR) || (szExpression[i] == C_COMMENT_CHAR) || (szExpression[i] == C_ITEMS_DELIM) || (!szExpression[i]))) {
+					if ((!swBracketCounter) && ((wcCur == C_SPACE_CHAR) || (wcCur == C_TAB_CHAR) || (wcCur == C_BRACKET_END_CHAR) || (wcCur == C_COMMENT_CHAR) || (wcCur == C_ITEMS_DELIM) || (!wcCur))) {
 						//The first expression may not be empty
-						if ((!this->m_vExpressionItems.size()) && ((i > 0) && (!szTemp.length()))) {
-							szTemp.clear(); //Clear string
+						if ((!this->m_uiExpressionItemCount) && ((i > 0) && (((!pItem) || (!pItem->length())) && (uiRangeStart == uiRangeEnd)))) {
+							pItem = nullptr;
+							uiRangeStart = uiRangeEnd = 0;
 							continue;
 						}
 
-						this->m_vExpressionItems.push_back(szTemp); //Add item to list
+						//Add item to list
+						if (!pItem)
+							pItem = &this->BeginExpressionItem();
+						pItem->append(&pszExpression[uiRangeStart], uiRangeEnd - uiRangeStart);
+						this->m_uiExpressionItemCount++;
+
+						pItem = nullptr;
+						uiRangeStart = uiRangeEnd = 0;
 
 						//Break out if end reached
-						if (szExpression[i] == C_COMMENT_CHAR)
+						if (wcCur == C_COMMENT_CHAR)
 							break;
 
-						szTemp.clear(); //Clear temp string
 						//Handle expression now if item delimiter has been found
-						if (szExpression[i] == C_ITEMS_DELIM) {
+						if (wcCur == C_ITEMS_DELIM) {
 							this->HandleCurrentItem(true); //Handle current item
-							bGotNonSpaceChar = false; //Reset indicator
 						}
 
 						continue; //Ignore current char
 					}
 				}
 
-				//Append current char
-				szTemp += szExpression[i];
+				//Don't take the terminating position as an item char
+				if (i == uiLen)
+					break;
+
+				//Extend pending range or flush it if a char has been skipped in between
+				if (uiRangeStart == uiRangeEnd) {
+					uiRangeStart = i;
+					uiRangeEnd = i + 1;
+				} else if (uiRangeEnd == i) {
+					uiRangeEnd++;
+				} else {
+					if (!pItem)
+						pItem = &this->BeginExpressionItem();
+					pItem->append(&pszExpression[uiRangeStart], uiRangeEnd - uiRangeStart);
+
+					uiRangeStart = i;
+					uiRangeEnd = i + 1;
+				}
 			}
 
 			this->HandleCurrentItem(); //Handle current item
@@ -775,26 +1120,69 @@ namespace ConfigMgr {
 		{
 			//Return count
 
-			return this->m_vExpressionItems.size();
+			return this->m_uiExpressionItemCount;
 		}
 
-		std::wstring ExpressionItemValue(const size_t uiId)
+		const std::wstring& ExpressionItemValue(const size_t uiId)
 		{
 			//Get expression item by id
 
-			std::wstring szResult(L"");
-
-			if (uiId < this->m_vExpressionItems.size()) {
-				szResult = this->m_vExpressionItems[uiId];
+			if (uiId < this->m_uiExpressionItemCount) {
+				return this->m_vExpressionItems[uiId];
 			}
 
-			return szResult;
+			return this->m_szEmptyItem;
 		}
 	};
 
 	class CConfigInt : public CScriptParser {
 	private:
 		std::wstring m_szScriptDir; //Full path of script directory
+
+		static bool ReadScriptFile(const std::wstring& szFile, std::wstring& szContent)
+		{
+			//Read the whole script file with a single read. Packed scripts are taken from the mapped archive
+
+			std::string szBuffer;
+			const byte* pPakData;
+			size_t uiPakSize;
+
+			if (oArchiveSet.GetFile(szFile, pPakData, uiPakSize)) {
+				szBuffer.assign((const char*)pPakData, uiPakSize);
+			} else {
+				std::ifstream hFile(szFile, std::ios::in | std::ios::binary);
+				if (!hFile.is_open())
+					return false;
+
+				hFile.seekg(0, std::ios::end);
+				std::streamoff iSize = hFile.tellg();
+				hFile.seekg(0, std::ios::beg);
+
+				if (iSize <= 0) {
+					szContent.clear();
+					return true;
+				}
+
+				szBuffer.resize((size_t)iSize);
+				hFile.read(&szBuffer[0], iSize);
+				szBuffer.resize((size_t)hFile.gcount());
+
+				hFile.close();
+			}
+
+			//Skip UTF-8 BOM
+			size_t uiStart = 0;
+			if ((szBuffer.length() >= 3) && ((unsigned char)szBuffer[0] == 0xEF) && ((unsigned char)szBuffer[1] == 0xBB) && ((unsigned char)szBuffer[2] == 0xBF))
+				uiStart = 3;
+
+			//Widen bytes as the default stream locale did
+			szContent.resize(szBuffer.length() - uiStart);
+			for (size_t i = uiStart; i < szBuffer.length(); i++) {
+				szContent[i - uiStart] = (wchar_t)(unsigned char)szBuffer[i];
+			}
+
+			return true;
+		}
 	public:
 		CConfigInt() {}
 		CConfigInt(const std::wstring& szScriptDir) : m_szScriptDir(szScriptDir) {}
@@ -817,29 +1205,54 @@ namespace ConfigMgr {
 
 		bool Execute(const std::wstring& szScriptFile)
 		{
-			//Execute script file
+			//Execute script file. The content is kept local so that commands may execute further scripts
 
-			std::wifstream hFile(this->m_szScriptDir + szScriptFile); //Open file for reading
-			if (hFile.is_open()) { //If file could be opened
-				wchar_t szCurrentLine[CM_MAX_BUFFER_SIZE] = {0};
-
-				while (!hFile.eof()) { //While not at end of file
-					hFile.getline(szCurrentLine, sizeof(szCurrentLine), '\n'); //Read current line
-					
-					//Ignore empty lines
-					if (!wcslen(szCurrentLine))
-						continue;
+			std::wstring szContent;
+			if (!ReadScriptFile(this->m_szScriptDir + szScriptFile, szContent))
+				return false;
 
-					//Parse current line
-					CScriptParser::Parse(CScriptParser::ReplaceVariables(szCurrentLine));
+			std::wstring szReplaced; //Reused for lines containing script variables
+			const wchar_t* pszContent = szContent.data();
+			size_t uiLineStart = 0;
+
+			while (uiLineStart < szContent.length()) { //While not at end of file
+				//Find end of current line
+				const wchar_t* pszLineEnd = wmemchr(&pszContent[uiLineStart], '\n', szContent.length() - uiLineStart);
+				size_t uiLineEnd = (pszLineEnd) ? pszLineEnd - pszContent : szContent.length();
+				size_t uiLineLen = uiLineEnd - uiLineStart;
+
+				//Strip carriage return of CRLF files
+				if ((uiLineLen) && (pszContent[uiLineStart + uiLineLen - 1] == '\r'))
+					uiLineLen--;
+
+				//Ignore empty lines
+				if (uiLineLen) {
+					//Parse current line, either directly from the file buffer or from its substituted copy
+					if ((CScriptParser::HasScriptVariables()) && (wmemchr(&pszContent[uiLineStart], '%', uiLineLen))) {
+						CScriptParser::ReplaceVariables(&pszContent[uiLineStart], uiLineLen, szReplaced);
+						CScriptParser::Parse(szReplaced.data(), szReplaced.length());
+					} else {
+						CScriptParser::Parse(&pszContent[uiLineStart], uiLineLen);
+					}
 				}
 
-				hFile.close(); //Close file
-
-				return true;
+				uiLineStart = uiLineEnd + 1;
 			}
 
-			return false;
+			return true;
+		}
+
+		bool Compile(const std::wstring& szScriptFile, std::vector<TExpression>& vExpressions)
+		{
+			//Tokenize script file into an expression list without handling it
+
+			vExpressions.clear();
+
+			CScriptParser::SetCapture(&vExpressions);
+			bool bResult = this->Execute(szScriptFile);
+			CScriptParser::SetCapture(nullptr);
+
+			return bResult;
 		}
 	};
 }
@@ -38,10 +38,28 @@ namespace Console {
 		this->m_wMaxLineHistory = wMaxHistory;
 		this->m_uiDrawedLines = iHeight / (uiFontHeight + uiFontLineDist) - 1;
 		this->m_uiLineHeight = uiFontHeight + uiFontLineDist;
+		this->m_dwOwnerThread = GetCurrentThreadId();
+
+		//Allocate line ring and text arena once
+		this->m_vLines.resize((wMaxHistory) ? wMaxHistory : CON_DEFAULT_MAXHISTORY);
+		this->m_vArena.resize(this->m_vLines.size() * CON_LINE_CHARS);
+		this->m_uiFirstLine = 0;
+		this->m_uiLineCount = 0;
 
 		return true;
 	}
 
+	void CConsole::Clear(void)
+	{
+		//Remove all lines
+
+		this->FetchPendingLines();
+
+		this->m_uiFirstLine = 0;
+		this->m_uiLineCount = 0;
+		this->m_uiLineOffset = 0;
+	}
+
 	void CConsole::UpdateRect(int iWidth, int iHeight)
 	{
 		//Update rectangle info
@@ -50,23 +68,95 @@ namespace Console {
 		this->m_uiConHeight = iHeight;
 	}
 
+	void CConsole::StoreLine(const std::wstring& wszText, const ConColor& rColor)
+	{
+		//Copy line into the ring. Text exceeding the arena slot is continued on further lines
+
+		if (!this->m_vLines.size())
+			return;
+
+		size_t uiPos = 0;
+
+		do {
+			//Overwrite oldest line if the ring is full
+			size_t uiSlot = (this->m_uiFirstLine + this->m_uiLineCount) % this->m_vLines.size();
+			if (this->m_uiLineCount == this->m_vLines.size()) {
+				this->m_uiFirstLine = (this->m_uiFirstLine + 1) % this->m_vLines.size();
+			} else {
+				this->m_uiLineCount++;
+			}
+
+			size_t uiLength = wszText.length() - uiPos;
+			if (uiLength > CON_LINE_CHARS) {
+				uiLength = CON_LINE_CHARS;
+			}
+
+			if (uiLength) {
+				memcpy(&this->m_vArena[uiSlot * CON_LINE_CHARS], wszText.c_str() + uiPos, uiLength * sizeof(wchar_t));
+			}
+
+			this->m_vLines[uiSlot].uiLength = uiLength;
+			this->m_vLines[uiSlot].sColor = rColor;
+
+			uiPos += uiLength;
+		} while (uiPos < wszText.length());
+
+		//Queue for the log file. The log thread only ever waits for this lock briefly
+		if (this->m_pLogThread) {
+			std::lock_guard<std::mutex> oLock(this->m_oLogMutex);
+			this->m_wszLogBuffer += wszText;
+			this->m_wszLogBuffer += L"\n";
+		}
+	}
+
+	bool CConsole::FetchPendingLines(void)
+	{
+		//Take over lines added by other threads
+
+		pending_line_s* pList = this->m_pPending.exchange(nullptr, std::memory_order_acquire);
+		if (!pList)
+			return false;
+
+		//Lines were pushed in front, so reverse to restore their order
+		pending_line_s* pOrdered = nullptr;
+		while (pList) {
+			pending_line_s* pNext = pList->pNext;
+			pList->pNext = pOrdered;
+			pOrdered = pList;
+			pList = pNext;
+		}
+
+		while (pOrdered) {
+			pending_line_s* pNext = pOrdered->pNext;
+			this->StoreLine(pOrdered->wszText, pOrdered->sColor);
+			delete pOrdered;
+			pOrdered = pNext;
+		}
+
+		return true;
+	}
+
 	void CConsole::AddLine(const std::wstring& wszText, const ConColor& rColor)
 	{
-		//Add line
+		//Add line. May be called from any thread
 
-		//Setup data struct
-		console_line_s sLine;
-		sLine.wszText = wszText;
-		sLine.sColor = rColor;
+		if (GetCurrentThreadId() != this->m_dwOwnerThread) {
+			pending_line_s* pLine = new pending_line_s();
+			pLine->wszText = wszText;
+			pLine->sColor = rColor;
+			pLine->pNext = this->m_pPending.load(std::memory_order_relaxed);
 
-		//Add to list
-		this->m_vLines.push_back(sLine);
+			//Push in front of the pending list without locking
+			while (!this->m_pPending.compare_exchange_weak(pLine->pNext, pLine, std::memory_order_release, std::memory_order_relaxed));
 
-		//Check if max history reached and if so remove first element
-		if (this->m_vLines.size() >= (size_t)this->m_wMaxLineHistory) {
-			this->m_vLines.erase(this->m_vLines.begin() + 0);
+			return;
 		}
 
+		//Keep order with lines of other threads added before
+		this->FetchPendingLines();
+
+		this->StoreLine(wszText, rColor);
+
 		//Scroll to end
 		this->ScrollToEnd();
 	}
@@ -92,8 +182,8 @@ namespace Console {
 
 		//The limit is reached if the last lines (from offset to end, depends on 'uiDrawedLines' how many do suit) are visible
 		size_t uiLimit = 0;
-		if (this->m_vLines.size() > this->m_uiDrawedLines)
-			uiLimit = this->m_vLines.size() - this->m_uiDrawedLines;
+		if (this->m_uiLineCount > this->m_uiDrawedLines)
+			uiLimit = this->m_uiLineCount - this->m_uiDrawedLines;
 
 		if (this->m_uiLineOffset < uiLimit)
 			this->m_uiLineOffset++;
@@ -104,17 +194,22 @@ namespace Console {
 		//Scroll to end
 
 		//Only perform scrolling to end if there are enough lines
-		if (this->m_vLines.size() < this->m_uiDrawedLines)
+		if (this->m_uiLineCount < this->m_uiDrawedLines)
 			return;
 
 		//Set line offset so that it draws only the last inserted lines which suit into the area
-		this->m_uiLineOffset = (unsigned int)this->m_vLines.size() - this->m_uiDrawedLines;
+		this->m_uiLineOffset = (unsigned int)this->m_uiLineCount - this->m_uiDrawedLines;
 	}
 
 	void CConsole::Draw(void)
 	{
 		//Draw console
 
+		//Take over lines of other threads even if hidden so that they do not pile up
+		if (this->FetchPendingLines()) {
+			this->ScrollToEnd();
+		}
+
 		if (!this->m_bVisible)
 			return;
 
@@ -122,11 +217,90 @@ namespace Console {
 		this->m_pRenderer->DrawFilledBox(0, 0, this->m_uiConWidth, this->m_uiConHeight, this->m_sOverlayColor.r, this->m_sOverlayColor.g, this->m_sOverlayColor.b, 50);
 	
 		//Calculate limitating conditional value
-		size_t uiBorder = (this->m_vLines.size() < this->m_uiDrawedLines) ? this->m_vLines.size() : this->m_uiDrawedLines;
+		size_t uiBorder = (this->m_uiLineCount < this->m_uiDrawedLines) ? this->m_uiLineCount : this->m_uiDrawedLines;
 
-		//Draw text
+		//Draw text directly from the arena
 		for (size_t i = 0; i < uiBorder; i++) {
-			this->m_pRenderer->DrawString(this->m_pFont, this->m_vLines[i + this->m_uiLineOffset].wszText.c_str(), 10, (int)(i * this->m_uiLineHeight) + 10, this->m_vLines[i + this->m_uiLineOffset].sColor.r, this->m_vLines[i + this->m_uiLineOffset].sColor.g, this->m_vLines[i + this->m_uiLineOffset].sColor.b, 200);
+			const console_line_s& rLine = this->GetLine(i + this->m_uiLineOffset);
+			this->m_pRenderer->DrawString(this->m_pFont, this->GetLineText(i + this->m_uiLineOffset), rLine.uiLength, 10, (int)(i * this->m_uiLineHeight) + 10, rLine.sColor.r, rLine.sColor.g, rLine.sColor.b, 200);
 		}
 	}
+
+	void CConsole::LogWorker(void)
+	{
+		//Append queued lines to the log file in intervals
+
+		std::wofstream hFile;
+		hFile.imbue(std::locale(hFile.getloc(), new std::codecvt_utf8<wchar_t>));
+		hFile.open(this->m_wszLogFile, std::wofstream::out | std::wofstream::app);
+
+		std::wstring wszWrite;
+		std::unique_lock<std::mutex> oLock(this->m_oLogMutex);
+
+		while (true) {
+			this->m_oLogSignal.wait_for(oLock, std::chrono::milliseconds(CON_LOG_FLUSH_INTERVAL), [this]() { return this->m_bLogShutdown; });
+
+			wszWrite.clear();
+			wszWrite.swap(this->m_wszLogBuffer);
+			bool bShutdown = this->m_bLogShutdown;
+
+			oLock.unlock();
+
+			if ((wszWrite.length()) && (hFile.is_open())) {
+				hFile << wszWrite;
+				hFile.flush();
+			}
+
+			oLock.lock();
+
+			if ((bShutdown) && (!this->m_wszLogBuffer.length()))
+				break;
+		}
+
+		hFile.close();
+	}
+
+	bool CConsole::StartLog(const std::wstring& wszFile)
+	{
+		//Start writing console lines to a file on a background thread. The current history is written first
+
+		this->StopLog();
+
+		if (!wszFile.length())
+			return false;
+
+		this->FetchPendingLines();
+
+		this->m_wszLogFile = wszFile;
+		this->m_bLogShutdown = false;
+		this->m_wszLogBuffer.clear();
+
+		for (size_t i = 0; i < this->m_uiLineCount; i++) {
+			this->m_wszLogBuffer.append(this->GetLineText(i), this->GetLine(i).uiLength);
+			this->m_wszLogBuffer += L"\n";
+		}
+
+		this->m_pLogThread = new std::thread(&CConsole::LogWorker, this);
+
+		return true;
+	}
+
+	void CConsole::StopLog(void)
+	{
+		//Write remaining lines and stop log thread
+
+		if (!this->m_pLogThread)
+			return;
+
+		{
+			std::lock_guard<std::mutex> oLock(this->m_oLogMutex);
+			this->m_bLogShutdown = true;
+		}
+
+		this->m_oLogSignal.notify_all();
+
+		this->m_pLogThread->join();
+		delete this->m_pLogThread;
+		this->m_pLogThread = nullptr;
+	}
 }
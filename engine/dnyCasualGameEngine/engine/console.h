@@ -13,8 +13,12 @@
 
 #include "shared.h"
 #include "renderer.h"
+#include <mutex>
+#include <condition_variable>
 
 #define CON_DEFAULT_MAXHISTORY 512
+#define CON_LINE_CHARS 256
+#define CON_LOG_FLUSH_INTERVAL 250
 
 /* Console environment */
 namespace Console {
@@ -34,16 +38,35 @@ namespace Console {
 		void Destruct(void* pMemory) { ((ConColor*)pMemory)->~ConColor(); }
 	};
 
-	class CConsole { //Console manager
+	/* Console manager. Lines are kept in a ring buffer whose text lives in a fixed arena. Lines added by other threads
+	   are handed over lock-free and taken over by the thread owning the console on its next AddLine() or Draw() */
+	class CConsole {
 	private:
 		struct console_line_s {
+			size_t uiLength; //Text is stored in the arena slot of the line
+			ConColor sColor;
+		};
+
+		struct pending_line_s {
 			std::wstring wszText;
 			ConColor sColor;
+			pending_line_s* pNext;
 		};
 
 		DxRenderer::CDxRenderer* m_pRenderer;
 		DxRenderer::d3dfont_s* m_pFont;
-		std::vector<console_line_s> m_vLines;
+		std::vector<console_line_s> m_vLines; //Ring buffer of history size
+		std::vector<wchar_t> m_vArena; //CON_LINE_CHARS per line
+		size_t m_uiFirstLine;
+		size_t m_uiLineCount;
+		std::atomic<pending_line_s*> m_pPending;
+		DWORD m_dwOwnerThread;
+		std::thread* m_pLogThread;
+		std::mutex m_oLogMutex;
+		std::condition_variable m_oLogSignal;
+		std::wstring m_wszLogBuffer;
+		std::wstring m_wszLogFile;
+		bool m_bLogShutdown;
 		unsigned short m_wMaxLineHistory;
 		unsigned int m_uiConWidth;
 		unsigned int m_uiConHeight;
@@ -53,13 +76,20 @@ namespace Console {
 		ConColor m_sOverlayColor;
 		ConColor m_sDefaultColor;
 		bool m_bVisible;
+
+		void StoreLine(const std::wstring& wszText, const ConColor& rColor);
+		bool FetchPendingLines(void);
+		void LogWorker(void);
+
+		const wchar_t* GetLineText(size_t uiLine) const { return &this->m_vArena[((this->m_uiFirstLine + uiLine) % this->m_vLines.size()) * CON_LINE_CHARS]; }
+		const console_line_s& GetLine(size_t uiLine) const { return this->m_vLines[(this->m_uiFirstLine + uiLine) % this->m_vLines.size()]; }
 	public:
-		CConsole() : m_pFont(nullptr), m_uiLineOffset(0), m_bVisible(false) { m_sDefaultColor.r = m_sDefaultColor.g = m_sDefaultColor.b = 220;  }
+		CConsole() : m_pFont(nullptr), m_uiFirstLine(0), m_uiLineCount(0), m_pPending(nullptr), m_dwOwnerThread(GetCurrentThreadId()), m_pLogThread(nullptr), m_bLogShutdown(false), m_uiLineOffset(0), m_bVisible(false) { m_sDefaultColor.r = m_sDefaultColor.g = m_sDefaultColor.b = 220;  }
 		CConsole(DxRenderer::CDxRenderer* pRenderer, int iWidth, int iHeight, unsigned short wMaxHistory, const ConColor& rColor) : CConsole() { this->Initialize(pRenderer, iWidth, iHeight, wMaxHistory, rColor); }
-		~CConsole() { this->Clear(); }
+		~CConsole() { this->StopLog(); this->Clear(); }
 
 		bool Initialize(DxRenderer::CDxRenderer* pRenderer, int iWidth, int iHeight, unsigned short wMaxHistory, const ConColor& rColor);
-		void Clear(void) { this->m_vLines.clear(); }
+		void Clear(void);
 
 		void UpdateRect(int iWidth, int iHeight);
 		void AddLine(const std::wstring& wszText, const ConColor& rColor);
@@ -70,6 +100,9 @@ namespace Console {
 		void ScrollToEnd(void);
 		void Draw(void);
 
+		bool StartLog(const std::wstring& wszFile);
+		void StopLog(void);
+
 		inline bool IsVisible(void) const { return this->m_bVisible; }
 	};
 }
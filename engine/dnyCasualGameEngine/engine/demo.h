@@ -0,0 +1,380 @@
+#pragma once
+
+/*
+	Casual Game Engine (dnyCasualGameEngine) developed by Daniel Brendel
+
+	(C) 2021 - 2022 by Daniel Brendel
+
+	Contact: dbrendel1988<at>gmail<dot>com
+	GitHub: https://github.com/danielbrendel/
+
+	Released under the MIT license
+*/
+
+#include "shared.h"
+#include "utils.h"
+#include "vars.h"
+#include "console.h"
+#include <climits>
+#include <cerrno>
+
+/* Demo recording and playback environment */
+namespace Demo {
+	struct demo_event_s {
+		unsigned long long ullTick;
+		bool bMouse;
+		int iKey;
+		int x, y;
+		bool bDown;
+	};
+
+	struct demo_header_s {
+		std::wstring wszPackage;
+		std::wstring wszMap;
+		unsigned int uiSeed;
+		int iTickRate;
+		unsigned long long ullEndTick;
+	};
+
+	#define DEMO_MAX_TICKRATE 1000
+	#define DEMO_MAX_SECONDS (60 * 60 * 24)
+	#define DEMO_MAX_RESERVED_FRAMES (60 * 60 * 60)
+
+	inline bool ParseTick(const std::string& szToken, unsigned long long& ullOut)
+	{
+		//Parse tick number. The whole token must be an unsigned decimal number within range
+
+		if ((!szToken.length()) || (szToken.find_first_not_of("0123456789") != std::string::npos))
+			return false;
+
+		errno = 0;
+		char* pEnd = nullptr;
+		unsigned long long ullValue = strtoull(szToken.c_str(), &pEnd, 10);
+		if ((*pEnd != 0) || (errno == ERANGE))
+			return false;
+
+		ullOut = ullValue;
+
+		return true;
+	}
+
+	inline bool ParseInt(const std::string& szToken, int& iOut)
+	{
+		//Parse signed decimal number. The whole token must be numeric and fit into an int
+
+		if (!szToken.length())
+			return false;
+
+		errno = 0;
+		char* pEnd = nullptr;
+		long lValue = strtol(szToken.c_str(), &pEnd, 10);
+		if ((*pEnd != 0) || (errno == ERANGE) || (lValue < INT_MIN) || (lValue > INT_MAX))
+			return false;
+
+		iOut = (int)lValue;
+
+		return true;
+	}
+
+	inline std::wstring GetDemoFileName(const std::wstring& wszName)
+	{
+		//Get full path of demo file
+
+		return wszBasePath + L"demos\\" + wszName + L".dem";
+	}
+
+	/* Input event recorder */
+	class CDemoRecorder {
+	private:
+		bool m_bRecording;
+		std::wstring m_wszName;
+		demo_header_s m_sHeader;
+		std::vector<demo_event_s> m_vEvents;
+	public:
+		CDemoRecorder() : m_bRecording(false) {}
+		~CDemoRecorder() {}
+
+		void Start(const std::wstring& wszName, const demo_header_s& sHeader)
+		{
+			//Start recording
+
+			this->m_wszName = wszName;
+			this->m_sHeader = sHeader;
+			this->m_vEvents.clear();
+			this->m_bRecording = true;
+		}
+
+		void AddKeyEvent(unsigned long long ullTick, int vKey, bool bDown)
+		{
+			//Record key event
+
+			if (!this->m_bRecording)
+				return;
+
+			demo_event_s sEvent;
+			sEvent.ullTick = ullTick;
+			sEvent.bMouse = false;
+			sEvent.iKey = vKey;
+			sEvent.x = sEvent.y = 0;
+			sEvent.bDown = bDown;
+
+			this->m_vEvents.push_back(sEvent);
+		}
+
+		void AddMouseEvent(unsigned long long ullTick, int x, int y, int iMouseKey, bool bDown)
+		{
+			//Record mouse event
+
+			if (!this->m_bRecording)
+				return;
+
+			demo_event_s sEvent;
+			sEvent.ullTick = ullTick;
+			sEvent.bMouse = true;
+			sEvent.iKey = iMouseKey;
+			sEvent.x = x;
+			sEvent.y = y;
+			sEvent.bDown = bDown;
+
+			this->m_vEvents.push_back(sEvent);
+		}
+
+		bool Stop(unsigned long long ullEndTick)
+		{
+			//Stop recording and write demo file
+
+			if (!this->m_bRecording)
+				return false;
+
+			this->m_bRecording = false;
+			this->m_sHeader.ullEndTick = ullEndTick;
+
+			CreateDirectory((wszBasePath + L"demos").c_str(), nullptr);
+
+			std::ofstream oFile(Utils::ConvertToAnsiString(GetDemoFileName(this->m_wszName)), std::ofstream::out);
+			if (!oFile.is_open())
+				return false;
+
+			//Write header
+			std::ostringstream oss;
+			oss << "package " << Utils::ConvertToAnsiString(this->m_sHeader.wszPackage) << "\n";
+			oss << "map " << Utils::ConvertToAnsiString(this->m_sHeader.wszMap) << "\n";
+			oss << "seed " << this->m_sHeader.uiSeed << "\n";
+			oss << "tickrate " << this->m_sHeader.iTickRate << "\n";
+
+			//Write events
+			for (size_t i = 0; i < this->m_vEvents.size(); i++) {
+				const demo_event_s& rEvent = this->m_vEvents[i];
+
+				if (rEvent.bMouse) {
+					oss << "mouse " << rEvent.ullTick << " " << rEvent.x << " " << rEvent.y << " " << rEvent.iKey << " " << rEvent.bDown << "\n";
+				} else {
+					oss << "key " << rEvent.ullTick << " " << rEvent.iKey << " " << rEvent.bDown << "\n";
+				}
+			}
+
+			oss << "end " << ullEndTick << "\n";
+
+			//Write in one go
+			std::string szContent = oss.str();
+			oFile.write(szContent.c_str(), szContent.length());
+			oFile.close();
+
+			this->m_vEvents.clear();
+
+			return true;
+		}
+
+		//Getters
+		bool IsRecording(void) const { return this->m_bRecording; }
+		size_t GetEventCount(void) const { return this->m_vEvents.size(); }
+	};
+
+	/* Timedemo player */
+	class CDemoPlayer {
+	private:
+		bool m_bPlaying;
+		demo_header_s m_sHeader;
+		std::vector<demo_event_s> m_vEvents;
+		size_t m_uiNextEvent;
+		std::vector<double> m_vFrameTimes;
+		size_t m_uiEntitiesMin;
+		size_t m_uiEntitiesMax;
+		unsigned long long m_ullEntitiesSum;
+		LONGLONG m_lFrequency;
+		LONGLONG m_lStartCount;
+		LONGLONG m_lLastCount;
+
+		double Percentile(const std::vector<double>& vSorted, double dblPercent)
+		{
+			//Get percentile of sorted list
+
+			if (!vSorted.size())
+				return 0.0;
+
+			size_t uiIndex = (size_t)(dblPercent / 100.0 * (double)(vSorted.size() - 1) + 0.5);
+
+			return vSorted[uiIndex];
+		}
+	public:
+		CDemoPlayer() : m_bPlaying(false), m_uiNextEvent(0) {}
+		~CDemoPlayer() {}
+
+		bool Load(const std::wstring& wszName)
+		{
+			//Load demo file
+
+			std::ifstream oFile(Utils::ConvertToAnsiString(GetDemoFileName(wszName)), std::ifstream::in);
+			if (!oFile.is_open())
+				return false;
+
+			this->m_vEvents.clear();
+			this->m_sHeader.uiSeed = 0;
+			this->m_sHeader.iTickRate = 0;
+			this->m_sHeader.ullEndTick = 0;
+
+			std::string szLine;
+			while (std::getline(oFile, szLine)) {
+				std::vector<std::string> vTokens = Utils::Split(szLine, " ");
+				if (vTokens.size() < 2)
+					continue;
+
+				bool bValid = true;
+
+				if (vTokens[0] == "package") {
+					this->m_sHeader.wszPackage = Utils::ConvertToWideString(vTokens[1]);
+				} else if (vTokens[0] == "map") {
+					this->m_sHeader.wszMap = Utils::ConvertToWideString(vTokens[1]);
+				} else if (vTokens[0] == "seed") {
+					unsigned long long ullSeed = 0;
+					bValid = (ParseTick(vTokens[1], ullSeed)) && (ullSeed <= UINT_MAX);
+					this->m_sHeader.uiSeed = (unsigned int)ullSeed;
+				} else if (vTokens[0] == "tickrate") {
+					bValid = ParseInt(vTokens[1], this->m_sHeader.iTickRate);
+				} else if (vTokens[0] == "end") {
+					bValid = ParseTick(vTokens[1], this->m_sHeader.ullEndTick);
+				} else if ((vTokens[0] == "key") && (vTokens.size() == 4)) {
+					demo_event_s sEvent;
+					sEvent.bMouse = false;
+					sEvent.x = sEvent.y = 0;
+					sEvent.bDown = vTokens[3] == "1";
+					bValid = (ParseTick(vTokens[1], sEvent.ullTick)) && (ParseInt(vTokens[2], sEvent.iKey));
+					if (bValid) this->m_vEvents.push_back(sEvent);
+				} else if ((vTokens[0] == "mouse") && (vTokens.size() == 6)) {
+					demo_event_s sEvent;
+					sEvent.bMouse = true;
+					sEvent.bDown = vTokens[5] == "1";
+					bValid = (ParseTick(vTokens[1], sEvent.ullTick)) && (ParseInt(vTokens[2], sEvent.x)) && (ParseInt(vTokens[3], sEvent.y)) && (ParseInt(vTokens[4], sEvent.iKey));
+					if (bValid) this->m_vEvents.push_back(sEvent);
+				}
+
+				//Truncated or edited files are rejected as a whole
+				if (!bValid) {
+					oFile.close();
+					this->m_vEvents.clear();
+					return false;
+				}
+			}
+
+			oFile.close();
+
+			if ((!this->m_sHeader.wszPackage.length()) || (!this->m_sHeader.wszMap.length()) || (this->m_sHeader.iTickRate <= 0) || (this->m_sHeader.iTickRate > DEMO_MAX_TICKRATE))
+				return false;
+
+			if (this->m_sHeader.ullEndTick > (unsigned long long)DEMO_MAX_SECONDS * this->m_sHeader.iTickRate)
+				return false;
+
+			//Events must be in tick order and within the recorded span
+			for (size_t i = 0; i < this->m_vEvents.size(); i++) {
+				if (((i) && (this->m_vEvents[i].ullTick < this->m_vEvents[i - 1].ullTick)) || (this->m_vEvents[i].ullTick > this->m_sHeader.ullEndTick))
+					return false;
+			}
+
+			return true;
+		}
+
+		void Start(void)
+		{
+			//Start playback
+
+			this->m_uiNextEvent = 0;
+			this->m_vFrameTimes.clear();
+			this->m_vFrameTimes.reserve((size_t)((this->m_sHeader.ullEndTick < DEMO_MAX_RESERVED_FRAMES) ? this->m_sHeader.ullEndTick : DEMO_MAX_RESERVED_FRAMES));
+			this->m_uiEntitiesMin = (size_t)-1;
+			this->m_uiEntitiesMax = 0;
+			this->m_ullEntitiesSum = 0;
+
+			QueryPerformanceFrequency((LARGE_INTEGER*)&this->m_lFrequency);
+			QueryPerformanceCounter((LARGE_INTEGER*)&this->m_lStartCount);
+			this->m_lLastCount = this->m_lStartCount;
+
+			this->m_bPlaying = true;
+		}
+
+		bool NextEvent(unsigned long long ullTick, demo_event_s& sEventOut)
+		{
+			//Fetch next event due at the given tick
+
+			if ((this->m_uiNextEvent >= this->m_vEvents.size()) || (this->m_vEvents[this->m_uiNextEvent].ullTick > ullTick))
+				return false;
+
+			sEventOut = this->m_vEvents[this->m_uiNextEvent++];
+
+			return true;
+		}
+
+		void AddFrameSample(size_t uiEntityCount)
+		{
+			//Store frame time since last sample and entity count
+
+			LONGLONG lCurCount;
+			QueryPerformanceCounter((LARGE_INTEGER*)&lCurCount);
+
+			this->m_vFrameTimes.push_back((double)(lCurCount - this->m_lLastCount) * 1000.0 / (double)this->m_lFrequency);
+			this->m_lLastCount = lCurCount;
+
+			if (uiEntityCount < this->m_uiEntitiesMin) {
+				this->m_uiEntitiesMin = uiEntityCount;
+			}
+
+			if (uiEntityCount > this->m_uiEntitiesMax) {
+				this->m_uiEntitiesMax = uiEntityCount;
+			}
+
+			this->m_ullEntitiesSum += uiEntityCount;
+		}
+
+		void Finish(void)
+		{
+			//Stop playback and print results
+
+			this->m_bPlaying = false;
+
+			if (!this->m_vFrameTimes.size()) {
+				pConsole->AddLine(L"timedemo: no frames processed");
+				return;
+			}
+
+			double dblTotal = (double)(this->m_lLastCount - this->m_lStartCount) * 1000.0 / (double)this->m_lFrequency;
+
+			std::vector<double> vSorted = this->m_vFrameTimes;
+			std::sort(vSorted.begin(), vSorted.end());
+
+			wchar_t wszResult[512];
+			swprintf_s(wszResult, L"timedemo: %u frames in %.1f ms (%.1f fps), frame time avg %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms",
+				(unsigned int)vSorted.size(), dblTotal, (double)vSorted.size() * 1000.0 / dblTotal,
+				dblTotal / (double)vSorted.size(), this->Percentile(vSorted, 50.0), this->Percentile(vSorted, 99.0), vSorted[vSorted.size() - 1]);
+			pConsole->AddLine(wszResult);
+
+			swprintf_s(wszResult, L"timedemo: entities min %u, avg %.1f, max %u",
+				(unsigned int)this->m_uiEntitiesMin, (double)this->m_ullEntitiesSum / (double)vSorted.size(), (unsigned int)this->m_uiEntitiesMax);
+			pConsole->AddLine(wszResult);
+		}
+
+		//Getters
+		bool IsPlaying(void) const { return this->m_bPlaying; }
+		bool HasPendingEvents(void) const { return this->m_uiNextEvent < this->m_vEvents.size(); }
+		bool IsFinished(unsigned long long ullTick) const { return ullTick >= this->m_sHeader.ullEndTick; }
+		const demo_header_s& GetHeader(void) const { return this->m_sHeader; }
+	};
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+/*
+	Casual Game Engine (dnyCasualGameEngine) developed by Daniel Brendel
+
+	(C) 2021 - 2022 by Daniel Brendel
+
+	Contact: dbrendel1988<at>gmail<dot>com
+	GitHub: https://github.com/danielbrendel/
+
+	Released under the MIT license
+*/
+
+#include "shared.h"
+#include "mixer.h"
+#include <mmsystem.h>
+#include <dsound.h>
+
+/* DirectSound output device of the software mixer */
+namespace DxSound {
+	#define DSOUT_BUFFER_BLOCKS 8
+
+	/* Output device playing mixed blocks on a looping DirectSound buffer */
+	class CDirectSoundMixerOutput : public IMixerOutput {
+	private:
+		HWND m_hWindow;
+		LPDIRECTSOUND8 m_pSoundDevice;
+		IDirectSoundBuffer8* m_pBuffer;
+		DWORD m_dwBufferSize;
+		DWORD m_dwWritePos;
+	public:
+		CDirectSoundMixerOutput(HWND hWindow) : m_hWindow(hWindow), m_pSoundDevice(nullptr), m_pBuffer(nullptr), m_dwBufferSize(0), m_dwWritePos(0) {}
+		virtual ~CDirectSoundMixerOutput() { this->Close(); }
+
+		virtual bool Open(unsigned int uiSampleRate, unsigned int uiChannels)
+		{
+			//Create sound device and start the looping output buffer
+
+			//Check window handle
+			if (!IsWindow(this->m_hWindow))
+				return false;
+
+			//Create sound device
+			if (FAILED(DirectSoundCreate8(nullptr, &this->m_pSoundDevice, nullptr)))
+				return false;
+
+			//Set cooperative level
+			if (FAILED(this->m_pSoundDevice->SetCooperativeLevel(this->m_hWindow, DSSCL_PRIORITY))) {
+				this->Close();
+				return false;
+			}
+
+			//Setup wave format data
+			WAVEFORMATEX sWaveFmt = { 0 };
+			sWaveFmt.wFormatTag = WAVE_FORMAT_PCM;
+			sWaveFmt.nChannels = (WORD)uiChannels;
+			sWaveFmt.nSamplesPerSec = uiSampleRate;
+			sWaveFmt.wBitsPerSample = 16;
+			sWaveFmt.nBlockAlign = (sWaveFmt.wBitsPerSample / 8) * sWaveFmt.nChannels;
+			sWaveFmt.nAvgBytesPerSec = sWaveFmt.nSamplesPerSec * sWaveFmt.nBlockAlign;
+
+			this->m_dwBufferSize = MIX_BLOCK_FRAMES * sWaveFmt.nBlockAlign * DSOUT_BUFFER_BLOCKS;
+
+			//Setup buffer description data
+			DSBUFFERDESC sBufferDesc = { 0 };
+			sBufferDesc.dwSize = sizeof(DSBUFFERDESC);
+			sBufferDesc.dwFlags = DSBCAPS_GETCURRENTPOSITION2;
+			sBufferDesc.dwBufferBytes = this->m_dwBufferSize;
+			sBufferDesc.lpwfxFormat = &sWaveFmt;
+			sBufferDesc.guid3DAlgorithm = GUID_NULL;
+
+			LPDIRECTSOUNDBUFFER pTempSoundBuffer = nullptr;
+
+			if (FAILED(this->m_pSoundDevice->CreateSoundBuffer(&sBufferDesc, &pTempSoundBuffer, nullptr))) {
+				this->Close();
+				return false;
+			}
+
+			HRESULT hResult = pTempSoundBuffer->QueryInterface(IID_IDirectSoundBuffer8, (LPVOID*)&this->m_pBuffer);
+			pTempSoundBuffer->Release();
+
+			if (FAILED(hResult)) {
+				this->m_pBuffer = nullptr;
+				this->Close();
+				return false;
+			}
+
+			//Start with silence. The first write is placed ahead of the play cursor
+			LPVOID lpvDataPtr1 = nullptr, lpvDataPtr2 = nullptr;
+			DWORD dwDataSize1 = 0, dwDataSize2 = 0;
+
+			if (SUCCEEDED(this->m_pBuffer->Lock(0, this->m_dwBufferSize, &lpvDataPtr1, &dwDataSize1, &lpvDataPtr2, &dwDataSize2, 0))) {
+				memset(lpvDataPtr1, 0x00, dwDataSize1);
+				this->m_pBuffer->Unlock(lpvDataPtr1, dwDataSize1, lpvDataPtr2, dwDataSize2);
+			}
+
+			this->m_dwWritePos = 0;
+
+			if (FAILED(this->m_pBuffer->Play(0, 0, DSBPLAY_LOOPING))) {
+				this->Close();
+				return false;
+			}
+
+			return true;
+		}
+
+		virtual bool Write(const short* pFrames, size_t uiFrames)
+		{
+			//Copy frames to the output buffer. Never blocks, the mixer thread keeps pace with the sample rate
+
+			if (!this->m_pBuffer)
+				return false;
+
+			DWORD dwBytes = (DWORD)(uiFrames * MIX_CHANNELS * sizeof(short));
+			DWORD dwPlayPos = 0;
+
+			if (FAILED(this->m_pBuffer->GetCurrentPosition(&dwPlayPos, nullptr)))
+				return false;
+
+			//At most half of the buffer is written ahead. A larger distance means the play cursor has passed the write position
+			DWORD dwAhead = (this->m_dwWritePos + this->m_dwBufferSize - dwPlayPos) % this->m_dwBufferSize;
+
+			if (dwAhead > this->m_dwBufferSize / 2) {
+				this->m_dwWritePos = (dwPlayPos + dwBytes) % this->m_dwBufferSize;
+			} else if (dwAhead + dwBytes > this->m_dwBufferSize / 2) {
+				return true; //Device clock runs slower than the mixer, drop block
+			}
+
+			LPVOID lpvDataPtr1 = nullptr, lpvDataPtr2 = nullptr;
+			DWORD dwDataSize1 = 0, dwDataSize2 = 0;
+
+			if (FAILED(this->m_pBuffer->Lock(this->m_dwWritePos, dwBytes, &lpvDataPtr1, &dwDataSize1, &lpvDataPtr2, &dwDataSize2, 0)))
+				return false;
+
+			memcpy(lpvDataPtr1, pFrames, dwDataSize1);
+
+			if (lpvDataPtr2) {
+				memcpy(lpvDataPtr2, (const unsigned char*)pFrames + dwDataSize1, dwDataSize2);
+			}
+
+			this->m_dwWritePos = (this->m_dwWritePos + dwBytes) % this->m_dwBufferSize;
+
+			return SUCCEEDED(this->m_pBuffer->Unlock(lpvDataPtr1, dwDataSize1, lpvDataPtr2, dwDataSize2));
+		}
+
+		virtual void Close(void)
+		{
+			//Stop output and release device
+
+			if (this->m_pBuffer) {
+				this->m_pBuffer->Stop();
+				this->m_pBuffer->Release();
+				this->m_pBuffer = nullptr;
+			}
+
+			if (this->m_pSoundDevice) {
+				this->m_pSoundDevice->Release();
+				this->m_pSoundDevice = nullptr;
+			}
+		}
+	};
+}
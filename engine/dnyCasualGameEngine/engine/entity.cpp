@@ -1,6 +1,7 @@
 #include "entity.h"
 #include "console.h"
 #include "game.h"
+#include <mutex>
 
 /*
 	Casual Game Engine (dnyCasualGameEngine) developed by Daniel Brendel
@@ -18,13 +19,17 @@ namespace Entity {
 	{
 		//Spawn new entity
 		
+		//Entities need the world they are spawned into
+		if (!this->m_pHost)
+			return false;
+
 		//Query script ident
-		Scripting::HSISCRIPT hScript = Game::pGame->GetScriptHandleByIdent(wszIdent);
+		Scripting::HSISCRIPT hScript = this->m_pHost->ResolveScript(wszIdent);
 		if (hScript == SI_INVALID_ID)
 			return false;
 		
 		//Instantiate entity object
-		CScriptedEntity* pEntity = new CScriptedEntity(hScript, pObject);
+		CScriptedEntity* pEntity = new CScriptedEntity(this->m_pScriptInt, hScript, pObject);
 		if (!pEntity)
 			return false;
 		
@@ -33,6 +38,9 @@ namespace Entity {
 			delete pEntity;
 			return false;
 		}
+
+		//Keep spawn ident, snapshots use it to recreate the entity
+		pEntity->SetIdent(wszIdent);
 		
 		//Call spawn function if required
 		pEntity->OnSpawn(vAtPos);
@@ -90,7 +98,7 @@ namespace Entity {
 			//Check for removal
 			if (this->m_vEnts[i]->NeedsRemoval()) {
 				if (this->m_vEnts[i]->GetName() == "player") {
-					Game::pGame->ShowGameOver();
+					this->m_pHost->OnPlayerRemoved();
 					return;
 				}
 				
@@ -99,18 +107,662 @@ namespace Entity {
 				this->m_vEnts.erase(this->m_vEnts.begin() + i);
 			}
 		}
+
+		//Move entities according to their movement intent
+		this->ProcessMovement();
+	}
+
+	void CScriptedEntsMgr::ProcessMovement(void)
+	{
+		//Integrate all moving entities in one pass
+
+		CWorld* pWorld = GetActiveWorld();
+		if (!pWorld)
+			return;
+
+		for (size_t i = 0; i < this->m_vEnts.size(); i++) {
+			CScriptedEntity* pEntity = this->m_vEnts[i];
+			if (!pEntity->IsMoving())
+				continue;
+
+			//Dormant entities do not move
+			if ((pEntity->CanBeDormant()) && (this->IsEntityDormant(pEntity)))
+				continue;
+
+			const CScriptedEntity::movement_s& rMovement = pEntity->GetMovement();
+
+			//Calculate new position
+			Vector vecPosition = pEntity->GetPosition();
+			if (!CalcMovement(vecPosition, rMovement.fHeading, rMovement.fSpeed, rMovement.eDir))
+				continue;
+
+			//If not collided then move forward
+			if (!pWorld->IsVectorFieldInsideWall(vecPosition, rMovement.vecSize)) {
+				pEntity->SetPosition(vecPosition);
+			} else {
+				pEntity->OnWallCollided();
+			}
+		}
+	}
+
+	bool CalcMovement(Vector& vecPosition, float fRotation, float fSpeed, MovementDir dir)
+	{
+		//Calculate forward or backward vector according to dir
+
+		CWorld* pWorld = GetActiveWorld();
+		if (!pWorld)
+			return false;
+
+		int iFrameRate = pWorld->GetStepRate(); //Fixed time step in deterministic mode
+		if (iFrameRate <= 0)
+			return false;
+
+		if (dir == MOVE_FORWARD) {
+			vecPosition[0] += (int)(sin(fRotation + 0.015) * fSpeed) / iFrameRate;
+			vecPosition[1] -= (int)(cos(fRotation + 0.015) * fSpeed) / iFrameRate;
+		} else if (dir == MOVE_BACKWARD) {
+			vecPosition[0] -= (int)(sin(fRotation + 0.015) * fSpeed) / iFrameRate;
+			vecPosition[1] += (int)(cos(fRotation + 0.015) * fSpeed) / iFrameRate;
+		} else if (dir == MOVE_LEFT) {
+			vecPosition[0] += (int)(sin(fRotation + 80.0) * fSpeed) / iFrameRate;
+			vecPosition[1] -= (int)(cos(fRotation + 80.0) * fSpeed) / iFrameRate;
+		} else if (dir == MOVE_RIGHT) {
+			vecPosition[0] -= (int)(sin(fRotation + 80.0) * fSpeed) / iFrameRate;
+			vecPosition[1] += (int)(cos(fRotation + 80.0) * fSpeed) / iFrameRate;
+		} else if (dir == MOVE_NORTH) {
+			vecPosition[1] -= (int)(cos(0.015) * fSpeed) / iFrameRate;
+		} else if (dir == MOVE_SOUTH) {
+			vecPosition[1] += (int)(cos(0.015) * fSpeed) / iFrameRate;
+		} else if (dir == MOVE_WEST) {
+			vecPosition[0] -= (int)(cos(0.015) * fSpeed) / iFrameRate;
+		} else if (dir == MOVE_EAST) {
+			vecPosition[0] += (int)(cos(0.015) * fSpeed) / iFrameRate;
+		}
+
+		return true;
+	}
+
+	static thread_local CWorld* pThreadWorld = nullptr;
+
+	CWorld* GetActiveWorld(void)
+	{
+		//Get world of the currently executing script or else of the calling thread. Threads without a bound world get nullptr
+
+		asIScriptContext* pContext = asGetActiveContext();
+		if (pContext) {
+			CWorld* pWorld = (CWorld*)pContext->GetUserData(SI_USERDATA_WORLD);
+			if (pWorld) {
+				return pWorld;
+			}
+		}
+
+		return pThreadWorld;
+	}
+
+	void SetActiveWorld(CWorld* pWorld)
+	{
+		//Bind world to calling thread
+
+		pThreadWorld = pWorld;
+	}
+
+	CScriptedEntsMgr& GetEntityManager(void)
+	{
+		//Get entity manager of active world. Threads without a bound world see an empty manager
+
+		static CScriptedEntsMgr oNoEntities;
+
+		CWorld* pWorld = GetActiveWorld();
+		if (!pWorld)
+			return oNoEntities;
+
+		return pWorld->Entities();
+	}
+
+	Scripting::CScriptInt* GetScriptInt(void)
+	{
+		//Get script interface of the active world. Code running outside of any world uses the global interface
+
+		CWorld* pWorld = GetActiveWorld();
+		if ((pWorld) && (pWorld->ScriptInt()))
+			return pWorld->ScriptInt();
+
+		return pScriptingInt;
+	}
+
+	DWORD GetSimulationTime(void)
+	{
+		//Get current time. In deterministic mode the time is derived from the world tick count
+
+		CWorld* pWorld = GetActiveWorld();
+		if ((pWorld) && (pWorld->Settings().bDeterministic)) {
+			return pWorld->GetSimulationTime();
+		}
+
+		return GetTickCount();
+	}
+
+	DxRenderer::HD3DSPRITE LoadAssetSprite(const std::wstring& wszFile, int iFrameCount, int iFrameWidth, int iFrameHeight, int iFramesPerLine, bool bForceCustomSize)
+	{
+		//Load sprite through the host of the active world. The game hands out sprites of its asset prefetcher
+
+		CWorld* pWorld = GetActiveWorld();
+		if ((!pWorld) || (!pWorld->Host()))
+			return GFX_INVALID_SPRITE_ID;
+
+		return pWorld->Host()->LoadSprite(wszFile, iFrameCount, iFrameWidth, iFrameHeight, iFramesPerLine, bForceCustomSize);
+	}
+
+	bool FreeAssetSprite(DxRenderer::HD3DSPRITE hSprite)
+	{
+		//Hand sprite back to the host of the active world
+
+		CWorld* pWorld = GetActiveWorld();
+		if ((!pWorld) || (!pWorld->Host()))
+			return false;
+
+		return pWorld->Host()->FreeSprite(hSprite);
+	}
+
+	void CWorld::Process(void)
+	{
+		//Process world on the calling thread
+
+		CWorld* pPrevWorld = pThreadWorld;
+		SetActiveWorld(this);
+
+		//Process scripted entities
+		this->m_oEntities.Process();
+
+		//Process goal entity
+		if (this->m_pGoalEntity) {
+			this->m_pGoalEntity->Process();
+		}
+
+		this->m_ullTick++;
+
+		//Compute state hash if required
+		if ((this->m_sSettings.bDeterministic) || (this->m_sSettings.bHashLog)) {
+			this->UpdateStateHash();
+
+			if ((this->m_sSettings.bHashLog) && (this->m_pHost)) {
+				wchar_t wszHash[32];
+				swprintf_s(wszHash, L"%08X", this->m_uiStateHash);
+				this->m_pHost->Log(L"tick " + std::to_wstring(this->m_ullTick) + L": " + wszHash);
+			}
+		}
+
+		//Capture rewind snapshot if required
+		if (this->m_sSettings.bRewind) {
+			this->m_oRewind.Capture(this);
+		}
+
+		SetActiveWorld(pPrevWorld);
+	}
+
+	void CRewindBuffer::EncodeDelta(const std::string& szPrev, const std::string& szCur, std::string& szOut)
+	{
+		//Encode current data as XOR against previous data. Output is a list of (unchanged count, changed count, changed bytes)
+
+		szOut.clear();
+
+		size_t uiPos = 0;
+		while (uiPos < szCur.length()) {
+			//Count unchanged bytes
+			unsigned int uiSame = 0;
+			while ((uiPos < szCur.length()) && (uiPos < szPrev.length()) && (szCur[uiPos] == szPrev[uiPos])) {
+				uiSame++;
+				uiPos++;
+			}
+
+			//Count changed bytes
+			size_t uiStart = uiPos;
+			while ((uiPos < szCur.length()) && ((uiPos >= szPrev.length()) || (szCur[uiPos] != szPrev[uiPos]))) {
+				uiPos++;
+			}
+
+			unsigned int uiChanged = (unsigned int)(uiPos - uiStart);
+
+			szOut.append((const char*)&uiSame, sizeof(uiSame));
+			szOut.append((const char*)&uiChanged, sizeof(uiChanged));
+
+			for (size_t i = uiStart; i < uiPos; i++) {
+				szOut.push_back((i < szPrev.length()) ? szCur[i] ^ szPrev[i] : szCur[i]);
+			}
+		}
+	}
+
+	void CRewindBuffer::DecodeDelta(const std::string& szPrev, const rewind_entry_s& sEntry, std::string& szOut)
+	{
+		//Apply delta to previous data
+
+		szOut = szPrev;
+		szOut.resize(sEntry.uiFullSize, 0);
+
+		size_t uiPos = 0;
+		size_t uiRead = 0;
+		const std::string& szDelta = sEntry.szDelta;
+
+		while (uiRead + sizeof(unsigned int) * 2 <= szDelta.length()) {
+			unsigned int uiSame, uiChanged;
+			memcpy(&uiSame, szDelta.data() + uiRead, sizeof(uiSame));
+			memcpy(&uiChanged, szDelta.data() + uiRead + sizeof(uiSame), sizeof(uiChanged));
+			uiRead += sizeof(unsigned int) * 2;
+
+			uiPos += uiSame;
+
+			for (unsigned int i = 0; (i < uiChanged) && (uiPos < szOut.length()) && (uiRead < szDelta.length()); i++) {
+				szOut[uiPos++] ^= szDelta[uiRead++];
+			}
+		}
+	}
+
+	void CRewindBuffer::DropOldest(void)
+	{
+		//Drop oldest entry. Its successor becomes the new base
+
+		if (this->m_uiCount > 1) {
+			std::string szNewBase;
+			DecodeDelta(this->m_szBase, this->Entry(1), szNewBase);
+			this->m_szBase.swap(szNewBase);
+		}
+
+		this->Entry(0).szDelta.clear();
+		this->m_uiHead = (this->m_uiHead + 1) % this->m_vEntries.size();
+		this->m_uiCount--;
+	}
+
+	void CRewindBuffer::Grow(void)
+	{
+		//Double the amount of entries while keeping the buffered ones in order
+
+		std::vector<rewind_entry_s> vEntries((this->m_vEntries.size() * 2 > REWIND_MIN_CAPACITY) ? this->m_vEntries.size() * 2 : REWIND_MIN_CAPACITY);
+
+		for (size_t i = 0; i < this->m_uiCount; i++) {
+			rewind_entry_s& rEntry = this->Entry(i);
+
+			vEntries[i].ullTick = rEntry.ullTick;
+			vEntries[i].dblTime = rEntry.dblTime;
+			vEntries[i].uiFullSize = rEntry.uiFullSize;
+			vEntries[i].szDelta.swap(rEntry.szDelta);
+		}
+
+		this->m_vEntries.swap(vEntries);
+		this->m_uiHead = 0;
+	}
+
+	void CRewindBuffer::Capture(CWorld* pWorld)
+	{
+		//Capture world snapshot every few ticks. Snapshots are kept for the configured span of simulation time,
+		//so the buffer holds the same time span whether ticks have a fixed length or follow the frame rate
+
+		const world_settings_s& rSettings = pWorld->Settings();
+
+		int iTickRate = pWorld->GetStepRate();
+		if (iTickRate > 0) {
+			this->m_dblTime += 1000.0 / (double)iTickRate;
+		}
+
+		if ((rSettings.iRewindInterval <= 0) || (rSettings.iRewindSeconds <= 0) || (pWorld->GetTick() % (unsigned long long)rSettings.iRewindInterval))
+			return;
+
+		LONGLONG lStartCount, lEndCount;
+		QueryPerformanceCounter((LARGE_INTEGER*)&lStartCount);
+
+		//Entity scripts change their state without notifying the world, so the whole state is written and only the delta is kept
+		this->m_oCapture.Clear();
+		pWorld->WriteSnapshot(this->m_oCapture);
+
+		//Drop entries which have left the time span
+		double dblSpan = (double)rSettings.iRewindSeconds * 1000.0;
+		while ((this->m_uiCount) && (this->m_dblTime - this->Entry(0).dblTime > dblSpan)) {
+			this->DropOldest();
+		}
+
+		//The span holds more snapshots than before, e.g. after the frame rate went up
+		if (this->m_uiCount == this->m_vEntries.size()) {
+			this->Grow();
+		}
+
+		rewind_entry_s& rEntry = this->Entry(this->m_uiCount);
+		rEntry.ullTick = pWorld->GetTick();
+		rEntry.dblTime = this->m_dblTime;
+		rEntry.uiFullSize = this->m_oCapture.GetSize();
+
+		if (!this->m_uiCount) {
+			this->m_szBase = this->m_oCapture.GetData();
+			rEntry.szDelta.clear();
+		} else {
+			EncodeDelta(this->m_oLatest.GetData(), this->m_oCapture.GetData(), rEntry.szDelta);
+		}
+
+		this->m_oLatest.Swap(this->m_oCapture);
+		this->m_uiCount++;
+
+		QueryPerformanceCounter((LARGE_INTEGER*)&lEndCount);
+
+		this->m_ullCaptures++;
+		this->m_lCaptureTime += lEndCount - lStartCount;
+	}
+
+	bool CRewindBuffer::Rewind(CWorld* pWorld, unsigned long long ullTick)
+	{
+		//Restore latest buffered snapshot at or before the given tick and discard newer ones
+
+		if ((!this->m_uiCount) || (ullTick < this->GetOldestTick()))
+			return false;
+
+		//Rebuild full snapshot data from base
+		std::string szData = this->m_szBase;
+		size_t uiIndex = 0;
+
+		while ((uiIndex + 1 < this->m_uiCount) && (this->Entry(uiIndex + 1).ullTick <= ullTick)) {
+			std::string szNext;
+			DecodeDelta(szData, this->Entry(uiIndex + 1), szNext);
+			szData.swap(szNext);
+			uiIndex++;
+		}
+
+		CSnapshotBuffer oSnapshot;
+		oSnapshot.Assign(szData);
+
+		if (!pWorld->ReadSnapshot(oSnapshot))
+			return false;
+
+		//Continue capturing from the restored snapshot
+		for (size_t i = uiIndex + 1; i < this->m_uiCount; i++) {
+			this->Entry(i).szDelta.clear();
+		}
+
+		this->m_uiCount = uiIndex + 1;
+		this->m_dblTime = this->Entry(uiIndex).dblTime;
+		this->m_oLatest.Assign(szData);
+
+		return true;
+	}
+
+	void CWorld::UpdateStateHash(void)
+	{
+		//Hash native entity state of the current tick. Entities are hashed in spawn order. Only state the engine holds
+		//itself is used, so hashing does not call into scripts
+
+		unsigned int uiHash = Utils::HashData(&this->m_ullTick, sizeof(this->m_ullTick));
+
+		size_t uiCount = this->m_oEntities.GetEntityCount();
+		uiHash = Utils::HashData(&uiCount, sizeof(uiCount), uiHash);
+
+		for (size_t i = 0; i < uiCount; i++) {
+			CScriptedEntity* pEntity = this->m_oEntities.GetEntity(i);
+
+			const Vector& rPos = pEntity->GetLastPosition();
+			int aPos[2] = { rPos[0], rPos[1] };
+			uiHash = Utils::HashData(aPos, sizeof(aPos), uiHash);
+
+			//Floats are hashed by their bits, so any drift changes the hash
+			const CScriptedEntity::movement_s& rMovement = pEntity->GetMovement();
+			uiHash = Utils::HashData(&rMovement.bActive, sizeof(rMovement.bActive), uiHash);
+			uiHash = Utils::HashData(&rMovement.fSpeed, sizeof(rMovement.fSpeed), uiHash);
+			uiHash = Utils::HashData(&rMovement.fHeading, sizeof(rMovement.fHeading), uiHash);
+			uiHash = Utils::HashData(&rMovement.eDir, sizeof(rMovement.eDir), uiHash);
+
+			int aSize[2] = { rMovement.vecSize[0], rMovement.vecSize[1] };
+			uiHash = Utils::HashData(aSize, sizeof(aSize), uiHash);
+		}
+
+		unsigned int uiRandomState = this->m_oRandom.GetState();
+		this->m_uiStateHash = Utils::HashData(&uiRandomState, sizeof(uiRandomState), uiHash);
+	}
+
+	void CWorld::WriteSnapshot(CSnapshotBuffer& oBuffer)
+	{
+		//Write simulation state and native entity state. Scripts may add own data via SaveSnapshot(). The spawn ident
+		//and script class are stored so entities spawned during play can be recreated
+
+		const size_t C_ESTIMATED_ENTITY_SIZE = 64;
+
+		unsigned int uiCount = (unsigned int)this->m_oEntities.GetEntityCount();
+		unsigned int uiRandomState = this->m_oRandom.GetState();
+		bool bGoalActivated = (this->m_pGoalEntity) ? this->m_pGoalEntity->IsActivated() : false;
+
+		oBuffer.Reserve(oBuffer.GetSize() + uiCount * C_ESTIMATED_ENTITY_SIZE);
+
+		oBuffer.Write(&this->m_ullTick, sizeof(this->m_ullTick));
+		oBuffer.Write(&uiRandomState, sizeof(uiRandomState));
+		oBuffer.Write(&bGoalActivated, sizeof(bGoalActivated));
+		oBuffer.Write(&uiCount, sizeof(uiCount));
+
+		for (unsigned int i = 0; i < uiCount; i++) {
+			CScriptedEntity* pEntity = this->m_oEntities.GetEntity(i);
+
+			Vector vecPos = pEntity->GetPosition();
+			int aPos[2] = { vecPos[0], vecPos[1] };
+			float fRotation = pEntity->GetRotation();
+			const CScriptedEntity::movement_s& rMovement = pEntity->GetMovement();
+			int aSize[2] = { rMovement.vecSize[0], rMovement.vecSize[1] };
+			int iDir = (int)rMovement.eDir;
+
+			oBuffer.WriteString(pEntity->GetName());
+			oBuffer.WriteString(Utils::ConvertToAnsiString(pEntity->GetIdent()));
+			oBuffer.WriteString(pEntity->GetScriptClassName());
+			oBuffer.Write(aPos, sizeof(aPos));
+			oBuffer.Write(&fRotation, sizeof(fRotation));
+			oBuffer.Write(&rMovement.bActive, sizeof(rMovement.bActive));
+			oBuffer.Write(&rMovement.fSpeed, sizeof(rMovement.fSpeed));
+			oBuffer.Write(&rMovement.fHeading, sizeof(rMovement.fHeading));
+			oBuffer.Write(&iDir, sizeof(iDir));
+			oBuffer.Write(aSize, sizeof(aSize));
+			oBuffer.WriteString(pEntity->SaveSnapshot());
+		}
+	}
+
+	bool CWorld::ReadSnapshot(CSnapshotBuffer& oBuffer)
+	{
+		//Restore state in one pass. Snapshot entities are matched to live entities by name and spawn order,
+		//live entities without a counterpart are removed. Entities which are not alive after map loading are
+		//spawned again if their class implements RestoreSnapshot(), other ones (e.g. projectiles) are skipped
+
+		struct name_cursor_s {
+			std::string szName;
+			size_t uiNext;
+		};
+
+		unsigned long long ullTick;
+		unsigned int uiRandomState;
+		bool bGoalActivated;
+		unsigned int uiCount;
+
+		if ((!oBuffer.Read(&ullTick, sizeof(ullTick))) || (!oBuffer.Read(&uiRandomState, sizeof(uiRandomState))) || (!oBuffer.Read(&bGoalActivated, sizeof(bGoalActivated))) || (!oBuffer.Read(&uiCount, sizeof(uiCount))))
+			return false;
+
+		CWorld* pPrevWorld = pThreadWorld;
+		SetActiveWorld(this);
+
+		//Cache names of live entities
+		size_t uiLiveCount = this->m_oEntities.GetEntityCount();
+		std::vector<std::string> vLiveNames;
+		std::vector<bool> vMatched(uiLiveCount, false);
+		std::vector<name_cursor_s> vCursors;
+
+		vLiveNames.reserve(uiLiveCount);
+		for (size_t i = 0; i < uiLiveCount; i++) {
+			vLiveNames.push_back(this->m_oEntities.GetEntity(i)->GetName());
+		}
+
+		bool bResult = true;
+		size_t uiSkipped = 0;
+		size_t uiRespawned = 0;
+
+		for (unsigned int i = 0; i < uiCount; i++) {
+			std::string szName, szIdent, szClassName, szData;
+			int aPos[2], aSize[2], iDir;
+			float fRotation;
+			CScriptedEntity::movement_s sMovement;
+
+			if ((!oBuffer.ReadString(szName)) || (!oBuffer.ReadString(szIdent)) || (!oBuffer.ReadString(szClassName)) || (!oBuffer.Read(aPos, sizeof(aPos))) || (!oBuffer.Read(&fRotation, sizeof(fRotation))) ||
+				(!oBuffer.Read(&sMovement.bActive, sizeof(sMovement.bActive))) || (!oBuffer.Read(&sMovement.fSpeed, sizeof(sMovement.fSpeed))) ||
+				(!oBuffer.Read(&sMovement.fHeading, sizeof(sMovement.fHeading))) || (!oBuffer.Read(&iDir, sizeof(iDir))) ||
+				(!oBuffer.Read(aSize, sizeof(aSize))) || (!oBuffer.ReadString(szData))) {
+				bResult = false;
+				break;
+			}
+
+			sMovement.eDir = (MovementDir)iDir;
+			sMovement.vecSize = Vector(aSize[0], aSize[1]);
+
+			//Find cursor of this entity name
+			size_t uiCursor = vCursors.size();
+			for (size_t j = 0; j < vCursors.size(); j++) {
+				if (vCursors[j].szName == szName) {
+					uiCursor = j;
+					break;
+				}
+			}
+
+			if (uiCursor == vCursors.size()) {
+				name_cursor_s sCursor;
+				sCursor.szName = szName;
+				sCursor.uiNext = 0;
+				vCursors.push_back(sCursor);
+			}
+
+			//Find next live entity with this name
+			size_t uiLiveId = vCursors[uiCursor].uiNext;
+			while ((uiLiveId < uiLiveCount) && ((vMatched[uiLiveId]) || (vLiveNames[uiLiveId] != szName))) {
+				uiLiveId++;
+			}
+
+			vCursors[uiCursor].uiNext = uiLiveId + 1;
+
+			CScriptedEntity* pEntity;
+
+			if (uiLiveId < uiLiveCount) {
+				vMatched[uiLiveId] = true;
+				pEntity = this->m_oEntities.GetEntity(uiLiveId);
+			} else {
+				pEntity = this->RespawnEntity(szIdent, szClassName, Vector(aPos[0], aPos[1]));
+				if (!pEntity) {
+					uiSkipped++;
+					continue;
+				}
+
+				uiRespawned++;
+			}
+
+			pEntity->SetPosition(Vector(aPos[0], aPos[1]));
+			pEntity->SetRotation(fRotation);
+			pEntity->SetMovementState(sMovement);
+			pEntity->RestoreSnapshot(szData);
+		}
+
+		if (bResult) {
+			//Remove live entities which did not exist anymore when the snapshot was taken
+			for (size_t i = uiLiveCount; i > 0; i--) {
+				if ((!vMatched[i - 1]) && (vLiveNames[i - 1] != "player")) {
+					this->m_oEntities.RemoveEntity(i - 1);
+				}
+			}
+
+			this->m_ullTick = ullTick;
+			this->m_oRandom.Seed(uiRandomState);
+
+			if (this->m_pGoalEntity) {
+				this->m_pGoalEntity->SetActivationStatus(bGoalActivated);
+			}
+
+			if (((uiSkipped) || (uiRespawned)) && (this->m_pHost)) {
+				this->m_pHost->Log(L"Snapshot: respawned " + std::to_wstring(uiRespawned) + L" entities, skipped " + std::to_wstring(uiSkipped) + L" transient entities");
+			}
+		}
+
+		SetActiveWorld(pPrevWorld);
+
+		return bResult;
+	}
+
+	CScriptedEntity* CWorld::RespawnEntity(const std::string& szIdent, const std::string& szClassName, const Vector& vecPos)
+	{
+		//Spawn entity of a snapshot again by its spawn ident and script class. Only classes which can restore their
+		//state are spawned. The instance is created via its default constructor
+
+		std::wstring wszIdent = Utils::ConvertToWideString(szIdent);
+
+		if ((!this->m_pHost) || (!this->m_pScriptInt))
+			return nullptr;
+
+		Scripting::HSISCRIPT hScript = this->m_pHost->ResolveScript(wszIdent);
+		if (hScript == SI_INVALID_ID)
+			return nullptr;
+
+		asIScriptObject* pObject = this->m_pScriptInt->CreateScriptObject(hScript, szClassName);
+		if (!pObject)
+			return nullptr;
+
+		if (!pObject->GetObjectType()->GetMethodByDecl("void RestoreSnapshot(const string &in)")) {
+			pObject->Release();
+			return nullptr;
+		}
+
+		if (!this->m_oEntities.Spawn(wszIdent, pObject, vecPos)) {
+			pObject->Release();
+			return nullptr;
+		}
+
+		return this->m_oEntities.GetEntity(this->m_oEntities.GetEntityCount() - 1);
 	}
 
-	CScriptedEntsMgr oScriptedEntMgr;
+	void CWorld::Draw(void)
+	{
+		//Draw world
+
+		CWorld* pPrevWorld = pThreadWorld;
+		SetActiveWorld(this);
+
+		//Draw solid sprites
+		for (size_t i = 0; i < this->m_vSolidSprites.size(); i++) {
+			this->m_vSolidSprites[i].Draw();
+		}
+
+		//Draw scripted entities
+		this->m_oEntities.Draw();
+		this->m_oEntities.DrawOnTop();
+
+		//Draw goal entity
+		if (this->m_pGoalEntity) {
+			this->m_pGoalEntity->Draw();
+		}
+
+		SetActiveWorld(pPrevWorld);
+	}
 
 	namespace APIFuncs { //API functions usable in scripts
+		static std::mutex oCVarLock; //Headless worlds on other threads share the CVar registry
+
+		bool IsHeadless(void)
+		{
+			//Scripts of headless worlds have no window, sound device, HUD or game session to talk to
+
+			CWorld* pWorld = GetActiveWorld();
+
+			return (pWorld) && (pWorld->IsHeadless());
+		}
+
 		void Print(const std::string& in)
 		{
+			if (IsHeadless()) {
+				GetActiveWorld()->Host()->Log(Utils::ConvertToWideString(in));
+				return;
+			}
+
 			pConsole->AddLine(Utils::ConvertToWideString(in));
 		}
 
 		void Print2(const std::string& in, const Console::ConColor& clr)
 		{
+			if (IsHeadless()) {
+				GetActiveWorld()->Host()->Log(Utils::ConvertToWideString(in));
+				return;
+			}
+
 			pConsole->AddLine(Utils::ConvertToWideString(in), clr);
 		}
 
@@ -127,6 +779,10 @@ namespace Entity {
 
 		DxRenderer::d3dfont_s* LoadFont(const std::string& szFontName, byte ucFontSizeW, byte ucFontSizeH)
 		{
+			if (IsHeadless()) {
+				return nullptr;
+			}
+
 			return pRenderer->LoadFont(Utils::ConvertToWideString(szFontName), ucFontSizeW, ucFontSizeH);
 		}
 
@@ -137,6 +793,9 @@ namespace Entity {
 			SpriteInfo sInfo;
 			D3DXIMAGE_INFO sImageInfo;
 
+			if (IsHeadless())
+				return false;
+
 			if (!pRenderer->GetSpriteInfo(Utils::ConvertToWideString(szFile), sImageInfo))
 				return false;
 
@@ -149,12 +808,12 @@ namespace Entity {
 
 		DxRenderer::HD3DSPRITE LoadSprite(const std::string& szTexture, int iFrameCount, int iFrameWidth, int iFrameHeight, int iFramesPerLine, const bool bForceCustomSize)
 		{
-			return pRenderer->LoadSprite(Utils::ConvertToWideString(szTexture), iFrameCount, iFrameWidth, iFrameHeight, iFramesPerLine, bForceCustomSize);
+			return LoadAssetSprite(Utils::ConvertToWideString(szTexture), iFrameCount, iFrameWidth, iFrameHeight, iFramesPerLine, bForceCustomSize);
 		}
 
 		bool FreeSprite(DxRenderer::HD3DSPRITE hSprite)
 		{
-			return pRenderer->FreeSprite(hSprite);
+			return FreeAssetSprite(hSprite);
 		}
 
 		bool DrawBox(const Vector& pos, const Vector& size, int iThickness, const Color& color)
@@ -184,6 +843,10 @@ namespace Entity {
 
 		void AddHudMessage(const std::string& szMsg, HudMessageColor color, int iDuration = HUDMSG_DEFAULDURATION)
 		{
+			if (IsHeadless()) {
+				return;
+			}
+
 			Game::pGame->AddHudInfoMessage(Utils::ConvertToWideString(szMsg), color, iDuration);
 		}
 
@@ -192,14 +855,32 @@ namespace Entity {
 			return Utils::ConvertToAnsiString(oPackageLocaleMgr.QueryPhrase(Utils::ConvertToWideString(szIdent), Utils::ConvertToWideString(szDefault)));
 		}
 
+		size_t GetLangPhraseId(const std::string& szIdent)
+		{
+			return oPackageLocaleMgr.GetPhraseId(Utils::ConvertToWideString(szIdent));
+		}
+
+		std::string QueryLangPhraseById(size_t hPhrase, const std::string& szDefault = "")
+		{
+			return Utils::ConvertToAnsiString(oPackageLocaleMgr.QueryPhraseById(hPhrase, Utils::ConvertToWideString(szDefault)));
+		}
+
 		void LoadMap(const std::string& szMapName)
 		{
+			if (IsHeadless()) {
+				return;
+			}
+
 			//Game::pGame->LoadMap(Utils::ConvertToWideString(szMapName) + L".cfg");
 			Game::pGame->InitStartGame(Game::pGame->GetPackageName(), Game::pGame->GetPackagePath(), Utils::ConvertToWideString(szMapName) + L".cfg");
 		}
 
 		void TriggerGameSave(void)
 		{
+			if (IsHeadless()) {
+				return;
+			}
+
 			Game::pGame->SaveGame();
 		}
 
@@ -210,8 +891,8 @@ namespace Entity {
 			Vector* vecPlayerPos = nullptr;
 			Vector* vecPlayerSize = nullptr;
 			
-			pScriptingInt->CallScriptMethod(oScriptedEntMgr.GetPlayerEntity().hScript, oScriptedEntMgr.GetPlayerEntity().pObject, "Vector& GetPosition()", nullptr, &vecPlayerPos, Scripting::FA_OBJECT);
-			pScriptingInt->CallScriptMethod(oScriptedEntMgr.GetPlayerEntity().hScript, oScriptedEntMgr.GetPlayerEntity().pObject, "Vector& GetSize()", nullptr, &vecPlayerSize, Scripting::FA_OBJECT);
+			GetScriptInt()->CallScriptMethod(GetEntityManager().GetPlayerEntity().hScript, GetEntityManager().GetPlayerEntity().pObject, "Vector& GetPosition()", nullptr, &vecPlayerPos, Scripting::FA_OBJECT);
+			GetScriptInt()->CallScriptMethod(GetEntityManager().GetPlayerEntity().hScript, GetEntityManager().GetPlayerEntity().pObject, "Vector& GetSize()", nullptr, &vecPlayerSize, Scripting::FA_OBJECT);
 
 			if ((!vecPlayerPos) || (!vecPlayerSize)) {
 				return false;
@@ -232,8 +913,8 @@ namespace Entity {
 			
 			Vector* vecPlayerPos;
 			Vector* vecPlayerSize;
-			pScriptingInt->CallScriptMethod(oScriptedEntMgr.GetPlayerEntity().hScript, oScriptedEntMgr.GetPlayerEntity().pObject, "Vector& GetPosition()", nullptr, &vecPlayerPos, Scripting::FA_OBJECT);
-			pScriptingInt->CallScriptMethod(oScriptedEntMgr.GetPlayerEntity().hScript, oScriptedEntMgr.GetPlayerEntity().pObject, "Vector& GetSize()", nullptr, &vecPlayerSize, Scripting::FA_OBJECT);
+			GetScriptInt()->CallScriptMethod(GetEntityManager().GetPlayerEntity().hScript, GetEntityManager().GetPlayerEntity().pObject, "Vector& GetPosition()", nullptr, &vecPlayerPos, Scripting::FA_OBJECT);
+			GetScriptInt()->CallScriptMethod(GetEntityManager().GetPlayerEntity().hScript, GetEntityManager().GetPlayerEntity().pObject, "Vector& GetSize()", nullptr, &vecPlayerSize, Scripting::FA_OBJECT);
 
 			out[0] = (vMyPos[0] - (*vecPlayerPos)[0]) + pRenderer->GetWindowWidth() / 2 - vMySize[0] / 2;
 			out[1] = (vMyPos[1] - (*vecPlayerPos)[1]) + pRenderer->GetWindowHeight() / 2 - vMySize[1] / 2;
@@ -241,20 +922,47 @@ namespace Entity {
 
 		DxSound::HDXSOUND QuerySound(const std::string& szSoundFile)
 		{
-			return pSound->QuerySound(Utils::ConvertToWideString(szSoundFile));
+			if (IsHeadless()) {
+				return SND_INVALID_HANDLE_VALUE;
+			}
+
+			std::wstring wszSoundFile = Utils::ConvertToWideString(szSoundFile);
+
+			Game::pGame->GetAssetPrefetcher().OnQuerySound(wszSoundFile);
+
+			return pSound->QuerySound(wszSoundFile);
+		}
+
+		bool PlaySound_(DxSound::HDXSOUND hSound, long lVolume, bool bLoop = false, int iPriority = SND_PRIORITY_NORMAL)
+		{
+			if ((IsHeadless()) || (!Game::pGame->IsGameStarted())) {
+				return false;
+			}
+
+			return pSound->Play(hSound, lVolume, ((bLoop) ? SND_PLAY_LOOPING : 0), false, iPriority);
 		}
 
-		bool PlaySound_(DxSound::HDXSOUND hSound, long lVolume, bool bLoop = false)
+		bool PlaySoundAt(DxSound::HDXSOUND hSound, long lVolume, const Vector& vPos, bool bLoop = false, int iPriority = SND_PRIORITY_NORMAL)
 		{
-			if (!Game::pGame->IsGameStarted()) {
+			//Play sound at world position relative to the listener, which the game moves to the player position once per frame
+
+			if ((IsHeadless()) || (!Game::pGame->IsGameStarted())) {
 				return false;
 			}
 
-			return pSound->Play(hSound, lVolume, ((bLoop) ? DSBPLAY_LOOPING : 0));
+			if (!GetEntityManager().GetPlayerEntity().pObject) {
+				return pSound->Play(hSound, lVolume, ((bLoop) ? SND_PLAY_LOOPING : 0), false, iPriority);
+			}
+
+			return pSound->PlayAt(hSound, lVolume, (float)vPos[0], (float)vPos[1], (float)pSndFalloffDist->iValue, ((bLoop) ? SND_PLAY_LOOPING : 0), iPriority);
 		}
 
 		bool StopSound_(DxSound::HDXSOUND hSound)
 		{
+			if (IsHeadless()) {
+				return false;
+			}
+
 			return pSound->StopSound(hSound);
 		}
 
@@ -275,45 +983,33 @@ namespace Entity {
 
 		bool SpawnScriptedEntity(const std::string& szIdent, asIScriptObject* ref, const Vector& vPos)
 		{
-			return oScriptedEntMgr.Spawn(Utils::ConvertToWideString(szIdent), ref, vPos);
+			if (!GetActiveWorld())
+				return false;
+
+			return GetEntityManager().Spawn(Utils::ConvertToWideString(szIdent), ref, vPos);
 		}
 
 		void Ent_Move(asIScriptObject* ref, float fSpeed, MovementDir dir)
 		{
 			//Move entity according to view
 
-			CScriptedEntity* pEntity = oScriptedEntMgr.GetEntity(oScriptedEntMgr.GetEntityId(ref)); //Get entity class object pointer
+			CScriptedEntity* pEntity = GetEntityManager().GetEntity(GetEntityManager().GetEntityId(ref)); //Get entity class object pointer
 			if (pEntity) {
 				//Query position and rotation
 				Vector vecPosition = pEntity->GetPosition();
 				float fRotation = pEntity->GetRotation();
 				Vector vecSize = pEntity->GetSize();
 				
-				//Calculate forward or backward vector according to dir
-				if (dir == MOVE_FORWARD) {
-					vecPosition[0] += (int)(sin(fRotation + 0.015) * fSpeed) / Game::pGame->GetCurrentFramerate();
-					vecPosition[1] -= (int)(cos(fRotation + 0.015) * fSpeed) / Game::pGame->GetCurrentFramerate();
-				} else if (dir == MOVE_BACKWARD) {
-					vecPosition[0] -= (int)(sin(fRotation + 0.015) * fSpeed) / Game::pGame->GetCurrentFramerate();
-					vecPosition[1] += (int)(cos(fRotation + 0.015) * fSpeed) / Game::pGame->GetCurrentFramerate();
-				} else if (dir == MOVE_LEFT) {
-					vecPosition[0] += (int)(sin(fRotation + 80.0) * fSpeed) / Game::pGame->GetCurrentFramerate();
-					vecPosition[1] -= (int)(cos(fRotation + 80.0) * fSpeed) / Game::pGame->GetCurrentFramerate();
-				} else if (dir == MOVE_RIGHT) {
-					vecPosition[0] -= (int)(sin(fRotation + 80.0) * fSpeed) / Game::pGame->GetCurrentFramerate();
-					vecPosition[1] += (int)(cos(fRotation + 80.0) * fSpeed) / Game::pGame->GetCurrentFramerate();
-				} else if (dir == MOVE_NORTH) {
-					vecPosition[1] -= (int)(cos(0.015) * fSpeed) / Game::pGame->GetCurrentFramerate();
-				} else if (dir == MOVE_SOUTH) {
-					vecPosition[1] += (int)(cos(0.015) * fSpeed) / Game::pGame->GetCurrentFramerate();
-				} else if (dir == MOVE_WEST) {
-					vecPosition[0] -= (int)(cos(0.015) * fSpeed) / Game::pGame->GetCurrentFramerate();
-				} else if (dir == MOVE_EAST) {
-					vecPosition[0] += (int)(cos(0.015) * fSpeed) / Game::pGame->GetCurrentFramerate();
-				}
+				//Calculate new position
+				if (!CalcMovement(vecPosition, fRotation, fSpeed, dir))
+					return;
+
+				CWorld* pWorld = GetActiveWorld();
+				if (!pWorld)
+					return;
 
 				//If not collided then move forward
-				if (!Game::pGame->IsVectorFieldInsideWall(vecPosition, vecSize)) {
+				if (!pWorld->IsVectorFieldInsideWall(vecPosition, vecSize)) {
 					pEntity->SetPosition(vecPosition);
 				} else {
 					pEntity->OnWallCollided();
@@ -321,27 +1017,58 @@ namespace Entity {
 			}
 		}
 
+		void Ent_SetMovement(asIScriptObject* ref, float fSpeed, MovementDir dir)
+		{
+			//Set movement intent of entity. A speed of zero stops the entity
+
+			CScriptedEntity* pEntity = GetEntityManager().GetEntity(GetEntityManager().GetEntityId(ref));
+			if (pEntity) {
+				pEntity->SetMovement(fSpeed, dir);
+			}
+		}
+
+		void Ent_SetHeading(asIScriptObject* ref, float fHeading)
+		{
+			//Set heading of entity used for view-relative movement
+
+			CScriptedEntity* pEntity = GetEntityManager().GetEntity(GetEntityManager().GetEntityId(ref));
+			if (pEntity) {
+				pEntity->SetHeading(fHeading);
+			}
+		}
+
+		void Ent_StopMovement(asIScriptObject* ref)
+		{
+			//Stop movement of entity
+
+			CScriptedEntity* pEntity = GetEntityManager().GetEntity(GetEntityManager().GetEntityId(ref));
+			if (pEntity) {
+				pEntity->StopMovement();
+			}
+		}
+
 		void SetGoalActivationStatus(bool bStatus)
 		{
-			CGoalEntity* pGoalEntity = Game::pGame->GetGoalEntity();
+			CWorld* pWorld = GetActiveWorld();
+			CGoalEntity* pGoalEntity = (pWorld) ? pWorld->GetGoalEntity() : nullptr;
 			if (pGoalEntity) {
-				Game::pGame->GetGoalEntity()->SetActivationStatus(bStatus);
+				pGoalEntity->SetActivationStatus(bStatus);
 			}
 		}
 
 		size_t GetEntityCount()
 		{
-			return oScriptedEntMgr.GetEntityCount();
+			return GetEntityManager().GetEntityCount();
 		}
 
 		size_t GetEntityNameCount(const std::string& szName)
 		{
-			return oScriptedEntMgr.GetEntityNameCount(szName);
+			return GetEntityManager().GetEntityNameCount(szName);
 		}
 
 		asIScriptObject* GetEntityHandle(size_t uiEntityId)
 		{
-			return oScriptedEntMgr.GetEntityHandle(uiEntityId);
+			return GetEntityManager().GetEntityHandle(uiEntityId);
 		}
 
 		asIScriptObject* EntityTrace(const Vector& vStart, const Vector& vEnd, asIScriptObject* pIgnoredEnt)
@@ -352,17 +1079,17 @@ namespace Entity {
 
 		bool Ent_IsValid(asIScriptObject* pEntity)
 		{
-			return oScriptedEntMgr.IsValidEntity(pEntity);
+			return GetEntityManager().IsValidEntity(pEntity);
 		}
 
 		size_t Ent_GetId(asIScriptObject* pEntity)
 		{
-			return oScriptedEntMgr.GetEntityId(pEntity);
+			return GetEntityManager().GetEntityId(pEntity);
 		}
 
 		asIScriptObject* GetPlayerEntity(void)
 		{
-			return oScriptedEntMgr.GetPlayerEntity().pObject;
+			return GetEntityManager().GetPlayerEntity().pObject;
 		}
 
 		bool ListFilesByExt(const std::string& szBaseDir, asIScriptFunction* pFunction, const char** pFileList, const size_t uiListLen)
@@ -401,7 +1128,7 @@ namespace Entity {
 				BEGIN_PARAMS(vArgs);
 				PUSH_OBJECT(&vNames[i]);
 
-				pScriptingInt->CallScriptFunction(pFunction, &vArgs, &bResult, Scripting::FA_BYTE);
+				GetScriptInt()->CallScriptFunction(pFunction, &vArgs, &bResult, Scripting::FA_BYTE);
 
 				END_PARAMS(vArgs);
 
@@ -434,15 +1161,23 @@ namespace Entity {
 
 		int Random(int start, int end)
 		{
-			//Generate and return a random number
+			//Generate and return a random number from the world generator
 
-			static bool bRndSeedOnce = false;
-			if (!bRndSeedOnce) {
-				srand((unsigned int)time(nullptr));
-				bRndSeedOnce = true;
-			}
+			CWorld* pWorld = GetActiveWorld();
+			if (!pWorld)
+				return start;
+
+			return pWorld->Random().Range(start, end);
+		}
+
+		void SetRandomSeed(asUINT seed)
+		{
+			//Seed world random number generator
 
-			return (rand() % (end - start)) + start;
+			CWorld* pWorld = GetActiveWorld();
+			if (pWorld) {
+				pWorld->Random().Seed(seed);
+			}
 		}
 
 		std::string StrReplace(const std::string& szString, const std::string& szFind, const std::string& szNew)
@@ -505,7 +1240,11 @@ namespace Entity {
 
 		bool SavePropsFile(const std::string& szProperties, const std::string& szFileName)
 		{
-			//Save properties to file
+			//Save properties to file. Headless worlds run side by side and must not overwrite the files of each other
+
+			if (IsHeadless()) {
+				return false;
+			}
 
 			std::string szFullFileName = Utils::ConvertToAnsiString(Game::pGame->GetPackagePath()) +  "props\\" + szFileName;
 
@@ -559,42 +1298,80 @@ namespace Entity {
 
 		void SetSteamAchievement(const std::string& szName)
 		{
+			if (IsHeadless()) {
+				return;
+			}
+
 			pAchievements->UnlockAchievement(szName.c_str());
 		}
 
 		void SetSteamStatInt(const std::string& szName, int iValue)
 		{
+			if (IsHeadless()) {
+				return;
+			}
+
 			pAchievements->SetStat(szName.c_str(), iValue);
 		}
 
 		void SetSteamStatFloat(const std::string& szName, float fValue)
 		{
+			if (IsHeadless()) {
+				return;
+			}
+
 			pAchievements->SetStat(szName.c_str(), fValue);
 		}
 
 		bool IsSteamAchievementUnlocked(const std::string& szName)
 		{
+			if (IsHeadless()) {
+				return false;
+			}
+
 			return pAchievements->IsAchievementUnlocked(szName.c_str());
 		}
 
 		int GetSteamStatInt(const std::string& szName)
 		{
+			if (IsHeadless()) {
+				return 0;
+			}
+
 			return pAchievements->GetStatInt(szName.c_str());
 		}
 
 		float GetSteamStatFloat(const std::string& szName)
 		{
+			if (IsHeadless()) {
+				return 0.0f;
+			}
+
 			return pAchievements->GetStatFloat(szName.c_str());
 		}
 
-		ConfigMgr::CCVar::cvar_s* RegisterCVar(const std::string& szName, ConfigMgr::CCVar::cvar_type_e eType, const std::string& szInitial)
+		ConfigMgr::CCVar::cvar_s* CVarFromHandle(size_t hCVar)
 		{
-			return pConfigMgr->CCVar::Add(Utils::ConvertToWideString(szName), eType, Utils::ConvertToWideString(szInitial));
+			//CVar handles are list IDs plus one, so the value a script passes is checked against the registry
+
+			return (hCVar) ? pConfigMgr->CCVar::GetById(hCVar - 1) : nullptr;
+		}
+
+		size_t RegisterCVar(const std::string& szName, ConfigMgr::CCVar::cvar_type_e eType, const std::string& szInitial)
+		{
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			if (!pConfigMgr->CCVar::Add(Utils::ConvertToWideString(szName), eType, Utils::ConvertToWideString(szInitial)))
+				return 0;
+
+			return pConfigMgr->CCVar::FindId(szName) + 1;
 		}
 
 		bool GetCVarBool(const std::string& szName, bool bFallback)
 		{
-			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(Utils::ConvertToWideString(szName));
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(szName);
 			if (!pCVar) {
 				return bFallback;
 			}
@@ -604,7 +1381,9 @@ namespace Entity {
 
 		int GetCVarInt(const std::string& szName, int iFallback)
 		{
-			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(Utils::ConvertToWideString(szName));
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(szName);
 			if (!pCVar) {
 				return iFallback;
 			}
@@ -614,7 +1393,9 @@ namespace Entity {
 
 		float GetCVarFloat(const std::string& szName, float fFallback)
 		{
-			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(Utils::ConvertToWideString(szName));
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(szName);
 			if (!pCVar) {
 				return fFallback;
 			}
@@ -624,7 +1405,9 @@ namespace Entity {
 
 		std::string GetCVarString(const std::string& szName, const std::string& szFallback)
 		{
-			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(Utils::ConvertToWideString(szName));
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(szName);
 			if (!pCVar) {
 				return szFallback;
 			}
@@ -634,7 +1417,9 @@ namespace Entity {
 
 		void SetCVarBool(const std::string& szName, bool value)
 		{
-			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(Utils::ConvertToWideString(szName));
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(szName);
 			if (pCVar) {
 				pCVar->bValue = value;
 			}
@@ -642,7 +1427,9 @@ namespace Entity {
 
 		void SetCVarInt(const std::string& szName, int value)
 		{
-			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(Utils::ConvertToWideString(szName));
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(szName);
 			if (pCVar) {
 				pCVar->iValue = value;
 			}
@@ -650,7 +1437,9 @@ namespace Entity {
 
 		void SetCVarFloat(const std::string& szName, float value)
 		{
-			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(Utils::ConvertToWideString(szName));
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(szName);
 			if (pCVar) {
 				pCVar->fValue = value;
 			}
@@ -658,7 +1447,94 @@ namespace Entity {
 
 		void SetCVarString(const std::string& szName, const std::string& value)
 		{
-			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(Utils::ConvertToWideString(szName));
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = pConfigMgr->CCVar::Find(szName);
+			if (pCVar) {
+				wcscpy(pCVar->szValue, Utils::ConvertToWideString(value).c_str());
+			}
+		}
+
+		size_t FindCVarHandle(const std::string& szName)
+		{
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			size_t uiListId = pConfigMgr->CCVar::FindId(szName);
+
+			return (uiListId != CM_INVALID_LIST_ID) ? uiListId + 1 : 0;
+		}
+
+		bool GetCVarBoolByHandle(size_t hCVar, bool bFallback)
+		{
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = CVarFromHandle(hCVar);
+
+			return (pCVar) ? pCVar->bValue : bFallback;
+		}
+
+		int GetCVarIntByHandle(size_t hCVar, int iFallback)
+		{
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = CVarFromHandle(hCVar);
+
+			return (pCVar) ? pCVar->iValue : iFallback;
+		}
+
+		float GetCVarFloatByHandle(size_t hCVar, float fFallback)
+		{
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = CVarFromHandle(hCVar);
+
+			return (pCVar) ? pCVar->fValue : fFallback;
+		}
+
+		std::string GetCVarStringByHandle(size_t hCVar, const std::string& szFallback)
+		{
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = CVarFromHandle(hCVar);
+
+			return (pCVar) ? Utils::ConvertToAnsiString(pCVar->szValue) : szFallback;
+		}
+
+		void SetCVarBoolByHandle(size_t hCVar, bool value)
+		{
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = CVarFromHandle(hCVar);
+			if (pCVar) {
+				pCVar->bValue = value;
+			}
+		}
+
+		void SetCVarIntByHandle(size_t hCVar, int value)
+		{
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = CVarFromHandle(hCVar);
+			if (pCVar) {
+				pCVar->iValue = value;
+			}
+		}
+
+		void SetCVarFloatByHandle(size_t hCVar, float value)
+		{
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = CVarFromHandle(hCVar);
+			if (pCVar) {
+				pCVar->fValue = value;
+			}
+		}
+
+		void SetCVarStringByHandle(size_t hCVar, const std::string& value)
+		{
+			std::lock_guard<std::mutex> oLock(oCVarLock);
+
+			ConfigMgr::CCVar::cvar_s* pCVar = CVarFromHandle(hCVar);
 			if (pCVar) {
 				wcscpy(pCVar->szValue, Utils::ConvertToWideString(value).c_str());
 			}
@@ -666,61 +1542,109 @@ namespace Entity {
 
 		bool ExecConfig(const std::string& szFile)
 		{
+			if (IsHeadless()) {
+				return false;
+			}
+
 			return pConfigMgr->Execute(Game::pGame->GetPackagePath() + Utils::ConvertToWideString(szFile));
 		}
 
 		void SetHUDEnableStatus(bool value)
 		{
+			if (IsHeadless()) {
+				return;
+			}
+
 			Game::pGame->GetHUD()->SetEnableStatus(value);
 		}
 
 		void UpdateHUDHealth(size_t value)
 		{
+			if (IsHeadless()) {
+				return;
+			}
+
 			Game::pGame->GetHUD()->UpdateHealth(value);
 		}
 
 		void AddHUDAmmoItem(const std::string& szIdent, const std::string& szSprite)
 		{
+			if (IsHeadless()) {
+				return;
+			}
+
 			Game::pGame->GetHUD()->AddAmmoItem(Utils::ConvertToWideString(szIdent), Utils::ConvertToWideString(szSprite));
 		}
 
 		void AddHUDCollectable(const std::string& szIdent, const std::string& szSprite, bool bDrawAlways)
 		{
+			if (IsHeadless()) {
+				return;
+			}
+
 			Game::pGame->GetHUD()->AddCollectable(Utils::ConvertToWideString(szIdent), Utils::ConvertToWideString(szSprite), bDrawAlways);
 		}
 
 		void UpdateHUDAmmoItem(const std::string& szIdent, size_t uiCurAmmo, size_t uiMaxAmmo)
 		{
+			if (IsHeadless()) {
+				return;
+			}
+
 			Game::pGame->GetHUD()->UpdateAmmoItem(Utils::ConvertToWideString(szIdent), uiCurAmmo, uiMaxAmmo);
 		}
 
 		void UpdateHUDCollectable(const std::string& szIdent, size_t uiCurCount)
 		{
+			if (IsHeadless()) {
+				return;
+			}
+
 			Game::pGame->GetHUD()->UpdateCollectable(Utils::ConvertToWideString(szIdent), uiCurCount);
 		}
 
 		size_t GetHUDAmmoItemCurrent(const std::string& szIdent)
 		{
+			if (IsHeadless()) {
+				return 0;
+			}
+
 			return Game::pGame->GetHUD()->GetAmmoItemCurrent(Utils::ConvertToWideString(szIdent));
 		}
 
 		size_t GetHUDAmmoItemMax(const std::string& szIdent)
 		{
+			if (IsHeadless()) {
+				return 0;
+			}
+
 			return Game::pGame->GetHUD()->GetAmmoItemMax(Utils::ConvertToWideString(szIdent));
 		}
 
 		size_t GetHUDCollectableCount(const std::string& szIdent)
 		{
+			if (IsHeadless()) {
+				return 0;
+			}
+
 			return Game::pGame->GetHUD()->GetCollectableCount(Utils::ConvertToWideString(szIdent));
 		}
 
 		void SetHUDAmmoDisplayItem(const std::string& szIdent)
 		{
+			if (IsHeadless()) {
+				return;
+			}
+
 			Game::pGame->GetHUD()->SetAmmoDisplayItem(Utils::ConvertToWideString(szIdent));
 		}
 
 		bool IsHUDEnabled(void)
 		{
+			if (IsHeadless()) {
+				return false;
+			}
+
 			return Game::pGame->GetHUD()->IsEnabled();
 		}
 	}
@@ -790,35 +1714,28 @@ namespace Entity {
 		this->m_pszFileName = nullptr;
 	}
 
-	bool Initialize(void)
+	bool RegisterScriptingInterface(Scripting::CScriptInt* pScriptInt)
 	{
-		//Initialize entity scripting
-
-		//Create default font
-		iDefaultFontSize[0] = 7;
-		iDefaultFontSize[1] = 15;
-		pDefaultFont = pRenderer->LoadFont(L"Verdana", iDefaultFontSize[0], iDefaultFontSize[1]);
-		if (!pDefaultFont)
-			return false;
+		//Register engine types and API functions with a script interface. Headless worlds register them with their own engine
 
 		//Registration macros
-		#define REG_ENUM(n, h) h = pScriptingInt->RegisterEnumeration(n); if (h == SI_INVALID_ID) { return false; }
-		#define ADD_ENUM(h, n, v) if (!pScriptingInt->AddEnumerationValue(h, n, v))  { return false; }
-		#define REG_TYPEDEF(t, n) if (!pScriptingInt->RegisterTypeDef(t, n))  { return false; }
-		#define REG_FUNCDEF(t) if (!pScriptingInt->RegisterFuncDef(t))  { return false; }
-		#define REG_STRUCT(n, s, h) h = pScriptingInt->RegisterStructure(n, s); if (h == SI_INVALID_ID)  { return false; }
-		#define ADD_STRUCT(n, o, h) if (!pScriptingInt->AddStructureMember(h, n, o))  { return false; }
-		#define REG_CLASSV(n, s, h) h = pScriptingInt->RegisterClass_(n, s, asOBJ_VALUE | asOBJ_APP_CLASS); if (h == SI_INVALID_ID)  { return false; }
-		#define REG_CLASSR(n, s, h) h = pScriptingInt->RegisterClass_(n, s, asOBJ_REF); if (h == SI_INVALID_ID)  { return false; }
-		#define REG_CLASSRT(n, s, h) h = pScriptingInt->RegisterClass_(n, s, asOBJ_REF | asOBJ_TEMPLATE); if (h == SI_INVALID_ID)  { return false; }
-		#define REG_CLASSRNC(n, s, h) h = pScriptingInt->RegisterClass_(n, s, asOBJ_REF | asOBJ_NOCOUNT); if (h == SI_INVALID_ID)  { return false; }
-		#define ADD_CLASSM(n, o, h) if (!pScriptingInt->AddClassMember(h, n, o))  { return false; }
-		#define ADD_CLASSF(n, p, h) if (!pScriptingInt->AddClassMethod(h, n, p))  { return false; }
-		#define ADD_CLASSB(b, t, p, h) if (!pScriptingInt->AddClassBehaviour(h, b, t, p))  { return false; }
-		#define REG_FUNC(d, p, c) if (!pScriptingInt->RegisterFunction(d, p, c))  {return false; }
-		#define REG_VAR(d, p) if (!pScriptingInt->RegisterGlobalVariable(d, p))  { return false; }
-		#define REG_IF(n) if (!pScriptingInt->RegisterInterface(n))  { return false; }
-		#define REG_IFM(n, m) if (!pScriptingInt->RegisterInterfaceMethod(n, m))  { return false; }
+		#define REG_ENUM(n, h) h = pScriptInt->RegisterEnumeration(n); if (h == SI_INVALID_ID) { return false; }
+		#define ADD_ENUM(h, n, v) if (!pScriptInt->AddEnumerationValue(h, n, v))  { return false; }
+		#define REG_TYPEDEF(t, n) if (!pScriptInt->RegisterTypeDef(t, n))  { return false; }
+		#define REG_FUNCDEF(t) if (!pScriptInt->RegisterFuncDef(t))  { return false; }
+		#define REG_STRUCT(n, s, h) h = pScriptInt->RegisterStructure(n, s); if (h == SI_INVALID_ID)  { return false; }
+		#define ADD_STRUCT(n, o, h) if (!pScriptInt->AddStructureMember(h, n, o))  { return false; }
+		#define REG_CLASSV(n, s, h) h = pScriptInt->RegisterClass_(n, s, asOBJ_VALUE | asOBJ_APP_CLASS); if (h == SI_INVALID_ID)  { return false; }
+		#define REG_CLASSR(n, s, h) h = pScriptInt->RegisterClass_(n, s, asOBJ_REF); if (h == SI_INVALID_ID)  { return false; }
+		#define REG_CLASSRT(n, s, h) h = pScriptInt->RegisterClass_(n, s, asOBJ_REF | asOBJ_TEMPLATE); if (h == SI_INVALID_ID)  { return false; }
+		#define REG_CLASSRNC(n, s, h) h = pScriptInt->RegisterClass_(n, s, asOBJ_REF | asOBJ_NOCOUNT); if (h == SI_INVALID_ID)  { return false; }
+		#define ADD_CLASSM(n, o, h) if (!pScriptInt->AddClassMember(h, n, o))  { return false; }
+		#define ADD_CLASSF(n, p, h) if (!pScriptInt->AddClassMethod(h, n, p))  { return false; }
+		#define ADD_CLASSB(b, t, p, h) if (!pScriptInt->AddClassBehaviour(h, b, t, p))  { return false; }
+		#define REG_FUNC(d, p, c) if (!pScriptInt->RegisterFunction(d, p, c))  {return false; }
+		#define REG_VAR(d, p) if (!pScriptInt->RegisterGlobalVariable(d, p))  { return false; }
+		#define REG_IF(n) if (!pScriptInt->RegisterInterface(n))  { return false; }
+		#define REG_IFM(n, m) if (!pScriptInt->RegisterInterfaceMethod(n, m))  { return false; }
 
 		//Register typedefs
 		REG_TYPEDEF("uint64", "size_t");
@@ -1044,7 +1961,8 @@ namespace Entity {
 			{ "void R_GetDrawingPosition(const Vector &in vMyPos, const Vector &in vMySize, Vector &out)", &APIFuncs::GetDrawingPosition },
 			{ "FontHandle R_GetDefaultFont()", &APIFuncs::GetDefaultFont },
 			{ "SoundHandle S_QuerySound(const string&in szSoundFile)", &APIFuncs::QuerySound },
-			{ "bool S_PlaySound(SoundHandle hSound, int32 lVolume, bool bLoop = false)", &APIFuncs::PlaySound_ },
+			{ "bool S_PlaySound(SoundHandle hSound, int32 lVolume, bool bLoop = false, int iPriority = 0)", &APIFuncs::PlaySound_ },
+			{ "bool S_PlaySoundAt(SoundHandle hSound, int32 lVolume, const Vector &in vPos, bool bLoop = false, int iPriority = 0)", &APIFuncs::PlaySoundAt },
 			{ "bool S_StopSound(SoundHandle hSound)", &APIFuncs::StopSound_ },
 			{ "int S_GetCurrentVolume()", &APIFuncs::GetCurrentVolume },
 			{ "int Wnd_GetWindowCenterX()", &APIFuncs::GetWindowCenterX },
@@ -1058,10 +1976,14 @@ namespace Entity {
 			{ "bool Ent_IsValid(IScriptedEntity@ pEntity)", &APIFuncs::Ent_IsValid },
 			{ "size_t Ent_GetId(IScriptedEntity@ pEntity)", &APIFuncs::Ent_GetId },
 			{ "void Ent_Move(IScriptedEntity@ pThis, float fSpeed, MovementDir dir)", &APIFuncs::Ent_Move },
+			{ "void Ent_SetMovement(IScriptedEntity@ pThis, float fSpeed, MovementDir dir)", &APIFuncs::Ent_SetMovement },
+			{ "void Ent_SetHeading(IScriptedEntity@ pThis, float fHeading)", &APIFuncs::Ent_SetHeading },
+			{ "void Ent_StopMovement(IScriptedEntity@ pThis)", &APIFuncs::Ent_StopMovement },
 			{ "void Ent_SetGoalActivationStatus(bool bStatus)", &APIFuncs::SetGoalActivationStatus },
 			{ "bool Util_ListSprites(const string& in, FuncFileListing @cb)", &APIFuncs::ListSprites },
 			{ "bool Util_ListSounds(const string& in, FuncFileListing @cb)", &APIFuncs::ListSounds },
 			{ "int Util_Random(int start, int end)", &APIFuncs::Random },
+			{ "void Util_SetRandomSeed(uint32 seed)", &APIFuncs::SetRandomSeed },
 			{ "string Util_StrReplace(const string& in szSource, const string &in szTarget, const string &in szNew)", &APIFuncs::StrReplace },
 			{ "string Props_CreateProperty(const string &in ident, const string &in value)", &APIFuncs::CreateProperty },
 			{ "string Props_ExtractValue(const string &in properties, const string &in ident)", &APIFuncs::ExtractValueFromProperties },
@@ -1082,6 +2004,15 @@ namespace Entity {
 			{ "void CVar_SetInt(const string &in szName, int value)", APIFuncs::SetCVarInt },
 			{ "void CVar_SetFloat(const string &in szName, float value)", APIFuncs::SetCVarFloat },
 			{ "void CVar_SetString(const string &in szName, const string &in value)", APIFuncs::SetCVarString },
+			{ "CVarHandle CVar_Find(const string &in szName)", &APIFuncs::FindCVarHandle },
+			{ "bool CVar_GetBool(CVarHandle hCVar, bool fallback)", &APIFuncs::GetCVarBoolByHandle },
+			{ "int CVar_GetInt(CVarHandle hCVar, int fallback)", &APIFuncs::GetCVarIntByHandle },
+			{ "float CVar_GetFloat(CVarHandle hCVar, float fallback)", &APIFuncs::GetCVarFloatByHandle },
+			{ "string CVar_GetString(CVarHandle hCVar, const string &in fallback)", &APIFuncs::GetCVarStringByHandle },
+			{ "void CVar_SetBool(CVarHandle hCVar, bool value)", &APIFuncs::SetCVarBoolByHandle },
+			{ "void CVar_SetInt(CVarHandle hCVar, int value)", &APIFuncs::SetCVarIntByHandle },
+			{ "void CVar_SetFloat(CVarHandle hCVar, float value)", &APIFuncs::SetCVarFloatByHandle },
+			{ "void CVar_SetString(CVarHandle hCVar, const string &in value)", &APIFuncs::SetCVarStringByHandle },
 			{ "bool ExecConfig(const string &in szFile)", APIFuncs::ExecConfig },
 			{ "void HUD_SetEnableStatus(bool value)", APIFuncs::SetHUDEnableStatus },
 			{ "void HUD_UpdateHealth(size_t value)", APIFuncs::UpdateHUDHealth },
@@ -1097,15 +2028,31 @@ namespace Entity {
 			{ "void HUD_AddMessage(const string &in msg, HudInfoMessageColor color, int duration = 3000)", &APIFuncs::AddHudMessage },
 			{ "string Lang_QueryPhrase(const string &in szIdent, const string &in szDefault = \"\")", &APIFuncs::QueryLangPhrase },
 			{ "string _(const string &in szIdent, const string &in szDefault = \"\")", &APIFuncs::QueryLangPhrase },
+			{ "size_t Lang_GetPhraseId(const string &in szIdent)", &APIFuncs::GetLangPhraseId },
+			{ "string Lang_QueryPhraseById(size_t hPhrase, const string &in szDefault = \"\")", &APIFuncs::QueryLangPhraseById },
 			{ "void LoadMap(const string &in map)", &APIFuncs::LoadMap },
 			{ "void TriggerGameSave()", &APIFuncs::TriggerGameSave }
 		};
 
 		for (size_t i = 0; i < _countof(sGameAPIFunctions); i++) {
-			if (!pScriptingInt->RegisterFunction(sGameAPIFunctions[i].szDefinition, sGameAPIFunctions[i].pFunction))
+			if (!pScriptInt->RegisterFunction(sGameAPIFunctions[i].szDefinition, sGameAPIFunctions[i].pFunction))
 				return false;
 		}
 		
 		return true;
 	}
-}
\ No newline at end of file
+
+	bool Initialize(void)
+	{
+		//Initialize entity scripting
+
+		//Create default font
+		iDefaultFontSize[0] = 7;
+		iDefaultFontSize[1] = 15;
+		pDefaultFont = pRenderer->LoadFont(L"Verdana", iDefaultFontSize[0], iDefaultFontSize[1]);
+		if (!pDefaultFont)
+			return false;
+
+		return RegisterScriptingInterface(pScriptingInt);
+	}
+}
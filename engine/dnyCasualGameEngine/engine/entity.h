@@ -20,6 +20,39 @@
 namespace Entity {
 	enum MovementDir { MOVE_FORWARD, MOVE_BACKWARD, MOVE_LEFT, MOVE_RIGHT, MOVE_NORTH, MOVE_SOUTH, MOVE_WEST, MOVE_EAST };
 
+	class CWorld;
+	class CScriptedEntsMgr;
+
+	/* Services a world takes from its host. The game hosts the presented world, headless worlds host themselves */
+	class IWorldHost {
+	public:
+		virtual Scripting::HSISCRIPT ResolveScript(const std::wstring& wszIdent) = 0;
+		virtual int GetFrameRate(void) = 0;
+		virtual bool IsPresenting(void) = 0; //False if there is no window, sound device or HUD for the world
+		virtual DxRenderer::HD3DSPRITE LoadSprite(const std::wstring& wszFile, int iFrameCount, int iFrameWidth, int iFrameHeight, int iFramesPerLine, bool bForceCustomSize) = 0;
+		virtual bool FreeSprite(DxRenderer::HD3DSPRITE hSprite) = 0;
+		virtual void OnPlayerRemoved(void) = 0;
+		virtual void Log(const std::wstring& wszText) = 0;
+	};
+
+	/* Simulation settings of a world */
+	struct world_settings_s {
+		bool bDeterministic; //Advance time by fixed ticks instead of by frame rate
+		int iTickRate;
+		bool bHashLog;
+		bool bRewind;
+		int iRewindInterval;
+		int iRewindSeconds;
+	};
+
+	CWorld* GetActiveWorld(void);
+	void SetActiveWorld(CWorld* pWorld);
+	CScriptedEntsMgr& GetEntityManager(void);
+	Scripting::CScriptInt* GetScriptInt(void);
+	DWORD GetSimulationTime(void);
+	DxRenderer::HD3DSPRITE LoadAssetSprite(const std::wstring& wszFile, int iFrameCount, int iFrameWidth, int iFrameHeight, int iFramesPerLine, bool bForceCustomSize);
+	bool FreeAssetSprite(DxRenderer::HD3DSPRITE hSprite);
+
 	struct Color {
 		Color() {}
 		Color(byte cr, byte cg, byte cb, byte ca) : r(cr), g(cg), b(cb), a(ca) {}
@@ -57,14 +90,14 @@ namespace Entity {
 		{
 			//Reset timer
 
-			this->m_dwCurrent = this->m_dwInitial = GetTickCount();
+			this->m_dwCurrent = this->m_dwInitial = GetSimulationTime();
 		}
 
 		void Update(void)
 		{
 			//Update current value
 
-			this->m_dwCurrent = GetTickCount();
+			this->m_dwCurrent = GetSimulationTime();
 		}
 
 		//Setters
@@ -302,7 +335,7 @@ namespace Entity {
 			//Initialize sprite object
 
 			//Load sprite
-			this->m_hSprite = pRenderer->LoadSprite(Utils::ConvertToWideString(szTexture), iFrameCount, iFrameWidth, iFrameHeight, iFramesPerLine, bForceCustomSize);
+			this->m_hSprite = LoadAssetSprite(Utils::ConvertToWideString(szTexture), iFrameCount, iFrameWidth, iFrameHeight, iFramesPerLine, bForceCustomSize);
 			if (this->m_hSprite == GFX_INVALID_SPRITE_ID)
 				return false;
 
@@ -353,7 +386,7 @@ namespace Entity {
 				return;
 
 			//Free sprite
-			pRenderer->FreeSprite(this->m_hSprite);
+			FreeAssetSprite(this->m_hSprite);
 
 			//Stop timer
 			this->m_oTimer.SetActive(false);
@@ -434,7 +467,7 @@ namespace Entity {
 			hFile.close();
 
 			//Load sprite
-			this->m_hSprite = pRenderer->LoadSprite(Utils::ConvertToWideString(szSpriteFile), iaFrameInfos[0], iaFrameInfos[1], iaFrameInfos[2], iaFrameInfos[3], bForceCustomSize);
+			this->m_hSprite = LoadAssetSprite(Utils::ConvertToWideString(szSpriteFile), iaFrameInfos[0], iaFrameInfos[1], iaFrameInfos[2], iaFrameInfos[3], bForceCustomSize);
 			if (!this->m_hSprite)
 				return false;
 
@@ -462,7 +495,7 @@ namespace Entity {
 				return;
 
 			//Free sprite
-			pRenderer->FreeSprite(this->m_hSprite);
+			FreeAssetSprite(this->m_hSprite);
 
 			//Clear bbox data
 			this->m_oBBox.Clear();
@@ -509,14 +542,42 @@ namespace Entity {
 		void Destruct(void* pMemory) { ((CModel*)pMemory)->~CModel(); }
 	};
 
+	bool CalcMovement(Vector& vecPosition, float fRotation, float fSpeed, MovementDir dir);
+
 	/* Managed entity component */
 	class CScriptedEntity {
 	public:
 		typedef byte DamageValue;
+
+		struct movement_s {
+			bool bActive;
+			float fSpeed;
+			float fHeading;
+			MovementDir eDir;
+			Vector vecSize;
+		};
 	private:
+		enum method_trait_e {
+			MT_ONRELEASE,
+			MT_ONDRAW,
+			MT_ONDRAWONTOP,
+			MT_ONWALLCOLLIDED,
+			MT_ONCOLLIDED,
+			MT_ISCOLLIDABLE,
+			MT_CANBEDORMANT,
+			MT_SAVESNAPSHOT,
+			MT_RESTORESNAPSHOT,
+			MT_MAX
+		};
+
 		std::string m_szClassName;
+		std::wstring m_wszIdent;
+		Scripting::CScriptInt* m_pScriptInt; //Script interface of the world the entity lives in
 		Scripting::HSISCRIPT m_hScript;
 		asIScriptObject* m_pScriptObject;
+		Scripting::si_func_trait_s m_sTraits[MT_MAX];
+		movement_s m_sMovement;
+		Vector m_vecLastPos; //Position last read or written by the engine
 
 		void Release(void)
 		{
@@ -525,9 +586,33 @@ namespace Entity {
 			this->m_pScriptObject->Release();
 			this->m_pScriptObject = nullptr;
 		}
+
+		void QueryTraits(void)
+		{
+			//Query traits of frequently dispatched methods in order to skip empty or constant ones
+
+			static const char* szMethodDecls[MT_MAX] = {
+				"void OnRelease()",
+				"void OnDraw()",
+				"void OnDrawOnTop()",
+				"void OnWallCollided()",
+				"void OnCollided(IScriptedEntity@)",
+				"bool IsCollidable()",
+				"bool CanBeDormant()",
+				"string SaveSnapshot()",
+				"void RestoreSnapshot(const string &in)"
+			};
+
+			for (size_t i = 0; i < MT_MAX; i++) {
+				this->m_sTraits[i] = this->m_pScriptInt->QueryMethodTrait(this->m_pScriptObject, szMethodDecls[i]);
+			}
+		}
+
+		inline bool IsEmpty(method_trait_e eMethod) const { return this->m_sTraits[eMethod].eTrait == Scripting::FT_EMPTY; }
+		inline bool IsConstant(method_trait_e eMethod) const { return this->m_sTraits[eMethod].eTrait == Scripting::FT_CONSTANT; }
 	public:
-		CScriptedEntity(const Scripting::HSISCRIPT hScript, asIScriptObject* pObject) : m_pScriptObject(pObject), m_hScript(hScript) {}
-		CScriptedEntity(const Scripting::HSISCRIPT hScript, const std::string& szClassName) : m_szClassName(szClassName) { this->Initialize(hScript, szClassName); }
+		CScriptedEntity(Scripting::CScriptInt* pScriptInt, const Scripting::HSISCRIPT hScript, asIScriptObject* pObject) : m_pScriptInt(pScriptInt), m_pScriptObject(pObject), m_hScript(hScript), m_vecLastPos(0, 0) { this->QueryTraits(); this->StopMovement(); }
+		CScriptedEntity(Scripting::CScriptInt* pScriptInt, const Scripting::HSISCRIPT hScript, const std::string& szClassName) : m_szClassName(szClassName), m_pScriptInt(pScriptInt), m_vecLastPos(0, 0) { this->Initialize(hScript, szClassName); this->StopMovement(); }
 		~CScriptedEntity() { this->Release(); }
 
 		bool Initialize(const Scripting::HSISCRIPT hScript, const std::string& szClassName)
@@ -538,11 +623,14 @@ namespace Entity {
 				return false;
 
 			//Allocate class instance
-			this->m_pScriptObject = pScriptingInt->AllocClass(hScript, szClassName);
+			this->m_pScriptObject = this->m_pScriptInt->AllocClass(hScript, szClassName);
 
 			//Store data
 			this->m_hScript = hScript;
 
+			//Query method traits
+			this->QueryTraits();
+
 			return this->m_pScriptObject != nullptr;
 		}
 
@@ -555,7 +643,7 @@ namespace Entity {
 			BEGIN_PARAMS(vArgs);
 			PUSH_OBJECT(&v);
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnSpawn(const Vector& in)", &vArgs, nullptr);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnSpawn(const Vector& in)", &vArgs, nullptr);
 
 			END_PARAMS(vArgs);
 		}
@@ -563,45 +651,60 @@ namespace Entity {
 		void OnRelease(void)
 		{
 			//Inform class instance of event
-			
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnRelease()", nullptr, nullptr);
+
+			if (this->IsEmpty(MT_ONRELEASE))
+				return;
+
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnRelease()", nullptr, nullptr);
 		}
 
 		void OnProcess(void)
 		{
 			//Inform class instance of event
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnProcess()", nullptr, nullptr);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnProcess()", nullptr, nullptr);
 		}
 
 		void OnDraw(void)
 		{
 			//Inform class instance of event
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnDraw()", nullptr, nullptr);
+			if (this->IsEmpty(MT_ONDRAW))
+				return;
+
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnDraw()", nullptr, nullptr);
 		}
 
 		void OnDrawOnTop(void)
 		{
 			//Inform class instance of event
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnDrawOnTop()", nullptr, nullptr);
+			if (this->IsEmpty(MT_ONDRAWONTOP))
+				return;
+
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnDrawOnTop()", nullptr, nullptr);
 		}
 
 		void OnWallCollided(void)
 		{
 			//Inform class instance of event
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnWallCollided()", nullptr, nullptr);
+			if (this->IsEmpty(MT_ONWALLCOLLIDED))
+				return;
+
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnWallCollided()", nullptr, nullptr);
 		}
 
 		bool IsCollidable(void)
 		{
 			//Query if entity is collidable
 
+			if (this->IsConstant(MT_ISCOLLIDABLE))
+				return (asBYTE)this->m_sTraits[MT_ISCOLLIDABLE].dwConstant != 0;
+
 			bool bResult;
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "bool IsCollidable()", nullptr, &bResult, Scripting::FA_BYTE);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "bool IsCollidable()", nullptr, &bResult, Scripting::FA_BYTE);
 
 			return bResult;
 		}
@@ -609,13 +712,16 @@ namespace Entity {
 		void OnCollided(asIScriptObject* ref)
 		{
 			//Inform of being collided
-			
+
+			if (this->IsEmpty(MT_ONCOLLIDED))
+				return;
+
 			BEGIN_PARAMS(vArgs);
 			PUSH_POINTER(ref);
 
 			ref->AddRef();
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnCollided(IScriptedEntity@)", &vArgs, nullptr);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnCollided(IScriptedEntity@)", &vArgs, nullptr);
 
 			END_PARAMS(vArgs);
 		}
@@ -627,7 +733,7 @@ namespace Entity {
 			BEGIN_PARAMS(vArgs);
 			PUSH_DWORD(damageValue);
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnDamage(uint32)", &vArgs, nullptr);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void OnDamage(uint32)", &vArgs, nullptr);
 
 			END_PARAMS(vArgs);
 		}
@@ -638,7 +744,7 @@ namespace Entity {
 
 			CModel* pResult;
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "Model& GetModel()", nullptr, &pResult, Scripting::FA_OBJECT);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "Model& GetModel()", nullptr, &pResult, Scripting::FA_OBJECT);
 
 			return pResult;
 		}
@@ -649,7 +755,9 @@ namespace Entity {
 
 			Vector* pResult;
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "Vector& GetPosition()", nullptr, &pResult, Scripting::FA_OBJECT);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "Vector& GetPosition()", nullptr, &pResult, Scripting::FA_OBJECT);
+
+			this->m_vecLastPos = *pResult;
 
 			return *pResult;
 		}
@@ -659,11 +767,12 @@ namespace Entity {
 			//Set position
 
 			Vector vPos = vec;
+			this->m_vecLastPos = vec;
 
 			BEGIN_PARAMS(vArgs);
 			PUSH_OBJECT(&vPos);
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void SetPosition(const Vector &in)", &vArgs, nullptr, Scripting::FA_VOID);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void SetPosition(const Vector &in)", &vArgs, nullptr, Scripting::FA_VOID);
 
 			END_PARAMS(vArgs);
 		}
@@ -674,7 +783,7 @@ namespace Entity {
 
 			float flResult;
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "float GetRotation()", nullptr, &flResult, Scripting::FA_FLOAT);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "float GetRotation()", nullptr, &flResult, Scripting::FA_FLOAT);
 			
 			return flResult;
 		}
@@ -686,7 +795,7 @@ namespace Entity {
 			BEGIN_PARAMS(vArgs);
 			PUSH_FLOAT(fRot);
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void SetRotation(float)", &vArgs, nullptr, Scripting::FA_VOID);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void SetRotation(float)", &vArgs, nullptr, Scripting::FA_VOID);
 
 			END_PARAMS(vArgs);
 		}
@@ -697,7 +806,7 @@ namespace Entity {
 
 			Vector* pResult;
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "Vector& GetSize()", nullptr, &pResult, Scripting::FA_OBJECT);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "Vector& GetSize()", nullptr, &pResult, Scripting::FA_OBJECT);
 
 			return *pResult;
 		}
@@ -708,7 +817,7 @@ namespace Entity {
 
 			bool bResult;
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "bool NeedsRemoval()", nullptr, &bResult, Scripting::FA_BYTE);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "bool NeedsRemoval()", nullptr, &bResult, Scripting::FA_BYTE);
 
 			return bResult;
 		}
@@ -717,9 +826,12 @@ namespace Entity {
 		{
 			//Indicate if entity can be dormant
 
+			if (this->IsConstant(MT_CANBEDORMANT))
+				return (asBYTE)this->m_sTraits[MT_CANBEDORMANT].dwConstant != 0;
+
 			bool bResult;
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "bool CanBeDormant()", nullptr, &bResult, Scripting::FA_BYTE);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "bool CanBeDormant()", nullptr, &bResult, Scripting::FA_BYTE);
 
 			return bResult;
 		}
@@ -730,14 +842,100 @@ namespace Entity {
 
 			std::string szResult;
 
-			pScriptingInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "string GetName()", nullptr, &szResult, Scripting::FA_STRING);
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "string GetName()", nullptr, &szResult, Scripting::FA_STRING);
 
 			return szResult;
 		}
 
+		void SetMovement(float fSpeed, MovementDir dir)
+		{
+			//Set movement intent. The entity is then moved by the entity manager each frame. Heading and size are
+			//taken from the entity on each call, so an entity that turns or resizes while moving calls this again
+
+			this->m_sMovement.fHeading = this->GetRotation();
+			this->m_sMovement.vecSize = this->GetSize();
+
+			this->m_sMovement.fSpeed = fSpeed;
+			this->m_sMovement.eDir = dir;
+			this->m_sMovement.bActive = fSpeed != 0.0f;
+		}
+
+		void SetHeading(float fHeading)
+		{
+			//Set heading used for view-relative movement
+
+			this->m_sMovement.fHeading = fHeading;
+		}
+
+		void StopMovement(void)
+		{
+			//Clear movement intent
+
+			this->m_sMovement.bActive = false;
+			this->m_sMovement.fSpeed = 0.0f;
+			this->m_sMovement.fHeading = 0.0f;
+			this->m_sMovement.eDir = MOVE_FORWARD;
+			this->m_sMovement.vecSize.Zero();
+		}
+
+		void SetMovementState(const movement_s& sMovement)
+		{
+			//Set whole movement state, used when restoring snapshots
+
+			this->m_sMovement = sMovement;
+		}
+
+		std::string SaveSnapshot(void)
+		{
+			//Query optional script specific snapshot data
+
+			if ((!this->m_sTraits[MT_SAVESNAPSHOT].pFunction) || (this->IsEmpty(MT_SAVESNAPSHOT)))
+				return "";
+
+			std::string szResult;
+
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "string SaveSnapshot()", nullptr, &szResult, Scripting::FA_STRING);
+
+			return szResult;
+		}
+
+		void RestoreSnapshot(const std::string& szData)
+		{
+			//Pass script specific snapshot data back to class instance
+
+			if ((!this->m_sTraits[MT_RESTORESNAPSHOT].pFunction) || (this->IsEmpty(MT_RESTORESNAPSHOT)))
+				return;
+
+			std::string szArg = szData;
+
+			BEGIN_PARAMS(vArgs);
+			PUSH_OBJECT(&szArg);
+
+			this->m_pScriptInt->CallScriptMethod(this->m_hScript, this->m_pScriptObject, "void RestoreSnapshot(const string &in)", &vArgs, nullptr, Scripting::FA_VOID);
+
+			END_PARAMS(vArgs);
+		}
+
+		std::string GetScriptClassName(void) const
+		{
+			//Get name of the script class of the instance
+
+			if (!this->m_pScriptObject)
+				return this->m_szClassName;
+
+			return this->m_pScriptObject->GetObjectType()->GetName();
+		}
+
+		//Setters
+		inline void SetIdent(const std::wstring& wszIdent) { this->m_wszIdent = wszIdent; }
+
 		//Getters
 		inline bool IsReady(void) const { return (this->m_pScriptObject != nullptr); }
 		inline asIScriptObject* Object(void) const { return this->m_pScriptObject; }
+		inline const std::wstring& GetIdent(void) const { return this->m_wszIdent; }
+		inline bool IsMoving(void) const { return this->m_sMovement.bActive; }
+		inline const movement_s& GetMovement(void) const { return this->m_sMovement; }
+		inline const Vector& GetLastPosition(void) const { return this->m_vecLastPos; }
 	};
 
 	/* Scripted entity manager */
@@ -750,16 +948,21 @@ namespace Entity {
 	private:
 		std::vector<CScriptedEntity*> m_vEnts;
 		playerentity_s m_sPlayerEntity;
+		Scripting::CScriptInt* m_pScriptInt;
+		IWorldHost* m_pHost;
 
 		bool IsEntityDormant(CScriptedEntity* pEntity)
 		{
-			//Check if entity is considered being dormant
+			//Check if entity is considered being dormant. Nothing is viewed in headless worlds, so entities never fall dormant there
 
 			const int C_DISTANCE_ADDITION = 200;
 
+			if ((!this->m_pHost) || (!this->m_pHost->IsPresenting()))
+				return false;
+
 			//Get player position
 			Vector* vecPlayerPos = nullptr;
-			pScriptingInt->CallScriptMethod(this->m_sPlayerEntity.hScript, this->m_sPlayerEntity.pObject, "Vector& GetPosition()", nullptr, &vecPlayerPos, Scripting::FA_OBJECT);
+			this->m_pScriptInt->CallScriptMethod(this->m_sPlayerEntity.hScript, this->m_sPlayerEntity.pObject, "Vector& GetPosition()", nullptr, &vecPlayerPos, Scripting::FA_OBJECT);
 
 			if (vecPlayerPos) {
 				Vector vecEntityPos = pEntity->GetPosition();
@@ -785,12 +988,21 @@ namespace Entity {
 			return true;
 		}
 	public:
-		CScriptedEntsMgr() {}
+		CScriptedEntsMgr() : m_pScriptInt(nullptr), m_pHost(nullptr) {}
 		~CScriptedEntsMgr() { this->Release(); }
 
+		void Bind(Scripting::CScriptInt* pScriptInt, IWorldHost* pHost)
+		{
+			//Set script interface and host the entities are created with
+
+			this->m_pScriptInt = pScriptInt;
+			this->m_pHost = pHost;
+		}
+
 		bool Spawn(const std::wstring& wszIdent, asIScriptObject* pObject, const Vector& vAtPos);
 
 		void Process(void);
+		void ProcessMovement(void);
 
 		void Draw(void)
 		{
@@ -822,6 +1034,18 @@ namespace Entity {
 			}
 		}
 
+		void RemoveEntity(size_t uiEntityId)
+		{
+			//Remove entity from list
+
+			if (uiEntityId >= this->m_vEnts.size())
+				return;
+
+			this->m_vEnts[uiEntityId]->OnRelease();
+			delete this->m_vEnts[uiEntityId];
+			this->m_vEnts.erase(this->m_vEnts.begin() + uiEntityId);
+		}
+
 		void Release(void)
 		{
 			//Release resources
@@ -889,8 +1113,6 @@ namespace Entity {
 		const playerentity_s& GetPlayerEntity(void) const { return this->m_sPlayerEntity; }
 	};
 
-	extern CScriptedEntsMgr oScriptedEntMgr;
-
 	class CEntityTrace { //Entity tracing utility class
 	private:
 		struct tracedata_s {
@@ -924,8 +1146,8 @@ namespace Entity {
 			//Clear list
 			this->m_vEntities.clear();
 
-			for (size_t i = 0; i < oScriptedEntMgr.GetEntityCount(); i++) { //Loop through all entities
-				CScriptedEntity* pEntity = oScriptedEntMgr.GetEntity(i); //Get entity pointer
+			for (size_t i = 0; i < GetEntityManager().GetEntityCount(); i++) { //Loop through all entities
+				CScriptedEntity* pEntity = GetEntityManager().GetEntity(i); //Get entity pointer
 				if ((pEntity) && (pEntity->Object() != pIgnoreEnt) && (pEntity->IsCollidable())) { //Use only valid collidable entities
 					//Obtain model pointer
 					CModel* pModel = pEntity->GetModel();
@@ -1011,7 +1233,7 @@ namespace Entity {
 
 			//Load repated sprites if any
 			for (size_t i = 0; i < repeat; i++) {
-				DxRenderer::HD3DSPRITE hSprite = pRenderer->LoadSprite(wszFile, 1, w, h, 1, false);
+				DxRenderer::HD3DSPRITE hSprite = LoadAssetSprite(wszFile, 1, w, h, 1, false);
 				if (hSprite == GFX_INVALID_SPRITE_ID) {
 					return false;
 				}
@@ -1054,7 +1276,7 @@ namespace Entity {
 			//Free resources
 
 			for (size_t i = 0; i < this->m_vSprites.size(); i++) {
-				pRenderer->FreeSprite(this->m_vSprites[i]);
+				FreeAssetSprite(this->m_vSprites[i]);
 			}
 
 			this->m_vSprites.clear();
@@ -1089,7 +1311,7 @@ namespace Entity {
 
 			for (size_t i = 1; i < GOAL_ENTITY_MAX_SPRITES + 1; i++) {
 				std::wstring wszFileName = L"portal" + ((i < 10) ? L"0" + std::to_wstring(i) : std::to_wstring(i)) + L".png";
-				DxRenderer::HD3DSPRITE hSprite = pRenderer->LoadSprite(wszBasePath + L"media\\gfx\\portal\\" + wszFileName, 1, this->m_vecSize[0], this->m_vecSize[1], 1, true);
+				DxRenderer::HD3DSPRITE hSprite = LoadAssetSprite(wszBasePath + L"media\\gfx\\portal\\" + wszFileName, 1, this->m_vecSize[0], this->m_vecSize[1], 1, true);
 				this->m_vSprites.push_back(hSprite);
 			}
 
@@ -1103,7 +1325,7 @@ namespace Entity {
 			//Free sprites and clear list
 
 			for (size_t i = 0; i < this->m_vSprites.size(); i++) {
-				pRenderer->FreeSprite(this->m_vSprites[i]);
+				FreeAssetSprite(this->m_vSprites[i]);
 			}
 
 			this->m_vSprites.clear();
@@ -1133,6 +1355,9 @@ namespace Entity {
 		//Indicate if goal reached
 		bool IsGoalReached(void) const { return this->m_bGoalReached; }
 
+		//Indicate if goal is activated
+		bool IsActivated(void) const { return this->m_bActivated; }
+
 		//Get goal type/map
 		const std::wstring& GetGoal(void) const { return this->m_wszGoal; }
 
@@ -1157,8 +1382,8 @@ namespace Entity {
 			Vector* vecPosition = nullptr;
 			Vector* vecSize = nullptr;
 
-			pScriptingInt->CallScriptMethod(oScriptedEntMgr.GetPlayerEntity().hScript, oScriptedEntMgr.GetPlayerEntity().pObject, "Vector& GetPosition()", nullptr, &vecPosition, Scripting::FA_OBJECT);
-			pScriptingInt->CallScriptMethod(oScriptedEntMgr.GetPlayerEntity().hScript, oScriptedEntMgr.GetPlayerEntity().pObject, "Vector& GetSize()", nullptr, &vecSize, Scripting::FA_OBJECT);
+			GetScriptInt()->CallScriptMethod(GetEntityManager().GetPlayerEntity().hScript, GetEntityManager().GetPlayerEntity().pObject, "Vector& GetPosition()", nullptr, &vecPosition, Scripting::FA_OBJECT);
+			GetScriptInt()->CallScriptMethod(GetEntityManager().GetPlayerEntity().hScript, GetEntityManager().GetPlayerEntity().pObject, "Vector& GetSize()", nullptr, &vecSize, Scripting::FA_OBJECT);
 
 			if ((!vecPosition) || (!vecSize)) {
 				return;
@@ -1176,6 +1401,510 @@ namespace Entity {
 		}
 	};
 
+	/* Binary snapshot buffer */
+	const unsigned int SNAPSHOT_MAGIC = 0x504E5344; //"DSNP"
+	const unsigned int SNAPSHOT_VERSION = 2;
+
+	struct snapshot_info_s {
+		std::string szPackage;
+		std::string szFromPath;
+		std::string szMap;
+	};
+
+	class CSnapshotBuffer {
+	private:
+		std::string m_szData;
+		size_t m_uiReadPos;
+	public:
+		CSnapshotBuffer() : m_uiReadPos(0) {}
+		~CSnapshotBuffer() {}
+
+		void Reserve(size_t uiSize)
+		{
+			//Reserve memory for expected snapshot size
+
+			this->m_szData.reserve(uiSize);
+		}
+
+		void Clear(void)
+		{
+			//Clear buffer
+
+			this->m_szData.clear();
+			this->m_uiReadPos = 0;
+		}
+
+		void Write(const void* pData, size_t uiSize)
+		{
+			//Append raw data
+
+			this->m_szData.append((const char*)pData, uiSize);
+		}
+
+		void WriteString(const std::string& szString)
+		{
+			//Append length prefixed string
+
+			unsigned int uiLength = (unsigned int)szString.length();
+
+			this->Write(&uiLength, sizeof(uiLength));
+			this->Write(szString.data(), szString.length());
+		}
+
+		bool Read(void* pData, size_t uiSize)
+		{
+			//Read raw data
+
+			if (this->m_uiReadPos + uiSize > this->m_szData.length())
+				return false;
+
+			memcpy(pData, this->m_szData.data() + this->m_uiReadPos, uiSize);
+			this->m_uiReadPos += uiSize;
+
+			return true;
+		}
+
+		bool ReadString(std::string& szString)
+		{
+			//Read length prefixed string
+
+			unsigned int uiLength;
+			if (!this->Read(&uiLength, sizeof(uiLength)))
+				return false;
+
+			if (this->m_uiReadPos + uiLength > this->m_szData.length())
+				return false;
+
+			szString.assign(this->m_szData.data() + this->m_uiReadPos, uiLength);
+			this->m_uiReadPos += uiLength;
+
+			return true;
+		}
+
+		void WriteHeader(const snapshot_info_s& sInfo)
+		{
+			//Write snapshot header
+
+			unsigned int uiMagic = SNAPSHOT_MAGIC;
+			unsigned int uiVersion = SNAPSHOT_VERSION;
+
+			this->Write(&uiMagic, sizeof(uiMagic));
+			this->Write(&uiVersion, sizeof(uiVersion));
+			this->WriteString(sInfo.szPackage);
+			this->WriteString(sInfo.szFromPath);
+			this->WriteString(sInfo.szMap);
+		}
+
+		bool ReadHeader(snapshot_info_s& sInfo)
+		{
+			//Read and validate snapshot header
+
+			this->m_uiReadPos = 0;
+
+			unsigned int uiMagic, uiVersion;
+			if ((!this->Read(&uiMagic, sizeof(uiMagic))) || (uiMagic != SNAPSHOT_MAGIC))
+				return false;
+
+			if ((!this->Read(&uiVersion, sizeof(uiVersion))) || (uiVersion != SNAPSHOT_VERSION))
+				return false;
+
+			return (this->ReadString(sInfo.szPackage)) && (this->ReadString(sInfo.szFromPath)) && (this->ReadString(sInfo.szMap));
+		}
+
+		bool SaveToFile(const std::wstring& wszFile)
+		{
+			//Write whole buffer in one go
+
+			std::ofstream oFile(wszFile, std::ofstream::out | std::ofstream::binary);
+			if (!oFile.is_open())
+				return false;
+
+			oFile.write(this->m_szData.data(), this->m_szData.length());
+			bool bResult = oFile.good();
+			oFile.close();
+
+			return bResult;
+		}
+
+		bool LoadFromFile(const std::wstring& wszFile)
+		{
+			//Read whole file in one go
+
+			std::ifstream oFile(wszFile, std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+			if (!oFile.is_open())
+				return false;
+
+			std::streamoff uiSize = oFile.tellg();
+			oFile.seekg(0, std::ios_base::beg);
+
+			this->m_szData.resize((size_t)uiSize);
+			this->m_uiReadPos = 0;
+
+			oFile.read(&this->m_szData[0], uiSize);
+			bool bResult = oFile.gcount() == uiSize;
+			oFile.close();
+
+			return bResult;
+		}
+
+		void Swap(CSnapshotBuffer& oOther)
+		{
+			//Exchange buffer content without copying
+
+			this->m_szData.swap(oOther.m_szData);
+			std::swap(this->m_uiReadPos, oOther.m_uiReadPos);
+		}
+
+		void Assign(const std::string& szData)
+		{
+			//Set buffer content
+
+			this->m_szData = szData;
+			this->m_uiReadPos = 0;
+		}
+
+		static bool IsSnapshotFile(const std::wstring& wszFile)
+		{
+			//Check for snapshot magic
+
+			std::ifstream oFile(wszFile, std::ifstream::in | std::ifstream::binary);
+			if (!oFile.is_open())
+				return false;
+
+			unsigned int uiMagic = 0;
+			oFile.read((char*)&uiMagic, sizeof(uiMagic));
+			oFile.close();
+
+			return uiMagic == SNAPSHOT_MAGIC;
+		}
+
+		//Getters
+		inline const std::string& GetData(void) const { return this->m_szData; }
+		inline size_t GetSize(void) const { return this->m_szData.length(); }
+	};
+
+	/* Background snapshot file writer */
+	class CAsyncSnapshotWriter {
+	public:
+		enum writer_state_e {
+			WS_IDLE,
+			WS_PENDING,
+			WS_SUCCEEDED,
+			WS_FAILED
+		};
+	private:
+		std::thread* m_pThread;
+		std::atomic<int> m_iState;
+		CSnapshotBuffer m_oBuffer;
+		std::wstring m_wszFile;
+
+		void Work(void)
+		{
+			//Write to temporary file and replace target file once completely written
+
+			std::wstring wszTempFile = this->m_wszFile + L".tmp";
+
+			bool bResult = this->m_oBuffer.SaveToFile(wszTempFile);
+			if (bResult) {
+				bResult = MoveFileEx(wszTempFile.c_str(), this->m_wszFile.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) == TRUE;
+			}
+
+			if (!bResult) {
+				DeleteFile(wszTempFile.c_str());
+			}
+
+			this->m_iState = (bResult) ? WS_SUCCEEDED : WS_FAILED;
+		}
+
+		void Join(void)
+		{
+			//Wait for worker thread and free it
+
+			if (this->m_pThread) {
+				this->m_pThread->join();
+				delete this->m_pThread;
+				this->m_pThread = nullptr;
+			}
+		}
+	public:
+		CAsyncSnapshotWriter() : m_pThread(nullptr), m_iState(WS_IDLE) {}
+		~CAsyncSnapshotWriter() { this->Join(); }
+
+		bool Write(CSnapshotBuffer& oBuffer, const std::wstring& wszFile)
+		{
+			//Take over buffer content and write it in background
+
+			if (this->IsBusy())
+				return false;
+
+			this->Join();
+
+			this->m_oBuffer.Clear();
+			this->m_oBuffer.Swap(oBuffer);
+			this->m_wszFile = wszFile;
+			this->m_iState = WS_PENDING;
+
+			this->m_pThread = new std::thread(&CAsyncSnapshotWriter::Work, this);
+
+			return true;
+		}
+
+		writer_state_e Poll(void)
+		{
+			//Query state. A finished state is returned once and then reset to idle
+
+			int iState = this->m_iState;
+
+			if ((iState == WS_SUCCEEDED) || (iState == WS_FAILED)) {
+				this->Join();
+				this->m_iState = WS_IDLE;
+			}
+
+			return (writer_state_e)iState;
+		}
+
+		void Wait(void)
+		{
+			//Block until pending write has finished
+
+			this->Join();
+		}
+
+		//Getters
+		inline bool IsBusy(void) const { return this->m_iState == WS_PENDING; }
+		inline const std::wstring& GetFileName(void) const { return this->m_wszFile; }
+	};
+
+	const size_t REWIND_MIN_CAPACITY = 16;
+
+	/* Ring buffer of delta encoded world snapshots covering the last rewind_seconds of simulation time */
+	class CRewindBuffer {
+	private:
+		struct rewind_entry_s {
+			unsigned long long ullTick;
+			double dblTime; //Simulation time of the capture in milliseconds
+			size_t uiFullSize;
+			std::string szDelta;
+		};
+
+		std::vector<rewind_entry_s> m_vEntries;
+		size_t m_uiHead;
+		size_t m_uiCount;
+		std::string m_szBase;
+		CSnapshotBuffer m_oLatest;
+		CSnapshotBuffer m_oCapture; //Reused for each capture so the snapshot memory is only allocated once
+		double m_dblTime;
+		unsigned long long m_ullCaptures;
+		LONGLONG m_lCaptureTime;
+
+		static void EncodeDelta(const std::string& szPrev, const std::string& szCur, std::string& szOut);
+		static void DecodeDelta(const std::string& szPrev, const rewind_entry_s& sEntry, std::string& szOut);
+
+		void DropOldest(void);
+		void Grow(void);
+
+		inline rewind_entry_s& Entry(size_t uiIndex) { return this->m_vEntries[(this->m_uiHead + uiIndex) % this->m_vEntries.size()]; }
+	public:
+		CRewindBuffer() : m_uiHead(0), m_uiCount(0), m_dblTime(0.0), m_ullCaptures(0), m_lCaptureTime(0) {}
+		~CRewindBuffer() {}
+
+		void Clear(void)
+		{
+			//Clear buffered snapshots
+
+			for (size_t i = 0; i < this->m_vEntries.size(); i++) {
+				this->m_vEntries[i].szDelta.clear();
+			}
+
+			this->m_uiHead = 0;
+			this->m_uiCount = 0;
+			this->m_szBase.clear();
+			this->m_oLatest.Clear();
+			this->m_oCapture.Clear();
+			this->m_dblTime = 0.0;
+			this->m_ullCaptures = 0;
+			this->m_lCaptureTime = 0;
+		}
+
+		void Capture(CWorld* pWorld);
+		bool Rewind(CWorld* pWorld, unsigned long long ullTick);
+
+		size_t GetMemoryUsage(void) const
+		{
+			//Get memory used by snapshot data
+
+			size_t uiResult = this->m_szBase.capacity() + this->m_oLatest.GetData().capacity() + this->m_oCapture.GetData().capacity();
+
+			for (size_t i = 0; i < this->m_vEntries.size(); i++) {
+				uiResult += sizeof(rewind_entry_s) + this->m_vEntries[i].szDelta.capacity();
+			}
+
+			return uiResult;
+		}
+
+		//Getters
+		inline size_t GetCount(void) const { return this->m_uiCount; }
+		inline size_t GetCapacity(void) const { return this->m_vEntries.size(); }
+		inline unsigned long long GetOldestTick(void) const { return (this->m_uiCount) ? this->m_vEntries[this->m_uiHead].ullTick : 0; }
+		inline unsigned long long GetNewestTick(void) const { return (this->m_uiCount) ? this->m_vEntries[(this->m_uiHead + this->m_uiCount - 1) % this->m_vEntries.size()].ullTick : 0; }
+		inline size_t GetFullSize(void) const { return this->m_oLatest.GetSize(); }
+		inline unsigned long long GetCaptureCount(void) const { return this->m_ullCaptures; }
+		inline LONGLONG GetCaptureTime(void) const { return this->m_lCaptureTime; }
+	};
+
+	/* World component, owns the simulation state of a map */
+	class CWorld {
+	private:
+		Scripting::CScriptInt* m_pScriptInt;
+		IWorldHost* m_pHost;
+		world_settings_s m_sSettings;
+		CScriptedEntsMgr m_oEntities;
+		std::vector<CSolidSprite> m_vSolidSprites;
+		CGoalEntity* m_pGoalEntity;
+		Utils::CRandom m_oRandom;
+		unsigned long long m_ullTick;
+		unsigned int m_uiStateHash;
+		CRewindBuffer m_oRewind;
+
+		void UpdateStateHash(void);
+		CScriptedEntity* RespawnEntity(const std::string& szIdent, const std::string& szClassName, const Vector& vecPos);
+	public:
+		CWorld() : m_pScriptInt(nullptr), m_pHost(nullptr), m_pGoalEntity(nullptr), m_ullTick(0), m_uiStateHash(0)
+		{
+			this->m_sSettings.bDeterministic = false;
+			this->m_sSettings.iTickRate = 60;
+			this->m_sSettings.bHashLog = false;
+			this->m_sSettings.bRewind = false;
+			this->m_sSettings.iRewindInterval = 10;
+			this->m_sSettings.iRewindSeconds = 10;
+		}
+		~CWorld() { this->Release(); }
+
+		void Bind(Scripting::CScriptInt* pScriptInt, IWorldHost* pHost)
+		{
+			//Set script interface the entities of this world run on and the host providing the remaining services
+
+			this->m_pScriptInt = pScriptInt;
+			this->m_pHost = pHost;
+			this->m_oEntities.Bind(pScriptInt, pHost);
+		}
+
+		void AddSolidSprite(const CSolidSprite& oSprite)
+		{
+			//Add solid sprite to world
+
+			this->m_vSolidSprites.push_back(oSprite);
+		}
+
+		void SpawnGoal(int x, int y, const std::wstring& wszGoal)
+		{
+			//Spawn goal entity
+
+			//Free previous goal entity if was spawned
+			if (this->m_pGoalEntity) {
+				delete this->m_pGoalEntity;
+				this->m_pGoalEntity = nullptr;
+			}
+
+			this->m_pGoalEntity = new CGoalEntity();
+			this->m_pGoalEntity->SetPosition(x, y);
+			this->m_pGoalEntity->SetGoal(wszGoal);
+		}
+
+		bool IsVectorFieldInsideWall(const Vector& vecPos, const Vector& vecSize)
+		{
+			//Check if vector is inside wall
+
+			for (size_t i = 0; i < this->m_vSolidSprites.size(); i++) {
+				if (!this->m_vSolidSprites[i].IsWall()) {
+					continue;
+				}
+
+				if (this->m_vSolidSprites[i].IsVectorFieldCollided(vecPos, vecSize)) {
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void ResetSimulation(unsigned int uiSeed)
+		{
+			//Reset simulation state for a new map
+
+			this->m_oRandom.Seed(uiSeed);
+			this->m_ullTick = 0;
+			this->m_uiStateHash = 0;
+			this->m_oRewind.Clear();
+		}
+
+		DWORD GetSimulationTime(void) const
+		{
+			//Get elapsed simulation time in milliseconds based on the fixed tick rate
+
+			if (this->m_sSettings.iTickRate <= 0)
+				return 0;
+
+			return (DWORD)(this->m_ullTick * 1000 / (unsigned long long)this->m_sSettings.iTickRate);
+		}
+
+		int GetStepRate(void)
+		{
+			//Get amount of ticks per second. Deterministic worlds use the fixed tick rate, others follow the frame rate of their host
+
+			if (this->m_sSettings.bDeterministic)
+				return this->m_sSettings.iTickRate;
+
+			return (this->m_pHost) ? this->m_pHost->GetFrameRate() : 0;
+		}
+
+		void Process(void);
+		void Draw(void);
+
+		void WriteSnapshot(CSnapshotBuffer& oBuffer);
+		bool ReadSnapshot(CSnapshotBuffer& oBuffer);
+
+		void Clear(void)
+		{
+			//Release map content
+
+			//Release solid sprites
+			for (size_t i = 0; i < this->m_vSolidSprites.size(); i++) {
+				this->m_vSolidSprites[i].Release();
+			}
+
+			this->m_vSolidSprites.clear();
+
+			//Release scripted entities
+			this->m_oEntities.Release();
+		}
+
+		void Release(void)
+		{
+			//Release resources
+
+			this->Clear();
+
+			//Free memory
+			if (this->m_pGoalEntity) {
+				delete this->m_pGoalEntity;
+				this->m_pGoalEntity = nullptr;
+			}
+		}
+
+		//Getters
+		inline Scripting::CScriptInt* ScriptInt(void) { return this->m_pScriptInt; }
+		inline IWorldHost* Host(void) { return this->m_pHost; }
+		inline bool IsHeadless(void) { return (this->m_pHost) && (!this->m_pHost->IsPresenting()); }
+		inline world_settings_s& Settings(void) { return this->m_sSettings; }
+		inline CScriptedEntsMgr& Entities(void) { return this->m_oEntities; }
+		inline CGoalEntity* GetGoalEntity(void) { return this->m_pGoalEntity; }
+		inline Utils::CRandom& Random(void) { return this->m_oRandom; }
+		inline unsigned long long GetTick(void) const { return this->m_ullTick; }
+		inline unsigned int GetStateHash(void) const { return this->m_uiStateHash; }
+		inline CRewindBuffer& RewindBuffer(void) { return this->m_oRewind; }
+	};
+
 	/* File reader class */
 	class CFileReader {
 	public:
@@ -1514,6 +2243,18 @@ namespace Entity {
 	private:
 		std::ifstream* m_poFile;
 		std::vector<save_game_entry_s> m_vData;
+		std::wstring m_wszFile;
+		bool m_bSnapshot;
+
+		void AddDataItem(const std::string& szIdent, const std::string& szValue)
+		{
+			//Add data item
+
+			save_game_entry_s sItem;
+			sItem.szIdent = szIdent;
+			sItem.szValue = szValue;
+			this->m_vData.push_back(sItem);
+		}
 
 		bool IsValidFileHandle(void)
 		{
@@ -1536,13 +2277,16 @@ namespace Entity {
 			}
 		}
 	public:
-		CSaveGameReader() : m_poFile(nullptr) {}
+		CSaveGameReader() : m_poFile(nullptr), m_bSnapshot(false) {}
 		~CSaveGameReader() {}
 
 		bool OpenSaveGameFile(const std::string& szFile)
 		{
 			//Open save game file
 
+			this->m_wszFile = wszBasePath + L"saves\\" + Utils::ConvertToWideString(szFile);
+			this->m_bSnapshot = CSnapshotBuffer::IsSnapshotFile(this->m_wszFile);
+
 			this->m_poFile = new std::ifstream();
 			if (!this->m_poFile)
 				return false;
@@ -1560,6 +2304,20 @@ namespace Entity {
 				return;
 			}
 
+			//Binary snapshots only provide their header items here
+			if (this->m_bSnapshot) {
+				CSnapshotBuffer oSnapshot;
+				snapshot_info_s sInfo;
+
+				if ((oSnapshot.LoadFromFile(this->m_wszFile)) && (oSnapshot.ReadHeader(sInfo))) {
+					this->AddDataItem("package", sInfo.szPackage);
+					this->AddDataItem("frompath", sInfo.szFromPath);
+					this->AddDataItem("map", sInfo.szMap);
+				}
+
+				return;
+			}
+
 			this->m_poFile->seekg(0, std::ios_base::beg);
 
 			while (!this->m_poFile->eof()) {
@@ -1605,8 +2363,10 @@ namespace Entity {
 			this->Release();
 		}
 
-		//Getter
+		//Getters
 		const std::vector<save_game_entry_s>& GetDataVector(void) const { return this->m_vData; }
+		const std::wstring& GetFileName(void) const { return this->m_wszFile; }
+		bool IsSnapshot(void) const { return this->m_bSnapshot; }
 
 		//AngelScript interface methods
 		void Construct(void* pMemory) { new (pMemory) CSaveGameReader(); }
@@ -1980,5 +2740,6 @@ namespace Entity {
 		bool IsEnabled(void) { return this->m_bEnable; }
 	};
 
+	bool RegisterScriptingInterface(Scripting::CScriptInt* pScriptInt);
 	bool Initialize(void);
 }
\ No newline at end of file
@@ -15,6 +15,107 @@ namespace Game {
 	class CGame* pGame = nullptr;
 	CWindowEvents oDxWindowEvents;
 
+	void CGame::DrawLoadingProgress(const std::wstring& wszStage, size_t uiDone, size_t uiTotal)
+	{
+		//Draw loading screen with progress bar. Map loading blocks the main loop, so a frame is presented directly
+
+		int iBarWidth = pWindow->GetResolutionX() / 2;
+		int iBarX = pWindow->GetResolutionX() / 2 - iBarWidth / 2;
+		int iBarY = pWindow->GetResolutionY() - 60;
+		int iFilled = (uiTotal) ? (int)((long long)iBarWidth * (long long)uiDone / (long long)uiTotal) : iBarWidth;
+
+		pRenderer->DrawBegin();
+		pRenderer->DrawSprite(this->m_hLoadingScreen, 0, 0, 0, 0.0f);
+		pRenderer->DrawFilledBox(iBarX, iBarY, iFilled, 10, 200, 200, 200, 255);
+		pRenderer->DrawBox(iBarX, iBarY, iBarWidth, 10, 1, 200, 200, 200, 255);
+		pRenderer->DrawString(pDefaultFont, wszStage, iBarX, iBarY - iDefaultFontSize[1] - 5, 200, 200, 200, 255);
+		pRenderer->DrawEnd();
+	}
+
+	bool CGame::ExecuteMapScript(const std::wstring& wszMapFile)
+	{
+		//Load map in stages: compile the map script and gather its dependencies, then read files and decode sounds on
+		//the job system while the required entity scripts are compiled. Textures and mixer sounds are created on this thread
+
+		LONGLONG lFrequency, lStart, lEnd;
+		QueryPerformanceFrequency((LARGE_INTEGER*)&lFrequency);
+		QueryPerformanceCounter((LARGE_INTEGER*)&lStart);
+
+		this->m_oJobs.Startup((pGameLoadWorkers->iValue > 0) ? (size_t)pGameLoadWorkers->iValue : Jobs::CJobSystem::GetDefaultWorkerCount());
+
+		//Sprites released by previous maps stay resident within the budget
+		this->m_oPrefetcher.SetBudget((pGameResidentBudget->iValue > 0) ? (size_t)pGameResidentBudget->iValue * 1024 * 1024 : 0);
+
+		//Load manifest of assets recorded during previous runs of the map
+		this->m_oPrefetcher.BeginMap(wszMapFile, pGamePrefetch->bValue);
+
+		if (!this->m_oMapCache.Prepare(wszMapFile, oFileSystem, pGameMapCache->bValue))
+			return false;
+
+		//Gather required entity scripts and sprites placed by the map. Sounds come from the manifest, sounds queried
+		//while the map script runs are decoded through the deferred loads below
+		std::vector<std::wstring> vScripts;
+		const std::vector<ConfigMgr::CScriptParser::TExpression>& vExpressions = this->m_oMapCache.GetExpressions();
+
+		for (size_t i = 0; i < vExpressions.size(); i++) {
+			const ConfigMgr::CScriptParser::TExpression& rExpression = vExpressions[i];
+
+			if ((rExpression.size() >= 2) && (rExpression[0] == L"ent_require")) {
+				vScripts.push_back(rExpression[1]);
+			} else if ((rExpression.size() >= 8) && (rExpression[0] == L"env_solidsprite")) {
+				std::wstring wszFile = this->m_oMapCache.ResolveGfxFile(oFileSystem, rExpression[1]);
+				int iRepeat = _wtoi(rExpression[7].c_str());
+
+				//The solid sprite loads one texture per repetition
+				for (int j = 0; j < iRepeat; j++) {
+					this->m_oPrefetcher.AddMapSprite(wszFile, 1, _wtoi(rExpression[4].c_str()), _wtoi(rExpression[5].c_str()), 1, false);
+				}
+			}
+		}
+
+		//Start reading and decoding
+		size_t uiJobBase = this->m_oJobs.GetSubmitted();
+		size_t uiJobCount = this->m_oPrefetcher.QueueJobs(this->m_oJobs);
+		size_t uiTotal = uiJobCount + vScripts.size();
+
+		//Sounds queried by scripts during loading are decoded on the job system as well
+		pSound->BeginDeferredLoads(&this->m_oJobs);
+
+		//Compile entity scripts meanwhile. Scripts kept resident from previous maps are reused
+		size_t uiResidentScripts = 0;
+		for (size_t i = 0; i < vScripts.size(); i++) {
+			if (this->FindScript(vScripts[i]) != std::string::npos) {
+				uiResidentScripts++;
+			}
+
+			this->DrawLoadingProgress(L"Compiling " + vScripts[i], i + this->m_oJobs.GetCompleted() - uiJobBase, uiTotal);
+			this->RequireEntityScript(vScripts[i]);
+		}
+
+		while (!this->m_oJobs.Wait(GAME_LOAD_PROGRESS_INTERVAL)) {
+			this->DrawLoadingProgress(L"Loading assets", vScripts.size() + this->m_oJobs.GetCompleted() - uiJobBase, uiTotal);
+		}
+
+		this->DrawLoadingProgress(L"Creating resources", uiTotal, uiTotal);
+
+		//Create sounds and sprites, then execute the map script which picks up the created sprites
+		this->m_oPrefetcher.Upload();
+		this->m_oMapCache.Replay();
+
+		//Create sounds queried while the map script was executed
+		while (!this->m_oJobs.Wait(GAME_LOAD_PROGRESS_INTERVAL)) {
+			this->DrawLoadingProgress(L"Loading sounds", uiTotal, uiTotal);
+		}
+
+		pSound->EndDeferredLoads();
+
+		QueryPerformanceCounter((LARGE_INTEGER*)&lEnd);
+
+		pConsole->AddLine(L"Loaded map in " + std::to_wstring((int)((double)(lEnd - lStart) * 1000.0 / (double)lFrequency)) + L" ms (" + std::to_wstring(vScripts.size()) + L" scripts, " + std::to_wstring(uiResidentScripts) + L" resident, " + std::to_wstring(uiJobCount) + L" asset jobs, " + std::to_wstring(this->m_oPrefetcher.GetResidentHits()) + L" resident sprites, " + std::to_wstring(this->m_oJobs.GetWorkerCount()) + L" workers)");
+
+		return true;
+	}
+
 	bool CGame::LoadMap(const std::wstring& wszMap)
 	{
 		//Load package map file
@@ -25,21 +126,28 @@ namespace Game {
 		this->m_bGamePause = false;
 
 		//Free old resources
+		this->m_oWorld.Clear();
+		this->UpdateWorldSettings();
 
-		for (size_t i = 0; i < this->m_vSolidSprites.size(); i++) {
-			this->m_vSolidSprites[i].Release();
-		}
-
-		this->m_vSolidSprites.clear();
+		//Reset simulation state. In deterministic mode the world generator uses a fixed seed
+		this->m_oWorld.ResetSimulation((pSimDeterministic->bValue) ? (unsigned int)pSimSeed->iValue : (unsigned int)time(nullptr));
+		QueryPerformanceCounter((LARGE_INTEGER*)&this->m_lSimLastCount);
+		this->m_lSimAccumulator = 0;
 
-		Entity::oScriptedEntMgr.Release();
+		//Restart autosave interval and drop save requests of the previous map
+		this->m_dwLastAutoSave = GetTickCount64();
+		this->m_bSaveRequested = false;
+		this->m_bSaveRequestAuto = false;
 
 		//Execute package map file
-		if (!pConfigMgr->Execute(this->GetPackagePath() + L"maps\\" + wszMap)) {
+		if (!this->ExecuteMapScript(this->GetPackagePath() + L"maps\\" + wszMap)) {
+			this->m_oMapCache.AbortLoad();
 			pConsole->AddLine(L"Failed to execute package map script");
 			return false;
 		}
 
+		this->m_oPrefetcher.StartRecording();
+
 		this->m_sMap.wszFileName = wszMap;
 
 		//Publish current achievements
@@ -47,10 +155,8 @@ namespace Game {
 			pAchievements->PublishAchievementAndStatProgress();
 		}
 
-		std::wstring wszBackgroundFile = this->m_sPackage.wszPakPath + L"\\gfx\\" + this->m_sMap.wszBackground;
-		if (!Utils::FileExists(wszBackgroundFile)) {
-			wszBackgroundFile = wszBasePath + L"packages\\.common\\gfx\\" + this->m_sMap.wszBackground;
-		}
+		std::wstring wszBackgroundFile = this->m_oMapCache.ResolveGfxFile(oFileSystem, this->m_sMap.wszBackground);
+		this->m_oMapCache.EndLoad();
 
 		//Set map background
 		return pRenderer->SetBackgroundPicture(wszBackgroundFile);
@@ -107,7 +213,19 @@ namespace Game {
 						pConsole->AddLine(L"Failed to start new game", Console::ConColor(250, 0, 0));
 					}
 
-					if (this->m_bLoadSavedGame) { //Handle load saved game state case
+					if ((this->m_bLoadSavedGame) && (this->m_oSaveGameReader.IsSnapshot())) { //Handle load binary snapshot case
+						this->LoadMap(Utils::ConvertToWideString(this->m_oSaveGameReader.GetDataItem("map")));
+
+						Entity::CSnapshotBuffer oSnapshot;
+						Entity::snapshot_info_s sInfo;
+
+						if ((!oSnapshot.LoadFromFile(this->m_oSaveGameReader.GetFileName())) || (!oSnapshot.ReadHeader(sInfo)) || (!this->m_oWorld.ReadSnapshot(oSnapshot))) {
+							pConsole->AddLine(L"Failed to restore snapshot", Console::ConColor(250, 0, 0));
+						}
+
+						this->m_oSaveGameReader.Close();
+						this->m_bLoadSavedGame = false;
+					} else if (this->m_bLoadSavedGame) { //Handle load saved game state case
 						this->LoadMap(Utils::ConvertToWideString(this->m_oSaveGameReader.GetDataItem("map")));
 
 						const std::vector<Entity::CSaveGameReader::save_game_entry_s>& vList = this->m_oSaveGameReader.GetDataVector();
@@ -116,7 +234,7 @@ namespace Game {
 								continue;
 							}
 
-							Scripting::HSISCRIPT hScript = this->FindScript(L"player");
+							Scripting::HSISCRIPT hScript = this->GetScriptHandleByIdent(L"player");
 
 							std::string szIdent = vList[i].szIdent;
 							std::string szValue = vList[i].szValue;
@@ -142,6 +260,11 @@ namespace Game {
 				}
 			}
 
+			//Inject recorded input in timedemo mode
+			if (this->m_oDemoPlayer.IsPlaying()) {
+				this->DispatchDemoEvents();
+			}
+
 			if ((this->m_bGameStarted) && (!this->m_bGamePause)) {
 				//Handle that framerate update are only allowed when a specific time has elapsed per map start
 				if (!this->m_bAllowUpdateFramerate) {
@@ -151,16 +274,26 @@ namespace Game {
 					}
 				}
 
-				//Process scripted entities
-				Entity::oScriptedEntMgr.Process();
+				//Process world
+				this->UpdateWorldSettings();
 
-				//Process goal entity
-				if (this->m_pGoalEntity) {
-					this->m_pGoalEntity->Process();
+				if (this->m_oDemoPlayer.IsPlaying()) {
+					this->ProcessTimeDemo();
+				} else if (pSimDeterministic->bValue) {
+					this->ProcessFixedTicks();
+				} else {
+					this->m_oWorld.Process();
+				}
+
+				//Capture requested save game at tick boundary
+				this->CaptureSaveGame();
 
+				//Handle goal entity
+				Entity::CGoalEntity* pGoalEntity = this->m_oWorld.GetGoalEntity();
+				if (pGoalEntity) {
 					//Handle if game goal reached
-					if (this->m_pGoalEntity->IsGoalReached()) {
-						if (this->m_pGoalEntity->GetGoal() == L"#finished") { //Package game has finished
+					if (pGoalEntity->IsGoalReached()) {
+						if (pGoalEntity->GetGoal() == L"#finished") { //Package game has finished
 							this->m_oIntermissionMenu.SetGameFinishState(true);
 						} else { //Current map has finished and a next map is following
 							this->m_oIntermissionMenu.SetGameFinishState(false);
@@ -174,10 +307,31 @@ namespace Game {
 				}
 			}
 
+			//Report finished background saves
+			this->PollSaveGame();
+
+			//Update sound voices. Looped positional sounds are heard from the player position
+			if ((this->m_bGameStarted) && (this->m_oWorld.Entities().GetPlayerEntity().pObject)) {
+				const Entity::CScriptedEntsMgr::playerentity_s& playerEntity = this->m_oWorld.Entities().GetPlayerEntity();
+				Entity::Vector* vecPlayerPos = nullptr;
+
+				pScriptingInt->CallScriptMethod(playerEntity.hScript, playerEntity.pObject, "Vector& GetPosition()", nullptr, &vecPlayerPos, Scripting::FA_OBJECT);
+
+				if (vecPlayerPos) {
+					pSound->SetListenerPosition((float)(*vecPlayerPos)[0], (float)(*vecPlayerPos)[1]);
+				}
+			}
+
+			pSound->SetMaxVoices((pSndMaxVoices->iValue > 0) ? (size_t)pSndMaxVoices->iValue : 1);
+			pSound->Process();
+
 			//Process HUD info messages
 			this->m_oHudInfoMessages.Process();
 
-			Sleep(1);
+			//Timedemo runs as fast as possible
+			if (!this->m_oDemoPlayer.IsPlaying()) {
+				Sleep(1);
+			}
 		}
 	}
 
@@ -185,19 +339,8 @@ namespace Game {
 	{
 		if (this->m_bGameStarted) {
 			if (!this->m_oMenu.IsOpen()) {
-				//Draw solid sprites
-				for (size_t i = 0; i < this->m_vSolidSprites.size(); i++) {
-					this->m_vSolidSprites[i].Draw();
-				}
-
-				//Draw scripted entities
-				Entity::oScriptedEntMgr.Draw();
-				Entity::oScriptedEntMgr.DrawOnTop();
-
-				//Draw goal entity
-				if (this->m_pGoalEntity) {
-					this->m_pGoalEntity->Draw();
-				}
+				//Draw world
+				this->m_oWorld.Draw();
 
 				//Draw intermission menu if active
 				if (this->m_bShowIntermission) {
@@ -246,28 +389,23 @@ namespace Game {
 		//Indicate game not started anymore
 		this->m_bGameStarted = false;
 
-		//Release solid sprites
-		for (size_t i = 0; i < this->m_vSolidSprites.size(); i++) {
-			this->m_vSolidSprites[i].Release();
-		}
-
-		//Release scripted entities
-		Entity::oScriptedEntMgr.Release();
+		//Release world content
+		this->m_oWorld.Release();
 
-		//Unload entity scripts
-		for (size_t i = 0; i < this->m_vEntityScripts.size(); i++) {
-			pScriptingInt->UnloadScript(this->m_vEntityScripts[i].hScript);
+		//Keep entity scripts compiled for the next map if resources may stay resident. Compiled modules are not counted
+		//against the resident budget, which only limits pooled sprites. Modules whose globals can not be reset are compiled again
+		if (pGameResidentBudget->iValue > 0) {
+			for (size_t i = this->m_vEntityScripts.size(); i > 0; i--) {
+				if (!pScriptingInt->ResetScript(this->m_vEntityScripts[i - 1].hScript)) {
+					this->ReloadEntityScript(i - 1);
+				}
+			}
+		} else {
+			this->UnloadEntityScripts();
 		}
 
-		//Clear lists
-		this->m_vEntityScripts.clear();
-		this->m_vSolidSprites.clear();
-
-		//Free memory
-		if (this->m_pGoalEntity) {
-			delete this->m_pGoalEntity;
-			this->m_pGoalEntity = nullptr;
-		}
+		//Store recorded asset manifest
+		this->m_oPrefetcher.EndMap();
 
 		//Reset indicators
 		this->m_bShowIntermission = false;
@@ -275,6 +413,10 @@ namespace Game {
 		this->m_bInGameLoadingProgress = false;
 		this->m_bLoadSavedGame = false;
 
+		//Drop pending save request, it refers to the stopped game
+		this->m_bSaveRequested = false;
+		this->m_bSaveRequestAuto = false;
+
 		//Inform menu
 		this->m_oMenu.OnStopGame();
 		//this->m_oMenu.OnCloseAll();
@@ -292,25 +434,88 @@ namespace Game {
 		pRenderer->SetBackgroundPicture(wszBasePath + L"media\\gfx\\background.jpg");
 
 		//Play main menu theme if loaded
-		pSound->Play(this->m_hMenuTheme, pSndVolume->iValue, DSBPLAY_LOOPING);
+		pSound->Play(this->m_hMenuTheme, pSndVolume->iValue, SND_PLAY_LOOPING);
+	}
+
+	void CGame::UnloadEntityScripts(void)
+	{
+		//Unload entity scripts
+
+		for (size_t i = 0; i < this->m_vEntityScripts.size(); i++) {
+			pScriptingInt->UnloadScript(this->m_vEntityScripts[i].hScript);
+		}
+
+		//Clear list
+		this->m_vEntityScripts.clear();
+		this->m_oEntityScriptIndex.Clear();
+	}
+
+	bool CGame::ReloadEntityScript(size_t uiScriptListId)
+	{
+		//Unload and compile an entity script again. The script is removed from the list if it can not be compiled
+
+		pScriptingInt->UnloadScript(this->m_vEntityScripts[uiScriptListId].hScript);
+
+		std::wstring wszFullFilePath;
+		if (oFileSystem.Resolve(L"entities\\" + this->m_vEntityScripts[uiScriptListId].wszIdent + L".as", wszFullFilePath)) {
+			Scripting::HSISCRIPT hScript = pScriptingInt->LoadScript(Utils::ConvertToAnsiString(wszFullFilePath));
+			if (hScript != SI_INVALID_ID) {
+				this->m_vEntityScripts[uiScriptListId].hScript = hScript;
+				return true;
+			}
+		}
+
+		pConsole->AddLine(L"Failed to reload entity script: " + this->m_vEntityScripts[uiScriptListId].wszIdent, Console::ConColor(255, 0, 0));
+
+		this->m_vEntityScripts.erase(this->m_vEntityScripts.begin() + uiScriptListId);
+		this->m_oEntityScriptIndex.Remove(uiScriptListId);
+
+		return false;
+	}
+
+	void CGame::FlushResidency(void)
+	{
+		//Free scripts and sprites kept resident for the current package
+
+		this->UnloadEntityScripts();
+		this->m_oPrefetcher.FlushResident();
+
+		this->m_wszResidentPackage.clear();
+	}
+
+	bool CGame::UnmountArchive(const std::wstring& wszPackagePath)
+	{
+		//Unmount archive of a package folder. Streams playing from the archive get their own copy of the data first
+
+		const Pak::CArchive* pArchive = oArchiveSet.FindArchive(wszPackagePath);
+		if (!pArchive)
+			return true;
+
+		if (!pSound->DetachArchive(pArchive))
+			return false;
+
+		return oArchiveSet.Unmount(wszPackagePath);
 	}
 
 	void CGame::OnMouseEvent(int x, int y, int iMouseKey, bool bDown, bool bCtrlHeld, bool bShiftHeld, bool bAltHeld)
 	{
 		//Called for mouse events
 		
+		//Record for demo if active
+		this->m_oDemoRecorder.AddMouseEvent(this->m_oWorld.GetTick(), x, y, iMouseKey, bDown);
+
 		this->m_oCursor.OnMouseEvent(x, y, iMouseKey, bDown, bCtrlHeld, bShiftHeld, bAltHeld);
 
 		if (!this->m_oMenu.IsOpen()) {
 			//Inform player entity
 			if (!iMouseKey) {
-				const Entity::CScriptedEntsMgr::playerentity_s& playerEntity = Entity::oScriptedEntMgr.GetPlayerEntity();
+				const Entity::CScriptedEntsMgr::playerentity_s& playerEntity = this->m_oWorld.Entities().GetPlayerEntity();
 				Entity::Vector vPos(x, y);
 				BEGIN_PARAMS(vArgs);
 				PUSH_OBJECT(&vPos);
 				pScriptingInt->CallScriptMethod(playerEntity.hScript, playerEntity.pObject, "void OnUpdateCursor(const Vector &in pos)", &vArgs, nullptr, Scripting::FA_VOID);
 			} else {
-				const Entity::CScriptedEntsMgr::playerentity_s& playerEntity = Entity::oScriptedEntMgr.GetPlayerEntity();
+				const Entity::CScriptedEntsMgr::playerentity_s& playerEntity = this->m_oWorld.Entities().GetPlayerEntity();
 				BEGIN_PARAMS(vArgs);
 				PUSH_DWORD(iMouseKey);
 				PUSH_BYTE(bDown);
@@ -355,6 +560,9 @@ namespace Game {
 	void CGame::OnKeyEvent(int vKey, bool bDown, bool bCtrlHeld, bool bShiftHeld, bool bAltHeld)
 	{
 		//Called for key events
+
+		//Record for demo if active
+		this->m_oDemoRecorder.AddKeyEvent(this->m_oWorld.GetTick(), vKey, bDown);
 		
 		if (vKey == g_oInputMgr.GetKeyBindingCode(L"MENU")) {
 			if (!bDown) {
@@ -374,7 +582,7 @@ namespace Game {
 		}
 
 		if (!this->m_oMenu.IsOpen()) {
-			const Entity::CScriptedEntsMgr::playerentity_s& playerEntity = Entity::oScriptedEntMgr.GetPlayerEntity();
+			const Entity::CScriptedEntsMgr::playerentity_s& playerEntity = this->m_oWorld.Entities().GetPlayerEntity();
 
 			BEGIN_PARAMS(vArgs);
 			PUSH_DWORD(vKey);
@@ -506,6 +714,312 @@ namespace Game {
 		pConfigMgr->Execute(wszBasePath + wszText);
 	}
 
+	void Cmd_SimState(void)
+	{
+		Entity::CWorld* pWorld = pGame->GetWorld();
+
+		wchar_t wszHash[32];
+		swprintf_s(wszHash, L"%08X", pWorld->GetStateHash());
+
+		pConsole->AddLine(L"Tick: " + std::to_wstring(pWorld->GetTick()) + L", state hash: " + wszHash + L", deterministic: " + std::to_wstring(pSimDeterministic->bValue));
+	}
+
+	void Cmd_Rewind(void)
+	{
+		Entity::CRewindBuffer& rRewind = pGame->GetWorld()->RewindBuffer();
+
+		std::wstring wszTick = pConfigMgr->ExpressionItemValue(1);
+		if (!wszTick.length()) {
+			pConsole->AddLine(L"Usage: rewind <tick> (buffered: " + std::to_wstring(rRewind.GetOldestTick()) + L" - " + std::to_wstring(rRewind.GetNewestTick()) + L")");
+			return;
+		}
+
+		if (rRewind.Rewind(pGame->GetWorld(), _wtoi64(wszTick.c_str()))) {
+			pConsole->AddLine(L"Rewound to tick " + std::to_wstring(pGame->GetWorld()->GetTick()));
+		} else {
+			pConsole->AddLine(L"Tick is not buffered", Console::ConColor(250, 0, 0));
+		}
+	}
+
+	void Cmd_RewindStats(void)
+	{
+		Entity::CRewindBuffer& rRewind = pGame->GetWorld()->RewindBuffer();
+
+		LONGLONG lFrequency;
+		QueryPerformanceFrequency((LARGE_INTEGER*)&lFrequency);
+
+		double dblCaptureTime = (rRewind.GetCaptureCount()) ? (double)rRewind.GetCaptureTime() * 1000000.0 / (double)lFrequency / (double)rRewind.GetCaptureCount() : 0.0;
+		double dblTickTime = (pRewindInterval->iValue > 0) ? dblCaptureTime / (double)pRewindInterval->iValue : 0.0;
+		size_t uiPerSnapshot = (rRewind.GetCount()) ? rRewind.GetMemoryUsage() / rRewind.GetCount() : 0;
+
+		wchar_t wszStats[512];
+		swprintf_s(wszStats, L"Rewind: %u/%u snapshots, ticks %llu - %llu, full snapshot %u bytes, memory %u bytes (%u per snapshot), capture %.1f us (%.1f us per tick)",
+			(unsigned int)rRewind.GetCount(), (unsigned int)rRewind.GetCapacity(), rRewind.GetOldestTick(), rRewind.GetNewestTick(),
+			(unsigned int)rRewind.GetFullSize(), (unsigned int)rRewind.GetMemoryUsage(), (unsigned int)uiPerSnapshot, dblCaptureTime, dblTickTime);
+
+		pConsole->AddLine(wszStats);
+	}
+
+	void Cmd_SndStats(void)
+	{
+		const DxSound::voice_stats_s& rStats = pSound->GetVoiceStats();
+
+		wchar_t wszStats[256];
+		swprintf_s(wszStats, L"Voices: %u active, %u peak, %u max. Last frame: %u started, %u stolen, %u rejected, %u culled. Resident audio: %u KB",
+			(unsigned int)rStats.uiActive, (unsigned int)rStats.uiPeak, (unsigned int)pSound->GetMaxVoices(),
+			(unsigned int)rStats.uiStarted, (unsigned int)rStats.uiStolen, (unsigned int)rStats.uiRejected, (unsigned int)rStats.uiCulled, (unsigned int)(pSound->GetResidentMemory() / 1024));
+
+		pConsole->AddLine(wszStats);
+
+		const DxSound::mixer_stats_s& rMixerStats = pSound->GetMixerStats();
+
+		swprintf_s(wszStats, L"Mixer: %llu blocks of %u frames, mix time avg %.1f us, max %.1f us, %u dropped commands",
+			rMixerStats.ullBlocks, (unsigned int)MIX_BLOCK_FRAMES, rMixerStats.dblAvgMixTime, rMixerStats.dblMaxMixTime, (unsigned int)rMixerStats.uiDroppedCommands);
+
+		pConsole->AddLine(wszStats);
+
+		pSound->ResetPeak();
+	}
+
+	void Cmd_PrefetchStats(void)
+	{
+		Prefetch::CAssetPrefetcher& rPrefetcher = pGame->GetAssetPrefetcher();
+
+		if (!rPrefetcher.GetManifestFile().length()) {
+			pConsole->AddLine(L"No map loaded");
+			return;
+		}
+
+		wchar_t wszStats[512];
+		swprintf_s(wszStats, L"Prefetch: %u manifest entries, %u assets prefetched in %.1f ms, %u prefetched sprites used, %u unused, %u resident from earlier maps. Pool: %u KB. Mid-game loads: %u",
+			(unsigned int)rPrefetcher.GetManifestSize(), (unsigned int)rPrefetcher.GetPrefetched(), rPrefetcher.GetPrefetchTime(),
+			(unsigned int)rPrefetcher.GetPrefetchHits(), (unsigned int)rPrefetcher.GetUnusedSprites(), (unsigned int)rPrefetcher.GetResidentHits(),
+			(unsigned int)(rPrefetcher.GetPoolMemory() / 1024), (unsigned int)rPrefetcher.GetMidGameLoads());
+
+		pConsole->AddLine(wszStats);
+	}
+
+	void Cmd_MapCacheStats(void)
+	{
+		MapCache::CMapCache& rMapCache = pGame->GetMapCache();
+
+		if (!rMapCache.GetCacheFile().length()) {
+			pConsole->AddLine(L"No map loaded");
+			return;
+		}
+
+		wchar_t wszStats[512];
+		swprintf_s(wszStats, L"Map cache: script %ls, %u expressions, %u asset paths, executed in %.1f ms",
+			(rMapCache.IsFromCache()) ? L"replayed from cache" : L"compiled", (unsigned int)rMapCache.GetExpressionCount(), (unsigned int)rMapCache.GetAssetCount(), rMapCache.GetLoadTime());
+
+		pConsole->AddLine(wszStats);
+	}
+
+	void Cmd_CfgBench(void)
+	{
+		std::wstring wszPackage = pConfigMgr->ExpressionItemValue(1);
+		if (!wszPackage.length()) {
+			pConsole->AddLine(L"Usage: cfg_bench <package> [passes]");
+			return;
+		}
+
+		int iPasses = _wtoi(pConfigMgr->ExpressionItemValue(2).c_str());
+		if (iPasses <= 0) {
+			iPasses = 100;
+		}
+
+		std::wstring wszMapPath = wszBasePath + L"packages\\" + wszPackage + L"\\maps\\";
+
+		//Map files are only tokenized by a separate parser so that nothing is spawned or changed
+		ConfigMgr::CConfigInt oParser(wszMapPath);
+		oParser.SetDispatch(false);
+
+		WIN32_FIND_DATA sFindData = { 0 };
+		double dTotalTime = 0.0;
+		size_t uiFileCount = 0;
+
+		HANDLE hFileSearch = FindFirstFile((wszMapPath + L"*.cfg").c_str(), &sFindData);
+		if (hFileSearch == INVALID_HANDLE_VALUE) {
+			pConsole->AddLine(L"No map files found in " + wszMapPath, Console::ConColor(250, 0, 0));
+			return;
+		}
+
+		do {
+			if ((sFindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY) {
+				continue;
+			}
+
+			std::chrono::steady_clock::time_point oStart = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < iPasses; i++) {
+				oParser.Execute(sFindData.cFileName);
+			}
+
+			double dTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - oStart).count();
+			dTotalTime += dTime;
+			uiFileCount++;
+
+			wchar_t wszResult[512];
+			swprintf_s(wszResult, L"%ls: %u bytes, %.3f ms per pass", sFindData.cFileName, (unsigned int)sFindData.nFileSizeLow, dTime / iPasses);
+			pConsole->AddLine(wszResult);
+		} while (FindNextFile(hFileSearch, &sFindData));
+
+		FindClose(hFileSearch);
+
+		wchar_t wszTotal[256];
+		swprintf_s(wszTotal, L"%u map files, %d passes: %.3f ms per pass in total", (unsigned int)uiFileCount, iPasses, dTotalTime / iPasses);
+		pConsole->AddLine(wszTotal);
+	}
+
+	void Cmd_PakBuild(void)
+	{
+		std::wstring wszPackage = pConfigMgr->ExpressionItemValue(1);
+		if (!wszPackage.length()) {
+			pConsole->AddLine(L"Usage: pak_build <package>");
+			return;
+		}
+
+		std::wstring wszPackagePath = wszBasePath + L"packages\\" + wszPackage;
+		if (!Utils::DirExists(wszPackagePath)) {
+			pConsole->AddLine(L"Package folder not found: " + wszPackagePath, Console::ConColor(250, 0, 0));
+			return;
+		}
+
+		//A mounted archive is mapped and can not be overwritten, so it is unmounted while building and mounted again afterwards
+		bool bMounted = oArchiveSet.FindArchive(wszPackagePath) != nullptr;
+		if ((bMounted) && (!pGame->UnmountArchive(wszPackagePath))) {
+			pConsole->AddLine(L"Archive of package is in use: " + wszPackage, Console::ConColor(250, 0, 0));
+			return;
+		}
+
+		size_t uiFileCount = 0;
+		std::wstring wszFailedFile;
+		bool bResult = Pak::BuildArchive(wszPackagePath, wszPackagePath + PAK_FILE_EXT, uiFileCount, wszFailedFile);
+
+		if (bMounted) {
+			oArchiveSet.Mount(wszPackagePath + PAK_FILE_EXT, wszPackagePath);
+		}
+
+		if (!bResult) {
+			if (wszFailedFile.length()) {
+				pConsole->AddLine(L"Failed to read " + wszFailedFile + L", archive has not been written", Console::ConColor(250, 0, 0));
+			} else {
+				pConsole->AddLine(L"Failed to write archive " + wszPackagePath + PAK_FILE_EXT, Console::ConColor(250, 0, 0));
+			}
+
+			return;
+		}
+
+		pConsole->AddLine(L"Packed " + std::to_wstring(uiFileCount) + L" files into " + wszPackagePath + PAK_FILE_EXT);
+	}
+
+	void Cmd_DemoRecord(void)
+	{
+		std::wstring wszName = pConfigMgr->ExpressionItemValue(1);
+		if (!wszName.length()) {
+			pConsole->AddLine(L"Usage: demo_record <name>");
+			return;
+		}
+
+		if (pGame->StartDemoRecording(wszName)) {
+			pConsole->AddLine(L"Recording demo " + wszName);
+		} else {
+			pConsole->AddLine(L"Failed to start demo recording", Console::ConColor(250, 0, 0));
+		}
+	}
+
+	void Cmd_DemoStop(void)
+	{
+		if (pGame->StopDemoRecording()) {
+			pConsole->AddLine(L"Demo recording stopped");
+		} else {
+			pConsole->AddLine(L"Failed to write demo", Console::ConColor(250, 0, 0));
+		}
+	}
+
+	void Cmd_TimeDemo(void)
+	{
+		std::wstring wszName = pConfigMgr->ExpressionItemValue(1);
+		if (!wszName.length()) {
+			pConsole->AddLine(L"Usage: timedemo <name>");
+			return;
+		}
+
+		if (pGame->StartTimeDemo(wszName)) {
+			pConsole->AddLine(L"Playing timedemo " + wszName);
+		}
+	}
+
+	void Cmd_SimHeadless(void)
+	{
+		std::wstring wszMap = pConfigMgr->ExpressionItemValue(1);
+		if (!wszMap.length()) {
+			pConsole->AddLine(L"Usage: sim_headless <map> [worlds] [ticks]");
+			return;
+		}
+
+		int iWorlds = _wtoi(pConfigMgr->ExpressionItemValue(2).c_str());
+		if (iWorlds <= 0) {
+			iWorlds = (std::thread::hardware_concurrency() > 0) ? (int)std::thread::hardware_concurrency() : 1;
+		}
+
+		Entity::world_settings_s sSettings;
+		sSettings.bDeterministic = true;
+		sSettings.iTickRate = (pSimTickRate->iValue > 0) ? pSimTickRate->iValue : 60;
+		sSettings.bHashLog = false;
+		sSettings.bRewind = false;
+		sSettings.iRewindInterval = pRewindInterval->iValue;
+		sSettings.iRewindSeconds = pRewindSeconds->iValue;
+
+		long long llTicks = _wtoi64(pConfigMgr->ExpressionItemValue(3).c_str());
+		if (llTicks <= 0) {
+			llTicks = (long long)sSettings.iTickRate * 60;
+		}
+
+		//The map is only compiled here, its commands are handled by each headless world on its own
+		std::vector<ConfigMgr::CScriptParser::TExpression> vExpressions;
+		if (!pConfigMgr->Compile(pGame->GetPackagePath() + L"maps\" + wszMap, vExpressions)) {
+			pConsole->AddLine(L"Failed to compile map script: " + wszMap, Console::ConColor(250, 0, 0));
+			return;
+		}
+
+		Entity::CWorldRunner oRunner;
+
+		for (int i = 0; i < iWorlds; i++) {
+			if (!oRunner.AddWorld(&AS_MessageCallback, sSettings, (unsigned int)(pSimSeed->iValue + i), pGame->m_sPackage.wszPakPath, vExpressions)) {
+				pConsole->AddLine(L"Failed to create headless world " + std::to_wstring(i), Console::ConColor(250, 0, 0));
+				break;
+			}
+		}
+
+		std::chrono::steady_clock::time_point oStart = std::chrono::steady_clock::now();
+
+		oRunner.Run((unsigned long long)llTicks);
+
+		double dTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - oStart).count();
+
+		for (size_t i = 0; i < oRunner.GetWorldCount(); i++) {
+			Entity::CHeadlessWorld* pWorld = oRunner.GetWorld(i);
+
+			wchar_t wszResult[256];
+			swprintf_s(wszResult, L"World %u: %llu ticks, %u entities, state hash: %08X, player removed: %d", (unsigned int)i, pWorld->GetTicks(), (unsigned int)pWorld->World().Entities().GetEntityCount(), pWorld->World().GetStateHash(), (int)pWorld->IsPlayerRemoved());
+			pConsole->AddLine(wszResult);
+
+			const std::vector<std::wstring>& vLog = pWorld->GetLog();
+			for (size_t j = 0; j < vLog.size(); j++) {
+				pConsole->AddLine(L"  " + vLog[j]);
+			}
+
+			if (pWorld->GetDroppedLines()) {
+				pConsole->AddLine(L"  (" + std::to_wstring(pWorld->GetDroppedLines()) + L" more lines)");
+			}
+		}
+
+		wchar_t wszTotal[256];
+		swprintf_s(wszTotal, L"%u headless worlds simulated in %.3f ms", (unsigned int)oRunner.GetWorldCount(), dTime);
+		pConsole->AddLine(wszTotal);
+	}
+
 	void Cmd_Restart(void)
 	{
 		pGame->m_bInAppRestart = true;
@@ -578,15 +1092,12 @@ namespace Game {
 		int dir = _wtoi(pConfigMgr->ExpressionItemValue(8).c_str());
 		bool wall = pConfigMgr->ExpressionItemValue(9) == L"true";
 
-		std::wstring wszFullFilePath = pGame->m_sPackage.wszPakPath + L"\\gfx\\" + wszFile;
-		if (!Utils::FileExists(wszFullFilePath)) {
-			wszFullFilePath = wszBasePath + L"packages\\.common\\gfx\\" + wszFile;
-		}
+		std::wstring wszFullFilePath = pGame->m_oMapCache.ResolveGfxFile(oFileSystem, wszFile);
 		
 		Entity::CSolidSprite oSprite;
 		oSprite.Initialize(x, y, w, h, wszFullFilePath, repeat, dir, rot, wall);
 
-		pGame->m_vSolidSprites.push_back(oSprite);
+		pGame->m_oWorld.AddSolidSprite(oSprite);
 	}
 
 	void Cmd_EntRequire(void)
@@ -15,6 +15,7 @@
 
 #include "renderer.h"
 #include "sound.h"
+#include "dsoutput.h"
 #include "window.h"
 #include "vars.h"
 #include "entity.h"
@@ -22,9 +23,17 @@
 #include "input.h"
 #include <steam_api.h>
 #include "workshop.h"
+#include "demo.h"
+#include "prefetch.h"
+#include "mapcache.h"
+#include "vfs.h"
+#include "jobs.h"
+#include "worldrunner.h"
 
 /* Game specific environment */
 namespace Game {
+	#define GAME_LOAD_PROGRESS_INTERVAL 15
+
 	extern class CGame* pGame;
 
 	//Window event handler component
@@ -59,11 +68,23 @@ namespace Game {
 	void Cmd_Echo(void);
 	void Cmd_Exec(void);
 	void Cmd_Restart(void);
+	void Cmd_SimState(void);
+	void Cmd_Rewind(void);
+	void Cmd_SndStats(void);
+	void Cmd_RewindStats(void);
+	void Cmd_PrefetchStats(void);
+	void Cmd_MapCacheStats(void);
+	void Cmd_CfgBench(void);
+	void Cmd_PakBuild(void);
+	void Cmd_DemoRecord(void);
+	void Cmd_DemoStop(void);
+	void Cmd_TimeDemo(void);
+	void Cmd_SimHeadless(void);
 
 	void OnHandleWorkshopItem(const std::wstring& wszItem);
 	void HandlePackageUpload(const std::wstring& wszArgs);
 
-	class CGame : public Input::CDxInput::IInputEvents {
+	class CGame : public Input::CDxInput::IInputEvents, public Entity::IWorldHost {
 	private:
 		struct package_s {
 			std::wstring wszPakName;
@@ -98,9 +119,9 @@ namespace Game {
 		package_s m_sPackage;
 		map_s m_sMap;
 		player_s m_sPlayerSpawn;
-		std::vector<Entity::CSolidSprite> m_vSolidSprites;
+		Entity::CWorld m_oWorld;
 		std::vector<entityscript_s> m_vEntityScripts;
-		Entity::CGoalEntity* m_pGoalEntity;
+		ConfigMgr::CNameIndex m_oEntityScriptIndex; //Ident hash index of m_vEntityScripts
 		bool m_bGamePause;
 		bool m_bShowIntermission;
 		Menu::CIntermissionMenu m_oIntermissionMenu;
@@ -124,6 +145,23 @@ namespace Game {
 		LONGLONG m_ilCurCount;
 		int m_iFrameRate;
 		int m_iFrames;
+		LONGLONG m_lSimLastCount;
+		LONGLONG m_lSimAccumulator;
+		Demo::CDemoRecorder m_oDemoRecorder;
+		Demo::CDemoPlayer m_oDemoPlayer;
+		Prefetch::CAssetPrefetcher m_oPrefetcher;
+		MapCache::CMapCache m_oMapCache;
+		Jobs::CJobSystem m_oJobs;
+		std::wstring m_wszResidentPackage;
+		Entity::CAsyncSnapshotWriter m_oSaveWriter;
+		bool m_bSaveRequested;
+		bool m_bSaveRequestAuto;
+		bool m_bSaveWriteAuto;
+		std::wstring m_wszSaveWriteFile;
+		DWORD64 m_dwLastAutoSave;
+		bool m_bDemoPrevDeterministic;
+		int m_iDemoPrevSeed;
+		int m_iDemoPrevTickRate;
 		size_t m_uiSkipFrame;
 		DxSound::HDXSOUND m_hMenuTheme;
 		bool m_bAllowUpdateFramerate;
@@ -144,6 +182,7 @@ namespace Game {
 		friend void Cmd_Echo(void);
 		friend void Cmd_Exec(void);
 		friend void Cmd_Restart(void);
+		friend void Cmd_SimHeadless(void);
 
 		bool LoadPackage(const std::wstring& wszPackage, const std::wstring& wszFromPath = L"", const std::wstring& wszFromMap = L"")
 		{
@@ -154,17 +193,39 @@ namespace Game {
 			this->m_sPackage.wszPakName = wszPackage;
 			this->m_sPackage.wszPakPath = wszPackagePath;
 
+			//Resident scripts and sprites only carry over while the same package is played. The archive of the previous
+			//package is not needed anymore then
+			if (this->m_wszResidentPackage != wszPackagePath) {
+				if (this->m_wszResidentPackage.length()) {
+					this->UnmountArchive(this->m_wszResidentPackage);
+				}
+
+				this->FlushResidency();
+				this->m_wszResidentPackage = wszPackagePath;
+			}
+
 			oPackageLocaleMgr.SetLanguagePath(wszPackagePath + L"\\lang");
 			oPackageLocaleMgr.SetLocale(pAppLang->szValue);
 			
-			//Check if package folder exists
-			if (!Utils::DirExists(wszPackagePath)) {
+			//Mount packed archives over their folders if present. They stay mapped until another package is loaded
+			oArchiveSet.Mount(wszPackagePath + PAK_FILE_EXT, wszPackagePath);
+			oArchiveSet.Mount(wszBasePath + L"packages\\.common" + PAK_FILE_EXT, wszBasePath + L"packages\\.common");
+
+			//Check if package folder or archive exists
+			if ((!Utils::DirExists(wszPackagePath)) && (!oArchiveSet.FindArchive(wszPackagePath))) {
 				pConsole->AddLine(L"Package not found: " + wszPackage, Console::ConColor(255, 0, 0));
 				return false;
 			}
 			
+			//Index package files once. Package files overlay the common files
+			oFileSystem.Clear();
+			oFileSystem.Mount(wszPackagePath);
+			oFileSystem.Mount(wszBasePath + L"packages\\.common");
+
+			pConsole->AddLine(L"Indexed " + std::to_wstring(oFileSystem.GetFileCount()) + L" package files in " + std::to_wstring((int)oFileSystem.GetIndexTime()) + L" ms");
+
 			//Check if package index config exists
-			if (!Utils::FileExists(wszPackagePath + L"\\" + wszPackage + L".cfg")) {
+			if (!oFileSystem.Exists(wszPackage + L".cfg")) {
 				pConsole->AddLine(L"Package configuration script not found", Console::ConColor(255, 0, 0));
 				return false;
 			}
@@ -184,19 +245,20 @@ namespace Game {
 
 			//Execute package index map file
 			pConsole->AddLine(L"Executing: " + wszPackagePath + L"\\maps\\" + this->m_sPackage.wszMapIndex, Console::ConColor(255, 255, 255));
-			if (!pConfigMgr->Execute(wszPackagePath + L"\\maps\\" + this->m_sPackage.wszMapIndex)) {
+			if (!this->ExecuteMapScript(wszPackagePath + L"\\maps\\" + this->m_sPackage.wszMapIndex)) {
+				this->m_oMapCache.AbortLoad();
 				pConsole->AddLine(L"Failed to execute package index map script", Console::ConColor(255, 0, 0));
 				return false;
 			}
 
+			this->m_oPrefetcher.StartRecording();
+
 			this->m_sMap.wszFileName = this->m_sPackage.wszMapIndex;
 
 			//Set map background
 
-			std::wstring wszBackgroundFile = wszPackagePath + L"\\gfx\\" + this->m_sMap.wszBackground;
-			if (!Utils::FileExists(wszBackgroundFile)) {
-				wszBackgroundFile = wszBasePath + L"packages\\.common\\gfx\\" + this->m_sMap.wszBackground;
-			}
+			std::wstring wszBackgroundFile = this->m_oMapCache.ResolveGfxFile(oFileSystem, this->m_sMap.wszBackground);
+			this->m_oMapCache.EndLoad();
 
 			this->m_sMap.wszBackgroundFullPath = wszBackgroundFile;
 
@@ -211,13 +273,10 @@ namespace Game {
 		{
 			//Spawn entity into world
 
-			std::wstring wszFullScriptPath = this->m_sPackage.wszPakPath + L"\\entities\\" + wszName + L".as";
-			if (!Utils::FileExists(wszFullScriptPath)) {
-				wszFullScriptPath = wszBasePath + L"packages\\.common\\entities\\" + wszName + L".as";
-			}
+			std::wstring wszFullScriptPath;
 
-			//Check if entity script exists
-			if (!Utils::FileExists(wszFullScriptPath)) {
+			//Check if entity script exists in package or common folder
+			if (!oFileSystem.Resolve(L"entities\\" + wszName + L".as", wszFullScriptPath)) {
 				pConsole->AddLine(L"Entity script does not exist", Console::ConColor(255, 0, 0));
 				return false;
 			}
@@ -233,11 +292,7 @@ namespace Game {
 				}
 
 				//Store data
-				entityscript_s sEntScript;
-				sEntScript.hScript = hScript;
-				sEntScript.wszIdent = wszName;
-				this->m_vEntityScripts.push_back(sEntScript);
-				uiScriptListId = this->m_vEntityScripts.size() - 1;
+				uiScriptListId = this->AddEntityScript(hScript, wszName);
 			} else {
 				hScript = this->m_vEntityScripts[uiScriptListId].hScript;
 			}
@@ -264,6 +319,7 @@ namespace Game {
 				pConsole->AddLine(L"Failed to call CreateEntity() in script", Console::ConColor(255, 0, 0));
 				pScriptingInt->UnloadScript(hScript);
 				this->m_vEntityScripts.erase(this->m_vEntityScripts.begin() + uiScriptListId);
+				this->m_oEntityScriptIndex.Remove(uiScriptListId);
 				return false;
 			}
 
@@ -274,13 +330,10 @@ namespace Game {
 		{
 			//Load entity script
 			
-			std::wstring wszFullFilePath = this->m_sPackage.wszPakPath + L"\\entities\\" + wszName + L".as";
-			if (!Utils::FileExists(wszFullFilePath)) {
-				wszFullFilePath = wszBasePath + L"packages\\.common\\entities\\" + wszName + L".as";
-			}
+			std::wstring wszFullFilePath;
 
-			//Check if entity script exists
-			if (!Utils::FileExists(wszFullFilePath)) {
+			//Check if entity script exists in package or common folder
+			if (!oFileSystem.Resolve(L"entities\\" + wszName + L".as", wszFullFilePath)) {
 				pConsole->AddLine(L"Entity script does not exist", Console::ConColor(255, 0, 0));
 				return false;
 			}
@@ -296,10 +349,7 @@ namespace Game {
 				}
 
 				//Store data
-				entityscript_s sEntScript;
-				sEntScript.hScript = hScript;
-				sEntScript.wszIdent = wszName;
-				this->m_vEntityScripts.push_back(sEntScript);
+				this->AddEntityScript(hScript, wszName);
 			}
 
 			return true;
@@ -309,58 +359,132 @@ namespace Game {
 		{
 			//Spawn goal entity
 
-			//Free previous goal entity if was spawned
-			if (this->m_pGoalEntity) {
-				delete this->m_pGoalEntity;
-				this->m_pGoalEntity = nullptr;
-			}
+			this->m_oWorld.SpawnGoal(x, y, wszGoal);
+		}
+
+		size_t AddEntityScript(const Scripting::HSISCRIPT hScript, const std::wstring& wszName)
+		{
+			//Add loaded entity script to list and index
+
+			entityscript_s sEntScript;
+			sEntScript.hScript = hScript;
+			sEntScript.wszIdent = wszName;
+			this->m_vEntityScripts.push_back(sEntScript);
+
+			this->m_oEntityScriptIndex.Insert(ConfigMgr::HashName(wszName), this->m_vEntityScripts.size() - 1);
 
-			this->m_pGoalEntity = new Entity::CGoalEntity();
-			this->m_pGoalEntity->SetPosition(x, y);
-			this->m_pGoalEntity->SetGoal(wszGoal);
+			return this->m_vEntityScripts.size() - 1;
 		}
 
 		size_t FindScript(const std::wstring& wszName)
 		{
-			//Find script by name if loaded
+			//Find list ID of script by name if loaded
 
-			for (size_t i = 0; i < this->m_vEntityScripts.size(); i++) {
-				if (this->m_vEntityScripts[i].wszIdent == wszName) {
-					return i;
-				}
-			}
-
-			return std::string::npos;
+			return this->m_oEntityScriptIndex.Find(ConfigMgr::HashName(wszName), [&](size_t uiEntry) { return this->m_vEntityScripts[uiEntry].wszIdent == wszName; });
 		}
 
 		// Input events for DirectInput
 
 		virtual void OnKeyDown(int vKey)
 		{
+			//Live input is ignored during timedemo playback
+			if (this->m_oDemoPlayer.IsPlaying())
+				return;
+
 			oDxWindowEvents.OnKeyEvent(vKey, true, false, false, false);
 		}
 
 		virtual void OnKeyUp(int vKey)
 		{
+			if (this->m_oDemoPlayer.IsPlaying())
+				return;
+
 			oDxWindowEvents.OnKeyEvent(vKey, false, false, false, false);
 		}
 
 		virtual void OnMouseMove(int x, int y)
 		{
+			if (this->m_oDemoPlayer.IsPlaying())
+				return;
+
 			oDxWindowEvents.OnMouseEvent(x, y, 0, false, false, false, false);
 		}
 
 		virtual void OnMouseKeyDown(int vKey)
 		{
+			if (this->m_oDemoPlayer.IsPlaying())
+				return;
+
 			oDxWindowEvents.OnMouseEvent(0, 0, vKey, true, false, false, false);
 		}
 
 		virtual void OnMouseKeyUp(int vKey)
 		{
+			if (this->m_oDemoPlayer.IsPlaying())
+				return;
+
 			oDxWindowEvents.OnMouseEvent(0, 0, vKey, false, false, false, false);
 		}
+
+		void UpdateWorldSettings(void)
+		{
+			//Copy simulation cvars into the settings of the local world
+
+			Entity::world_settings_s& rSettings = this->m_oWorld.Settings();
+			rSettings.bDeterministic = pSimDeterministic->bValue;
+			rSettings.iTickRate = pSimTickRate->iValue;
+			rSettings.bHashLog = pSimHashLog->bValue;
+			rSettings.bRewind = pRewindEnable->bValue;
+			rSettings.iRewindInterval = pRewindInterval->iValue;
+			rSettings.iRewindSeconds = pRewindSeconds->iValue;
+		}
+
+		void RestoreSimulationSettings(void)
+		{
+			//Restore simulation cvars changed for demo recording or playback
+
+			pSimDeterministic->bValue = this->m_bDemoPrevDeterministic;
+			pSimSeed->iValue = this->m_iDemoPrevSeed;
+			pSimTickRate->iValue = this->m_iDemoPrevTickRate;
+		}
+
+		void DispatchDemoEvents(void)
+		{
+			//Inject recorded input events which are due at the current tick
+
+			Demo::demo_event_s sEvent;
+
+			while (this->m_oDemoPlayer.NextEvent(this->m_oWorld.GetTick(), sEvent)) {
+				if (sEvent.bMouse) {
+					this->OnMouseEvent(sEvent.x, sEvent.y, sEvent.iKey, sEvent.bDown, false, false, false);
+				} else {
+					this->OnKeyEvent(sEvent.iKey, sEvent.bDown, false, false, false);
+				}
+			}
+
+			//Finish if the simulation cannot advance anymore
+			if (((!this->m_bGameStarted) || (this->m_bGamePause)) && (!this->m_oDemoPlayer.HasPendingEvents())) {
+				this->m_oDemoPlayer.Finish();
+				this->RestoreSimulationSettings();
+			}
+		}
+
+		void ProcessTimeDemo(void)
+		{
+			//Process one timedemo tick as fast as possible
+
+			if (this->m_oDemoPlayer.IsFinished(this->m_oWorld.GetTick())) {
+				this->m_oDemoPlayer.Finish();
+				this->RestoreSimulationSettings();
+				return;
+			}
+
+			this->m_oWorld.Process();
+
+			this->m_oDemoPlayer.AddFrameSample(this->m_oWorld.Entities().GetEntityCount());
+		}
 	public:
-		CGame() : m_bInit(false), m_bGameStarted(false), m_bGamePause(false), m_bShowIntermission(false), pSteamDownloader(nullptr), m_bInGameLoadingProgress(false), m_bGameOver(false), m_bLoadSavedGame(false), m_pHud(nullptr), m_bInAppRestart(false), m_iFrames(100), m_iFrameRate(100), m_bAllowUpdateFramerate(false) { pGame = this; }
+		CGame() : m_bInit(false), m_bGameStarted(false), m_bGamePause(false), m_bShowIntermission(false), pSteamDownloader(nullptr), m_bInGameLoadingProgress(false), m_bGameOver(false), m_bLoadSavedGame(false), m_pHud(nullptr), m_bInAppRestart(false), m_iFrames(100), m_iFrameRate(100), m_lSimLastCount(0), m_lSimAccumulator(0), m_bSaveRequested(false), m_bSaveRequestAuto(false), m_bSaveWriteAuto(false), m_dwLastAutoSave(0), m_bDemoPrevDeterministic(false), m_iDemoPrevSeed(1), m_iDemoPrevTickRate(60), m_bAllowUpdateFramerate(false) { pGame = this; }
 		~CGame() { pGame = nullptr; }
 
 		bool Initialize(const std::wstring& wszPackage = L"", const std::wstring& wszMap = L"")
@@ -371,6 +495,9 @@ namespace Game {
 				return true;
 			}
 
+			//Bind local world to main thread
+			Entity::SetActiveWorld(&this->m_oWorld);
+
 			//Get base game path
 
 			wchar_t wszAppPath[2080];
@@ -406,13 +533,41 @@ namespace Game {
 			pGfxResolutionHeight = pConfigMgr->CCVar::Add(L"gfx_resolution_height", ConfigMgr::CCVar::CVAR_TYPE_INT, L"768");
 			pGfxFullscreen = pConfigMgr->CCVar::Add(L"gfx_fullscreen", ConfigMgr::CCVar::CVAR_TYPE_BOOL, L"1");
 			pSndVolume = pConfigMgr->CCVar::Add(L"snd_volume", ConfigMgr::CCVar::CVAR_TYPE_INT, L"10");
+			pSndMaxVoices = pConfigMgr->CCVar::Add(L"snd_maxvoices", ConfigMgr::CCVar::CVAR_TYPE_INT, std::to_wstring(SND_DEFAULT_MAX_VOICES));
+			pSndDevice = pConfigMgr->CCVar::Add(L"snd_device", ConfigMgr::CCVar::CVAR_TYPE_STRING, L"dsound");
+			pSndFalloffDist = pConfigMgr->CCVar::Add(L"snd_falloffdist", ConfigMgr::CCVar::CVAR_TYPE_INT, L"1200");
 			pSndPlayMusic = pConfigMgr->CCVar::Add(L"snd_playmusic", ConfigMgr::CCVar::CVAR_TYPE_BOOL, L"1");
+			pSimDeterministic = pConfigMgr->CCVar::Add(L"sim_deterministic", ConfigMgr::CCVar::CVAR_TYPE_BOOL, L"0");
+			pSimTickRate = pConfigMgr->CCVar::Add(L"sim_tickrate", ConfigMgr::CCVar::CVAR_TYPE_INT, L"60");
+			pSimSeed = pConfigMgr->CCVar::Add(L"sim_seed", ConfigMgr::CCVar::CVAR_TYPE_INT, L"1");
+			pSimHashLog = pConfigMgr->CCVar::Add(L"sim_hashlog", ConfigMgr::CCVar::CVAR_TYPE_BOOL, L"0");
+			pGameAutoSave = pConfigMgr->CCVar::Add(L"game_autosave", ConfigMgr::CCVar::CVAR_TYPE_INT, L"0");
+			pGamePrefetch = pConfigMgr->CCVar::Add(L"game_prefetch", ConfigMgr::CCVar::CVAR_TYPE_BOOL, L"1");
+			pGameMapCache = pConfigMgr->CCVar::Add(L"game_mapcache", ConfigMgr::CCVar::CVAR_TYPE_BOOL, L"1");
+			pGameLoadWorkers = pConfigMgr->CCVar::Add(L"game_loadworkers", ConfigMgr::CCVar::CVAR_TYPE_INT, L"0");
+			pGameResidentBudget = pConfigMgr->CCVar::Add(L"game_residentbudget", ConfigMgr::CCVar::CVAR_TYPE_INT, L"256");
+			pRewindEnable = pConfigMgr->CCVar::Add(L"rewind_enable", ConfigMgr::CCVar::CVAR_TYPE_BOOL, L"0");
+			pRewindSeconds = pConfigMgr->CCVar::Add(L"rewind_seconds", ConfigMgr::CCVar::CVAR_TYPE_INT, L"10");
+			pRewindInterval = pConfigMgr->CCVar::Add(L"rewind_interval", ConfigMgr::CCVar::CVAR_TYPE_INT, L"10");
+			pConLogFile = pConfigMgr->CCVar::Add(L"con_logfile", ConfigMgr::CCVar::CVAR_TYPE_STRING, L"");
 			
 			//Add commands
 			pConfigMgr->CCommand::Add(L"exec", L"Execute a script file", &Cmd_Exec);
 			pConfigMgr->CCommand::Add(L"bind", L"Bind command to key", &Cmd_Bind);
 			pConfigMgr->CCommand::Add(L"echo", L"Print text to console", &Cmd_Echo);
 			pConfigMgr->CCommand::Add(L"restart", L"Restart application", &Cmd_Restart);
+			pConfigMgr->CCommand::Add(L"sim_state", L"Print simulation tick and state hash", &Cmd_SimState);
+			pConfigMgr->CCommand::Add(L"rewind", L"Rewind world to a buffered tick", &Cmd_Rewind);
+			pConfigMgr->CCommand::Add(L"snd_stats", L"Print sound voice statistics", &Cmd_SndStats);
+			pConfigMgr->CCommand::Add(L"rewind_stats", L"Print rewind buffer statistics", &Cmd_RewindStats);
+			pConfigMgr->CCommand::Add(L"prefetch_stats", L"Print asset prefetch statistics of the current map", &Cmd_PrefetchStats);
+			pConfigMgr->CCommand::Add(L"mapcache_stats", L"Print compiled map cache statistics of the current map", &Cmd_MapCacheStats);
+			pConfigMgr->CCommand::Add(L"cfg_bench", L"Measure config parsing speed of the map files of a package", &Cmd_CfgBench);
+			pConfigMgr->CCommand::Add(L"pak_build", L"Pack the files of a package folder into a package archive", &Cmd_PakBuild);
+			pConfigMgr->CCommand::Add(L"demo_record", L"Restart current map and record input to a demo file", &Cmd_DemoRecord);
+			pConfigMgr->CCommand::Add(L"demo_stop", L"Stop demo recording", &Cmd_DemoStop);
+			pConfigMgr->CCommand::Add(L"timedemo", L"Play back a demo as fast as possible and report frame times", &Cmd_TimeDemo);
+			pConfigMgr->CCommand::Add(L"sim_headless", L"Simulate a map in several headless worlds on threads and report their state", &Cmd_SimHeadless);
 			pConfigMgr->CCommand::Add(L"package_name", L"Package name", &Cmd_PackageName);
 			pConfigMgr->CCommand::Add(L"package_version", L"Package version", &Cmd_PackageVersion);
 			pConfigMgr->CCommand::Add(L"package_author", L"Package author", &Cmd_PackageAuthor);
@@ -492,8 +647,17 @@ namespace Game {
 				return false;
 			}
 
-			//Initialize sound
-			if (!pSound->Initialize(pWindow->GetHandle())) {
+			//Initialize sound. The null and wave file output devices do not need an audio device
+			bool bSoundResult;
+			if (std::wstring(pSndDevice->szValue) == L"null") {
+				bSoundResult = pSound->Initialize(new DxSound::CNullMixerOutput());
+			} else if (std::wstring(pSndDevice->szValue) == L"wav") {
+				bSoundResult = pSound->Initialize(new DxSound::CWaveFileMixerOutput(Utils::ConvertToAnsiString(wszBasePath + L"mixer_output.wav")));
+			} else {
+				bSoundResult = pSound->Initialize(new DxSound::CDirectSoundMixerOutput(pWindow->GetHandle()));
+			}
+
+			if (!bSoundResult) {
 				this->Release();
 				return false;
 			}
@@ -517,6 +681,11 @@ namespace Game {
 				return false;
 			}
 
+			//Mirror console to log file if configured
+			if (wcslen(pConLogFile->szValue)) {
+				pConsole->StartLog(wszBasePath + pConLogFile->szValue);
+			}
+
 			//Instantiate and initialize AngelScript scripting interface
 			pScriptingInt = new Scripting::CScriptInt("", &AS_MessageCallback);
 			if (!pScriptingInt) {
@@ -530,6 +699,9 @@ namespace Game {
 				return false;
 			}
 
+			//Let local world run on the global scripting interface and take its services from the game
+			this->m_oWorld.Bind(pScriptingInt, this);
+
 			//Initialize engine localization
 			oEngineLocaleMgr.SetLanguagePath(wszBasePath + L"lang");
 			oEngineLocaleMgr.SetLocale(pAppLang->szValue);
@@ -606,7 +778,7 @@ namespace Game {
 			this->m_hMenuTheme = pSound->QuerySound(wszBasePath + L"media\\sound\\menu.wav");
 
 			if (pSndPlayMusic->bValue) {
-				pSound->Play(this->m_hMenuTheme, pSndVolume->iValue, DSBPLAY_LOOPING);
+				pSound->Play(this->m_hMenuTheme, pSndVolume->iValue, SND_PLAY_LOOPING);
 			}
 
 			//Create restart script
@@ -722,9 +894,15 @@ namespace Game {
 			this->m_oCursor.SetActiveStatus(true);
 		}
 
+		void DrawLoadingProgress(const std::wstring& wszStage, size_t uiDone, size_t uiTotal);
+		bool ExecuteMapScript(const std::wstring& wszMapFile);
 		bool LoadMap(const std::wstring& wszMap);
 
 		void StopGame(void);
+		void UnloadEntityScripts(void);
+		bool ReloadEntityScript(size_t uiScriptListId);
+		void FlushResidency(void);
+		bool UnmountArchive(const std::wstring& wszPackagePath);
 
 		void LoadSavedGameState(const std::wstring& wszFile)
 		{
@@ -764,37 +942,25 @@ namespace Game {
 		{
 			//Get script handle by ident
 
-			for (size_t i = 0; i < this->m_vEntityScripts.size(); i++) {
-				if (this->m_vEntityScripts[i].wszIdent == wszIdent) {
-					return this->m_vEntityScripts[i].hScript;
-				}
-			}
+			size_t uiScriptListId = this->FindScript(wszIdent);
+			if (uiScriptListId == std::string::npos)
+				return SI_INVALID_ID;
 
-			return SI_INVALID_ID;
+			return this->m_vEntityScripts[uiScriptListId].hScript;
 		}
 
 		bool IsVectorFieldInsideWall(const Entity::Vector& vecPos, const Entity::Vector& vecSize)
 		{
 			//Check if vector is inside wall
 
-			for (size_t i = 0; i < this->m_vSolidSprites.size(); i++) {
-				if (!this->m_vSolidSprites[i].IsWall()) {
-					continue;
-				}
-
-				if (this->m_vSolidSprites[i].IsVectorFieldCollided(vecPos, vecSize)) {
-					return true;
-				}
-			}
-
-			return false;
+			return this->m_oWorld.IsVectorFieldInsideWall(vecPos, vecSize);
 		}
 
 		int GetLocalPlayerScore(void)
 		{
 			//Get local player score
 
-			const Entity::CScriptedEntsMgr::playerentity_s& playerEntity = Entity::oScriptedEntMgr.GetPlayerEntity();
+			const Entity::CScriptedEntsMgr::playerentity_s& playerEntity = this->m_oWorld.Entities().GetPlayerEntity();
 
 			int iScore;
 
@@ -807,6 +973,119 @@ namespace Game {
 		void OnKeyEvent(int vKey, bool bDown, bool bCtrlHeld, bool bShiftHeld, bool bAltHeld);
 		void OnMouseWheel(short wDistance, bool bForward);
 
+		void ProcessFixedTicks(void)
+		{
+			//Process world with a fixed time step in order to keep the simulation deterministic
+
+			const int C_MAX_TICKS_PER_FRAME = 5;
+
+			if (pSimTickRate->iValue <= 0)
+				return;
+
+			LONGLONG lCurCount;
+			QueryPerformanceCounter((LARGE_INTEGER*)&lCurCount);
+
+			this->m_lSimAccumulator += lCurCount - this->m_lSimLastCount;
+			this->m_lSimLastCount = lCurCount;
+
+			LONGLONG lTickLength = this->m_lFrequency / pSimTickRate->iValue;
+
+			//Catch up with elapsed time, but do not spiral when processing is slower than real-time
+			int iTicks = 0;
+			while ((this->m_lSimAccumulator >= lTickLength) && (iTicks < C_MAX_TICKS_PER_FRAME)) {
+				this->m_oWorld.Process();
+				this->m_lSimAccumulator -= lTickLength;
+				iTicks++;
+			}
+
+			if (iTicks >= C_MAX_TICKS_PER_FRAME) {
+				this->m_lSimAccumulator = 0;
+			}
+		}
+
+		bool StartDemoRecording(const std::wstring& wszName)
+		{
+			//Restart current map in deterministic mode and record input
+
+			if ((!this->m_bGameStarted) || (this->m_oDemoRecorder.IsRecording()) || (this->m_oDemoPlayer.IsPlaying()))
+				return false;
+
+			this->m_bDemoPrevDeterministic = pSimDeterministic->bValue;
+			this->m_iDemoPrevSeed = pSimSeed->iValue;
+			this->m_iDemoPrevTickRate = pSimTickRate->iValue;
+			pSimDeterministic->bValue = true;
+
+			if (!this->LoadMap(this->m_sMap.wszFileName)) {
+				this->RestoreSimulationSettings();
+				return false;
+			}
+
+			Demo::demo_header_s sHeader;
+			sHeader.wszPackage = this->m_sPackage.wszPakName;
+			sHeader.wszMap = this->m_sMap.wszFileName;
+			sHeader.uiSeed = (unsigned int)pSimSeed->iValue;
+			sHeader.iTickRate = pSimTickRate->iValue;
+			sHeader.ullEndTick = 0;
+
+			this->m_oDemoRecorder.Start(wszName, sHeader);
+
+			return true;
+		}
+
+		bool StopDemoRecording(void)
+		{
+			//Stop recording and write demo file
+
+			if (!this->m_oDemoRecorder.IsRecording())
+				return false;
+
+			bool bResult = this->m_oDemoRecorder.Stop(this->m_oWorld.GetTick());
+
+			this->RestoreSimulationSettings();
+
+			return bResult;
+		}
+
+		bool StartTimeDemo(const std::wstring& wszName)
+		{
+			//Load demo and play it back as benchmark
+
+			if ((this->m_oDemoRecorder.IsRecording()) || (this->m_oDemoPlayer.IsPlaying()))
+				return false;
+
+			if (!this->m_oDemoPlayer.Load(wszName)) {
+				pConsole->AddLine(L"timedemo: failed to load demo " + wszName, Console::ConColor(250, 0, 0));
+				return false;
+			}
+
+			//Demo must be played with the package it was recorded with
+			if ((!this->m_bGameStarted) || (this->m_sPackage.wszPakName != this->m_oDemoPlayer.GetHeader().wszPackage)) {
+				pConsole->AddLine(L"timedemo: package " + this->m_oDemoPlayer.GetHeader().wszPackage + L" must be running", Console::ConColor(250, 0, 0));
+				return false;
+			}
+
+			this->m_bDemoPrevDeterministic = pSimDeterministic->bValue;
+			this->m_iDemoPrevSeed = pSimSeed->iValue;
+			this->m_iDemoPrevTickRate = pSimTickRate->iValue;
+			pSimDeterministic->bValue = true;
+			pSimSeed->iValue = (int)this->m_oDemoPlayer.GetHeader().uiSeed;
+			pSimTickRate->iValue = this->m_oDemoPlayer.GetHeader().iTickRate;
+
+			if (!this->LoadMap(this->m_oDemoPlayer.GetHeader().wszMap)) {
+				this->RestoreSimulationSettings();
+				return false;
+			}
+
+			//Close menus so that the simulation runs
+			this->m_oMenu.SetOpenStatus(false);
+			this->m_oCursor.SetActiveStatus(false);
+			this->m_bGamePause = false;
+
+			this->m_oDemoPlayer.Start();
+
+			return true;
+		}
+
 		void ResumeGame(void)
 		{
 			//Resume game
@@ -819,20 +1098,87 @@ namespace Game {
 			this->m_bGamePause = false;
 		}
 
-		void SaveGame(void)
+		void SaveGame(bool bAutoSave = false)
 		{
+			//Request saving the game. The snapshot is captured at the next tick boundary
+
+			if (!this->m_bSaveRequested) {
+				this->m_bSaveRequestAuto = bAutoSave;
+			} else if (!bAutoSave) {
+				this->m_bSaveRequestAuto = false;
+			}
+
+			this->m_bSaveRequested = true;
+		}
+
+		void CaptureSaveGame(void)
+		{
+			//Capture requested snapshot and hand it over to the background writer
+
+			//Request autosave if interval has elapsed
+			if (pGameAutoSave->iValue > 0) {
+				DWORD64 dwCurTime = GetTickCount64();
+				if (dwCurTime >= this->m_dwLastAutoSave + (DWORD64)pGameAutoSave->iValue * 1000) {
+					this->m_dwLastAutoSave = dwCurTime;
+					this->SaveGame(true);
+				}
+			}
+
+			//Keep request pending while a previous save is still being written
+			if ((!this->m_bSaveRequested) || (this->m_oSaveWriter.IsBusy()))
+				return;
+
+			this->m_bSaveRequested = false;
+			this->m_bSaveWriteAuto = this->m_bSaveRequestAuto;
+
 			if (GetFileAttributes((wszBasePath + L"saves").c_str()) == INVALID_FILE_ATTRIBUTES) {
 				CreateDirectory((wszBasePath + L"saves").c_str(), nullptr);
 			}
 
-			size_t uiPlayerScript = this->FindScript(L"player");
-			bool bResult = false;
+			//Build file name from current date and time, autosaves replace each other
+			std::wstring wszFileName = L"autosave.sav";
 
-			pScriptingInt->CallScriptFunction(this->m_vEntityScripts[uiPlayerScript].hScript, true, "SaveGame", nullptr, &bResult, Scripting::FA_BYTE);
+			if (!this->m_bSaveWriteAuto) {
+				tm time;
+				time_t t = std::time(nullptr);
+				localtime_s(&time, &t);
 
-			if (bResult) {
-				this->m_oHudInfoMessages.AddMessage(oEngineLocaleMgr.QueryPhrase(L"app.savegame.success", L"Game saved!"), Entity::HudMessageColor::HM_GREEN);
-			} else {
+				std::wostringstream woss;
+				woss << std::put_time(&time, L"%d-%m-%Y_%H-%M-%S");
+
+				wszFileName = L"savegame_" + woss.str() + L".sav";
+			}
+
+			this->m_wszSaveWriteFile = wszFileName;
+
+			//Capture binary world snapshot
+			Entity::snapshot_info_s sInfo;
+			sInfo.szPackage = Utils::ConvertToAnsiString(this->m_sPackage.wszPakName);
+			sInfo.szFromPath = Utils::ConvertToAnsiString(this->m_sPackage.wszPakPath);
+			sInfo.szMap = Utils::ConvertToAnsiString(this->m_sMap.wszFileName);
+
+			Entity::CSnapshotBuffer oSnapshot;
+			oSnapshot.WriteHeader(sInfo);
+			this->m_oWorld.WriteSnapshot(oSnapshot);
+
+			this->m_oSaveWriter.Write(oSnapshot, wszBasePath + L"saves\\" + wszFileName);
+		}
+
+		void PollSaveGame(void)
+		{
+			//Report finished background save
+
+			Entity::CAsyncSnapshotWriter::writer_state_e eState = this->m_oSaveWriter.Poll();
+
+			if (eState == Entity::CAsyncSnapshotWriter::WS_SUCCEEDED) {
+				if (!this->m_bSaveWriteAuto) {
+					this->m_oMenu.AddToSaveGameList(this->m_wszSaveWriteFile);
+
+					this->m_oHudInfoMessages.AddMessage(oEngineLocaleMgr.QueryPhrase(L"app.savegame.success", L"Game saved!"), Entity::HudMessageColor::HM_GREEN);
+				} else {
+					this->m_oHudInfoMessages.AddMessage(oEngineLocaleMgr.QueryPhrase(L"app.savegame.autosaved", L"Game autosaved"), Entity::HudMessageColor::HM_GREEN);
+				}
+			} else if (eState == Entity::CAsyncSnapshotWriter::WS_FAILED) {
 				this->m_oHudInfoMessages.AddMessage(oEngineLocaleMgr.QueryPhrase(L"app.savegame.failure", L"Failed to save game"), Entity::HudMessageColor::HM_RED);
 			}
 		}
@@ -848,8 +1194,15 @@ namespace Game {
 			this->m_bGameStarted = false;
 			this->m_bInit = false;
 
+			//Finish pending save
+			this->m_oSaveWriter.Wait();
+
 			//Stop current game
 			this->StopGame();
+			this->FlushResidency();
+
+			//Stop loader threads
+			this->m_oJobs.Shutdown();
 
 			//Unlink from Steam
 			SteamAPI_Shutdown();
@@ -889,13 +1242,19 @@ namespace Game {
 		{
 			if (value) {
 				if (!this->m_bGameStarted) {
-					pSound->Play(this->m_hMenuTheme, pSndVolume->iValue, DSBPLAY_LOOPING);
+					pSound->Play(this->m_hMenuTheme, pSndVolume->iValue, SND_PLAY_LOOPING);
 				}
 			} else {
 				pSound->StopAll();
 			}
 		}
 
+		//Get asset prefetcher
+		Prefetch::CAssetPrefetcher& GetAssetPrefetcher(void) { return this->m_oPrefetcher; }
+		//Get compiled map cache
+		MapCache::CMapCache& GetMapCache(void) { return this->m_oMapCache; }
+		//Get virtual file system of the current package
+		Vfs::CFileSystem& GetFileSystem(void) { return oFileSystem; }
 		//Return package name
 		std::wstring GetPackageName(void) { return this->m_sPackage.wszPakName; }
 		//Return current map name
@@ -905,7 +1264,9 @@ namespace Game {
 		//Return key binding
 		int GetKeyBinding(const std::wstring& wszIdent) { return g_oInputMgr.GetKeyBindingCode(wszIdent); }
 		//Get goal entity
-		Entity::CGoalEntity* GetGoalEntity(void) { return this->m_pGoalEntity; }
+		Entity::CGoalEntity* GetGoalEntity(void) { return this->m_oWorld.GetGoalEntity(); }
+		//Get world of the local game
+		Entity::CWorld* GetWorld(void) { return &this->m_oWorld; }
 		//Get cursor
 		Menu::CCursor* GetCursor(void) { return &this->m_oCursor; }
 		//Get main menu
@@ -918,5 +1279,14 @@ namespace Game {
 		int GetCurrentFramerate(void) { return this->m_iFrameRate; }
 		//Get current full background file name
 		std::wstring GetFullBackgroundFileName(void) { return this->m_sMap.wszBackgroundFullPath; }
+
+		//World host interface
+		virtual Scripting::HSISCRIPT ResolveScript(const std::wstring& wszIdent) { return this->GetScriptHandleByIdent(wszIdent); }
+		virtual int GetFrameRate(void) { return this->m_iFrameRate; }
+		virtual bool IsPresenting(void) { return true; }
+		virtual DxRenderer::HD3DSPRITE LoadSprite(const std::wstring& wszFile, int iFrameCount, int iFrameWidth, int iFrameHeight, int iFramesPerLine, bool bForceCustomSize) { return this->m_oPrefetcher.LoadSprite(wszFile, iFrameCount, iFrameWidth, iFrameHeight, iFramesPerLine, bForceCustomSize); }
+		virtual bool FreeSprite(DxRenderer::HD3DSPRITE hSprite) { return this->m_oPrefetcher.ReleaseSprite(hSprite); }
+		virtual void OnPlayerRemoved(void) { this->ShowGameOver(); }
+		virtual void Log(const std::wstring& wszText) { pConsole->AddLine(wszText); }
 	};
 }
\ No newline at end of file
@@ -0,0 +1,158 @@
+#pragma once
+
+/*
+	Casual Game Engine (dnyCasualGameEngine) developed by Daniel Brendel
+
+	(C) 2021 - 2022 by Daniel Brendel
+
+	Contact: dbrendel1988<at>gmail<dot>com
+	GitHub: https://github.com/danielbrendel/
+
+	Released under the MIT license
+*/
+
+#include "shared.h"
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+/* Worker thread job environment */
+namespace Jobs {
+	#define JOBS_MAX_WORKERS 8
+
+	typedef std::function<void(void)> TJob;
+
+	/* Fixed pool of worker threads running submitted jobs in submission order. Jobs must not use the render or sound device */
+	class CJobSystem {
+	private:
+		std::vector<std::thread*> m_vWorkers;
+		std::vector<TJob> m_vQueue;
+		size_t m_uiQueueHead;
+		size_t m_uiSubmitted;
+		size_t m_uiCompleted;
+		bool m_bShutdown;
+		std::mutex m_oMutex;
+		std::condition_variable m_oJobSignal;
+		std::condition_variable m_oIdleSignal;
+
+		void Worker(void)
+		{
+			//Run queued jobs. Remaining jobs are still run on shutdown
+
+			std::unique_lock<std::mutex> oLock(this->m_oMutex);
+
+			while (true) {
+				this->m_oJobSignal.wait(oLock, [this]() { return (this->m_bShutdown) || (this->m_uiQueueHead < this->m_vQueue.size()); });
+
+				if (this->m_uiQueueHead >= this->m_vQueue.size())
+					return;
+
+				TJob oJob;
+				oJob.swap(this->m_vQueue[this->m_uiQueueHead++]);
+
+				if (this->m_uiQueueHead == this->m_vQueue.size()) {
+					this->m_vQueue.clear();
+					this->m_uiQueueHead = 0;
+				}
+
+				oLock.unlock();
+				oJob();
+				oLock.lock();
+
+				this->m_uiCompleted++;
+
+				if (this->m_uiCompleted == this->m_uiSubmitted) {
+					this->m_oIdleSignal.notify_all();
+				}
+			}
+		}
+	public:
+		CJobSystem() : m_uiQueueHead(0), m_uiSubmitted(0), m_uiCompleted(0), m_bShutdown(false) {}
+		~CJobSystem() { this->Shutdown(); }
+
+		static size_t GetDefaultWorkerCount(void)
+		{
+			//One worker per core besides the main thread
+
+			size_t uiCount = std::thread::hardware_concurrency();
+			uiCount = (uiCount > 1) ? uiCount - 1 : 1;
+
+			return (uiCount > JOBS_MAX_WORKERS) ? JOBS_MAX_WORKERS : uiCount;
+		}
+
+		void Startup(size_t uiWorkerCount)
+		{
+			//Start worker threads. A running pool is restarted if the count differs
+
+			if (uiWorkerCount > JOBS_MAX_WORKERS) {
+				uiWorkerCount = JOBS_MAX_WORKERS;
+			}
+
+			if (uiWorkerCount == this->m_vWorkers.size())
+				return;
+
+			this->Shutdown();
+
+			for (size_t i = 0; i < uiWorkerCount; i++) {
+				this->m_vWorkers.push_back(new std::thread(&CJobSystem::Worker, this));
+			}
+		}
+
+		void Shutdown(void)
+		{
+			//Finish queued jobs and stop worker threads
+
+			{
+				std::lock_guard<std::mutex> oLock(this->m_oMutex);
+				this->m_bShutdown = true;
+			}
+
+			this->m_oJobSignal.notify_all();
+
+			for (size_t i = 0; i < this->m_vWorkers.size(); i++) {
+				this->m_vWorkers[i]->join();
+				delete this->m_vWorkers[i];
+			}
+
+			this->m_vWorkers.clear();
+			this->m_bShutdown = false;
+		}
+
+		void Submit(const TJob& oJob)
+		{
+			//Queue job. Without workers the job is run on the calling thread
+
+			if (!this->m_vWorkers.size()) {
+				oJob();
+
+				std::lock_guard<std::mutex> oLock(this->m_oMutex);
+				this->m_uiSubmitted++;
+				this->m_uiCompleted++;
+
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> oLock(this->m_oMutex);
+				this->m_vQueue.push_back(oJob);
+				this->m_uiSubmitted++;
+			}
+
+			this->m_oJobSignal.notify_one();
+		}
+
+		bool Wait(DWORD dwTimeout)
+		{
+			//Wait until all submitted jobs are done or the timeout has elapsed
+
+			std::unique_lock<std::mutex> oLock(this->m_oMutex);
+
+			return this->m_oIdleSignal.wait_for(oLock, std::chrono::milliseconds(dwTimeout), [this]() { return this->m_uiCompleted == this->m_uiSubmitted; });
+		}
+
+		//Getters. Counters only grow, so progress of a batch is measured against the counters at its start
+		size_t GetWorkerCount(void) const { return this->m_vWorkers.size(); }
+		size_t GetSubmitted(void) { std::lock_guard<std::mutex> oLock(this->m_oMutex); return this->m_uiSubmitted; }
+		size_t GetCompleted(void) { std::lock_guard<std::mutex> oLock(this->m_oMutex); return this->m_uiCompleted; }
+	};
+}
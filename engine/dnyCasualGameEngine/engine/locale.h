@@ -12,199 +12,192 @@
 */
 
 #include "shared.h"
+#include "configmgr.h"
+
+#define LOC_INVALID_PHRASE_ID std::wstring::npos
 
 /* Localization environment */
 namespace Localization {
+	typedef size_t HPHRASE;
+
+	/* All language files of the active locale are loaded at once into one hashed phrase table. Phrase IDs stay valid
+	   for the whole runtime, also if the locale or language path changes */
 	class CLocalizationMgr {
 	private:
 		struct phrase_s {
-			std::wstring wszIdent;
+			std::wstring wszIdent; //<file>.<phrase> in lower case
 			std::wstring wszPhrase;
-		};
-
-		struct langfile_s {
-			std::wstring wszFile;
-			std::vector<phrase_s> vPhrases;
-		};
-
-		struct locale_s {
-			std::wstring wszLocale;
-			std::vector<langfile_s> vFiles;
+			bool bPresent; //Provided by the active locale
 		};
 
 		std::wstring m_wszLocale;
 		std::wstring m_wszLangPath;
-		std::vector<locale_s> m_vLocales;
+		std::vector<phrase_s> m_vPhrases;
+		ConfigMgr::CNameIndex m_oIndex; //Ident hash index of m_vPhrases
+		bool m_bLoaded;
 
-		size_t FindLocale(const std::wstring& wszLocale)
+		static std::wstring NormalizeIdent(const std::wstring& wszIdent)
 		{
-			//Find locale and return ID if found
+			//Lower case ident, so file and phrase names match regardless of their case
 
-			for (size_t i = 0; i < this->m_vLocales.size(); i++) {
-				if (this->m_vLocales[i].wszLocale == wszLocale) {
-					return i;
-				}
+			std::wstring wszResult = wszIdent;
+
+			for (size_t i = 0; i < wszResult.length(); i++) {
+				wszResult[i] = (wchar_t)towlower(wszResult[i]);
 			}
 
-			return std::string::npos;
+			return wszResult;
 		}
 
-		size_t FindLocaleEx(const std::wstring& wszLocale, const std::wstring& wszIdent)
+		HPHRASE FindPhrase(const std::wstring& wszIdent) const
 		{
-			//More specific locale finding
-
-			for (size_t i = 0; i < this->m_vLocales.size(); i++) {
-				if (this->m_vLocales[i].wszLocale == wszLocale) {
-					//Find position of delimiter char
-					size_t uiDelim = wszIdent.find(L".");
-					if (uiDelim == std::string::npos) {
-						return std::string::npos;
-					}
+			//Find phrase ID of ident
 
-					//Extract file ident
-					std::wstring wszFile = wszIdent.substr(0, uiDelim);
+			std::wstring wszKey = NormalizeIdent(wszIdent);
 
-					//Search for specified file
-					for (size_t j = 0; j < this->m_vLocales[i].vFiles.size(); j++) {
-						if (this->m_vLocales[i].vFiles[j].wszFile == wszFile) {
-							return i;
-						}
-					}
-				}
-			}
-
-			return std::string::npos;
+			return this->m_oIndex.Find(ConfigMgr::HashName(wszKey), [&](size_t uiEntry) { return this->m_vPhrases[uiEntry].wszIdent == wszKey; });
 		}
 
-		std::wstring FindLocalePhrase(const std::wstring& wszIdent, const std::wstring& wszDefault = L"")
+		HPHRASE AddPhrase(const std::wstring& wszIdent)
 		{
-			//Find locale phrase of current locale
+			//Get phrase ID of ident and register it if unknown yet
 
-			//Find locale entry in locale list
-			size_t uiLocaleId = this->FindLocale(this->m_wszLocale);
-			if (uiLocaleId == std::string::npos) {
-				return wszDefault;
-			}
+			HPHRASE hPhrase = this->FindPhrase(wszIdent);
+			if (hPhrase != LOC_INVALID_PHRASE_ID)
+				return hPhrase;
 
-			//Find position of delimiter char
-			size_t uiDelim = wszIdent.find(L".");
-			if (uiDelim == std::string::npos) {
-				return wszDefault;
-			}
+			phrase_s sPhrase;
+			sPhrase.wszIdent = NormalizeIdent(wszIdent);
+			sPhrase.bPresent = false;
+			this->m_vPhrases.push_back(sPhrase);
 
-			//Extract file and phrase ident
-			std::wstring wszFile = wszIdent.substr(0, uiDelim);
-			std::wstring wszPhraseIdent = wszIdent.substr(uiDelim + 1);
-			
-			//Loop trough phrases of locale file and search for ident
-			for (size_t i = 0; i < this->m_vLocales[uiLocaleId].vFiles.size(); i++) {
-				if (this->m_vLocales[uiLocaleId].vFiles[i].wszFile == wszFile) {
-					for (size_t j = 0; j < this->m_vLocales[uiLocaleId].vFiles[i].vPhrases.size(); j++) {
-						if (this->m_vLocales[uiLocaleId].vFiles[i].vPhrases[j].wszIdent == wszPhraseIdent) {
-							return this->m_vLocales[uiLocaleId].vFiles[i].vPhrases[j].wszPhrase;
-						}
-					}
-				}
-			}
+			this->m_oIndex.Insert(ConfigMgr::HashName(sPhrase.wszIdent), this->m_vPhrases.size() - 1);
 
-			return wszDefault;
+			return this->m_vPhrases.size() - 1;
 		}
 
-		bool ExtractIdentAndPhrase(const std::wstring& wszBuffer, phrase_s& rOut)
+		bool LoadLocaleFile(const std::wstring& wszFile)
 		{
-			//Extract ident and phrase from buffer
+			//Load phrases of a language file. Lines are formatted as <phrase>:<text>
 
-			size_t uiDelim = wszBuffer.find(L":");
-			if (uiDelim == std::string::npos) {
+			std::wifstream hFile;
+			hFile.open(this->m_wszLangPath + L"\\" + this->m_wszLocale + L"\\" + wszFile + L".lng", std::wifstream::in);
+			if (!hFile.is_open())
 				return false;
+
+			std::wstring wszLine;
+			while (std::getline(hFile, wszLine)) {
+				if ((!wszLine.length()) || (wszLine[0] == '#')) {
+					continue;
+				}
+
+				size_t uiDelim = wszLine.find(L":");
+				if (uiDelim == std::string::npos) {
+					continue;
+				}
+
+				phrase_s& rPhrase = this->m_vPhrases[this->AddPhrase(wszFile + L"." + wszLine.substr(0, uiDelim))];
+				rPhrase.wszPhrase = wszLine.substr(uiDelim + 1);
+				rPhrase.bPresent = true;
 			}
 
-			rOut.wszIdent = wszBuffer.substr(0, uiDelim);
-			rOut.wszPhrase = wszBuffer.substr(uiDelim + 1);
+			hFile.close();
 
 			return true;
 		}
 
-		bool AddLocaleFile(const std::wstring& wszIdent)
+		void LoadLocale(void)
 		{
-			//Add locale file
+			//Load all language files of the active locale. Phrases of a previous locale are dropped, their IDs are kept
 
-			//Get current locale ID
-			size_t uiLocaleId = this->FindLocale(this->m_wszLocale);
+			this->m_bLoaded = true;
 
-			//Find position of delimiter char
-			size_t uiDelim = wszIdent.find(L".");
-			if (uiDelim == std::string::npos) {
-				return false;
+			for (size_t i = 0; i < this->m_vPhrases.size(); i++) {
+				this->m_vPhrases[i].wszPhrase.clear();
+				this->m_vPhrases[i].bPresent = false;
 			}
 
-			//Extract file ident
-			std::wstring wszFile = wszIdent.substr(0, uiDelim);
+			if (!this->m_wszLangPath.length())
+				return;
 
-			//Open file for reading
-			std::wifstream hFile;
-			hFile.open(this->m_wszLangPath + L"\\" + this->m_wszLocale + L"\\" + wszFile + L".lng", std::wifstream::in);
-			if (hFile.is_open()) {
-				langfile_s sLangData;
-				sLangData.wszFile = wszFile;
+			WIN32_FIND_DATA sFindData;
 
-				while (!hFile.eof()) {
-					wchar_t wszLineBuffer[4096] = { 0 };
-					hFile.getline(wszLineBuffer, sizeof(wszLineBuffer), '\n');
+			HANDLE hFileSearch = FindFirstFile((this->m_wszLangPath + L"\\" + this->m_wszLocale + L"\\*.lng").c_str(), &sFindData);
+			if (hFileSearch != INVALID_HANDLE_VALUE) {
+				do {
+					std::wstring wszFile = sFindData.cFileName;
 
-					if ((wszLineBuffer[0] == '#') || (wcslen(wszLineBuffer) == 0)) {
-						continue;
+					//Short name matching may yield other extensions starting with .lng
+					if (((sFindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != FILE_ATTRIBUTE_DIRECTORY) && (wszFile.length() > 4) && (_wcsicmp(wszFile.c_str() + wszFile.length() - 4, L".lng") == 0)) {
+						this->LoadLocaleFile(wszFile.substr(0, wszFile.length() - 4));
 					}
+				} while (FindNextFile(hFileSearch, &sFindData));
 
-					phrase_s sPhrase;
-					this->ExtractIdentAndPhrase(wszLineBuffer, sPhrase);
-					sLangData.vPhrases.push_back(sPhrase);
-				}
-
-				if (uiLocaleId == std::string::npos) {
-					locale_s sLocale;
-					sLocale.wszLocale = this->m_wszLocale;
-					sLocale.vFiles.push_back(sLangData);
-					this->m_vLocales.push_back(sLocale);
-				} else {
-					this->m_vLocales[uiLocaleId].vFiles.push_back(sLangData);
-				}
-
-				hFile.close();
-
-				return true;
+				FindClose(hFileSearch);
 			}
-
-			return false;
 		}
 	public:
-		CLocalizationMgr() : m_wszLocale(L"en") {}
+		CLocalizationMgr() : m_wszLocale(L"en"), m_bLoaded(false) {}
 		~CLocalizationMgr() {}
 
 		std::wstring QueryPhrase(const std::wstring& wszIdent, const std::wstring& wszDefault = L"")
 		{
 			//Query phrase of locale
 
-			size_t uiLocaleId = this->FindLocaleEx(this->GetLocale(), wszIdent);
-			if (uiLocaleId == std::string::npos) {
-				this->AddLocaleFile(wszIdent);
-			} 
-			
-			return this->FindLocalePhrase(wszIdent, wszDefault);
+			if (!this->m_bLoaded) {
+				this->LoadLocale();
+			}
+
+			HPHRASE hPhrase = this->FindPhrase(wszIdent);
+			if ((hPhrase == LOC_INVALID_PHRASE_ID) || (!this->m_vPhrases[hPhrase].bPresent))
+				return wszDefault;
+
+			return this->m_vPhrases[hPhrase].wszPhrase;
+		}
+
+		std::wstring QueryPhraseById(const HPHRASE hPhrase, const std::wstring& wszDefault = L"")
+		{
+			//Query phrase of locale by an ID obtained via GetPhraseId
+
+			if (!this->m_bLoaded) {
+				this->LoadLocale();
+			}
+
+			if ((hPhrase >= this->m_vPhrases.size()) || (!this->m_vPhrases[hPhrase].bPresent))
+				return wszDefault;
+
+			return this->m_vPhrases[hPhrase].wszPhrase;
+		}
+
+		HPHRASE GetPhraseId(const std::wstring& wszIdent)
+		{
+			//Resolve phrase ident once for repeated queries. Idents no locale file has provided yield LOC_INVALID_PHRASE_ID
+
+			if (!this->m_bLoaded) {
+				this->LoadLocale();
+			}
+
+			return this->FindPhrase(wszIdent);
 		}
 
 		void SetLocale(const std::wstring& wszLocale)
 		{
-			//Set current locale
+			//Set current locale. Its phrases are loaded on next query
 
-			this->m_wszLocale = wszLocale;
+			if (this->m_wszLocale != wszLocale) {
+				this->m_wszLocale = wszLocale;
+				this->m_bLoaded = false;
+			}
 		}
 
 		void SetLanguagePath(const std::wstring& wszPath)
 		{
 			//Set path to language folder
 
-			this->m_wszLangPath = wszPath;
+			if (this->m_wszLangPath != wszPath) {
+				this->m_wszLangPath = wszPath;
+				this->m_bLoaded = false;
+			}
 		}
 
 		//Getters
@@ -0,0 +1,361 @@
+#pragma once
+
+/*
+	Casual Game Engine (dnyCasualGameEngine) developed by Daniel Brendel
+
+	(C) 2021 - 2022 by Daniel Brendel
+
+	Contact: dbrendel1988<at>gmail<dot>com
+	GitHub: https://github.com/danielbrendel/
+
+	Released under the MIT license
+*/
+
+#include "shared.h"
+#include "utils.h"
+#include "vars.h"
+#include "configmgr.h"
+#include "vfs.h"
+#include "pak.h"
+
+/* Compiled map script cache environment */
+namespace MapCache {
+	#define MAPCACHE_MAGIC 0x4D43444E //"NDCM"
+	#define MAPCACHE_VERSION 2
+
+	struct asset_path_s {
+		std::wstring wszFile; //File name as used in the map script
+		std::wstring wszResolved; //Path the file has been resolved to
+	};
+
+	inline std::wstring GetCacheFileName(const std::wstring& wszMapFile)
+	{
+		//Get cache file name next to the map script
+
+		size_t uiExt = wszMapFile.find_last_of(L'.');
+		if ((uiExt == std::wstring::npos) || (uiExt < wszMapFile.find_last_of(L'\\') + 1)) {
+			return wszMapFile + L".mapc";
+		}
+
+		return wszMapFile.substr(0, uiExt) + L".mapc";
+	}
+
+	/* Stores map scripts as pre-tokenized expression lists together with the resolved asset paths they depend on */
+	class CMapCache {
+	private:
+		std::wstring m_wszCacheFile;
+		unsigned long long m_ullSourceTime;
+		unsigned long long m_ullSourceSize;
+		std::vector<ConfigMgr::CScriptParser::TExpression> m_vExpressions;
+		std::vector<asset_path_s> m_vAssets;
+		ConfigMgr::CNameIndex m_oAssetIndex;
+		bool m_bLoading;
+		bool m_bChanged;
+		bool m_bFromCache;
+		double m_dblLoadTime;
+
+		static std::wstring ToCachePath(const std::wstring& wszFile)
+		{
+			//Store paths relative to the base path so caches stay valid in other installations
+
+			if ((wszFile.length() > wszBasePath.length()) && (_wcsnicmp(wszFile.c_str(), wszBasePath.c_str(), wszBasePath.length()) == 0)) {
+				return wszFile.substr(wszBasePath.length());
+			}
+
+			return wszFile;
+		}
+
+		static std::wstring FromCachePath(const std::wstring& wszFile)
+		{
+			//Resolve relative cache path
+
+			if ((wszFile.length() > 1) && (wszFile[1] == L':')) {
+				return wszFile;
+			}
+
+			return wszBasePath + wszFile;
+		}
+
+		static std::wstring ResolveGfx(const Vfs::CFileSystem& rVfs, const std::wstring& wszFile)
+		{
+			//Resolve graphics file through the mounted package and common folders
+
+			std::wstring wszResolved;
+			if (!rVfs.Resolve(L"gfx\\" + wszFile, wszResolved)) {
+				wszResolved = wszBasePath + L"packages\\.common\\gfx\\" + wszFile;
+			}
+
+			return wszResolved;
+		}
+
+		static bool QuerySource(const std::wstring& wszFile, unsigned long long& ullTime, unsigned long long& ullSize)
+		{
+			//Get last write time and size of a file. Packed files have no own time stamp, so their content hash is used instead
+
+			const byte* pPakData;
+			size_t uiPakSize;
+			if (oArchiveSet.GetFile(wszFile, pPakData, uiPakSize)) {
+				ullTime = Utils::HashData(pPakData, uiPakSize);
+				ullSize = uiPakSize;
+				return true;
+			}
+
+			WIN32_FILE_ATTRIBUTE_DATA sData;
+			if (!GetFileAttributesEx(wszFile.c_str(), GetFileExInfoStandard, &sData))
+				return false;
+
+			ullTime = ((unsigned long long)sData.ftLastWriteTime.dwHighDateTime << 32) | sData.ftLastWriteTime.dwLowDateTime;
+			ullSize = ((unsigned long long)sData.nFileSizeHigh << 32) | sData.nFileSizeLow;
+
+			return true;
+		}
+
+		static void WriteString(std::ofstream& oFile, const std::wstring& wszString)
+		{
+			//Write length prefixed string
+
+			unsigned int uiLength = (unsigned int)wszString.length();
+			oFile.write((const char*)&uiLength, sizeof(uiLength));
+			oFile.write((const char*)wszString.data(), uiLength * sizeof(wchar_t));
+		}
+
+		static bool ReadString(std::ifstream& oFile, std::wstring& wszString)
+		{
+			//Read length prefixed string
+
+			unsigned int uiLength = 0;
+			if (!oFile.read((char*)&uiLength, sizeof(uiLength)))
+				return false;
+
+			if (uiLength > CM_MAX_BUFFER_SIZE * 16)
+				return false;
+
+			wszString.resize(uiLength);
+			if (uiLength) {
+				oFile.read((char*)&wszString[0], uiLength * sizeof(wchar_t));
+			}
+
+			return oFile.good();
+		}
+
+		bool LoadCache(void)
+		{
+			//Load cache if it has been compiled from the current map script
+
+			std::ifstream oFile(Utils::ConvertToAnsiString(this->m_wszCacheFile), std::ifstream::in | std::ifstream::binary);
+			if (!oFile.is_open())
+				return false;
+
+			unsigned int uiMagic = 0, uiVersion = 0, uiCount = 0;
+			unsigned long long ullTime = 0, ullSize = 0;
+
+			oFile.read((char*)&uiMagic, sizeof(uiMagic));
+			oFile.read((char*)&uiVersion, sizeof(uiVersion));
+			oFile.read((char*)&ullTime, sizeof(ullTime));
+			oFile.read((char*)&ullSize, sizeof(ullSize));
+
+			if ((!oFile.good()) || (uiMagic != MAPCACHE_MAGIC) || (uiVersion != MAPCACHE_VERSION) || (ullTime != this->m_ullSourceTime) || (ullSize != this->m_ullSourceSize))
+				return false;
+
+			//Read expressions
+			if (!oFile.read((char*)&uiCount, sizeof(uiCount)))
+				return false;
+
+			this->m_vExpressions.resize(uiCount);
+
+			for (size_t i = 0; i < this->m_vExpressions.size(); i++) {
+				unsigned int uiItems = 0;
+				if ((!oFile.read((char*)&uiItems, sizeof(uiItems))) || (uiItems > CM_MAX_BUFFER_SIZE))
+					return false;
+
+				this->m_vExpressions[i].resize(uiItems);
+
+				for (size_t j = 0; j < uiItems; j++) {
+					if (!ReadString(oFile, this->m_vExpressions[i][j]))
+						return false;
+				}
+			}
+
+			//Read dependencies
+			if (!oFile.read((char*)&uiCount, sizeof(uiCount)))
+				return false;
+
+			this->m_vAssets.resize(uiCount);
+
+			for (size_t i = 0; i < this->m_vAssets.size(); i++) {
+				if ((!ReadString(oFile, this->m_vAssets[i].wszFile)) || (!ReadString(oFile, this->m_vAssets[i].wszResolved)))
+					return false;
+
+				this->m_vAssets[i].wszResolved = FromCachePath(this->m_vAssets[i].wszResolved);
+				this->m_oAssetIndex.Insert(ConfigMgr::HashName(this->m_vAssets[i].wszFile), i);
+			}
+
+			oFile.close();
+
+			return true;
+		}
+
+		bool SaveCache(void)
+		{
+			//Write cache file
+
+			std::ofstream oFile(Utils::ConvertToAnsiString(this->m_wszCacheFile), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+			if (!oFile.is_open())
+				return false;
+
+			unsigned int uiMagic = MAPCACHE_MAGIC, uiVersion = MAPCACHE_VERSION, uiCount;
+
+			oFile.write((const char*)&uiMagic, sizeof(uiMagic));
+			oFile.write((const char*)&uiVersion, sizeof(uiVersion));
+			oFile.write((const char*)&this->m_ullSourceTime, sizeof(this->m_ullSourceTime));
+			oFile.write((const char*)&this->m_ullSourceSize, sizeof(this->m_ullSourceSize));
+
+			uiCount = (unsigned int)this->m_vExpressions.size();
+			oFile.write((const char*)&uiCount, sizeof(uiCount));
+
+			for (size_t i = 0; i < this->m_vExpressions.size(); i++) {
+				unsigned int uiItems = (unsigned int)this->m_vExpressions[i].size();
+				oFile.write((const char*)&uiItems, sizeof(uiItems));
+
+				for (size_t j = 0; j < this->m_vExpressions[i].size(); j++) {
+					WriteString(oFile, this->m_vExpressions[i][j]);
+				}
+			}
+
+			uiCount = (unsigned int)this->m_vAssets.size();
+			oFile.write((const char*)&uiCount, sizeof(uiCount));
+
+			for (size_t i = 0; i < this->m_vAssets.size(); i++) {
+				WriteString(oFile, this->m_vAssets[i].wszFile);
+				WriteString(oFile, ToCachePath(this->m_vAssets[i].wszResolved));
+			}
+
+			oFile.close();
+
+			return true;
+		}
+
+		bool ValidateAssets(const Vfs::CFileSystem& rVfs)
+		{
+			//Check that every asset still resolves to the cached path
+
+			for (size_t i = 0; i < this->m_vAssets.size(); i++) {
+				if (ResolveGfx(rVfs, this->m_vAssets[i].wszFile) != this->m_vAssets[i].wszResolved)
+					return false;
+			}
+
+			return true;
+		}
+	public:
+		CMapCache() : m_ullSourceTime(0), m_ullSourceSize(0), m_bLoading(false), m_bChanged(false), m_bFromCache(false), m_dblLoadTime(0.0) {}
+		~CMapCache() {}
+
+		bool Prepare(const std::wstring& wszMapFile, const Vfs::CFileSystem& rVfs, bool bUseCache)
+		{
+			//Load compiled map script from its cache or compile it. Asset paths are resolved through this cache until EndLoad
+
+			LONGLONG lFrequency, lStart, lEnd;
+			QueryPerformanceFrequency((LARGE_INTEGER*)&lFrequency);
+			QueryPerformanceCounter((LARGE_INTEGER*)&lStart);
+
+			this->m_wszCacheFile = GetCacheFileName(wszMapFile);
+			this->m_vExpressions.clear();
+			this->m_vAssets.clear();
+			this->m_oAssetIndex.Clear();
+			this->m_bLoading = false;
+			this->m_bChanged = false;
+			this->m_bFromCache = false;
+
+			if (!QuerySource(wszMapFile, this->m_ullSourceTime, this->m_ullSourceSize))
+				return false;
+
+			if ((bUseCache) && (this->LoadCache()) && (this->ValidateAssets(rVfs))) {
+				this->m_bFromCache = true;
+			} else {
+				this->m_vAssets.clear();
+				this->m_oAssetIndex.Clear();
+
+				if (!pConfigMgr->Compile(wszMapFile, this->m_vExpressions))
+					return false;
+
+				this->m_bChanged = bUseCache;
+			}
+
+			this->m_bLoading = true;
+
+			QueryPerformanceCounter((LARGE_INTEGER*)&lEnd);
+			this->m_dblLoadTime = (double)(lEnd - lStart) * 1000.0 / (double)lFrequency;
+
+			return true;
+		}
+
+		void Replay(void)
+		{
+			//Execute the prepared expressions
+
+			LONGLONG lFrequency, lStart, lEnd;
+			QueryPerformanceFrequency((LARGE_INTEGER*)&lFrequency);
+			QueryPerformanceCounter((LARGE_INTEGER*)&lStart);
+
+			for (size_t i = 0; i < this->m_vExpressions.size(); i++) {
+				pConfigMgr->HandleExpression(this->m_vExpressions[i]);
+			}
+
+			QueryPerformanceCounter((LARGE_INTEGER*)&lEnd);
+			this->m_dblLoadTime += (double)(lEnd - lStart) * 1000.0 / (double)lFrequency;
+		}
+
+		void EndLoad(void)
+		{
+			//Map loading is done. Write the cache if it has been compiled
+
+			if ((this->m_bChanged) && (this->m_wszCacheFile.length())) {
+				this->SaveCache();
+			}
+
+			this->m_bLoading = false;
+			this->m_bChanged = false;
+		}
+
+		void AbortLoad(void)
+		{
+			//Map loading failed. Stop recording assets and discard the compiled script instead of caching it
+
+			this->m_bLoading = false;
+			this->m_bChanged = false;
+		}
+
+		std::wstring ResolveGfxFile(const Vfs::CFileSystem& rVfs, const std::wstring& wszFile)
+		{
+			//Resolve graphics file of the package with fallback to the common folder
+
+			size_t uiHash = ConfigMgr::HashName(wszFile);
+
+			if (this->m_bLoading) {
+				size_t uiAsset = this->m_oAssetIndex.Find(uiHash, [&](size_t uiEntry) { return this->m_vAssets[uiEntry].wszFile == wszFile; });
+				if (uiAsset != CM_INVALID_LIST_ID) {
+					return this->m_vAssets[uiAsset].wszResolved;
+				}
+			}
+
+			asset_path_s sAsset;
+			sAsset.wszFile = wszFile;
+			sAsset.wszResolved = ResolveGfx(rVfs, wszFile);
+
+			if (this->m_bLoading) {
+				this->m_vAssets.push_back(sAsset);
+				this->m_oAssetIndex.Insert(uiHash, this->m_vAssets.size() - 1);
+			}
+
+			return sAsset.wszResolved;
+		}
+
+		//Getters
+		const std::wstring& GetCacheFile(void) const { return this->m_wszCacheFile; }
+		const std::vector<ConfigMgr::CScriptParser::TExpression>& GetExpressions(void) const { return this->m_vExpressions; }
+		size_t GetExpressionCount(void) const { return this->m_vExpressions.size(); }
+		size_t GetAssetCount(void) const { return this->m_vAssets.size(); }
+		bool IsFromCache(void) const { return this->m_bFromCache; }
+		double GetLoadTime(void) const { return this->m_dblLoadTime; }
+	};
+}
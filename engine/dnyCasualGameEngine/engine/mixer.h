@@ -0,0 +1,920 @@
+#pragma once
+
+/*
+	Casual Game Engine (dnyCasualGameEngine) developed by Daniel Brendel
+
+	(C) 2021 - 2022 by Daniel Brendel
+
+	Contact: dbrendel1988<at>gmail<dot>com
+	GitHub: https://github.com/danielbrendel/
+
+	Released under the MIT license
+*/
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIX_USE_SSE2
+#endif
+
+/* Software audio mixer. Does not depend on any platform audio API */
+namespace DxSound {
+	#define MIX_SAMPLE_RATE 44100
+	#define MIX_CHANNELS 2
+	#define MIX_BLOCK_FRAMES 512
+	#define MIX_MAX_VOICES 64
+	#define MIX_QUEUE_SIZE 256
+	#define MIX_FIXED_ONE (1ULL << 32)
+	#define MIX_STREAM_RING_FRAMES 65536
+	#define MIX_STREAM_CHUNK_FRAMES 4096
+	#define MIX_STREAM_POLL_MS 10
+	#define MIX_STREAM_OPEN (~0ULL)
+	#define SND_INVALID_VOICE std::wstring::npos
+
+	/* Decoder of a streamed sound. Only used by the decode thread of the stream */
+	class IMixerStreamSource {
+	public:
+		virtual ~IMixerStreamSource() {}
+
+		virtual size_t Read(float* pFrames, size_t uiFrames) = 0; //Decode up to uiFrames interleaved stereo float frames. Returns 0 at the end
+		virtual void Rewind(void) = 0;
+	};
+
+	/* Ring of decoded frames refilled by a decode thread. The decode thread only advances ullWritten and the mixer thread only
+	   advances ullRead, so the samples are exchanged without locks. A restart is requested by the mixer thread through uiRequest
+	   and confirmed by the decode thread through uiServed once the ring holds data from the start of the sound */
+	struct mixer_stream_s {
+		IMixerStreamSource* pSource;
+		float* pRing;
+		std::atomic<unsigned long long> ullWritten;
+		std::atomic<unsigned long long> ullRead;
+		std::atomic<unsigned long long> ullEnd; //Written frame count at which the stream ends, MIX_STREAM_OPEN while decoding
+		std::atomic<unsigned int> uiRequest;
+		std::atomic<unsigned int> uiServed;
+		std::atomic<bool> bLoop;
+		std::atomic<bool> bRunning;
+		std::mutex oSourceLock; //Held by the decode thread while reading from the source
+		std::thread* pThread;
+	};
+
+	/* Decoded sound data as interleaved stereo float samples. Streamed sounds have no samples but a stream ring */
+	struct mixer_sound_s {
+		float* pSamples;
+		size_t uiFrames;
+		unsigned int uiSampleRate;
+		unsigned long long ullResumePos; //Only accessed by the mixer thread
+		mixer_stream_s* pStream;
+	};
+
+	struct mixer_stats_s {
+		size_t uiActive;
+		size_t uiStarted;
+		size_t uiStolen;
+		size_t uiRejected;
+		size_t uiDroppedCommands;
+		unsigned long long ullBlocks;
+		double dblAvgMixTime;
+		double dblMaxMixTime;
+	};
+
+	enum mixer_command_e {
+		MIX_CMD_PLAY,
+		MIX_CMD_STOP,
+		MIX_CMD_STOPALL,
+		MIX_CMD_SETMAXVOICES,
+		MIX_CMD_SETLOOPGAIN
+	};
+
+	struct mixer_command_s {
+		mixer_command_e eType;
+		mixer_sound_s* pSound;
+		float fGain;
+		float fPan;
+		bool bLoop;
+		bool bResume;
+		int iPriority;
+		size_t uiValue;
+	};
+
+	/* Lock-free command queue with one producer (game thread) and one consumer (mixer thread) */
+	class CMixerCommandQueue {
+	private:
+		mixer_command_s m_sCommands[MIX_QUEUE_SIZE];
+		std::atomic<size_t> m_uiHead; //Next slot to read, written by consumer
+		std::atomic<size_t> m_uiTail; //Next slot to write, written by producer
+	public:
+		CMixerCommandQueue() : m_uiHead(0), m_uiTail(0) {}
+		~CMixerCommandQueue() {}
+
+		bool Push(const mixer_command_s& sCommand)
+		{
+			//Enqueue command. Fails if the queue is full
+
+			size_t uiTail = this->m_uiTail.load(std::memory_order_relaxed);
+			size_t uiNext = (uiTail + 1) % MIX_QUEUE_SIZE;
+
+			if (uiNext == this->m_uiHead.load(std::memory_order_acquire))
+				return false;
+
+			this->m_sCommands[uiTail] = sCommand;
+			this->m_uiTail.store(uiNext, std::memory_order_release);
+
+			return true;
+		}
+
+		bool Pop(mixer_command_s& sCommandOut)
+		{
+			//Dequeue command. Fails if the queue is empty
+
+			size_t uiHead = this->m_uiHead.load(std::memory_order_relaxed);
+
+			if (uiHead == this->m_uiTail.load(std::memory_order_acquire))
+				return false;
+
+			sCommandOut = this->m_sCommands[uiHead];
+			this->m_uiHead.store((uiHead + 1) % MIX_QUEUE_SIZE, std::memory_order_release);
+
+			return true;
+		}
+	};
+
+	/* Output device interface. Receives mixed blocks of interleaved 16 bit stereo frames */
+	class IMixerOutput {
+	public:
+		virtual ~IMixerOutput() {}
+
+		virtual bool Open(unsigned int uiSampleRate, unsigned int uiChannels) = 0;
+		virtual bool Write(const short* pFrames, size_t uiFrames) = 0;
+		virtual void Close(void) = 0;
+	};
+
+	/* Output device discarding all data, used for headless runs and benchmarks */
+	class CNullMixerOutput : public IMixerOutput {
+	public:
+		CNullMixerOutput() {}
+		virtual ~CNullMixerOutput() {}
+
+		virtual bool Open(unsigned int uiSampleRate, unsigned int uiChannels) { return true; }
+		virtual bool Write(const short* pFrames, size_t uiFrames) { return true; }
+		virtual void Close(void) {}
+	};
+
+	/* Output device writing all mixed data to a wave file */
+	class CWaveFileMixerOutput : public IMixerOutput {
+	private:
+		std::string m_szFileName;
+		std::ofstream m_oFile;
+		unsigned int m_uiChannels;
+		unsigned int m_uiSampleRate;
+		uint32_t m_ulDataSize;
+
+		void WriteHeader(unsigned int uiSampleRate)
+		{
+			//Write RIFF wave header. Sizes are patched on close
+
+			uint32_t ulValue;
+			uint16_t usValue;
+
+			this->m_oFile.write("RIFF", 4);
+			ulValue = 36 + this->m_ulDataSize; this->m_oFile.write((const char*)&ulValue, sizeof(ulValue));
+			this->m_oFile.write("WAVEfmt ", 8);
+			ulValue = 16; this->m_oFile.write((const char*)&ulValue, sizeof(ulValue));
+			usValue = 1; this->m_oFile.write((const char*)&usValue, sizeof(usValue)); //PCM
+			usValue = (uint16_t)this->m_uiChannels; this->m_oFile.write((const char*)&usValue, sizeof(usValue));
+			ulValue = uiSampleRate; this->m_oFile.write((const char*)&ulValue, sizeof(ulValue));
+			ulValue = uiSampleRate * this->m_uiChannels * (uint32_t)sizeof(short); this->m_oFile.write((const char*)&ulValue, sizeof(ulValue));
+			usValue = (uint16_t)(this->m_uiChannels * sizeof(short)); this->m_oFile.write((const char*)&usValue, sizeof(usValue));
+			usValue = 16; this->m_oFile.write((const char*)&usValue, sizeof(usValue));
+			this->m_oFile.write("data", 4);
+			ulValue = this->m_ulDataSize; this->m_oFile.write((const char*)&ulValue, sizeof(ulValue));
+		}
+	public:
+		CWaveFileMixerOutput(const std::string& szFileName) : m_szFileName(szFileName), m_uiChannels(MIX_CHANNELS), m_uiSampleRate(MIX_SAMPLE_RATE), m_ulDataSize(0) {}
+		virtual ~CWaveFileMixerOutput() { this->Close(); }
+
+		virtual bool Open(unsigned int uiSampleRate, unsigned int uiChannels)
+		{
+			//Create wave file
+
+			this->m_oFile.open(this->m_szFileName, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+			if (!this->m_oFile.is_open())
+				return false;
+
+			this->m_uiChannels = uiChannels;
+			this->m_uiSampleRate = uiSampleRate;
+			this->m_ulDataSize = 0;
+
+			this->WriteHeader(uiSampleRate);
+
+			return this->m_oFile.good();
+		}
+
+		virtual bool Write(const short* pFrames, size_t uiFrames)
+		{
+			//Append frames to file
+
+			size_t uiSize = uiFrames * this->m_uiChannels * sizeof(short);
+
+			this->m_oFile.write((const char*)pFrames, uiSize);
+			this->m_ulDataSize += (uint32_t)uiSize;
+
+			return this->m_oFile.good();
+		}
+
+		virtual void Close(void)
+		{
+			//Patch header sizes and close file
+
+			if (!this->m_oFile.is_open())
+				return;
+
+			this->m_oFile.seekp(0, std::ofstream::beg);
+			this->WriteHeader(this->m_uiSampleRate);
+			this->m_oFile.close();
+		}
+	};
+
+	/* Mixer running on its own thread. Voices are controlled through the command queue only */
+	class CSoftwareMixer {
+	private:
+		struct voice_s {
+			bool bActive;
+			mixer_sound_s* pSound;
+			unsigned long long ullPos; //32.32 fixed point frame position
+			unsigned long long ullStep;
+			float fGainL;
+			float fGainR;
+			bool bLoop;
+			int iPriority;
+			unsigned long long ullSerial;
+			unsigned int uiStreamRequest; //Restart of the stream the voice waits for
+		};
+
+		IMixerOutput* m_pOutput;
+		std::thread* m_pThread;
+		std::atomic<bool> m_bRunning;
+		CMixerCommandQueue m_oQueue;
+		voice_s m_sVoices[MIX_MAX_VOICES];
+		size_t m_uiMaxVoices;
+		unsigned long long m_ullVoiceSerial;
+		float m_fAccum[MIX_BLOCK_FRAMES * MIX_CHANNELS];
+		short m_sOutput[MIX_BLOCK_FRAMES * MIX_CHANNELS];
+
+		std::atomic<size_t> m_uiStatActive;
+		std::atomic<size_t> m_uiStatStarted;
+		std::atomic<size_t> m_uiStatStolen;
+		std::atomic<size_t> m_uiStatRejected;
+		std::atomic<size_t> m_uiStatDropped;
+		std::atomic<unsigned long long> m_ullStatBlocks;
+		std::atomic<unsigned long long> m_ullStatMixTimeSum; //Nanoseconds
+		std::atomic<unsigned long long> m_ullStatMixTimeMax;
+
+		size_t AcquireVoice(int iPriority)
+		{
+			//Find free voice or steal the oldest one of lower or equal priority
+
+			size_t uiActive = 0;
+			size_t uiFree = SND_INVALID_VOICE;
+			size_t uiVictim = SND_INVALID_VOICE;
+
+			for (size_t i = 0; i < MIX_MAX_VOICES; i++) {
+				const voice_s& rVoice = this->m_sVoices[i];
+
+				if (!rVoice.bActive) {
+					if (uiFree == SND_INVALID_VOICE) {
+						uiFree = i;
+					}
+
+					continue;
+				}
+
+				uiActive++;
+
+				//Looping voices (music, ambience) are never stolen
+				if ((rVoice.bLoop) || (rVoice.iPriority > iPriority))
+					continue;
+
+				if ((uiVictim == SND_INVALID_VOICE) || (rVoice.iPriority < this->m_sVoices[uiVictim].iPriority) || ((rVoice.iPriority == this->m_sVoices[uiVictim].iPriority) && (rVoice.ullSerial < this->m_sVoices[uiVictim].ullSerial))) {
+					uiVictim = i;
+				}
+			}
+
+			if ((uiFree != SND_INVALID_VOICE) && (uiActive < this->m_uiMaxVoices))
+				return uiFree;
+
+			if (uiVictim != SND_INVALID_VOICE) {
+				this->m_sVoices[uiVictim].bActive = false;
+				this->m_uiStatStolen++;
+			}
+
+			return uiVictim;
+		}
+
+		void StopVoices(mixer_sound_s* pSound)
+		{
+			//Stop voices of sound or of all sounds. Remembers the position of looped voices for resuming
+
+			for (size_t i = 0; i < MIX_MAX_VOICES; i++) {
+				voice_s& rVoice = this->m_sVoices[i];
+
+				if ((!rVoice.bActive) || ((pSound) && (rVoice.pSound != pSound)))
+					continue;
+
+				if (rVoice.bLoop) {
+					rVoice.pSound->ullResumePos = rVoice.ullPos;
+				}
+
+				rVoice.bActive = false;
+			}
+		}
+
+		static void SetVoiceGain(voice_s& rVoice, float fGain, float fPan)
+		{
+			//Split gain into left and right channel gain by pan (-1 = left, 1 = right)
+
+			fPan = (fPan < -1.0f) ? -1.0f : ((fPan > 1.0f) ? 1.0f : fPan);
+
+			rVoice.fGainL = fGain * ((fPan > 0.0f) ? 1.0f - fPan : 1.0f);
+			rVoice.fGainR = fGain * ((fPan < 0.0f) ? 1.0f + fPan : 1.0f);
+		}
+
+		void HandleCommand(const mixer_command_s& sCommand)
+		{
+			//Apply command on mixer thread
+
+			switch (sCommand.eType) {
+			case MIX_CMD_PLAY: {
+				//A sound which is started again replaces its looped voice. A stream can only be read by one voice
+				if (sCommand.bLoop || sCommand.bResume || sCommand.pSound->pStream) {
+					this->StopVoices(sCommand.pSound);
+				}
+
+				size_t uiVoice = this->AcquireVoice(sCommand.iPriority);
+				if (uiVoice == SND_INVALID_VOICE) {
+					this->m_uiStatRejected++;
+					break;
+				}
+
+				voice_s& rVoice = this->m_sVoices[uiVoice];
+				rVoice.pSound = sCommand.pSound;
+				rVoice.ullPos = ((sCommand.bResume) && (sCommand.pSound->ullResumePos < ((unsigned long long)sCommand.pSound->uiFrames << 32))) ? sCommand.pSound->ullResumePos : 0;
+				rVoice.ullStep = ((unsigned long long)sCommand.pSound->uiSampleRate << 32) / MIX_SAMPLE_RATE;
+				SetVoiceGain(rVoice, sCommand.fGain, sCommand.fPan);
+				rVoice.bLoop = sCommand.bLoop;
+				rVoice.iPriority = sCommand.iPriority;
+				rVoice.ullSerial = ++this->m_ullVoiceSerial;
+				rVoice.bActive = true;
+
+				//Streams continue where they have been stopped when resumed, otherwise the decode thread restarts them
+				if (sCommand.pSound->pStream) {
+					mixer_stream_s* pStream = sCommand.pSound->pStream;
+
+					bool bEnded = pStream->ullRead.load() >= pStream->ullEnd.load();
+
+					pStream->bLoop = sCommand.bLoop;
+					if ((!sCommand.bResume) || (bEnded)) {
+						pStream->uiRequest.store(pStream->uiRequest.load() + 1, std::memory_order_release);
+					}
+
+					rVoice.uiStreamRequest = pStream->uiRequest.load();
+					rVoice.ullPos = 0;
+				}
+
+				this->m_uiStatStarted++;
+				break;
+			}
+			case MIX_CMD_STOP:
+				this->StopVoices(sCommand.pSound);
+				break;
+			case MIX_CMD_STOPALL:
+				this->StopVoices(nullptr);
+				break;
+			case MIX_CMD_SETMAXVOICES:
+				this->m_uiMaxVoices = (sCommand.uiValue > MIX_MAX_VOICES) ? MIX_MAX_VOICES : ((sCommand.uiValue) ? sCommand.uiValue : 1);
+				break;
+			case MIX_CMD_SETLOOPGAIN:
+				for (size_t i = 0; i < MIX_MAX_VOICES; i++) {
+					if ((this->m_sVoices[i].bActive) && (this->m_sVoices[i].bLoop) && (this->m_sVoices[i].pSound == sCommand.pSound)) {
+						SetVoiceGain(this->m_sVoices[i], sCommand.fGain, sCommand.fPan);
+					}
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+		static size_t MixSameRate(float* pAccum, const float* pSource, size_t uiFrames, float fGainL, float fGainR)
+		{
+			//Add source frames with equal sample rate to the accumulation buffer
+
+			size_t i = 0;
+
+#ifdef MIX_USE_SSE2
+			//Two stereo frames per iteration
+			__m128 vGain = _mm_setr_ps(fGainL, fGainR, fGainL, fGainR);
+
+			for (; i + 2 <= uiFrames; i += 2) {
+				__m128 vAccum = _mm_loadu_ps(pAccum + i * MIX_CHANNELS);
+				__m128 vSource = _mm_loadu_ps(pSource + i * MIX_CHANNELS);
+				_mm_storeu_ps(pAccum + i * MIX_CHANNELS, _mm_add_ps(vAccum, _mm_mul_ps(vSource, vGain)));
+			}
+#endif
+
+			for (; i < uiFrames; i++) {
+				pAccum[i * MIX_CHANNELS] += pSource[i * MIX_CHANNELS] * fGainL;
+				pAccum[i * MIX_CHANNELS + 1] += pSource[i * MIX_CHANNELS + 1] * fGainR;
+			}
+
+			return uiFrames;
+		}
+
+		void MixStreamVoice(voice_s& rVoice, float* pAccum, size_t uiFrames)
+		{
+			//Mix voice of a streamed sound and hand the consumed frames back to the decode thread. The voice position is relative
+			//to the read position of the ring. If the decode thread falls behind the rest of the block stays silent
+
+			mixer_stream_s* pStream = rVoice.pSound->pStream;
+
+			if (pStream->uiServed.load(std::memory_order_acquire) != rVoice.uiStreamRequest)
+				return;
+
+			unsigned long long ullRead = pStream->ullRead.load(std::memory_order_relaxed);
+			size_t uiAvailable = (size_t)(pStream->ullWritten.load(std::memory_order_acquire) - ullRead);
+			size_t uiDone = 0;
+
+			while (uiDone < uiFrames) {
+				size_t uiPos = (size_t)(rVoice.ullPos >> 32);
+
+				if (uiPos >= uiAvailable) {
+					if (ullRead + uiPos >= pStream->ullEnd.load(std::memory_order_acquire)) {
+						rVoice.bActive = false;
+					}
+
+					break;
+				}
+
+				size_t uiRingPos = (size_t)((ullRead + uiPos) % MIX_STREAM_RING_FRAMES);
+
+				if (rVoice.ullStep == MIX_FIXED_ONE) {
+					//Matching sample rate: copy whole runs up to the end of the ring
+					size_t uiCount = uiAvailable - uiPos;
+					if (uiCount > uiFrames - uiDone) {
+						uiCount = uiFrames - uiDone;
+					}
+					if (uiCount > MIX_STREAM_RING_FRAMES - uiRingPos) {
+						uiCount = MIX_STREAM_RING_FRAMES - uiRingPos;
+					}
+
+					MixSameRate(pAccum + uiDone * MIX_CHANNELS, pStream->pRing + uiRingPos * MIX_CHANNELS, uiCount, rVoice.fGainL, rVoice.fGainR);
+
+					rVoice.ullPos += (unsigned long long)uiCount << 32;
+					uiDone += uiCount;
+				} else {
+					//Different sample rate: linear interpolation
+					size_t uiNext = (uiPos + 1 < uiAvailable) ? (uiRingPos + 1) % MIX_STREAM_RING_FRAMES : uiRingPos;
+					float fFrac = (float)(rVoice.ullPos & 0xFFFFFFFF) / 4294967296.0f;
+
+					const float* pCur = pStream->pRing + uiRingPos * MIX_CHANNELS;
+					const float* pNext = pStream->pRing + uiNext * MIX_CHANNELS;
+
+					pAccum[uiDone * MIX_CHANNELS] += (pCur[0] + (pNext[0] - pCur[0]) * fFrac) * rVoice.fGainL;
+					pAccum[uiDone * MIX_CHANNELS + 1] += (pCur[1] + (pNext[1] - pCur[1]) * fFrac) * rVoice.fGainR;
+
+					rVoice.ullPos += rVoice.ullStep;
+					uiDone++;
+				}
+			}
+
+			size_t uiConsumed = (size_t)(rVoice.ullPos >> 32);
+			if (uiConsumed > uiAvailable) {
+				uiConsumed = uiAvailable;
+			}
+
+			rVoice.ullPos -= (unsigned long long)uiConsumed << 32;
+			pStream->ullRead.store(ullRead + uiConsumed, std::memory_order_release);
+		}
+
+		void MixVoice(voice_s& rVoice, float* pAccum, size_t uiFrames)
+		{
+			//Mix voice into accumulation buffer
+
+			if (rVoice.pSound->pStream) {
+				this->MixStreamVoice(rVoice, pAccum, uiFrames);
+				return;
+			}
+
+			const mixer_sound_s* pSound = rVoice.pSound;
+			unsigned long long ullEnd = (unsigned long long)pSound->uiFrames << 32;
+			size_t uiDone = 0;
+
+			while (uiDone < uiFrames) {
+				if (rVoice.ullPos >= ullEnd) {
+					if (!rVoice.bLoop) {
+						rVoice.bActive = false;
+						return;
+					}
+
+					rVoice.ullPos -= ullEnd;
+				}
+
+				if (rVoice.ullStep == MIX_FIXED_ONE) {
+					//Matching sample rate: copy whole runs
+					size_t uiPos = (size_t)(rVoice.ullPos >> 32);
+					size_t uiCount = pSound->uiFrames - uiPos;
+					if (uiCount > uiFrames - uiDone) {
+						uiCount = uiFrames - uiDone;
+					}
+
+					MixSameRate(pAccum + uiDone * MIX_CHANNELS, pSound->pSamples + uiPos * MIX_CHANNELS, uiCount, rVoice.fGainL, rVoice.fGainR);
+
+					rVoice.ullPos += (unsigned long long)uiCount << 32;
+					uiDone += uiCount;
+				} else {
+					//Different sample rate: linear interpolation
+					size_t uiPos = (size_t)(rVoice.ullPos >> 32);
+					size_t uiNext = (uiPos + 1 < pSound->uiFrames) ? uiPos + 1 : ((rVoice.bLoop) ? 0 : uiPos);
+					float fFrac = (float)(rVoice.ullPos & 0xFFFFFFFF) / 4294967296.0f;
+
+					const float* pCur = pSound->pSamples + uiPos * MIX_CHANNELS;
+					const float* pNext = pSound->pSamples + uiNext * MIX_CHANNELS;
+
+					pAccum[uiDone * MIX_CHANNELS] += (pCur[0] + (pNext[0] - pCur[0]) * fFrac) * rVoice.fGainL;
+					pAccum[uiDone * MIX_CHANNELS + 1] += (pCur[1] + (pNext[1] - pCur[1]) * fFrac) * rVoice.fGainR;
+
+					rVoice.ullPos += rVoice.ullStep;
+					uiDone++;
+				}
+			}
+		}
+
+		static void ConvertBlock(const float* pAccum, short* pOutput, size_t uiSamples)
+		{
+			//Clamp mixed samples and convert them to 16 bit
+
+			size_t i = 0;
+
+#ifdef MIX_USE_SSE2
+			__m128 vScale = _mm_set1_ps(32767.0f);
+			__m128 vMin = _mm_set1_ps(-1.0f);
+			__m128 vMax = _mm_set1_ps(1.0f);
+
+			for (; i + 8 <= uiSamples; i += 8) {
+				__m128 vLow = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(pAccum + i), vMin), vMax), vScale);
+				__m128 vHigh = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(pAccum + i + 4), vMin), vMax), vScale);
+				_mm_storeu_si128((__m128i*)(pOutput + i), _mm_packs_epi32(_mm_cvtps_epi32(vLow), _mm_cvtps_epi32(vHigh)));
+			}
+#endif
+
+			for (; i < uiSamples; i++) {
+				float fSample = (pAccum[i] < -1.0f) ? -1.0f : ((pAccum[i] > 1.0f) ? 1.0f : pAccum[i]);
+				pOutput[i] = (short)(fSample * 32767.0f);
+			}
+		}
+
+		void MixBlock(void)
+		{
+			//Process pending commands and mix one block
+
+			mixer_command_s sCommand;
+			while (this->m_oQueue.Pop(sCommand)) {
+				this->HandleCommand(sCommand);
+			}
+
+			memset(this->m_fAccum, 0x00, sizeof(this->m_fAccum));
+
+			size_t uiActive = 0;
+
+			for (size_t i = 0; i < MIX_MAX_VOICES; i++) {
+				if (!this->m_sVoices[i].bActive)
+					continue;
+
+				this->MixVoice(this->m_sVoices[i], this->m_fAccum, MIX_BLOCK_FRAMES);
+
+				if (this->m_sVoices[i].bActive) {
+					uiActive++;
+				}
+			}
+
+			ConvertBlock(this->m_fAccum, this->m_sOutput, MIX_BLOCK_FRAMES * MIX_CHANNELS);
+
+			this->m_uiStatActive = uiActive;
+		}
+
+		static void StreamThread(mixer_stream_s* pStream)
+		{
+			//Keep the ring of a stream filled. Loops wrap around to the start of the source, other streams mark their end
+
+			unsigned int uiServed = pStream->uiServed;
+
+			while (pStream->bRunning) {
+				unsigned int uiRequest = pStream->uiRequest.load(std::memory_order_acquire);
+
+				//The voice waits for the restart, so the mixer thread does not read from the ring meanwhile
+				if (uiRequest != uiServed) {
+					{
+						std::lock_guard<std::mutex> oLock(pStream->oSourceLock);
+						pStream->pSource->Rewind();
+					}
+
+					pStream->ullWritten.store(pStream->ullRead.load(std::memory_order_acquire), std::memory_order_relaxed);
+					pStream->ullEnd.store(MIX_STREAM_OPEN, std::memory_order_relaxed);
+
+					uiServed = uiRequest;
+					pStream->uiServed.store(uiServed, std::memory_order_release);
+				}
+
+				unsigned long long ullWritten = pStream->ullWritten.load(std::memory_order_relaxed);
+				size_t uiFree = MIX_STREAM_RING_FRAMES - (size_t)(ullWritten - pStream->ullRead.load(std::memory_order_acquire));
+
+				if ((pStream->ullEnd.load(std::memory_order_relaxed) != MIX_STREAM_OPEN) || (uiFree < MIX_STREAM_CHUNK_FRAMES)) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(MIX_STREAM_POLL_MS));
+					continue;
+				}
+
+				size_t uiRingPos = (size_t)(ullWritten % MIX_STREAM_RING_FRAMES);
+				size_t uiCount = MIX_STREAM_CHUNK_FRAMES;
+				if (uiCount > MIX_STREAM_RING_FRAMES - uiRingPos) {
+					uiCount = MIX_STREAM_RING_FRAMES - uiRingPos;
+				}
+
+				size_t uiDecoded;
+
+				{
+					std::lock_guard<std::mutex> oLock(pStream->oSourceLock);
+
+					uiDecoded = pStream->pSource->Read(pStream->pRing + uiRingPos * MIX_CHANNELS, uiCount);
+					if ((!uiDecoded) && (pStream->bLoop)) {
+						pStream->pSource->Rewind();
+						uiDecoded = pStream->pSource->Read(pStream->pRing + uiRingPos * MIX_CHANNELS, uiCount);
+					}
+				}
+
+				if (!uiDecoded) {
+					pStream->ullEnd.store(ullWritten, std::memory_order_release);
+					continue;
+				}
+
+				pStream->ullWritten.store(ullWritten + uiDecoded, std::memory_order_release);
+			}
+		}
+
+		static void MixerThread(CSoftwareMixer* pMixer)
+		{
+			//Mix blocks in real time and pass them to the output device
+
+			const std::chrono::nanoseconds oBlockDuration((long long)MIX_BLOCK_FRAMES * 1000000000LL / MIX_SAMPLE_RATE);
+			std::chrono::steady_clock::time_point oNextBlock = std::chrono::steady_clock::now();
+
+			while (pMixer->m_bRunning) {
+				std::chrono::steady_clock::time_point oStart = std::chrono::steady_clock::now();
+
+				pMixer->MixBlock();
+
+				unsigned long long ullMixTime = (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - oStart).count();
+				pMixer->m_ullStatMixTimeSum += ullMixTime;
+				if (ullMixTime > pMixer->m_ullStatMixTimeMax) {
+					pMixer->m_ullStatMixTimeMax = ullMixTime;
+				}
+				pMixer->m_ullStatBlocks++;
+
+				pMixer->m_pOutput->Write(pMixer->m_sOutput, MIX_BLOCK_FRAMES);
+
+				//Output devices do not block, so keep pace with the sample rate. Resync after stalls
+				oNextBlock += oBlockDuration;
+				std::chrono::steady_clock::time_point oNow = std::chrono::steady_clock::now();
+
+				if (oNow > oNextBlock + std::chrono::seconds(1)) {
+					oNextBlock = oNow;
+				} else if (oNextBlock > oNow) {
+					std::this_thread::sleep_until(oNextBlock);
+				}
+			}
+		}
+
+		bool PushCommand(const mixer_command_s& sCommand)
+		{
+			//Pass command to mixer thread
+
+			if (!this->m_oQueue.Push(sCommand)) {
+				this->m_uiStatDropped++;
+				return false;
+			}
+
+			return true;
+		}
+	public:
+		CSoftwareMixer() : m_pOutput(nullptr), m_pThread(nullptr), m_bRunning(false), m_uiMaxVoices(MIX_MAX_VOICES), m_ullVoiceSerial(0),
+			m_uiStatActive(0), m_uiStatStarted(0), m_uiStatStolen(0), m_uiStatRejected(0), m_uiStatDropped(0), m_ullStatBlocks(0), m_ullStatMixTimeSum(0), m_ullStatMixTimeMax(0)
+		{
+			memset(this->m_sVoices, 0x00, sizeof(this->m_sVoices));
+		}
+		~CSoftwareMixer() { this->Stop(); }
+
+		bool Start(IMixerOutput* pOutput)
+		{
+			//Open output device and start mixer thread. Takes ownership of the device
+
+			if ((!pOutput) || (this->m_pThread))
+				return false;
+
+			if (!pOutput->Open(MIX_SAMPLE_RATE, MIX_CHANNELS)) {
+				delete pOutput;
+				return false;
+			}
+
+			this->m_pOutput = pOutput;
+			this->m_bRunning = true;
+			this->m_pThread = new std::thread(&CSoftwareMixer::MixerThread, this);
+
+			return true;
+		}
+
+		void Stop(void)
+		{
+			//Stop mixer thread and close output device
+
+			if (this->m_pThread) {
+				this->m_bRunning = false;
+				this->m_pThread->join();
+				delete this->m_pThread;
+				this->m_pThread = nullptr;
+			}
+
+			if (this->m_pOutput) {
+				this->m_pOutput->Close();
+				delete this->m_pOutput;
+				this->m_pOutput = nullptr;
+			}
+
+			memset(this->m_sVoices, 0x00, sizeof(this->m_sVoices));
+		}
+
+		bool Play(mixer_sound_s* pSound, float fGain, float fPan, bool bLoop, bool bResume, int iPriority)
+		{
+			//Start voice of sound
+
+			if ((!pSound) || (!pSound->uiFrames))
+				return false;
+
+			mixer_command_s sCommand = { MIX_CMD_PLAY, pSound, fGain, fPan, bLoop, bResume, iPriority, 0 };
+
+			return this->PushCommand(sCommand);
+		}
+
+		bool StopSound(mixer_sound_s* pSound)
+		{
+			//Stop all voices of sound
+
+			mixer_command_s sCommand = { MIX_CMD_STOP, pSound, 0.0f, 0.0f, false, false, 0, 0 };
+
+			return this->PushCommand(sCommand);
+		}
+
+		bool StopAll(void)
+		{
+			//Stop all voices
+
+			mixer_command_s sCommand = { MIX_CMD_STOPALL, nullptr, 0.0f, 0.0f, false, false, 0, 0 };
+
+			return this->PushCommand(sCommand);
+		}
+
+		bool SetMaxVoices(size_t uiMaxVoices)
+		{
+			//Set maximum amount of simultaneously mixed voices
+
+			mixer_command_s sCommand = { MIX_CMD_SETMAXVOICES, nullptr, 0.0f, 0.0f, false, false, 0, uiMaxVoices };
+
+			return this->PushCommand(sCommand);
+		}
+
+		bool SetLoopGain(mixer_sound_s* pSound, float fGain, float fPan)
+		{
+			//Change gain and pan of the looped voice of sound
+
+			mixer_command_s sCommand = { MIX_CMD_SETLOOPGAIN, pSound, fGain, fPan, true, false, 0, 0 };
+
+			return this->PushCommand(sCommand);
+		}
+
+		void GetStats(mixer_stats_s& sStatsOut) const
+		{
+			//Get cumulative mixer statistics
+
+			sStatsOut.uiActive = this->m_uiStatActive;
+			sStatsOut.uiStarted = this->m_uiStatStarted;
+			sStatsOut.uiStolen = this->m_uiStatStolen;
+			sStatsOut.uiRejected = this->m_uiStatRejected;
+			sStatsOut.uiDroppedCommands = this->m_uiStatDropped;
+			sStatsOut.ullBlocks = this->m_ullStatBlocks;
+			sStatsOut.dblAvgMixTime = (sStatsOut.ullBlocks) ? (double)this->m_ullStatMixTimeSum / (double)sStatsOut.ullBlocks / 1000.0 : 0.0;
+			sStatsOut.dblMaxMixTime = (double)this->m_ullStatMixTimeMax / 1000.0;
+		}
+
+		static bool IsSupportedFormat(unsigned int uiChannels, unsigned int uiBitsPerSample, unsigned int uiSampleRate)
+		{
+			//Check if PCM data of the format can be converted
+
+			return (uiChannels) && (uiChannels <= 2) && ((uiBitsPerSample == 8) || (uiBitsPerSample == 16)) && (uiSampleRate);
+		}
+
+		static void ConvertFrames(const void* pData, size_t uiFrames, unsigned int uiChannels, unsigned int uiBitsPerSample, float* pOutput)
+		{
+			//Convert 8 or 16 bit PCM frames to stereo float frames
+
+			for (size_t i = 0; i < uiFrames; i++) {
+				for (size_t c = 0; c < MIX_CHANNELS; c++) {
+					size_t uiSample = i * uiChannels + ((uiChannels == 2) ? c : 0);
+
+					pOutput[i * MIX_CHANNELS + c] = (uiBitsPerSample == 16) ? (float)((const short*)pData)[uiSample] / 32768.0f : (float)((int)((const unsigned char*)pData)[uiSample] - 128) / 128.0f;
+				}
+			}
+		}
+
+		static mixer_sound_s* CreateSound(const void* pData, size_t uiDataSize, unsigned int uiChannels, unsigned int uiBitsPerSample, unsigned int uiSampleRate)
+		{
+			//Convert 8 or 16 bit PCM data to stereo float samples
+
+			if ((!pData) || (!IsSupportedFormat(uiChannels, uiBitsPerSample, uiSampleRate)))
+				return nullptr;
+
+			size_t uiFrames = uiDataSize / (uiChannels * (uiBitsPerSample / 8));
+			if (!uiFrames)
+				return nullptr;
+
+			mixer_sound_s* pSound = new mixer_sound_s();
+			pSound->pSamples = new float[uiFrames * MIX_CHANNELS];
+			pSound->uiFrames = uiFrames;
+			pSound->uiSampleRate = uiSampleRate;
+			pSound->ullResumePos = 0;
+			pSound->pStream = nullptr;
+
+			ConvertFrames(pData, uiFrames, uiChannels, uiBitsPerSample, pSound->pSamples);
+
+			return pSound;
+		}
+
+		static mixer_sound_s* CreateStream(IMixerStreamSource* pSource, size_t uiFrames, unsigned int uiSampleRate)
+		{
+			//Create sound which is decoded while it plays and start its decode thread. Takes ownership of the source
+
+			if ((!pSource) || (!uiFrames) || (!uiSampleRate)) {
+				delete pSource;
+				return nullptr;
+			}
+
+			mixer_stream_s* pStream = new mixer_stream_s();
+			pStream->pSource = pSource;
+			pStream->pRing = new float[MIX_STREAM_RING_FRAMES * MIX_CHANNELS];
+			pStream->ullWritten = 0;
+			pStream->ullRead = 0;
+			pStream->ullEnd = MIX_STREAM_OPEN;
+			pStream->uiRequest = 0;
+			pStream->uiServed = 0;
+			pStream->bLoop = false;
+			pStream->bRunning = true;
+			pStream->pThread = new std::thread(&CSoftwareMixer::StreamThread, pStream);
+
+			mixer_sound_s* pSound = new mixer_sound_s();
+			pSound->pSamples = nullptr;
+			pSound->uiFrames = uiFrames;
+			pSound->uiSampleRate = uiSampleRate;
+			pSound->ullResumePos = 0;
+			pSound->pStream = pStream;
+
+			return pSound;
+		}
+
+		static void FreeSound(mixer_sound_s* pSound)
+		{
+			//Free converted sound data. Streams stop their decode thread first
+
+			if (!pSound)
+				return;
+
+			if (pSound->pStream) {
+				pSound->pStream->bRunning = false;
+				pSound->pStream->pThread->join();
+				delete pSound->pStream->pThread;
+				delete pSound->pStream->pSource;
+				delete[] pSound->pStream->pRing;
+				delete pSound->pStream;
+			}
+
+			delete[] pSound->pSamples;
+			delete pSound;
+		}
+
+		//Getters
+		bool IsRunning(void) const { return this->m_pThread != nullptr; }
+	};
+}
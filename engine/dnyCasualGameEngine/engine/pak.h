@@ -0,0 +1,457 @@
+#pragma once
+
+/*
+	Casual Game Engine (dnyCasualGameEngine) developed by Daniel Brendel
+
+	(C) 2021 - 2022 by Daniel Brendel
+
+	Contact: dbrendel1988<at>gmail<dot>com
+	GitHub: https://github.com/danielbrendel/
+
+	Released under the MIT license
+*/
+
+#include "shared.h"
+
+/* Packed asset archive environment */
+namespace Pak {
+	#define PAK_MAGIC 0x4B415044 //"DPAK"
+	#define PAK_VERSION 1
+	#define PAK_ALIGNMENT 4096
+	#define PAK_FILE_EXT L".pak"
+
+	/*
+		Archive layout:
+		- header_s
+		- entry data, each entry starting at a PAK_ALIGNMENT boundary
+		- index at header_s::ullIndexOffset: per entry an index_entry_s followed by the UTF-16 path.
+		  Entries are sorted by their normalized path
+	*/
+
+	enum compression_e {
+		COMPRESSION_NONE = 0
+	};
+
+	#pragma pack(push, 1)
+	struct header_s {
+		unsigned int uiMagic;
+		unsigned int uiVersion;
+		unsigned int uiEntryCount;
+		unsigned int uiFlags;
+		unsigned long long ullIndexOffset;
+	};
+
+	struct index_entry_s {
+		unsigned long long ullOffset;
+		unsigned long long ullSize;
+		unsigned int uiCompression;
+		unsigned int uiPathLength;
+	};
+	#pragma pack(pop)
+
+	struct entry_s {
+		std::wstring wszPath;
+		const byte* pData;
+		size_t uiSize;
+	};
+
+	inline std::wstring NormalizePath(const std::wstring& wszPath)
+	{
+		//Lower case path with backslashes only and without leading separators
+
+		std::wstring wszResult;
+		wszResult.reserve(wszPath.length());
+
+		for (size_t i = 0; i < wszPath.length(); i++) {
+			wchar_t wc = (wszPath[i] == L'/') ? L'\\' : wszPath[i];
+
+			if ((wc == L'\\') && (!wszResult.length()))
+				continue;
+
+			wszResult += (wchar_t)towlower(wc);
+		}
+
+		return wszResult;
+	}
+
+	/* Read-only memory mapped archive. Views handed out stay valid until the archive is closed */
+	class CArchive {
+	private:
+		HANDLE m_hFile;
+		HANDLE m_hMapping;
+		const byte* m_pView;
+		size_t m_uiSize;
+		std::vector<entry_s> m_vEntries;
+
+		static bool ComparePath(const entry_s& a, const entry_s& b) { return a.wszPath < b.wszPath; }
+	public:
+		CArchive() : m_hFile(INVALID_HANDLE_VALUE), m_hMapping(nullptr), m_pView(nullptr), m_uiSize(0) {}
+		~CArchive() { this->Close(); }
+
+		bool Open(const std::wstring& wszFile)
+		{
+			//Map archive into memory and read its index
+
+			this->Close();
+
+			this->m_hFile = CreateFile(wszFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, 0);
+			if (this->m_hFile == INVALID_HANDLE_VALUE)
+				return false;
+
+			LARGE_INTEGER sFileSize;
+			if ((!GetFileSizeEx(this->m_hFile, &sFileSize)) || (sFileSize.QuadPart < (LONGLONG)sizeof(header_s))) {
+				this->Close();
+				return false;
+			}
+
+			this->m_uiSize = (size_t)sFileSize.QuadPart;
+
+			this->m_hMapping = CreateFileMapping(this->m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!this->m_hMapping) {
+				this->Close();
+				return false;
+			}
+
+			this->m_pView = (const byte*)MapViewOfFile(this->m_hMapping, FILE_MAP_READ, 0, 0, 0);
+			if (!this->m_pView) {
+				this->Close();
+				return false;
+			}
+
+			//Validate header
+			const header_s* pHeader = (const header_s*)this->m_pView;
+			if ((pHeader->uiMagic != PAK_MAGIC) || (pHeader->uiVersion != PAK_VERSION) || (pHeader->ullIndexOffset > this->m_uiSize)) {
+				this->Close();
+				return false;
+			}
+
+			//Read index
+			size_t uiPos = (size_t)pHeader->ullIndexOffset;
+			this->m_vEntries.reserve(pHeader->uiEntryCount);
+
+			for (unsigned int i = 0; i < pHeader->uiEntryCount; i++) {
+				if (uiPos + sizeof(index_entry_s) > this->m_uiSize) {
+					this->Close();
+					return false;
+				}
+
+				index_entry_s sIndex;
+				memcpy(&sIndex, this->m_pView + uiPos, sizeof(index_entry_s));
+				uiPos += sizeof(index_entry_s);
+
+				if ((sIndex.uiCompression != COMPRESSION_NONE) || (sIndex.ullOffset > this->m_uiSize) || (sIndex.ullSize > this->m_uiSize - sIndex.ullOffset) || (uiPos + sIndex.uiPathLength * sizeof(wchar_t) > this->m_uiSize)) {
+					this->Close();
+					return false;
+				}
+
+				entry_s sEntry;
+				sEntry.wszPath.resize(sIndex.uiPathLength);
+				memcpy(&sEntry.wszPath[0], this->m_pView + uiPos, sIndex.uiPathLength * sizeof(wchar_t));
+				sEntry.pData = this->m_pView + sIndex.ullOffset;
+				sEntry.uiSize = (size_t)sIndex.ullSize;
+				uiPos += sIndex.uiPathLength * sizeof(wchar_t);
+
+				this->m_vEntries.push_back(sEntry);
+			}
+
+			//Index is written sorted, but do not rely on foreign tools doing so
+			if (!std::is_sorted(this->m_vEntries.begin(), this->m_vEntries.end(), &ComparePath)) {
+				std::sort(this->m_vEntries.begin(), this->m_vEntries.end(), &ComparePath);
+			}
+
+			return true;
+		}
+
+		void Close(void)
+		{
+			//Unmap archive
+
+			this->m_vEntries.clear();
+
+			if (this->m_pView) {
+				UnmapViewOfFile(this->m_pView);
+				this->m_pView = nullptr;
+			}
+
+			if (this->m_hMapping) {
+				CloseHandle(this->m_hMapping);
+				this->m_hMapping = nullptr;
+			}
+
+			if (this->m_hFile != INVALID_HANDLE_VALUE) {
+				CloseHandle(this->m_hFile);
+				this->m_hFile = INVALID_HANDLE_VALUE;
+			}
+
+			this->m_uiSize = 0;
+		}
+
+		const entry_s* Find(const std::wstring& wszPath) const
+		{
+			//Binary search entry by normalized path
+
+			entry_s sKey;
+			sKey.wszPath = wszPath;
+
+			std::vector<entry_s>::const_iterator it = std::lower_bound(this->m_vEntries.begin(), this->m_vEntries.end(), sKey, &ComparePath);
+			if ((it == this->m_vEntries.end()) || (it->wszPath != wszPath))
+				return nullptr;
+
+			return &(*it);
+		}
+
+		bool Contains(const void* pData) const
+		{
+			//Check if memory belongs to the mapped view
+
+			return (this->m_pView) && ((const byte*)pData >= this->m_pView) && ((const byte*)pData < this->m_pView + this->m_uiSize);
+		}
+
+		//Getters
+		bool IsOpen(void) const { return this->m_pView != nullptr; }
+		size_t GetEntryCount(void) const { return this->m_vEntries.size(); }
+		const entry_s& GetEntry(size_t uiEntry) const { return this->m_vEntries[uiEntry]; }
+	};
+
+	/* Archives mounted over directories. A file below a mount directory is served from the archive if it contains it */
+	class CArchiveSet {
+	private:
+		struct mount_s {
+			std::wstring wszRoot; //Normalized directory the archive stands in for
+			std::wstring wszFile;
+			CArchive* pArchive;
+		};
+
+		std::vector<mount_s> m_vMounts;
+	public:
+		CArchiveSet() {}
+		~CArchiveSet() { this->Clear(); }
+
+		bool Mount(const std::wstring& wszArchive, const std::wstring& wszRootDir)
+		{
+			//Mount archive over a directory. Archives stay mapped until cleared so views remain valid
+
+			std::wstring wszRoot = NormalizePath(wszRootDir);
+			while ((wszRoot.length()) && (wszRoot[wszRoot.length() - 1] == L'\\')) {
+				wszRoot.pop_back();
+			}
+
+			for (size_t i = 0; i < this->m_vMounts.size(); i++) {
+				if (this->m_vMounts[i].wszRoot == wszRoot)
+					return true;
+			}
+
+			CArchive* pArchive = new CArchive();
+			if (!pArchive->Open(wszArchive)) {
+				delete pArchive;
+				return false;
+			}
+
+			mount_s sMount;
+			sMount.wszRoot = wszRoot;
+			sMount.wszFile = wszArchive;
+			sMount.pArchive = pArchive;
+			this->m_vMounts.push_back(sMount);
+
+			return true;
+		}
+
+		const CArchive* FindArchive(const std::wstring& wszRootDir) const
+		{
+			//Get archive mounted over a directory
+
+			std::wstring wszRoot = NormalizePath(wszRootDir);
+			while ((wszRoot.length()) && (wszRoot[wszRoot.length() - 1] == L'\\')) {
+				wszRoot.pop_back();
+			}
+
+			for (size_t i = 0; i < this->m_vMounts.size(); i++) {
+				if (this->m_vMounts[i].wszRoot == wszRoot)
+					return this->m_vMounts[i].pArchive;
+			}
+
+			return nullptr;
+		}
+
+		bool GetFile(const std::wstring& wszFullPath, const byte*& pData, size_t& uiSize) const
+		{
+			//Get zero-copy view of a file if a mounted archive provides it
+
+			if (!this->m_vMounts.size())
+				return false;
+
+			std::wstring wszPath = NormalizePath(wszFullPath);
+
+			for (size_t i = 0; i < this->m_vMounts.size(); i++) {
+				const std::wstring& wszRoot = this->m_vMounts[i].wszRoot;
+
+				if ((wszPath.length() <= wszRoot.length() + 1) || (wszPath[wszRoot.length()] != L'\\') || (wszPath.compare(0, wszRoot.length(), wszRoot) != 0))
+					continue;
+
+				const entry_s* pEntry = this->m_vMounts[i].pArchive->Find(wszPath.substr(wszRoot.length() + 1));
+				if (pEntry) {
+					pData = pEntry->pData;
+					uiSize = pEntry->uiSize;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		bool Unmount(const std::wstring& wszRootDir)
+		{
+			//Unmount archive of a directory. Views into the archive must not be used anymore
+
+			std::wstring wszRoot = NormalizePath(wszRootDir);
+			while ((wszRoot.length()) && (wszRoot[wszRoot.length() - 1] == L'\\')) {
+				wszRoot.pop_back();
+			}
+
+			for (size_t i = 0; i < this->m_vMounts.size(); i++) {
+				if (this->m_vMounts[i].wszRoot == wszRoot) {
+					delete this->m_vMounts[i].pArchive;
+					this->m_vMounts.erase(this->m_vMounts.begin() + i);
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void Clear(void)
+		{
+			//Unmount all archives
+
+			for (size_t i = 0; i < this->m_vMounts.size(); i++) {
+				delete this->m_vMounts[i].pArchive;
+			}
+
+			this->m_vMounts.clear();
+		}
+
+		size_t GetMountCount(void) const { return this->m_vMounts.size(); }
+	};
+
+	inline void CollectFiles(const std::wstring& wszDir, const std::wstring& wszRelPath, std::vector<std::wstring>& vFiles)
+	{
+		//Collect relative paths of all files below a directory
+
+		WIN32_FIND_DATA sFindData = { 0 };
+
+		HANDLE hFileSearch = FindFirstFile((wszDir + L"\\" + wszRelPath + L"*.*").c_str(), &sFindData);
+		if (hFileSearch == INVALID_HANDLE_VALUE)
+			return;
+
+		do {
+			if ((!wcscmp(sFindData.cFileName, L".")) || (!wcscmp(sFindData.cFileName, L"..")))
+				continue;
+
+			if ((sFindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY) {
+				CollectFiles(wszDir, wszRelPath + sFindData.cFileName + L"\\", vFiles);
+			} else {
+				vFiles.push_back(wszRelPath + sFindData.cFileName);
+			}
+		} while (FindNextFile(hFileSearch, &sFindData));
+
+		FindClose(hFileSearch);
+	}
+
+	inline bool BuildArchive(const std::wstring& wszDir, const std::wstring& wszArchive, size_t& uiFileCount, std::wstring& wszFailedFile)
+	{
+		//Pack all files of a directory into an archive. Generated cache files next to maps are left out. The archive is
+		//written to a temporary file first, so a previous archive is kept if a file can not be read
+
+		std::vector<std::wstring> vFiles;
+		CollectFiles(wszDir, L"", vFiles);
+
+		std::vector<std::pair<std::wstring, std::wstring>> vEntries; //Normalized path and relative file path
+		for (size_t i = 0; i < vFiles.size(); i++) {
+			std::wstring wszPath = NormalizePath(vFiles[i]);
+			size_t uiExt = wszPath.find_last_of(L'.');
+			std::wstring wszExt = (uiExt != std::wstring::npos) ? wszPath.substr(uiExt) : L"";
+
+			if ((wszExt == L".mapc") || (wszExt == L".prefetch"))
+				continue;
+
+			vEntries.push_back(std::make_pair(wszPath, vFiles[i]));
+		}
+
+		std::sort(vEntries.begin(), vEntries.end());
+
+		std::wstring wszTempFile = wszArchive + L".tmp";
+
+		std::ofstream oFile(wszTempFile, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+		if (!oFile.is_open())
+			return false;
+
+		header_s sHeader = { PAK_MAGIC, PAK_VERSION, 0, 0, 0 };
+		oFile.write((const char*)&sHeader, sizeof(sHeader));
+
+		std::vector<index_entry_s> vIndex;
+		std::vector<std::wstring> vIndexPaths;
+		unsigned long long ullPos = sizeof(sHeader);
+		std::vector<char> vBuffer;
+
+		for (size_t i = 0; i < vEntries.size(); i++) {
+			std::ifstream oInput(wszDir + L"\\" + vEntries[i].second, std::ifstream::in | std::ifstream::binary);
+			if (!oInput.is_open()) {
+				wszFailedFile = vEntries[i].second;
+				oFile.close();
+				DeleteFile(wszTempFile.c_str());
+				return false;
+			}
+
+			vBuffer.assign(std::istreambuf_iterator<char>(oInput), std::istreambuf_iterator<char>());
+			oInput.close();
+
+			//Align entry so it can be used in place from the mapped view
+			unsigned long long ullPadding = (PAK_ALIGNMENT - (ullPos % PAK_ALIGNMENT)) % PAK_ALIGNMENT;
+			for (unsigned long long j = 0; j < ullPadding; j++) {
+				oFile.put(0);
+			}
+
+			ullPos += ullPadding;
+
+			index_entry_s sIndex;
+			sIndex.ullOffset = ullPos;
+			sIndex.ullSize = vBuffer.size();
+			sIndex.uiCompression = COMPRESSION_NONE;
+			sIndex.uiPathLength = (unsigned int)vEntries[i].first.length();
+			vIndex.push_back(sIndex);
+			vIndexPaths.push_back(vEntries[i].first);
+
+			if (vBuffer.size()) {
+				oFile.write(vBuffer.data(), vBuffer.size());
+			}
+
+			ullPos += vBuffer.size();
+		}
+
+		//Write index
+		sHeader.uiEntryCount = (unsigned int)vIndex.size();
+		sHeader.ullIndexOffset = ullPos;
+
+		for (size_t i = 0; i < vIndex.size(); i++) {
+			oFile.write((const char*)&vIndex[i], sizeof(index_entry_s));
+			oFile.write((const char*)vIndexPaths[i].data(), vIndexPaths[i].length() * sizeof(wchar_t));
+		}
+
+		oFile.seekp(0, std::ios::beg);
+		oFile.write((const char*)&sHeader, sizeof(sHeader));
+
+		bool bResult = oFile.good();
+		oFile.close();
+
+		if ((!bResult) || (!MoveFileEx(wszTempFile.c_str(), wszArchive.c_str(), MOVEFILE_REPLACE_EXISTING))) {
+			DeleteFile(wszTempFile.c_str());
+			return false;
+		}
+
+		uiFileCount = vIndex.size();
+
+		return true;
+	}
+}
+
+extern Pak::CArchiveSet oArchiveSet;
@@ -0,0 +1,675 @@
+#pragma once
+
+/*
+	Casual Game Engine (dnyCasualGameEngine) developed by Daniel Brendel
+
+	(C) 2021 - 2022 by Daniel Brendel
+
+	Contact: dbrendel1988<at>gmail<dot>com
+	GitHub: https://github.com/danielbrendel/
+
+	Released under the MIT license
+*/
+
+#include <unordered_map>
+#include <unordered_set>
+#include "shared.h"
+#include "utils.h"
+#include "configmgr.h"
+#include "vars.h"
+#include "renderer.h"
+#include "sound.h"
+#include "jobs.h"
+#include "pak.h"
+
+/* Per-map asset prefetching environment */
+namespace Prefetch {
+	enum asset_type_e {
+		ASSET_SOUND,
+		ASSET_SPRITE
+	};
+
+	struct asset_entry_s {
+		asset_type_e eType;
+		std::wstring wszFile;
+		int iFrameCount;
+		int iFrameWidth;
+		int iFrameHeight;
+		int iFramesPerLine;
+		bool bForceCustomSize;
+		size_t uiInstances; //Most sprite instances loaded at the same time
+	};
+
+	struct prefetched_sprite_s {
+		asset_entry_s sEntry;
+		DxRenderer::HD3DSPRITE hSprite;
+		size_t uiMemory; //Texture memory while kept in the pool
+	};
+
+	inline std::wstring GetManifestFileName(const std::wstring& wszMapFile)
+	{
+		//Get manifest file name next to the map script
+
+		size_t uiExt = wszMapFile.find_last_of(L'.');
+		if ((uiExt == std::wstring::npos) || (uiExt < wszMapFile.find_last_of(L'\\') + 1)) {
+			return wszMapFile + L".prefetch";
+		}
+
+		return wszMapFile.substr(0, uiExt) + L".prefetch";
+	}
+
+	/* Records assets first requested after a map has started and prefetches them on the next load of the map.
+	   Sprites placed by the map script itself are prefetched the same way. Released sprites stay resident in the
+	   pool for reuse across map changes as long as the pool fits into the memory budget */
+	class CAssetPrefetcher {
+	private:
+		struct read_job_s {
+			std::wstring wszFile;
+			const byte* pData; //Either owned or a view into a mapped archive
+			size_t uiSize;
+			bool bOwned;
+		};
+
+		std::wstring m_wszManifest;
+		std::vector<asset_entry_s> m_vEntries;
+		ConfigMgr::CNameIndex m_oEntryIndex; //Asset hash index of m_vEntries
+		std::vector<asset_entry_s> m_vMapSprites;
+		std::vector<asset_entry_s> m_vCreateSprites;
+		std::vector<prefetched_sprite_s> m_vSpritePool;
+		ConfigMgr::CNameIndex m_oPoolIndex; //Asset hash index of m_vSpritePool
+		std::unordered_set<DxRenderer::HD3DSPRITE> m_sPoolSprites; //Handles of m_vSpritePool
+		std::unordered_map<DxRenderer::HD3DSPRITE, prefetched_sprite_s> m_mLoanedSprites;
+		std::vector<asset_entry_s> m_vLoanCounts; //Sprites handed out per asset, stored as instances
+		ConfigMgr::CNameIndex m_oLoanIndex; //Asset hash index of m_vLoanCounts
+		std::vector<read_job_s> m_vReadJobs;
+		size_t m_uiPoolMemory;
+		size_t m_uiBudget;
+		bool m_bPrefetch;
+		bool m_bChanged;
+		bool m_bRecording;
+		size_t m_uiMidGameLoads;
+		size_t m_uiPrefetched;
+		size_t m_uiPrefetchHits;
+		size_t m_uiResidentHits;
+		double m_dblPrefetchTime;
+
+		static bool IsSameEntry(const asset_entry_s& a, const asset_entry_s& b)
+		{
+			//Check if two entries describe the same asset
+
+			if ((a.eType != b.eType) || (a.wszFile != b.wszFile))
+				return false;
+
+			if (a.eType == ASSET_SOUND)
+				return true;
+
+			return (a.iFrameCount == b.iFrameCount) && (a.iFrameWidth == b.iFrameWidth) && (a.iFrameHeight == b.iFrameHeight) && (a.iFramesPerLine == b.iFramesPerLine) && (a.bForceCustomSize == b.bForceCustomSize);
+		}
+
+		static size_t HashEntry(const asset_entry_s& rEntry)
+		{
+			//Hash the fields compared by IsSameEntry
+
+			size_t uiHash = ConfigMgr::HashName(rEntry.wszFile);
+
+			if (rEntry.eType == ASSET_SOUND)
+				return uiHash;
+
+			int aiFrameParams[5] = { rEntry.iFrameCount, rEntry.iFrameWidth, rEntry.iFrameHeight, rEntry.iFramesPerLine, (int)rEntry.bForceCustomSize };
+
+			return (size_t)Utils::HashData(aiFrameParams, sizeof(aiFrameParams), (unsigned int)uiHash);
+		}
+
+		static std::wstring ToManifestPath(const std::wstring& wszFile)
+		{
+			//Store paths relative to the base path so manifests stay valid in other installations
+
+			if ((wszFile.length() > wszBasePath.length()) && (_wcsnicmp(wszFile.c_str(), wszBasePath.c_str(), wszBasePath.length()) == 0)) {
+				return wszFile.substr(wszBasePath.length());
+			}
+
+			return wszFile;
+		}
+
+		static std::wstring FromManifestPath(const std::wstring& wszFile)
+		{
+			//Resolve relative manifest path
+
+			if ((wszFile.length() > 1) && (wszFile[1] == L':')) {
+				return wszFile;
+			}
+
+			return wszBasePath + wszFile;
+		}
+
+		static bool ParseNumber(const std::string& szToken, int& iOut)
+		{
+			//Parse non-negative decimal number. The whole token must be numeric
+
+			if ((!szToken.length()) || (szToken.length() > 9))
+				return false;
+
+			char* pEnd = nullptr;
+			long lValue = strtol(szToken.c_str(), &pEnd, 10);
+			if ((*pEnd != 0) || (lValue < 0))
+				return false;
+
+			iOut = (int)lValue;
+
+			return true;
+		}
+
+		static void ReadJob(read_job_s& rJob)
+		{
+			//Read file of a job. Packed files are used in place
+
+			if (oArchiveSet.GetFile(rJob.wszFile, rJob.pData, rJob.uiSize))
+				return;
+
+			rJob.pData = Utils::ReadEntireFile(rJob.wszFile, rJob.uiSize);
+			rJob.bOwned = rJob.pData != nullptr;
+		}
+
+		void AddReadJob(const std::wstring& wszFile)
+		{
+			//Queue file read if not yet queued
+
+			for (size_t i = 0; i < this->m_vReadJobs.size(); i++) {
+				if (this->m_vReadJobs[i].wszFile == wszFile)
+					return;
+			}
+
+			read_job_s sJob;
+			sJob.wszFile = wszFile;
+			sJob.pData = nullptr;
+			sJob.uiSize = 0;
+			sJob.bOwned = false;
+			this->m_vReadJobs.push_back(sJob);
+		}
+
+		const read_job_s* FindReadJob(const std::wstring& wszFile) const
+		{
+			//Get read job of a file
+
+			for (size_t i = 0; i < this->m_vReadJobs.size(); i++) {
+				if (this->m_vReadJobs[i].wszFile == wszFile)
+					return &this->m_vReadJobs[i];
+			}
+
+			return nullptr;
+		}
+
+		void CreatePooledSprite(const asset_entry_s& rEntry)
+		{
+			//Create sprite from read file data and keep it for the next request
+
+			const read_job_s* pJob = this->FindReadJob(rEntry.wszFile);
+			if ((!pJob) || (!pJob->pData))
+				return;
+
+			prefetched_sprite_s sPrefetched;
+			sPrefetched.sEntry = rEntry;
+			sPrefetched.hSprite = pRenderer->LoadSpriteFromMemory(rEntry.wszFile, pJob->pData, pJob->uiSize, rEntry.iFrameCount, rEntry.iFrameWidth, rEntry.iFrameHeight, rEntry.iFramesPerLine, rEntry.bForceCustomSize);
+
+			if (sPrefetched.hSprite != GFX_INVALID_SPRITE_ID) {
+				sPrefetched.uiMemory = pRenderer->GetSpriteMemory(sPrefetched.hSprite);
+				this->AddPooledSprite(sPrefetched);
+				this->m_uiPrefetched++;
+			}
+		}
+
+		void AddPooledSprite(const prefetched_sprite_s& rSprite)
+		{
+			//Keep sprite in the pool as most recently pooled item
+
+			this->m_vSpritePool.push_back(rSprite);
+			this->m_oPoolIndex.Insert(HashEntry(rSprite.sEntry), this->m_vSpritePool.size() - 1);
+			this->m_sPoolSprites.insert(rSprite.hSprite);
+			this->m_uiPoolMemory += rSprite.uiMemory;
+		}
+
+		void RemovePooledSprite(size_t uiPoolItem)
+		{
+			//Remove sprite from the pool without freeing it
+
+			this->m_uiPoolMemory -= this->m_vSpritePool[uiPoolItem].uiMemory;
+			this->m_sPoolSprites.erase(this->m_vSpritePool[uiPoolItem].hSprite);
+			this->m_oPoolIndex.Remove(uiPoolItem);
+			this->m_vSpritePool.erase(this->m_vSpritePool.begin() + uiPoolItem);
+		}
+
+		size_t AddLoan(const prefetched_sprite_s& rLoaned)
+		{
+			//Track sprite handed out by LoadSprite. Returns how many sprites of the asset are handed out now
+
+			this->m_mLoanedSprites[rLoaned.hSprite] = rLoaned;
+
+			size_t uiCount = this->m_oLoanIndex.Find(HashEntry(rLoaned.sEntry), [this, &rLoaned](size_t uiEntry) { return IsSameEntry(this->m_vLoanCounts[uiEntry], rLoaned.sEntry); });
+			if (uiCount == CM_INVALID_LIST_ID) {
+				asset_entry_s sCount = rLoaned.sEntry;
+				sCount.uiInstances = 0;
+				this->m_vLoanCounts.push_back(sCount);
+
+				uiCount = this->m_vLoanCounts.size() - 1;
+				this->m_oLoanIndex.Insert(HashEntry(sCount), uiCount);
+			}
+
+			return ++this->m_vLoanCounts[uiCount].uiInstances;
+		}
+
+		void EndLoan(const prefetched_sprite_s& rLoaned)
+		{
+			//Count sprite handed out by LoadSprite as returned
+
+			size_t uiCount = this->m_oLoanIndex.Find(HashEntry(rLoaned.sEntry), [this, &rLoaned](size_t uiEntry) { return IsSameEntry(this->m_vLoanCounts[uiEntry], rLoaned.sEntry); });
+			if ((uiCount != CM_INVALID_LIST_ID) && (this->m_vLoanCounts[uiCount].uiInstances)) {
+				this->m_vLoanCounts[uiCount].uiInstances--;
+			}
+		}
+
+		void RequestSprite(const asset_entry_s& rEntry, std::vector<bool>& vClaimed)
+		{
+			//Claim a resident sprite for an upcoming request or queue its creation
+
+			size_t uiPoolItem = this->m_oPoolIndex.Find(HashEntry(rEntry), [this, &rEntry, &vClaimed](size_t uiEntry) { return (!vClaimed[uiEntry]) && (IsSameEntry(this->m_vSpritePool[uiEntry].sEntry, rEntry)); });
+			if (uiPoolItem != CM_INVALID_LIST_ID) {
+				vClaimed[uiPoolItem] = true;
+				this->m_uiResidentHits++;
+				return;
+			}
+
+			this->m_vCreateSprites.push_back(rEntry);
+			this->AddReadJob(rEntry.wszFile);
+		}
+
+		void FreePooledSprite(size_t uiPoolItem)
+		{
+			//Free texture of a pooled sprite
+
+			pRenderer->FreeSprite(this->m_vSpritePool[uiPoolItem].hSprite);
+			this->RemovePooledSprite(uiPoolItem);
+		}
+
+		void Trim(void)
+		{
+			//Free least recently pooled sprites until the pool fits into the budget. Without budget the pool is emptied
+
+			while ((this->m_vSpritePool.size()) && ((!this->m_uiBudget) || (this->m_uiPoolMemory > this->m_uiBudget))) {
+				this->FreePooledSprite(0);
+			}
+		}
+
+		void FreeReadJobs(void)
+		{
+			//Free read file data
+
+			for (size_t i = 0; i < this->m_vReadJobs.size(); i++) {
+				if (this->m_vReadJobs[i].bOwned) {
+					free((void*)this->m_vReadJobs[i].pData);
+				}
+			}
+
+			this->m_vReadJobs.clear();
+		}
+
+		bool LoadManifest(void)
+		{
+			//Load manifest entries. Malformed lines are skipped
+
+			std::ifstream oFile(Utils::ConvertToAnsiString(this->m_wszManifest), std::ifstream::in);
+			if (!oFile.is_open())
+				return false;
+
+			std::string szLine;
+			while (std::getline(oFile, szLine)) {
+				std::vector<std::string> vTokens = Utils::Split(szLine, " ");
+				if (vTokens.size() < 2)
+					continue;
+
+				asset_entry_s sEntry;
+				sEntry.iFrameCount = sEntry.iFrameWidth = sEntry.iFrameHeight = sEntry.iFramesPerLine = 0;
+				sEntry.bForceCustomSize = false;
+				sEntry.uiInstances = 1;
+
+				size_t uiPathToken;
+
+				if (vTokens[0] == "sound") {
+					sEntry.eType = ASSET_SOUND;
+					uiPathToken = 1;
+				} else if ((vTokens[0] == "sprite") && (vTokens.size() >= 8)) {
+					int iInstances;
+
+					if ((!ParseNumber(vTokens[1], sEntry.iFrameCount)) || (!ParseNumber(vTokens[2], sEntry.iFrameWidth)) || (!ParseNumber(vTokens[3], sEntry.iFrameHeight)) || (!ParseNumber(vTokens[4], sEntry.iFramesPerLine)) || ((vTokens[5] != "0") && (vTokens[5] != "1")) || (!ParseNumber(vTokens[6], iInstances)) || (iInstances < 1))
+						continue;
+
+					sEntry.eType = ASSET_SPRITE;
+					sEntry.bForceCustomSize = vTokens[5] == "1";
+					sEntry.uiInstances = (size_t)iInstances;
+					uiPathToken = 7;
+				} else {
+					continue;
+				}
+
+				//Path is the remainder of the line and may contain spaces
+				std::string szPath = vTokens[uiPathToken];
+				for (size_t i = uiPathToken + 1; i < vTokens.size(); i++) {
+					szPath += " " + vTokens[i];
+				}
+
+				sEntry.wszFile = FromManifestPath(Utils::ConvertToWideString(szPath));
+
+				this->m_vEntries.push_back(sEntry);
+				this->m_oEntryIndex.Insert(HashEntry(sEntry), this->m_vEntries.size() - 1);
+			}
+
+			oFile.close();
+
+			return true;
+		}
+
+		bool SaveManifest(void)
+		{
+			//Write manifest entries
+
+			std::ofstream oFile(Utils::ConvertToAnsiString(this->m_wszManifest), std::ofstream::out | std::ofstream::trunc);
+			if (!oFile.is_open())
+				return false;
+
+			std::ostringstream oss;
+
+			for (size_t i = 0; i < this->m_vEntries.size(); i++) {
+				const asset_entry_s& rEntry = this->m_vEntries[i];
+
+				if (rEntry.eType == ASSET_SOUND) {
+					oss << "sound ";
+				} else {
+					oss << "sprite " << rEntry.iFrameCount << " " << rEntry.iFrameWidth << " " << rEntry.iFrameHeight << " " << rEntry.iFramesPerLine << " " << rEntry.bForceCustomSize << " " << rEntry.uiInstances << " ";
+				}
+
+				oss << Utils::ConvertToAnsiString(ToManifestPath(rEntry.wszFile)) << "\n";
+			}
+
+			std::string szContent = oss.str();
+			oFile.write(szContent.c_str(), szContent.length());
+			oFile.close();
+
+			return true;
+		}
+
+		void AddEntry(const asset_entry_s& sEntry)
+		{
+			//Add asset to manifest or raise its instance count. Only loads which change the manifest are counted as
+			//mid-game loads, so the counter drops to zero once the manifest covers the map
+
+			if (!this->m_bRecording)
+				return;
+
+			size_t uiHash = HashEntry(sEntry);
+
+			size_t uiEntry = this->m_oEntryIndex.Find(uiHash, [this, &sEntry](size_t uiItem) { return IsSameEntry(this->m_vEntries[uiItem], sEntry); });
+			if (uiEntry != CM_INVALID_LIST_ID) {
+				if (sEntry.uiInstances > this->m_vEntries[uiEntry].uiInstances) {
+					this->m_vEntries[uiEntry].uiInstances = sEntry.uiInstances;
+					this->m_uiMidGameLoads++;
+					this->m_bChanged = true;
+				}
+
+				return;
+			}
+
+			this->m_vEntries.push_back(sEntry);
+			this->m_oEntryIndex.Insert(uiHash, this->m_vEntries.size() - 1);
+			this->m_uiMidGameLoads++;
+			this->m_bChanged = true;
+		}
+	public:
+		CAssetPrefetcher() : m_uiPoolMemory(0), m_uiBudget(0), m_bPrefetch(false), m_bChanged(false), m_bRecording(false), m_uiMidGameLoads(0), m_uiPrefetched(0), m_uiPrefetchHits(0), m_uiResidentHits(0), m_dblPrefetchTime(0.0) {}
+		~CAssetPrefetcher() {}
+
+		void BeginMap(const std::wstring& wszMapFile, bool bPrefetch)
+		{
+			//Finish previous map and load the manifest of the new map. Prefetching is started by QueueJobs
+
+			this->EndMap();
+
+			this->m_wszManifest = GetManifestFileName(wszMapFile);
+			this->m_uiMidGameLoads = 0;
+			this->m_uiPrefetched = 0;
+			this->m_uiPrefetchHits = 0;
+			this->m_uiResidentHits = 0;
+			this->m_dblPrefetchTime = 0.0;
+
+			this->m_bPrefetch = (bPrefetch) && (this->LoadManifest());
+		}
+
+		void AddMapSprite(const std::wstring& wszFile, int iFrameCount, int iFrameWidth, int iFrameHeight, int iFramesPerLine, bool bForceCustomSize)
+		{
+			//Add sprite which the map script is going to load
+
+			asset_entry_s sEntry;
+			sEntry.eType = ASSET_SPRITE;
+			sEntry.wszFile = wszFile;
+			sEntry.iFrameCount = iFrameCount;
+			sEntry.iFrameWidth = iFrameWidth;
+			sEntry.iFrameHeight = iFrameHeight;
+			sEntry.iFramesPerLine = iFramesPerLine;
+			sEntry.bForceCustomSize = bForceCustomSize;
+			sEntry.uiInstances = 1;
+
+			this->m_vMapSprites.push_back(sEntry);
+		}
+
+		size_t QueueJobs(Jobs::CJobSystem& rJobs)
+		{
+			//Read sprite files and decode sounds on the job system. Returns the amount of submitted jobs
+
+			LONGLONG lFrequency, lStart, lEnd;
+			QueryPerformanceFrequency((LARGE_INTEGER*)&lFrequency);
+			QueryPerformanceCounter((LARGE_INTEGER*)&lStart);
+
+			std::vector<std::wstring> vSounds;
+			std::vector<bool> vClaimed(this->m_vSpritePool.size(), false);
+
+			//Only sprites which are not resident from earlier maps are created
+			if (this->m_bPrefetch) {
+				for (size_t i = 0; i < this->m_vEntries.size(); i++) {
+					if (this->m_vEntries[i].eType == ASSET_SOUND) {
+						vSounds.push_back(this->m_vEntries[i].wszFile);
+					} else {
+						for (size_t j = 0; j < this->m_vEntries[i].uiInstances; j++) {
+							this->RequestSprite(this->m_vEntries[i], vClaimed);
+						}
+					}
+				}
+			}
+
+			for (size_t i = 0; i < this->m_vMapSprites.size(); i++) {
+				this->RequestSprite(this->m_vMapSprites[i], vClaimed);
+			}
+
+			this->m_vMapSprites.clear();
+
+			size_t uiSoundJobs = pSound->BeginPreload(vSounds);
+
+			//Job lists are not resized until Upload, so the jobs can refer to their elements
+			for (size_t i = 0; i < this->m_vReadJobs.size(); i++) {
+				read_job_s* pJob = &this->m_vReadJobs[i];
+				rJobs.Submit([pJob]() { ReadJob(*pJob); });
+			}
+
+			for (size_t i = 0; i < uiSoundJobs; i++) {
+				rJobs.Submit([i]() { pSound->DecodePreloadJob(i); });
+			}
+
+			QueryPerformanceCounter((LARGE_INTEGER*)&lEnd);
+			this->m_dblPrefetchTime = (double)(lEnd - lStart) * 1000.0 / (double)lFrequency;
+
+			return this->m_vReadJobs.size() + uiSoundJobs;
+		}
+
+		void Upload(void)
+		{
+			//Create sounds and sprites from the finished jobs on this thread. All queued jobs must be done
+
+			LONGLONG lFrequency, lStart, lEnd;
+			QueryPerformanceFrequency((LARGE_INTEGER*)&lFrequency);
+			QueryPerformanceCounter((LARGE_INTEGER*)&lStart);
+
+			this->m_uiPrefetched += pSound->EndPreload();
+
+			//Create sprites in manifest order, then one per placement of the map
+			for (size_t i = 0; i < this->m_vCreateSprites.size(); i++) {
+				this->CreatePooledSprite(this->m_vCreateSprites[i]);
+			}
+
+			this->m_vCreateSprites.clear();
+			this->FreeReadJobs();
+
+			QueryPerformanceCounter((LARGE_INTEGER*)&lEnd);
+			this->m_dblPrefetchTime += (double)(lEnd - lStart) * 1000.0 / (double)lFrequency;
+		}
+
+		void StartRecording(void)
+		{
+			//Map loading is done, assets requested from now on are mid-game loads
+
+			if (this->m_wszManifest.length()) {
+				this->m_bRecording = true;
+			}
+		}
+
+		void EndMap(void)
+		{
+			//Write manifest if new assets were recorded. Pooled sprites are kept as far as the budget allows
+
+			if ((this->m_bChanged) && (this->m_wszManifest.length())) {
+				this->SaveManifest();
+			}
+
+			this->Trim();
+
+			this->m_vEntries.clear();
+			this->m_oEntryIndex.Clear();
+			this->m_vMapSprites.clear();
+			this->m_vCreateSprites.clear();
+			this->FreeReadJobs();
+			this->m_bPrefetch = false;
+			this->m_bChanged = false;
+			this->m_bRecording = false;
+		}
+
+		void OnQuerySound(const std::wstring& wszFile)
+		{
+			//Record sound which is about to be loaded
+
+			if ((!this->m_bRecording) || (pSound->IsSoundLoaded(wszFile)))
+				return;
+
+			asset_entry_s sEntry;
+			sEntry.eType = ASSET_SOUND;
+			sEntry.wszFile = wszFile;
+			sEntry.iFrameCount = sEntry.iFrameWidth = sEntry.iFrameHeight = sEntry.iFramesPerLine = 0;
+			sEntry.bForceCustomSize = false;
+			sEntry.uiInstances = 1;
+
+			this->AddEntry(sEntry);
+		}
+
+		DxRenderer::HD3DSPRITE LoadSprite(const std::wstring& wszFile, int iFrameCount, int iFrameWidth, int iFrameHeight, int iFramesPerLine, bool bForceCustomSize)
+		{
+			//Hand out prefetched sprite or load and record it. Each instance of a sprite uses its own pool entry, so the
+			//manifest stores how many instances were loaded at the same time
+
+			asset_entry_s sEntry;
+			sEntry.eType = ASSET_SPRITE;
+			sEntry.wszFile = wszFile;
+			sEntry.iFrameCount = iFrameCount;
+			sEntry.iFrameWidth = iFrameWidth;
+			sEntry.iFrameHeight = iFrameHeight;
+			sEntry.iFramesPerLine = iFramesPerLine;
+			sEntry.bForceCustomSize = bForceCustomSize;
+			sEntry.uiInstances = 1;
+
+			prefetched_sprite_s sLoaned;
+			sLoaned.sEntry = sEntry;
+			sLoaned.uiMemory = 0;
+
+			size_t uiPoolItem = this->m_oPoolIndex.Find(HashEntry(sEntry), [this, &sEntry](size_t uiEntry) { return IsSameEntry(this->m_vSpritePool[uiEntry].sEntry, sEntry); });
+			if (uiPoolItem != CM_INVALID_LIST_ID) {
+				sLoaned.hSprite = this->m_vSpritePool[uiPoolItem].hSprite;
+				this->RemovePooledSprite(uiPoolItem);
+				this->AddLoan(sLoaned);
+				this->m_uiPrefetchHits++;
+				return sLoaned.hSprite;
+			}
+
+			sLoaned.hSprite = pRenderer->LoadSprite(wszFile, iFrameCount, iFrameWidth, iFrameHeight, iFramesPerLine, bForceCustomSize);
+
+			if (sLoaned.hSprite != GFX_INVALID_SPRITE_ID) {
+				sEntry.uiInstances = this->AddLoan(sLoaned);
+
+				this->AddEntry(sEntry);
+			}
+
+			return sLoaned.hSprite;
+		}
+
+		bool ReleaseSprite(DxRenderer::HD3DSPRITE hSprite)
+		{
+			//Return sprite handed out by LoadSprite to the pool. Other sprites are freed
+
+			if (this->m_sPoolSprites.count(hSprite))
+				return true;
+
+			std::unordered_map<DxRenderer::HD3DSPRITE, prefetched_sprite_s>::iterator it = this->m_mLoanedSprites.find(hSprite);
+			if (it != this->m_mLoanedSprites.end()) {
+				prefetched_sprite_s sPooled = it->second;
+				this->m_mLoanedSprites.erase(it);
+				this->EndLoan(sPooled);
+
+				if (this->m_uiBudget) {
+					sPooled.uiMemory = pRenderer->GetSpriteMemory(hSprite);
+					this->AddPooledSprite(sPooled);
+
+					this->Trim();
+
+					return true;
+				}
+			}
+
+			return pRenderer->FreeSprite(hSprite);
+		}
+
+		void SetBudget(size_t uiBytes)
+		{
+			//Set memory budget of the sprite pool
+
+			this->m_uiBudget = uiBytes;
+			this->Trim();
+		}
+
+		void FlushResident(void)
+		{
+			//Free all pooled sprites, e.g. when another package is loaded
+
+			while (this->m_vSpritePool.size()) {
+				this->FreePooledSprite(this->m_vSpritePool.size() - 1);
+			}
+
+			this->m_mLoanedSprites.clear();
+			this->m_vLoanCounts.clear();
+			this->m_oLoanIndex.Clear();
+		}
+
+		//Getters
+		const std::wstring& GetManifestFile(void) const { return this->m_wszManifest; }
+		size_t GetManifestSize(void) const { return this->m_vEntries.size(); }
+		size_t GetMidGameLoads(void) const { return this->m_uiMidGameLoads; }
+		size_t GetPrefetched(void) const { return this->m_uiPrefetched; }
+		size_t GetPrefetchHits(void) const { return this->m_uiPrefetchHits; }
+		size_t GetUnusedSprites(void) const { return this->m_vSpritePool.size(); }
+		size_t GetPoolMemory(void) const { return this->m_uiPoolMemory; }
+		size_t GetResidentHits(void) const { return this->m_uiResidentHits; }
+		double GetPrefetchTime(void) const { return this->m_dblPrefetchTime; }
+	};
+}
@@ -16,6 +16,7 @@
 #include <d3dx9core.h>
 #include <DxErr.h>
 #include "utils.h"
+#include "vfs.h"
 
 /* Renderer management component */
 namespace DxRenderer {
@@ -384,10 +385,29 @@ namespace DxRenderer {
 				return hExists;
 			}*/
 
-			d3dsprite_s sSpriteData;	
+			//Read through the file system, which serves packed files and answers missing package files without probing the disk
+			Vfs::file_view_s sView;
+			if (!oFileSystem.MapFile(wszTexture, sView))
+				return GFX_INVALID_SPRITE_ID;
+
+			HD3DSPRITE hSprite = this->LoadSpriteFromMemory(wszTexture, sView.pData, sView.uiSize, iFrameCount, iFrameWidth, iFrameHeight, iFramesPerLine, bForceCustomSize);
+
+			Vfs::CFileSystem::ReleaseView(sView);
+
+			return hSprite;
+		}
+
+		HD3DSPRITE LoadSpriteFromMemory(const std::wstring& wszTexture, const void* pData, size_t uiSize, int iFrameCount, int iFrameWidth, int iFrameHeight, int iFramesPerLine, const bool bForceCustomSize = false)
+		{
+			//Load sprite from file data which has already been read into memory
 
-			//Load texture from file
-			if (FAILED(D3DXCreateTextureFromFileEx(this->m_pDevice, wszTexture.c_str(), (bForceCustomSize) ? iFrameWidth : D3DX_DEFAULT_NONPOW2, (bForceCustomSize) ? iFrameHeight : D3DX_DEFAULT_NONPOW2, D3DX_DEFAULT, 0, D3DFMT_FROM_FILE, D3DPOOL_DEFAULT, D3DX_DEFAULT, D3DX_DEFAULT, 0xFF000000, nullptr, nullptr, &sSpriteData.pTexture))) {
+			if ((!wszTexture.length()) || (!pData) || (!uiSize))
+				return GFX_INVALID_SPRITE_ID;
+
+			d3dsprite_s sSpriteData;
+
+			//Load texture from memory
+			if (FAILED(D3DXCreateTextureFromFileInMemoryEx(this->m_pDevice, pData, (UINT)uiSize, (bForceCustomSize) ? iFrameWidth : D3DX_DEFAULT_NONPOW2, (bForceCustomSize) ? iFrameHeight : D3DX_DEFAULT_NONPOW2, D3DX_DEFAULT, 0, D3DFMT_FROM_FILE, D3DPOOL_DEFAULT, D3DX_DEFAULT, D3DX_DEFAULT, 0xFF000000, nullptr, nullptr, &sSpriteData.pTexture))) {
 				return GFX_INVALID_SPRITE_ID;
 			}
 
@@ -427,11 +447,37 @@ namespace DxRenderer {
 			return true;
 		}
 
+		size_t GetSpriteMemory(const HD3DSPRITE hSprite)
+		{
+			//Estimate texture memory of the sprite over all mip levels
+
+			if (!hSprite)
+				return 0;
+
+			size_t uiMemory = 0;
+
+			for (DWORD i = 0; i < hSprite->GetLevelCount(); i++) {
+				D3DSURFACE_DESC sDesc;
+				if (SUCCEEDED(hSprite->GetLevelDesc(i, &sDesc))) {
+					uiMemory += (size_t)sDesc.Width * sDesc.Height * 4;
+				}
+			}
+
+			return uiMemory;
+		}
+
 		bool DrawString(const d3dfont_s* pFont, const std::wstring& wszText, int x, int y, BYTE r, BYTE g, BYTE b, BYTE a)
 		{
 			//Draw a string on backbuffer
 
-			if ((!this->m_pDevice) || (!wszText.length()) || (!pFont))
+			return this->DrawString(pFont, wszText.c_str(), wszText.length(), x, y, r, g, b, a);
+		}
+
+		bool DrawString(const d3dfont_s* pFont, const wchar_t* pszText, size_t uiLength, int x, int y, BYTE r, BYTE g, BYTE b, BYTE a)
+		{
+			//Draw a string of the given length which does not need to be zero terminated
+
+			if ((!this->m_pDevice) || (!pszText) || (!uiLength) || (!pFont))
 				return false;
 
 			//End drawing sprites
@@ -443,7 +489,7 @@ namespace DxRenderer {
 			D3DCOLOR d3dcColor = D3DCOLOR_ARGB(a, r, g, b);
 
 			//Calculate font rect
-			INT iResult = pFont->pFont->DrawText(nullptr, wszText.c_str(), (int)wszText.length(), &rect, DT_NOCLIP, d3dcColor);
+			INT iResult = pFont->pFont->DrawText(nullptr, pszText, (int)uiLength, &rect, DT_NOCLIP, d3dcColor);
 
 			//Begin drawing sprites
 			if (FAILED(this->m_pSpriteMgr->Begin(D3DXSPRITE_ALPHABLEND)))
@@ -693,18 +739,28 @@ namespace DxRenderer {
 			}
 			else { //Create new surface with picture
 				D3DXIMAGE_INFO d3dimgInfo;
+				Vfs::file_view_s sView;
+				if (!oFileSystem.MapFile(wszPictureFile, sView)) //Read through the file system
+					return false;
 
-				if (FAILED(D3DXGetImageInfoFromFile(wszPictureFile.c_str(), &d3dimgInfo))) //Get image info
+				if (FAILED(D3DXGetImageInfoFromFileInMemory(sView.pData, (UINT)sView.uiSize, &d3dimgInfo))) { //Get image info
+					Vfs::CFileSystem::ReleaseView(sView);
 					return false;
+				}
 				
-				if (FAILED(this->m_pDevice->CreateOffscreenPlainSurface(this->GetWindowWidth(), this->GetWindowHeight(), D3DFMT_X8R8G8B8, D3DPOOL_DEFAULT, &this->m_pImageSurface, nullptr))) //Create surface for image
+				if (FAILED(this->m_pDevice->CreateOffscreenPlainSurface(this->GetWindowWidth(), this->GetWindowHeight(), D3DFMT_X8R8G8B8, D3DPOOL_DEFAULT, &this->m_pImageSurface, nullptr))) { //Create surface for image
+					Vfs::CFileSystem::ReleaseView(sView);
 					return false;
+				}
 				
-				if (FAILED(D3DXLoadSurfaceFromFile(this->m_pImageSurface, nullptr, nullptr, wszPictureFile.c_str(), nullptr, D3DX_DEFAULT, 0, &d3dimgInfo))) { //Load image into surface
+				if (FAILED(D3DXLoadSurfaceFromFileInMemory(this->m_pImageSurface, nullptr, nullptr, sView.pData, (UINT)sView.uiSize, nullptr, D3DX_DEFAULT, 0, &d3dimgInfo))) { //Load image into surface
 					this->m_pImageSurface->Release();
 					this->m_pImageSurface = nullptr;
+					Vfs::CFileSystem::ReleaseView(sView);
 					return false;
 				}
+
+				Vfs::CFileSystem::ReleaseView(sView);
 			}
 
 			return true;
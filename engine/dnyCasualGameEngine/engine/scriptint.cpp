@@ -4,6 +4,7 @@
 #include "utils.h"
 #include "vars.h"
 #include "game.h"
+#include "vfs.h"
 
 /*
 	Casual Game Engine (dnyCasualGameEngine) developed by Daniel Brendel
@@ -79,9 +80,14 @@ namespace Scripting {
 
 		//Unload scripts
 		for (size_t i = 0; i < this->m_vScripts.size(); i++) {
-			this->UnloadScript(i);
+			if (this->m_vScripts[i].pModule) {
+				this->UnloadScript((this->m_vScripts[i].uiGeneration << SI_SCRIPT_SLOT_BITS) | i);
+			}
 		}
 
+		this->m_vScripts.clear();
+		this->m_vFreeScriptSlots.clear();
+
 		//Shutdown AngelScript
 		if (this->m_pScriptEngine) {
 			this->m_pScriptEngine->ShutDownAndRelease();
@@ -109,24 +115,62 @@ namespace Scripting {
 			return SI_INVALID_ID;
 		
 		//Add script file to module
-		if (AS_FAILED(oScriptBuilder.AddSectionFromFile((/*this->m_szScriptPath +*/ szScriptName).c_str())))
+		if (AS_FAILED(ScriptInt_AddSection(&oScriptBuilder, /*this->m_szScriptPath +*/ szScriptName)))
 			return SI_INVALID_ID;
 		
 		//Build script module
 		if (AS_FAILED(oScriptBuilder.BuildModule()))
 			return SI_INVALID_ID;
 		
-		//Setup struct
-		si_script_s sScriptData;
-		sScriptData.szName = szScriptName;
-		sScriptData.pModule = this->m_pScriptEngine->GetModule(szScriptName.c_str()); //Get pointer to script module
-		if (!sScriptData.pModule)
+		//Get pointer to script module
+		asIScriptModule* pModule = this->m_pScriptEngine->GetModule(szScriptName.c_str());
+		if (!pModule)
 			return SI_INVALID_ID;
-		
-		//Add to list
-		this->m_vScripts.push_back(sScriptData);
 
-		return this->m_vScripts.size() - 1; //Return entry ID
+		//Reuse slot of an unloaded script or add a new one
+		size_t uiSlot;
+		if (this->m_vFreeScriptSlots.size()) {
+			uiSlot = this->m_vFreeScriptSlots.back();
+			this->m_vFreeScriptSlots.pop_back();
+		} else {
+			if (this->m_vScripts.size() > SI_SCRIPT_SLOT_MASK) {
+				this->m_pScriptEngine->DiscardModule(szScriptName.c_str());
+				return SI_INVALID_ID;
+			}
+
+			si_script_s sScriptData;
+			sScriptData.pModule = nullptr;
+			sScriptData.uiGeneration = 1;
+			this->m_vScripts.push_back(sScriptData);
+			uiSlot = this->m_vScripts.size() - 1;
+		}
+
+		this->m_vScripts[uiSlot].szName = szScriptName;
+		this->m_vScripts[uiSlot].pModule = pModule;
+
+		//Flag trivial methods of script classes
+		this->AnalyzeModule(pModule);
+
+		//Return handle made of slot and generation
+		return (this->m_vScripts[uiSlot].uiGeneration << SI_SCRIPT_SLOT_BITS) | uiSlot;
+	}
+
+	si_script_s* CScriptInt::GetScript(const HSISCRIPT hScript)
+	{
+		//Get script data of handle. Fails for handles of unloaded scripts even if their slot has been reused
+
+		if (hScript == SI_INVALID_ID)
+			return nullptr;
+
+		size_t uiSlot = hScript & SI_SCRIPT_SLOT_MASK;
+		if (uiSlot >= this->m_vScripts.size())
+			return nullptr;
+
+		si_script_s* pScript = &this->m_vScripts[uiSlot];
+		if ((!pScript->pModule) || (pScript->uiGeneration != (hScript >> SI_SCRIPT_SLOT_BITS)))
+			return nullptr;
+
+		return pScript;
 	}
 
 	bool CScriptInt::UnloadScript(const HSISCRIPT hScript)
@@ -137,20 +181,42 @@ namespace Scripting {
 			return false;
 
 		//Validate script handle
-		if ((hScript == SI_INVALID_ID) || (hScript >= this->m_vScripts.size()))
+		si_script_s* pScript = this->GetScript(hScript);
+		if (!pScript)
 			return false;
 
+		//Forget about method traits of module
+		this->DiscardModuleTraits(pScript->pModule);
+
 		//Discard module object
-		this->m_vScripts[hScript].pModule->Discard();
+		pScript->pModule->Discard();
 
 		//Unregister from AngelScript
-		this->m_pScriptEngine->DiscardModule(this->m_vScripts[hScript].szName.c_str());
+		this->m_pScriptEngine->DiscardModule(pScript->szName.c_str());
 
-		//Remove from list
-		this->m_vScripts.erase(this->m_vScripts.begin() + hScript);
+		//Free slot. Handles of other scripts stay valid
+		pScript->pModule = nullptr;
+		pScript->szName.clear();
+		pScript->uiGeneration = (pScript->uiGeneration < SI_SCRIPT_MAX_GENERATION) ? pScript->uiGeneration + 1 : 1;
+		this->m_vFreeScriptSlots.push_back(hScript & SI_SCRIPT_SLOT_MASK);
 
 		return true;
 	}
+
+	bool CScriptInt::ResetScript(const HSISCRIPT hScript)
+	{
+		//Reinitialize global variables of a script while keeping it compiled
+
+		if (!this->m_bInitialized)
+			return false;
+
+		//Validate script handle
+		si_script_s* pScript = this->GetScript(hScript);
+		if (!pScript)
+			return false;
+
+		return pScript->pModule->ResetGlobalVars() >= 0;
+	}
 	
 	bool CScriptInt::CallScriptFunction(const HSISCRIPT hScript, const bool bIsName, const std::string& szFunctionNameOrDeclaration, const std::vector<si_func_arg>* pArgs, void* pResult, func_args_e eResultType)
 	{
@@ -160,16 +226,17 @@ namespace Scripting {
 			return false;
 
 		//Validate script handle
-		if ((hScript == SI_INVALID_ID) || (hScript >= this->m_vScripts.size()))
+		si_script_s* pScript = this->GetScript(hScript);
+		if (!pScript)
 			return false;
 		
 		//Get function by declaration
-		asIScriptFunction* pFunction = (bIsName) ? this->m_vScripts[hScript].pModule->GetFunctionByName(szFunctionNameOrDeclaration.c_str()) : this->m_vScripts[hScript].pModule->GetFunctionByDecl(szFunctionNameOrDeclaration.c_str());
+		asIScriptFunction* pFunction = (bIsName) ? pScript->pModule->GetFunctionByName(szFunctionNameOrDeclaration.c_str()) : pScript->pModule->GetFunctionByDecl(szFunctionNameOrDeclaration.c_str());
 		if (!pFunction)
 			return false;
 		
 		//Create calling context
-		asIScriptContext* pContext = this->m_pScriptEngine->CreateContext();
+		asIScriptContext* pContext = this->CreateContext();
 		if (!pContext)
 			return false;
 		
@@ -287,7 +354,7 @@ namespace Scripting {
 			return false;
 
 		//Create calling context
-		asIScriptContext* pContext = this->m_pScriptEngine->CreateContext();
+		asIScriptContext* pContext = this->CreateContext();
 		if (!pContext)
 			return false;
 
@@ -399,11 +466,12 @@ namespace Scripting {
 			return false;
 
 		//Validate script handle
-		if ((hScript == SI_INVALID_ID) || (hScript >= this->m_vScripts.size()))
+		si_script_s* pScript = this->GetScript(hScript);
+		if (!pScript)
 			return false;
 
 		//Get function by name
-		asIScriptFunction* pFunction = this->m_vScripts[hScript].pModule->GetFunctionByName(szFunctionName.c_str());
+		asIScriptFunction* pFunction = pScript->pModule->GetFunctionByName(szFunctionName.c_str());
 
 		return pFunction != nullptr;
 	}
@@ -609,7 +677,7 @@ namespace Scripting {
 		if (!szClassName.length())
 			return nullptr;
 
-		if (hScript >= this->m_vScripts.size())
+		if (!this->GetScript(hScript))
 			return nullptr;
 
 		//Get type info
@@ -625,7 +693,7 @@ namespace Scripting {
 		}
 
 		//Create calling context
-		asIScriptContext* pContext = this->m_pScriptEngine->CreateContext();
+		asIScriptContext* pContext = this->CreateContext();
 		if (!pContext) {
 			pTypeInfo->Release();
 			return nullptr;
@@ -648,6 +716,24 @@ namespace Scripting {
 		return pObject;
 	}
 
+	asIScriptObject* CScriptInt::CreateScriptObject(const HSISCRIPT hScript, const std::string& szClassName)
+	{
+		//Create instance of a class declared in the module of the script via its default constructor
+
+		if (!szClassName.length())
+			return nullptr;
+
+		si_script_s* pScript = this->GetScript(hScript);
+		if (!pScript)
+			return nullptr;
+
+		asITypeInfo* pTypeInfo = pScript->pModule->GetTypeInfoByName(szClassName.c_str());
+		if (!pTypeInfo)
+			return nullptr;
+
+		return (asIScriptObject*)this->m_pScriptEngine->CreateScriptObject(pTypeInfo);
+	}
+
 	bool CScriptInt::CallScriptMethod(const HSISCRIPT hScript, asIScriptObject* pClassInstance, const std::string& szMethodDef, const std::vector<si_func_arg>* pArgs, void* pResult, func_args_e eResultType)
 	{
 		if (!this->m_bInitialized)
@@ -659,7 +745,7 @@ namespace Scripting {
 		__try {
 
 			//Create calling context
-			asIScriptContext* pContext = this->m_pScriptEngine->CreateContext();
+			asIScriptContext* pContext = this->CreateContext();
 			if (!pContext)
 				return false;
 
@@ -789,6 +875,169 @@ namespace Scripting {
 		}
 	}
 
+	asIScriptContext* CScriptInt::CreateContext(void)
+	{
+		//Create calling context bound to the active world
+
+		asIScriptContext* pContext = this->m_pScriptEngine->CreateContext();
+		if (pContext) {
+			pContext->SetUserData(Entity::GetActiveWorld(), SI_USERDATA_WORLD);
+		}
+
+		return pContext;
+	}
+
+	si_func_trait_s CScriptInt::QueryMethodTrait(asIScriptObject* pClassInstance, const std::string& szMethodDef)
+	{
+		//Query trait of a class method. Regular methods are not stored, so they are returned as FT_REGULAR
+
+		si_func_trait_s sResult;
+		sResult.pFunction = nullptr;
+		sResult.eTrait = FT_REGULAR;
+		sResult.dwConstant = 0;
+
+		if ((!this->m_bInitialized) || (!pClassInstance))
+			return sResult;
+
+		//Query class method
+		asITypeInfo* pTypeInfo = pClassInstance->GetObjectType();
+		if (!pTypeInfo)
+			return sResult;
+
+		//Resolve the actual implementation, not the virtual dispatch stub
+		sResult.pFunction = pTypeInfo->GetMethodByDecl(szMethodDef.c_str(), false);
+		if (!sResult.pFunction)
+			return sResult;
+
+		//Search in flagged methods
+		std::unordered_map<asIScriptFunction*, si_func_trait_s>::const_iterator it = this->m_mFuncTraits.find(sResult.pFunction);
+		if (it != this->m_mFuncTraits.end())
+			return it->second;
+
+		return sResult;
+	}
+
+	void CScriptInt::AnalyzeModule(asIScriptModule* pModule)
+	{
+		//Inspect bytecode of all script class methods of the module
+
+		for (asUINT i = 0; i < pModule->GetObjectTypeCount(); i++) {
+			asITypeInfo* pTypeInfo = pModule->GetObjectTypeByIndex(i);
+			if (!pTypeInfo)
+				continue;
+
+			for (asUINT j = 0; j < pTypeInfo->GetMethodCount(); j++) {
+				si_func_trait_s sTrait;
+
+				//Only store methods which can be skipped or short-circuited. Script methods are virtual, so the
+				//real function has to be queried instead of the dispatch stub
+				if (this->AnalyzeFunction(pTypeInfo->GetMethodByIndex(j, false), sTrait)) {
+					this->m_mFuncTraits[sTrait.pFunction] = sTrait;
+				}
+			}
+		}
+	}
+
+	void CScriptInt::DiscardModuleTraits(asIScriptModule* pModule)
+	{
+		//Remove all method traits belonging to the module
+
+		std::unordered_map<asIScriptFunction*, si_func_trait_s>::iterator it = this->m_mFuncTraits.begin();
+		while (it != this->m_mFuncTraits.end()) {
+			if (it->second.pFunction->GetModule() == pModule) {
+				it = this->m_mFuncTraits.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	bool CScriptInt::AnalyzeFunction(asIScriptFunction* pFunction, si_func_trait_s& rTrait)
+	{
+		//Check if a script function is trivially empty or returns a constant value.
+		//Only straight-line code consisting of line cues, variable constants and the return is accepted
+
+		if ((!pFunction) || (pFunction->GetFuncType() != asFUNC_SCRIPT))
+			return false;
+
+		asUINT uiLength = 0;
+		asDWORD* pByteCode = pFunction->GetByteCode(&uiLength);
+		if ((!pByteCode) || (!uiLength))
+			return false;
+
+		const int C_MAX_VARS = 8;
+		short aVarOffsets[C_MAX_VARS];
+		asDWORD aVarValues[C_MAX_VARS];
+		int iVarCount = 0;
+		bool bRegisterSet = false;
+		asDWORD dwRegister = 0;
+
+		asUINT uiPos = 0;
+		while (uiPos < uiLength) {
+			asDWORD* pInstr = &pByteCode[uiPos];
+			asEBCInstr eInstr = (asEBCInstr)*(asBYTE*)pInstr;
+			asUINT uiSize = (asUINT)asBCTypeSize[asBCInfo[eInstr].type];
+
+			switch (eInstr) {
+			case asBC_SUSPEND:
+			case asBC_JitEntry:
+			case asBC_FREE: //Release of handle arguments
+				break;
+			case asBC_SetV1:
+			case asBC_SetV2:
+			case asBC_SetV4:
+				//Remember constant assigned to variable
+				if (iVarCount >= C_MAX_VARS)
+					return false;
+				aVarOffsets[iVarCount] = asBC_SWORDARG0(pInstr);
+				aVarValues[iVarCount] = asBC_DWORDARG(pInstr);
+				iVarCount++;
+				break;
+			case asBC_CpyVtoR4: {
+				//Copy a known constant variable into the return register
+				bool bFound = false;
+				for (int i = iVarCount - 1; i >= 0; i--) {
+					if (aVarOffsets[i] == asBC_SWORDARG0(pInstr)) {
+						dwRegister = aVarValues[i];
+						bFound = true;
+						break;
+					}
+				}
+				if (!bFound)
+					return false;
+				bRegisterSet = true;
+				break;
+			}
+			case asBC_JMP:
+				//Follow forward jumps only
+				if (asBC_INTARG(pInstr) < 0)
+					return false;
+				uiPos += uiSize + (asUINT)asBC_INTARG(pInstr);
+				continue;
+			case asBC_RET:
+				//Determine trait by return type
+				rTrait.pFunction = pFunction;
+				rTrait.dwConstant = dwRegister;
+
+				if (pFunction->GetReturnTypeId() == asTYPEID_VOID) {
+					rTrait.eTrait = FT_EMPTY;
+					return true;
+				} else if ((bRegisterSet) && ((pFunction->GetReturnTypeId() == asTYPEID_BOOL) || (pFunction->GetReturnTypeId() == asTYPEID_INT32) || (pFunction->GetReturnTypeId() == asTYPEID_UINT32))) {
+					rTrait.eTrait = FT_CONSTANT;
+					return true;
+				}
+
+				return false;
+			default:
+				return false;
+			}
+
+			uiPos += uiSize;
+		}
+
+		return false;
+	}
+
 	bool CScriptInt::RegisterInterface(const std::string& szName)
 	{
 		//Register interface
@@ -815,13 +1064,33 @@ namespace Scripting {
 		} else {
 			if (std::string(from).find(Utils::ReplaceString(Utils::ConvertToAnsiString(wszBasePath), "\\", "/") + "packages/.common") == 0) { //Provide path to scripts from common path context
 				szInclude = Utils::ConvertToAnsiString(wszBasePath) + "packages\\.common\\entities\\" + szInclude;
-			} else { //Provide absolute path to relative includes from package path
-				szInclude = Utils::ConvertToAnsiString(Game::pGame->GetPackagePath()) + "entities\\" + szInclude;
+			} else { //Provide absolute path to relative includes from package path or the overlaid common path
+				std::wstring wszResolved;
+				if (Game::pGame->GetFileSystem().Resolve(L"entities\\" + Utils::ConvertToWideString(szInclude), wszResolved)) {
+					szInclude = Utils::ConvertToAnsiString(wszResolved);
+				} else {
+					szInclude = Utils::ConvertToAnsiString(Game::pGame->GetPackagePath()) + "entities\\" + szInclude;
+				}
 			}
 		}
 
-		builder->AddSectionFromFile(szInclude.c_str());
+		ScriptInt_AddSection(builder, szInclude);
 
 		return 0;
 	}
+
+	int ScriptInt_AddSection(CScriptBuilder* builder, const std::string& szFile)
+	{
+		//Add script file to module. The file is read through the file system and added under the name the builder would use for it
+
+		Vfs::file_view_s sView;
+		if (!oFileSystem.MapFile(Utils::ConvertToWideString(szFile), sView))
+			return -1;
+
+		int iResult = builder->AddSectionFromMemory(Utils::ReplaceString(szFile, "\\", "/").c_str(), (sView.uiSize) ? (const char*)sView.pData : "", (unsigned int)sView.uiSize); //The builder reads a zero length as terminated string
+
+		Vfs::CFileSystem::ReleaseView(sView);
+
+		return iResult;
+	}
 }
\ No newline at end of file
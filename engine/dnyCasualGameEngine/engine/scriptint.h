@@ -12,6 +12,7 @@
 */
 
 #include "shared.h"
+#include <unordered_map>
 #include <angelscript.h>
 #include <scriptbuilder\scriptbuilder.h>
 #include <scriptarray\scriptarray.h>
@@ -20,6 +21,10 @@
 #define AS_FAILED(r) (r < 0)
 #define AS_EXECUTED(r) (r == asEXECUTION_FINISHED)
 #define SI_INVALID_ID ((size_t)-1)
+#define SI_SCRIPT_SLOT_BITS 16
+#define SI_SCRIPT_SLOT_MASK 0xFFFF
+#define SI_SCRIPT_MAX_GENERATION 0x7FFF
+#define SI_USERDATA_WORLD 1001
 #define BEGIN_PARAMS(lv) std::vector<Scripting::si_func_arg> lv; Scripting::si_func_arg lv##_sSIArg_;
 #define PUSH_PARAM(t, n, v, lv) lv##_sSIArg_.eType = t; lv##_sSIArg_.##n = v; lv.push_back(lv##_sSIArg_);
 #define PUSH_BOOL(var) PUSH_PARAM(Scripting::FA_BYTE, byte, (byte)var, vArgs);
@@ -49,6 +54,12 @@ namespace Scripting {
 		FA_OBJECT
 	};
 
+	enum func_trait_e {
+		FT_REGULAR,
+		FT_EMPTY,
+		FT_CONSTANT
+	};
+
 	typedef size_t HSIHANDLE;
 	typedef HSIHANDLE HSISCRIPT;
 	typedef HSIHANDLE HSIENUM;
@@ -59,7 +70,8 @@ namespace Scripting {
 
 	struct si_script_s {
 		std::string szName;
-		asIScriptModule* pModule;
+		asIScriptModule* pModule; //nullptr if slot is free
+		size_t uiGeneration; //Advanced on unload so that old handles to the slot are rejected
 	};
 
 	struct si_enum_s {
@@ -71,6 +83,12 @@ namespace Scripting {
 		size_t uiSize;
 	};
 
+	struct si_func_trait_s {
+		asIScriptFunction* pFunction;
+		func_trait_e eTrait;
+		asDWORD dwConstant;
+	};
+
 	struct si_func_arg {
 		func_args_e eType;
 		union {
@@ -86,6 +104,7 @@ namespace Scripting {
 	};
 
 	int ScriptInt_IncludeCallback(const char* include, const char* from, CScriptBuilder* builder, void* userParam);
+	int ScriptInt_AddSection(CScriptBuilder* builder, const std::string& szFile);
 
 	/* Scripting interface component */
 	class CScriptInt {
@@ -94,9 +113,17 @@ namespace Scripting {
 		std::string m_szScriptPath;
 		asIScriptEngine* m_pScriptEngine;
 		std::vector<si_script_s> m_vScripts;
+		std::vector<size_t> m_vFreeScriptSlots;
 		std::vector<si_enum_s> m_vEnums;
 		std::vector<si_struct_s> m_vStructs;
 		std::vector<si_class_s> m_vClasses;
+		std::unordered_map<asIScriptFunction*, si_func_trait_s> m_mFuncTraits; //Skippable or constant methods by function
+
+		asIScriptContext* CreateContext(void);
+		si_script_s* GetScript(const HSISCRIPT hScript);
+		void AnalyzeModule(asIScriptModule* pModule);
+		void DiscardModuleTraits(asIScriptModule* pModule);
+		bool AnalyzeFunction(asIScriptFunction* pFunction, si_func_trait_s& rTrait);
 
 		friend int ScriptInt_IncludeCallback(const char* include, const char* from, CScriptBuilder* builder, void* userParam);
 	public:
@@ -111,6 +138,7 @@ namespace Scripting {
 
 		virtual HSISCRIPT LoadScript(const std::string& szScriptName);
 		virtual bool UnloadScript(const HSISCRIPT hScript);
+		virtual bool ResetScript(const HSISCRIPT hScript);
 
 		virtual bool CallScriptFunction(const HSISCRIPT hScript, const bool bIsName, const std::string& szFunctionNameOrDeclaration, const std::vector<si_func_arg>* pArgs, void* pResult, func_args_e eResultType = FA_VOID);
 		bool CallScriptFunction(asIScriptFunction* pFunction, const std::vector<si_func_arg>* pArgs, void* pResult, func_args_e eResultType = FA_VOID);
@@ -130,7 +158,9 @@ namespace Scripting {
 		virtual bool AddClassBehaviour(const HSICLASS hClass, const asEBehaviours eBehavior, const std::string& szTypeDef, const asSFuncPtr& pMethod);
 		virtual asITypeInfo* GetTypeInfo(const std::string& szTypeText, bool bNameOrDef);
 		virtual asIScriptObject* AllocClass(const HSISCRIPT hScript, const std::string& szClassName);
+		virtual asIScriptObject* CreateScriptObject(const HSISCRIPT hScript, const std::string& szClassName);
 		virtual bool CallScriptMethod(const HSISCRIPT hScript, asIScriptObject* pClassInstance, const std::string& szMethodDef, const std::vector<si_func_arg>* pArgs, void* pResult, func_args_e eResultType = FA_VOID);
+		virtual si_func_trait_s QueryMethodTrait(asIScriptObject* pClassInstance, const std::string& szMethodDef);
 		virtual bool RegisterInterface(const std::string& szName);
 		virtual bool RegisterInterfaceMethod(const std::string& szIfName, const std::string& szTypedef);
 	};
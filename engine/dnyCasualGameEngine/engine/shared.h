@@ -28,6 +28,8 @@
 #include <algorithm>
 #include <iomanip>
 #include <ctime>
+#include <thread>
+#include <atomic>
 #include <strsafe.h>
 #include <Windows.h>
 #include "resource.h"
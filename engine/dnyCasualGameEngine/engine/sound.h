@@ -12,15 +12,40 @@
 */
 
 #include "shared.h"
+#include "utils.h"
+#include "mixer.h"
+#include "jobs.h"
+#include "vfs.h"
+#include <cmath>
 #include <mmsystem.h>
-#include <dsound.h>
-#include <DxErr.h>
+#ifdef SND_ENABLE_OGG
+#include <vorbis/vorbisfile.h>
+#endif
 
 /* Sound management component */
 namespace DxSound {
 	#define SND_INVALID_HANDLE_VALUE std::wstring::npos
+	#define SND_DEFAULT_MAX_VOICES 32
+	#define SND_PRIORITY_NORMAL 0
+	#define SND_PLAY_LOOPING 0x00000001
+	#define SND_MAX_DECODE_WORKERS 4
+	#define SND_STREAM_THRESHOLD (1024 * 1024)
+	#define SND_MAX_ATTENUATION 10000
+	#define SND_TO_ATTENUATION(indicator) (indicator * 10 * SND_MAX_ATTENUATION / 100 - SND_MAX_ATTENUATION)
+	#define SND_AUDIBLE_GAIN 0.01f
+	#define SND_PAN_WIDTH 0.8f
+	#define SND_EMITTER_UPDATE_DELTA 0.005f
 
 	typedef size_t HDXSOUND;
+
+	struct voice_stats_s {
+		size_t uiActive;
+		size_t uiPeak;
+		size_t uiStarted;
+		size_t uiStolen;
+		size_t uiRejected;
+		size_t uiCulled;
+	};
 	
 	class CDxSound {
 	private:
@@ -40,64 +65,375 @@ namespace DxSound {
 			unsigned long dataSize;
 		};
 
+		class CStreamSource;
+
 		struct soundfile_s {
 			std::wstring wszName;
-			void* pData;
-			IDirectSoundBuffer8* pSoundBuffer;
 			wave_header_s sWaveHeader;
+			mixer_sound_s* pMixerSound;
+			DWORD dwResidentSize;
+		};
+
+		struct decode_job_s {
+			std::wstring wszFile;
+			wave_header_s sWaveHeader;
+			void* pData;
+			CStreamSource* pStream; //Set instead of the data for sounds above the stream threshold
+			HDXSOUND hSound; //Handle reserved for the sound if it has been queried before decoding finished
+		};
+
+		struct emitter_s {
+			HDXSOUND hSound;
+			long iVolume;
+			float fPosX;
+			float fPosY;
+			float fFalloffDistance;
+			float fGain; //Last gain and pan sent to the mixer
+			float fPan;
 		};
 
-		LPDIRECTSOUND8 m_pSoundDevice;
 		std::vector<soundfile_s> m_vSounds;
 		long m_lGlobalVolume;
+		size_t m_uiMaxVoices;
+		voice_stats_s m_sFrameStats;
+		voice_stats_s m_sLastFrameStats;
+		CSoftwareMixer* m_pMixer;
+		std::vector<mixer_sound_s*> m_vRetiredSounds;
+		mixer_stats_s m_sLastMixerStats;
+		std::vector<decode_job_s> m_vPreloadJobs;
+		Jobs::CJobSystem* m_pDeferJobs;
+		std::vector<decode_job_s*> m_vDeferredJobs;
+		std::vector<emitter_s> m_vEmitters; //Looped positional sounds
+		float m_fListenerX;
+		float m_fListenerY;
+
+		static bool ReadWaveHeader(const byte* pFileData, size_t uiFileSize, wave_header_s& sWaveHeader)
+		{
+			//Get header of a wave file which has been read into memory
 
-		void* LoadFile(const std::wstring& wszSoundFile, wave_header_s& sWaveHeader)
+			if (uiFileSize < sizeof(wave_header_s))
+				return false;
+
+			memcpy(&sWaveHeader, pFileData, sizeof(wave_header_s));
+
+			//Validate wave file header
+			return (IsValidWaveFile(sWaveHeader)) && (sWaveHeader.dataSize <= uiFileSize - sizeof(wave_header_s));
+		}
+
+		static void* LoadWaveData(const byte* pFileData, const wave_header_s& sWaveHeader)
 		{
-			//Load file into memory
+			//Copy PCM data of a wave file with validated header
 
-			if (!wszSoundFile.length())
-				return nullptr;
+			//Allocate memory for wave sound data
+			void* pData = new unsigned char[sWaveHeader.dataSize];
+			memcpy(pData, pFileData + sizeof(wave_header_s), sWaveHeader.dataSize);
 
-			//Open file in read-mode
-			HANDLE hFile = CreateFile(wszSoundFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
-			if (hFile == INVALID_HANDLE_VALUE)
-				return nullptr;
+			return pData;
+		}
 
-			DWORD dwBytesRead;
+		static bool IsOggFile(const byte* pFileData, size_t uiFileSize)
+		{
+			//Check for Ogg container signature
 
-			//Read Wave file header
-			if ((!ReadFile(hFile, &sWaveHeader, sizeof(wave_header_s), &dwBytesRead, nullptr)) && (dwBytesRead != sizeof(wave_header_s))) {
-				CloseHandle(hFile);
-				return nullptr;
+			return (uiFileSize >= 4) && (!memcmp(pFileData, "OggS", 4));
+		}
+
+#ifdef SND_ENABLE_OGG
+		struct ogg_memory_s {
+			const unsigned char* pData;
+			size_t uiSize;
+			size_t uiPos;
+		};
+
+		static size_t OggMemRead(void* pDest, size_t uiSize, size_t uiCount, void* pSource)
+		{
+			//Read from Ogg data in memory
+
+			ogg_memory_s* pMem = (ogg_memory_s*)pSource;
+
+			size_t uiBytes = uiSize * uiCount;
+			if (uiBytes > pMem->uiSize - pMem->uiPos) {
+				uiBytes = pMem->uiSize - pMem->uiPos;
 			}
 
-			//Validate wave file header
-			if (!this->IsValidWaveFile(sWaveHeader)) {
-				CloseHandle(hFile);
-				return nullptr;
+			memcpy(pDest, pMem->pData + pMem->uiPos, uiBytes);
+			pMem->uiPos += uiBytes;
+
+			return (uiSize) ? uiBytes / uiSize : 0;
+		}
+
+		static int OggMemSeek(void* pSource, ogg_int64_t iOffset, int iWhence)
+		{
+			//Seek in Ogg data in memory
+
+			ogg_memory_s* pMem = (ogg_memory_s*)pSource;
+
+			ogg_int64_t iPos = iOffset;
+			if (iWhence == SEEK_CUR) {
+				iPos += (ogg_int64_t)pMem->uiPos;
+			} else if (iWhence == SEEK_END) {
+				iPos += (ogg_int64_t)pMem->uiSize;
 			}
 
-			//Allocate memory for wave sound data
-			void* pData = new unsigned char[sWaveHeader.dataSize];
-			if (!pData) {
-				CloseHandle(hFile);
+			if ((iPos < 0) || (iPos > (ogg_int64_t)pMem->uiSize))
+				return -1;
+
+			pMem->uiPos = (size_t)iPos;
+
+			return 0;
+		}
+
+		static int OggMemClose(void* pSource)
+		{
+			//Release Ogg data source. The data itself belongs to the caller
+
+			delete (ogg_memory_s*)pSource;
+
+			return 0;
+		}
+
+		static long OggMemTell(void* pSource)
+		{
+			//Get position in Ogg data in memory
+
+			return (long)((ogg_memory_s*)pSource)->uiPos;
+		}
+
+		static void MakeOggHeader(OggVorbis_File* pOggFile, wave_header_s& sWaveHeader)
+		{
+			//Describe decoded Ogg Vorbis data as 16 bit PCM wave
+
+			vorbis_info* pInfo = ov_info(pOggFile, -1);
+
+			memset(&sWaveHeader, 0x00, sizeof(wave_header_s));
+			memcpy(sWaveHeader.chunkId, "RIFF", sizeof(DWORD));
+			memcpy(sWaveHeader.format, "WAVE", sizeof(DWORD));
+			memcpy(sWaveHeader.subChunkId, "fmt ", sizeof(DWORD));
+			memcpy(sWaveHeader.dataChunkId, "data", sizeof(DWORD));
+			sWaveHeader.audioFormat = WAVE_FORMAT_PCM;
+			sWaveHeader.numChannels = (unsigned short)pInfo->channels;
+			sWaveHeader.sampleRate = (unsigned long)pInfo->rate;
+			sWaveHeader.bitsPerSample = 16;
+			sWaveHeader.blockAlign = sWaveHeader.numChannels * 2;
+			sWaveHeader.bytesPerSecond = sWaveHeader.sampleRate * sWaveHeader.blockAlign;
+			sWaveHeader.dataSize = (unsigned long)ov_pcm_total(pOggFile, -1) * sWaveHeader.blockAlign;
+		}
+
+		static OggVorbis_File* OpenOggFile(const byte* pFileData, size_t uiFileSize, wave_header_s& sWaveHeader)
+		{
+			//Open Ogg Vorbis file which has been read into memory for decoding
+
+			OggVorbis_File* pOggFile = new OggVorbis_File();
+
+			ov_callbacks sCallbacks = { &OggMemRead, &OggMemSeek, &OggMemClose, &OggMemTell };
+
+			ogg_memory_s* pMem = new ogg_memory_s();
+			pMem->pData = pFileData;
+			pMem->uiSize = uiFileSize;
+			pMem->uiPos = 0;
+
+			if (ov_open_callbacks(pMem, pOggFile, nullptr, 0, sCallbacks) != 0) {
+				delete pMem;
+				delete pOggFile;
 				return nullptr;
 			}
 
-			//Read sound data to buffer
-			if ((!ReadFile(hFile, pData, sWaveHeader.dataSize, &dwBytesRead, nullptr)) && (dwBytesRead != sWaveHeader.dataSize)) {
-				delete[] pData;
-				CloseHandle(hFile);
+			MakeOggHeader(pOggFile, sWaveHeader);
+
+			return pOggFile;
+		}
+
+		static bool ReadOggData(OggVorbis_File* pOggFile, unsigned char* pDest, DWORD dwSize, DWORD& dwBytesRead)
+		{
+			//Decode Ogg Vorbis data to 16 bit little endian PCM
+
+			int iBitStream = 0;
+			dwBytesRead = 0;
+
+			while (dwBytesRead < dwSize) {
+				long lResult = ov_read(pOggFile, (char*)pDest + dwBytesRead, (int)(dwSize - dwBytesRead), 0, 2, 1, &iBitStream);
+				if (lResult <= 0)
+					break;
+
+				dwBytesRead += (DWORD)lResult;
+			}
+
+			return dwBytesRead > 0;
+		}
+#endif
+
+		/* Decodes a sound while it plays. The file data is used in place as long as it is not detached from its archive */
+		class CStreamSource : public IMixerStreamSource {
+		private:
+			Vfs::file_view_s m_sView;
+			wave_header_s m_sWaveHeader;
+			size_t m_uiReadPos; //Position in wave data
+			void* m_pOggFile;
+			std::vector<unsigned char> m_vPcmData;
+		public:
+			CStreamSource(const Vfs::file_view_s& sView, const wave_header_s& sWaveHeader, void* pOggFile) : m_sView(sView), m_sWaveHeader(sWaveHeader), m_uiReadPos(0), m_pOggFile(pOggFile) {}
+			virtual ~CStreamSource()
+			{
+#ifdef SND_ENABLE_OGG
+				if (this->m_pOggFile) {
+					ov_clear((OggVorbis_File*)this->m_pOggFile);
+					delete (OggVorbis_File*)this->m_pOggFile;
+				}
+#endif
+
+				Vfs::CFileSystem::ReleaseView(this->m_sView);
+			}
+
+			virtual size_t Read(float* pFrames, size_t uiFrames)
+			{
+				//Decode next frames to stereo float
+
+				size_t uiFrameSize = this->m_sWaveHeader.numChannels * (this->m_sWaveHeader.bitsPerSample / 8);
+				size_t uiBytes = uiFrames * uiFrameSize;
+				size_t uiBytesRead = 0;
+
+				if (this->m_vPcmData.size() < uiBytes) {
+					this->m_vPcmData.resize(uiBytes);
+				}
+
+				if (this->m_pOggFile) {
+#ifdef SND_ENABLE_OGG
+					DWORD dwBytesRead = 0;
+					ReadOggData((OggVorbis_File*)this->m_pOggFile, &this->m_vPcmData[0], (DWORD)uiBytes, dwBytesRead);
+					uiBytesRead = dwBytesRead;
+#endif
+				} else {
+					uiBytesRead = this->m_sWaveHeader.dataSize - this->m_uiReadPos;
+					if (uiBytesRead > uiBytes) {
+						uiBytesRead = uiBytes;
+					}
+
+					memcpy(&this->m_vPcmData[0], this->m_sView.pData + sizeof(wave_header_s) + this->m_uiReadPos, uiBytesRead);
+					this->m_uiReadPos += uiBytesRead;
+				}
+
+				CSoftwareMixer::ConvertFrames(&this->m_vPcmData[0], uiBytesRead / uiFrameSize, this->m_sWaveHeader.numChannels, this->m_sWaveHeader.bitsPerSample, pFrames);
+
+				return uiBytesRead / uiFrameSize;
+			}
+
+			virtual void Rewind(void)
+			{
+				//Continue decoding from the start
+
+#ifdef SND_ENABLE_OGG
+				if (this->m_pOggFile) {
+					ov_pcm_seek((OggVorbis_File*)this->m_pOggFile, 0);
+				}
+#endif
+
+				this->m_uiReadPos = 0;
+			}
+
+			bool DetachArchive(const Pak::CArchive* pArchive)
+			{
+				//Copy file data which is used in place from the archive, so that the archive can be unmounted
+
+				if ((this->m_sView.bOwned) || (!pArchive->Contains(this->m_sView.pData)))
+					return true;
+
+				byte* pCopy = (byte*)malloc(this->m_sView.uiSize);
+				if (!pCopy)
+					return false;
+
+				memcpy(pCopy, this->m_sView.pData, this->m_sView.uiSize);
+
+#ifdef SND_ENABLE_OGG
+				if (this->m_pOggFile) {
+					((ogg_memory_s*)((OggVorbis_File*)this->m_pOggFile)->datasource)->pData = pCopy;
+				}
+#endif
+
+				this->m_sView.pData = pCopy;
+				this->m_sView.bOwned = true;
+
+				return true;
+			}
+		};
+
+		static bool ShouldStream(const wave_header_s& sWaveHeader)
+		{
+			//Check if a sound is large enough to be decoded while it plays
+
+			return (sWaveHeader.dataSize > SND_STREAM_THRESHOLD) && (CSoftwareMixer::IsSupportedFormat(sWaveHeader.numChannels, sWaveHeader.bitsPerSample, sWaveHeader.sampleRate));
+		}
+
+		static void* DecodeFile(const std::wstring& wszSoundFile, wave_header_s& sWaveHeader, CStreamSource** ppStream = nullptr)
+		{
+			//Decode whole sound file to PCM data. Does not touch the sound device, so it can run on worker threads. Sounds above the stream
+			//threshold are not decoded if a stream source is requested, the source keeps the file data then
+
+			//Map file once through the file system and decode it from memory
+			Vfs::file_view_s sView;
+			if (!oFileSystem.MapFile(wszSoundFile, sView))
 				return nullptr;
+
+			void* pData = nullptr;
+
+			if (IsOggFile(sView.pData, sView.uiSize)) {
+#ifdef SND_ENABLE_OGG
+				OggVorbis_File* pOggFile = OpenOggFile(sView.pData, sView.uiSize, sWaveHeader);
+
+				if ((pOggFile) && (ppStream) && (ShouldStream(sWaveHeader))) {
+					*ppStream = new CStreamSource(sView, sWaveHeader, pOggFile);
+					return nullptr;
+				}
+
+				if (pOggFile) {
+					unsigned char* pPcmData = new unsigned char[sWaveHeader.dataSize];
+					DWORD dwBytesRead = 0;
+
+					ReadOggData(pOggFile, pPcmData, sWaveHeader.dataSize, dwBytesRead);
+					sWaveHeader.dataSize = dwBytesRead;
+
+					ov_clear(pOggFile);
+					delete pOggFile;
+
+					if (dwBytesRead) {
+						pData = pPcmData;
+					} else {
+						delete[] pPcmData;
+					}
+				}
+#endif
+			} else if (ReadWaveHeader(sView.pData, sView.uiSize, sWaveHeader)) {
+				if ((ppStream) && (ShouldStream(sWaveHeader))) {
+					*ppStream = new CStreamSource(sView, sWaveHeader, nullptr);
+					return nullptr;
+				}
+
+				pData = LoadWaveData(sView.pData, sWaveHeader);
 			}
 
-			//Close file
-			CloseHandle(hFile);
+			Vfs::CFileSystem::ReleaseView(sView);
 
 			return pData;
 		}
 
-		bool IsValidWaveFile(const wave_header_s& sWaveHeader)
+		static void DecodeWorker(std::vector<decode_job_s>* pJobs, std::atomic<size_t>* pNextJob)
+		{
+			//Decode queued sound files until no job is left
+
+			size_t uiJob;
+
+			while ((uiJob = (*pNextJob)++) < pJobs->size()) {
+				DecodeJob((*pJobs)[uiJob]);
+			}
+		}
+
+		static void DecodeJob(decode_job_s& rJob)
+		{
+			//Decode sound file of a job. Large sounds get a stream source instead
+
+			rJob.pData = DecodeFile(rJob.wszFile, rJob.sWaveHeader, &rJob.pStream);
+		}
+
+		static bool IsValidWaveFile(const wave_header_s& sWaveHeader)
 		{
 			//Check if the wave header contains valid data
 
@@ -117,65 +453,94 @@ namespace DxSound {
 			if (!wszSoundFile.length())
 				return SND_INVALID_HANDLE_VALUE;
 
-			soundfile_s sSoundFile;
+			//Decode on the job system while loads are deferred
+			if (this->m_pDeferJobs)
+				return this->DeferLoad(wszSoundFile);
+
+			wave_header_s sWaveHeader;
+			CStreamSource* pStream = nullptr;
+
+			//Decode file into memory
+			void* pMemData = DecodeFile(wszSoundFile, sWaveHeader, &pStream);
+			if (pStream)
+				return this->CreateStreamedSound(wszSoundFile, sWaveHeader, pStream);
 
-			//Load file into memory
-			void* pMemData = this->LoadFile(wszSoundFile, sSoundFile.sWaveHeader);
 			if (!pMemData)
 				return SND_INVALID_HANDLE_VALUE;
 
-			//Save further data
-			sSoundFile.pData = pMemData;
+			return this->CreateStaticSound(wszSoundFile, sWaveHeader, pMemData);
+		}
+
+		HDXSOUND DeferLoad(const std::wstring& wszSoundFile)
+		{
+			//Reserve handle of a sound and decode it on the job system. The sound can be played once EndDeferredLoads has run
+
+			soundfile_s sSoundFile;
 			sSoundFile.wszName = wszSoundFile;
+			memset(&sSoundFile.sWaveHeader, 0x00, sizeof(wave_header_s));
+			sSoundFile.pMixerSound = nullptr;
+			sSoundFile.dwResidentSize = 0;
+			this->m_vSounds.push_back(sSoundFile);
 
-			//Setup wave format data
-			WAVEFORMATEX sWaveFmt = { 0 };
-			sWaveFmt.wFormatTag = WAVE_FORMAT_PCM;
-			sWaveFmt.nChannels = sSoundFile.sWaveHeader.numChannels;
-			sWaveFmt.nSamplesPerSec = sSoundFile.sWaveHeader.sampleRate;
-			sWaveFmt.wBitsPerSample = sSoundFile.sWaveHeader.bitsPerSample;
-			sWaveFmt.nBlockAlign = (sWaveFmt.wBitsPerSample / 8) * sWaveFmt.nChannels;
-			sWaveFmt.nAvgBytesPerSec = sWaveFmt.nSamplesPerSec * sWaveFmt.nBlockAlign;
-
-			//Setup buffer description data
-			DSBUFFERDESC sBufferDesc = { 0 };
-			sBufferDesc.dwSize = sizeof(DSBUFFERDESC);
-			sBufferDesc.dwFlags = DSBCAPS_CTRLPAN | DSBCAPS_CTRLVOLUME | DSBCAPS_CTRLFREQUENCY;
-			sBufferDesc.dwBufferBytes = sSoundFile.sWaveHeader.dataSize;
-			sBufferDesc.lpwfxFormat = &sWaveFmt;
-			sBufferDesc.guid3DAlgorithm = GUID_NULL;
-
-			LPDIRECTSOUNDBUFFER pTempSoundBuffer = nullptr;
-
-			//Create temporary interface sound buffer
-			if (FAILED(this->m_pSoundDevice->CreateSoundBuffer(&sBufferDesc, &pTempSoundBuffer, nullptr))) {
-				delete[] sSoundFile.pData;
-				return false;
-			}
+			HDXSOUND hSound = this->m_vSounds.size() - 1;
 
-			//Create new secondary sound buffer
-			if (FAILED(pTempSoundBuffer->QueryInterface(IID_IDirectSoundBuffer8, (LPVOID*)&sSoundFile.pSoundBuffer))) {
-				delete[] sSoundFile.pData;
-				pTempSoundBuffer->Release();
-				return false;
+			//Sounds already queued for preloading are created in the reserved slot
+			for (size_t i = 0; i < this->m_vPreloadJobs.size(); i++) {
+				if ((this->m_vPreloadJobs[i].wszFile == wszSoundFile) && (this->m_vPreloadJobs[i].hSound == SND_INVALID_HANDLE_VALUE)) {
+					this->m_vPreloadJobs[i].hSound = hSound;
+					return hSound;
+				}
 			}
 
-			//Release temporary sound buffer
-			pTempSoundBuffer->Release();
+			decode_job_s* pJob = new decode_job_s();
+			pJob->wszFile = wszSoundFile;
+			pJob->pData = nullptr;
+			pJob->pStream = nullptr;
+			pJob->hSound = hSound;
+			this->m_vDeferredJobs.push_back(pJob);
 
-			LPVOID lpvDataPtr1 = nullptr, lpvDataPtr2 = nullptr;
-			DWORD dwDataSize1 = 0, dwDataSize2 = 0;
+			this->m_pDeferJobs->Submit([pJob]() { DecodeJob(*pJob); });
 
-			//Acquire buffer memory area to write file data and lock it
-			if (FAILED(sSoundFile.pSoundBuffer->Lock(0, sSoundFile.sWaveHeader.dataSize, &lpvDataPtr1, &dwDataSize1, &lpvDataPtr2, &dwDataSize2, 0)))
-				return false;
+			return hSound;
+		}
+
+		HDXSOUND CreateStaticSound(const std::wstring& wszSoundFile, const wave_header_s& sWaveHeader, void* pMemData, HDXSOUND hReserved = SND_INVALID_HANDLE_VALUE)
+		{
+			//Convert decoded data for the mixer. Takes ownership of the data. A reserved handle is filled instead of adding a new sound
 
-			//Copy file data to buffers memory area
-			memcpy(lpvDataPtr1, sSoundFile.pData, sSoundFile.sWaveHeader.dataSize);
+			mixer_sound_s* pMixerSound = CSoftwareMixer::CreateSound(pMemData, sWaveHeader.dataSize, sWaveHeader.numChannels, sWaveHeader.bitsPerSample, sWaveHeader.sampleRate);
 
-			//Unlock buffer memory area again
-			if (FAILED(sSoundFile.pSoundBuffer->Unlock(lpvDataPtr1, dwDataSize1, lpvDataPtr2, dwDataSize2)))
-				return false;
+			delete[] (unsigned char*)pMemData;
+
+			return this->AddSound(wszSoundFile, sWaveHeader, pMixerSound, hReserved);
+		}
+
+		HDXSOUND CreateStreamedSound(const std::wstring& wszSoundFile, const wave_header_s& sWaveHeader, CStreamSource* pStream, HDXSOUND hReserved = SND_INVALID_HANDLE_VALUE)
+		{
+			//Create sound which is decoded while it plays. Takes ownership of the stream source
+
+			mixer_sound_s* pMixerSound = CSoftwareMixer::CreateStream(pStream, sWaveHeader.dataSize / (sWaveHeader.numChannels * (sWaveHeader.bitsPerSample / 8)), sWaveHeader.sampleRate);
+
+			return this->AddSound(wszSoundFile, sWaveHeader, pMixerSound, hReserved);
+		}
+
+		HDXSOUND AddSound(const std::wstring& wszSoundFile, const wave_header_s& sWaveHeader, mixer_sound_s* pMixerSound, HDXSOUND hReserved)
+		{
+			//Add mixer sound to the list. A reserved handle is filled instead of adding a new sound
+
+			if (!pMixerSound)
+				return SND_INVALID_HANDLE_VALUE;
+
+			soundfile_s sSoundFile;
+			sSoundFile.wszName = wszSoundFile;
+			sSoundFile.sWaveHeader = sWaveHeader;
+			sSoundFile.pMixerSound = pMixerSound;
+			sSoundFile.dwResidentSize = (DWORD)(((pMixerSound->pStream) ? MIX_STREAM_RING_FRAMES : pMixerSound->uiFrames) * MIX_CHANNELS * sizeof(float));
+
+			if (this->IsValidHandle(hReserved)) {
+				this->m_vSounds[hReserved] = sSoundFile;
+				return hReserved;
+			}
 
 			//Add to list
 			this->m_vSounds.push_back(sSoundFile);
@@ -203,40 +568,144 @@ namespace DxSound {
 			if (!this->IsValidHandle(hSound))
 				return false;
 
-			//Release sound buffer
-			this->m_vSounds[hSound].pSoundBuffer->Release();
+			//Remove emitters and update handles of following sounds
+			this->RemoveEmitter(hSound);
+
+			for (size_t i = 0; i < this->m_vEmitters.size(); i++) {
+				if (this->m_vEmitters[i].hSound > hSound) {
+					this->m_vEmitters[i].hSound--;
+				}
+			}
+
+			//Handles reserved by open loads follow the same shift. A freed reservation is dropped: deferred data is discarded and preloads are added as new sounds
+			for (size_t i = 0; i < this->m_vPreloadJobs.size(); i++) {
+				if (this->m_vPreloadJobs[i].hSound == SND_INVALID_HANDLE_VALUE)
+					continue;
+
+				if (this->m_vPreloadJobs[i].hSound > hSound) {
+					this->m_vPreloadJobs[i].hSound--;
+				} else if (this->m_vPreloadJobs[i].hSound == hSound) {
+					this->m_vPreloadJobs[i].hSound = SND_INVALID_HANDLE_VALUE;
+				}
+			}
 
-			//Free wave memory area
-			delete this->m_vSounds[hSound].pData;
+			for (size_t i = 0; i < this->m_vDeferredJobs.size(); i++) {
+				if (this->m_vDeferredJobs[i]->hSound == SND_INVALID_HANDLE_VALUE)
+					continue;
+
+				if (this->m_vDeferredJobs[i]->hSound > hSound) {
+					this->m_vDeferredJobs[i]->hSound--;
+				} else if (this->m_vDeferredJobs[i]->hSound == hSound) {
+					this->m_vDeferredJobs[i]->hSound = SND_INVALID_HANDLE_VALUE;
+				}
+			}
+
+			//The mixer thread may still read the samples until it has handled the stop command
+			if ((this->m_pMixer) && (this->m_vSounds[hSound].pMixerSound)) {
+				this->m_pMixer->StopSound(this->m_vSounds[hSound].pMixerSound);
+				this->m_vRetiredSounds.push_back(this->m_vSounds[hSound].pMixerSound);
+			} else {
+				CSoftwareMixer::FreeSound(this->m_vSounds[hSound].pMixerSound);
+			}
 
 			//Remove from list
 			this->m_vSounds.erase(this->m_vSounds.begin() + hSound);
 
 			return true;
 		}
+
+		float GetVolumeGain(const long iVolume) const
+		{
+			//Get linear gain of volume indicator (1-10). Global volume overrides it
+
+			return (float)pow(10.0, (double)SND_TO_ATTENUATION(((this->m_lGlobalVolume != -1) ? this->m_lGlobalVolume : iVolume)) / 2000.0);
+		}
+
+		void GetEmitterGain(const long iVolume, float fRelativeX, float fRelativeY, float fFalloffDistance, float& fGainOut, float& fPanOut) const
+		{
+			//Gain falls off with distance and pan follows the horizontal offset
+
+			float fDistance = sqrtf(fRelativeX * fRelativeX + fRelativeY * fRelativeY);
+			float fFalloff = 1.0f - fDistance / fFalloffDistance;
+			fGainOut = this->GetVolumeGain(iVolume) * ((fFalloff > 0.0f) ? fFalloff * fFalloff : 0.0f);
+
+			fPanOut = fRelativeX / fFalloffDistance * SND_PAN_WIDTH;
+			if (fPanOut < -SND_PAN_WIDTH) {
+				fPanOut = -SND_PAN_WIDTH;
+			} else if (fPanOut > SND_PAN_WIDTH) {
+				fPanOut = SND_PAN_WIDTH;
+			}
+		}
+
+		void RemoveEmitter(HDXSOUND hSound)
+		{
+			//Stop tracking looped positional sound
+
+			for (size_t i = 0; i < this->m_vEmitters.size(); i++) {
+				if (this->m_vEmitters[i].hSound == hSound) {
+					this->m_vEmitters.erase(this->m_vEmitters.begin() + i);
+					return;
+				}
+			}
+		}
+
+		void UpdateEmitters(void)
+		{
+			//Follow listener movement with gain and pan of looped positional sounds. Only noticeable changes are sent to the mixer
+
+			if (!this->m_pMixer)
+				return;
+
+			for (size_t i = 0; i < this->m_vEmitters.size(); i++) {
+				emitter_s& rEmitter = this->m_vEmitters[i];
+
+				float fGain, fPan;
+				this->GetEmitterGain(rEmitter.iVolume, rEmitter.fPosX - this->m_fListenerX, rEmitter.fPosY - this->m_fListenerY, rEmitter.fFalloffDistance, fGain, fPan);
+
+				if ((fabsf(fGain - rEmitter.fGain) < SND_EMITTER_UPDATE_DELTA) && (fabsf(fPan - rEmitter.fPan) < SND_EMITTER_UPDATE_DELTA))
+					continue;
+
+				if (this->m_pMixer->SetLoopGain(this->m_vSounds[rEmitter.hSound].pMixerSound, fGain, fPan)) {
+					rEmitter.fGain = fGain;
+					rEmitter.fPan = fPan;
+				}
+			}
+		}
+
+		bool PlayVoice(HDXSOUND hSound, float fGain, float fPan, const DWORD dwFlags, const bool bOnPreviousPosition, const int iPriority)
+		{
+			//Start voice with linear gain and pan (-1 = left, 1 = right)
+
+			//Mixer handles voice allocation on its own thread
+			if ((!this->m_pMixer) || (!this->m_pMixer->Play(this->m_vSounds[hSound].pMixerSound, fGain, fPan, (dwFlags & SND_PLAY_LOOPING) == SND_PLAY_LOOPING, bOnPreviousPosition, iPriority))) {
+				this->m_sFrameStats.uiRejected++;
+				return false;
+			}
+
+			return true;
+		}
 	public:
-		CDxSound() : m_pSoundDevice(nullptr), m_lGlobalVolume(-1) {}
-		CDxSound(HWND hWindow) : CDxSound() { this->Initialize(hWindow); }
+		CDxSound() : m_lGlobalVolume(-1), m_uiMaxVoices(SND_DEFAULT_MAX_VOICES), m_pMixer(nullptr), m_fListenerX(0.0f), m_fListenerY(0.0f), m_pDeferJobs(nullptr) { memset(&this->m_sFrameStats, 0x00, sizeof(voice_stats_s)); memset(&this->m_sLastFrameStats, 0x00, sizeof(voice_stats_s)); memset(&this->m_sLastMixerStats, 0x00, sizeof(mixer_stats_s)); }
+		CDxSound(IMixerOutput* pOutput) : CDxSound() { this->Initialize(pOutput); }
 		~CDxSound() { this->Release();  }
 
-		bool Initialize(HWND hWindow)
+		bool Initialize(IMixerOutput* pOutput)
 		{
-			//Initialize sound manager
-			
-			//Check window handle
-			if (!IsWindow(hWindow))
-				return false;
-			
-			//Create sound device
-			if (FAILED(DirectSoundCreate8(nullptr, &this->m_pSoundDevice, nullptr)))
+			//Initialize sound manager. All sounds are mixed in software and passed to the output device. Takes ownership of the device
+
+			if (this->m_pMixer)
 				return false;
-			
-			//Set cooperative level
-			if (FAILED(this->m_pSoundDevice->SetCooperativeLevel(hWindow, DSSCL_PRIORITY))) {
-				this->Release();
+
+			this->m_pMixer = new CSoftwareMixer();
+
+			if (!this->m_pMixer->Start(pOutput)) {
+				delete this->m_pMixer;
+				this->m_pMixer = nullptr;
 				return false;
 			}
-			
+
+			this->m_pMixer->SetMaxVoices(this->m_uiMaxVoices);
+
 			return true;
 		}
 
@@ -244,20 +713,39 @@ namespace DxSound {
 		{
 			//Release resources
 
-			//Release secondary buffers, free memory and clear list
-			if (this->m_vSounds.size()) {
-				for (size_t i = 0; i < this->m_vSounds.size(); i++) {
-					this->m_vSounds[i].pSoundBuffer->Release();
-					delete[] this->m_vSounds[i].pData;
-				}
+			//Stop mixer thread before its sound data is freed
+			if (this->m_pMixer) {
+				this->m_pMixer->Stop();
+			}
 
-				this->m_vSounds.clear();
+			//Free sound data and clear list
+			for (size_t i = 0; i < this->m_vSounds.size(); i++) {
+				CSoftwareMixer::FreeSound(this->m_vSounds[i].pMixerSound);
 			}
 
-			//Release device if exists
-			if (this->m_pSoundDevice) {
-				this->m_pSoundDevice->Release();
-				this->m_pSoundDevice = nullptr;
+			this->m_vSounds.clear();
+			this->m_vEmitters.clear();
+
+			//Deferred decoding must have finished at this point
+			for (size_t i = 0; i < this->m_vDeferredJobs.size(); i++) {
+				delete[] (unsigned char*)this->m_vDeferredJobs[i]->pData;
+				delete this->m_vDeferredJobs[i]->pStream;
+				delete this->m_vDeferredJobs[i];
+			}
+
+			this->m_vDeferredJobs.clear();
+			this->m_pDeferJobs = nullptr;
+
+			//Free sound data retired while the mixer was running
+			for (size_t i = 0; i < this->m_vRetiredSounds.size(); i++) {
+				CSoftwareMixer::FreeSound(this->m_vRetiredSounds[i]);
+			}
+
+			this->m_vRetiredSounds.clear();
+
+			if (this->m_pMixer) {
+				delete this->m_pMixer;
+				this->m_pMixer = nullptr;
 			}
 		}
 
@@ -278,7 +766,149 @@ namespace DxSound {
 			return hSound;
 		}
 
-		bool Play(HDXSOUND hSound, const long iVolume, const DWORD dwFlags, const bool bOnPreviousPosition = false)
+		bool IsSoundLoaded(const std::wstring& wszSoundFile)
+		{
+			//Check if sound has already been loaded
+
+			return this->FindSound(wszSoundFile) != SND_INVALID_HANDLE_VALUE;
+		}
+
+		size_t BeginPreload(const std::vector<std::wstring>& vSoundFiles)
+		{
+			//Queue decoding of sounds which are not yet loaded. Jobs are run by DecodePreloadJob and finished by EndPreload
+
+			this->m_vPreloadJobs.clear();
+
+			for (size_t i = 0; i < vSoundFiles.size(); i++) {
+				if ((!vSoundFiles[i].length()) || (this->FindSound(vSoundFiles[i]) != SND_INVALID_HANDLE_VALUE))
+					continue;
+
+				bool bQueued = false;
+				for (size_t j = 0; j < this->m_vPreloadJobs.size(); j++) {
+					if (this->m_vPreloadJobs[j].wszFile == vSoundFiles[i]) {
+						bQueued = true;
+						break;
+					}
+				}
+
+				if (bQueued)
+					continue;
+
+				decode_job_s sJob;
+				sJob.wszFile = vSoundFiles[i];
+				sJob.pData = nullptr;
+				sJob.pStream = nullptr;
+				sJob.hSound = SND_INVALID_HANDLE_VALUE;
+				this->m_vPreloadJobs.push_back(sJob);
+			}
+
+			return this->m_vPreloadJobs.size();
+		}
+
+		void DecodePreloadJob(size_t uiJob)
+		{
+			//Decode a queued sound. Does not touch the sound device, so it can run on worker threads
+
+			DecodeJob(this->m_vPreloadJobs[uiJob]);
+		}
+
+		size_t EndPreload(void)
+		{
+			//Create mixer sounds of the decoded sounds on the calling thread
+
+			size_t uiLoaded = 0;
+
+			for (size_t i = 0; i < this->m_vPreloadJobs.size(); i++) {
+				HDXSOUND hSound = SND_INVALID_HANDLE_VALUE;
+
+				if (this->m_vPreloadJobs[i].pStream) {
+					hSound = this->CreateStreamedSound(this->m_vPreloadJobs[i].wszFile, this->m_vPreloadJobs[i].sWaveHeader, this->m_vPreloadJobs[i].pStream, this->m_vPreloadJobs[i].hSound);
+				} else if (this->m_vPreloadJobs[i].pData) {
+					hSound = this->CreateStaticSound(this->m_vPreloadJobs[i].wszFile, this->m_vPreloadJobs[i].sWaveHeader, this->m_vPreloadJobs[i].pData, this->m_vPreloadJobs[i].hSound);
+				}
+
+				if (hSound != SND_INVALID_HANDLE_VALUE) {
+					uiLoaded++;
+				}
+			}
+
+			this->m_vPreloadJobs.clear();
+
+			return uiLoaded;
+		}
+
+		void BeginDeferredLoads(Jobs::CJobSystem* pJobs)
+		{
+			//Decode sounds queried from now on with the job system instead of the calling thread
+
+			this->m_pDeferJobs = pJobs;
+		}
+
+		size_t EndDeferredLoads(void)
+		{
+			//Create mixer sounds of the deferred loads on the calling thread. All submitted jobs must be done
+
+			size_t uiLoaded = 0;
+
+			for (size_t i = 0; i < this->m_vDeferredJobs.size(); i++) {
+				decode_job_s* pJob = this->m_vDeferredJobs[i];
+
+				//Reserved sound has been freed meanwhile
+				if (pJob->hSound == SND_INVALID_HANDLE_VALUE) {
+					delete[] (unsigned char*)pJob->pData;
+					delete pJob->pStream;
+					delete pJob;
+					continue;
+				}
+
+				if ((pJob->pStream) && (this->CreateStreamedSound(pJob->wszFile, pJob->sWaveHeader, pJob->pStream, pJob->hSound) != SND_INVALID_HANDLE_VALUE)) {
+					uiLoaded++;
+				} else if ((pJob->pData) && (this->CreateStaticSound(pJob->wszFile, pJob->sWaveHeader, pJob->pData, pJob->hSound) != SND_INVALID_HANDLE_VALUE)) {
+					uiLoaded++;
+				}
+
+				delete pJob;
+			}
+
+			this->m_vDeferredJobs.clear();
+			this->m_pDeferJobs = nullptr;
+
+			return uiLoaded;
+		}
+
+		size_t PreloadSounds(const std::vector<std::wstring>& vSoundFiles)
+		{
+			//Decode sounds which are not yet loaded on a pool of worker threads, then create their mixer sounds
+
+			if (!this->BeginPreload(vSoundFiles))
+				return 0;
+
+			//Start decoding
+			size_t uiWorkerCount = std::thread::hardware_concurrency();
+			if ((!uiWorkerCount) || (uiWorkerCount > SND_MAX_DECODE_WORKERS)) {
+				uiWorkerCount = SND_MAX_DECODE_WORKERS;
+			}
+
+			if (uiWorkerCount > this->m_vPreloadJobs.size()) {
+				uiWorkerCount = this->m_vPreloadJobs.size();
+			}
+
+			std::atomic<size_t> uiNextJob(0);
+			std::vector<std::thread*> vWorkers;
+
+			for (size_t i = 0; i < uiWorkerCount; i++) {
+				vWorkers.push_back(new std::thread(&CDxSound::DecodeWorker, &this->m_vPreloadJobs, &uiNextJob));
+			}
+
+			for (size_t i = 0; i < vWorkers.size(); i++) {
+				vWorkers[i]->join();
+				delete vWorkers[i];
+			}
+
+			return this->EndPreload();
+		}
+
+		bool Play(HDXSOUND hSound, const long iVolume, const DWORD dwFlags, const bool bOnPreviousPosition = false, const int iPriority = SND_PRIORITY_NORMAL)
 		{
 			//Play sound
 
@@ -286,46 +916,160 @@ namespace DxSound {
 			if (!this->IsValidHandle(hSound))
 				return false;
 
-			DWORD dwPlayPos = 0;
+			//A looped or resumed voice replaces the looped voice of a positional sound
+			if (((dwFlags & SND_PLAY_LOOPING) == SND_PLAY_LOOPING) || (bOnPreviousPosition)) {
+				this->RemoveEmitter(hSound);
+			}
+
+			return this->PlayVoice(hSound, this->GetVolumeGain(iVolume), 0.0f, dwFlags, bOnPreviousPosition, iPriority);
+		}
+
+		bool PlayAt(HDXSOUND hSound, const long iVolume, float fPosX, float fPosY, float fFalloffDistance, const DWORD dwFlags, const int iPriority = SND_PRIORITY_NORMAL)
+		{
+			//Play sound emitted at a world position. Gain falls off with the distance to the listener and pan follows the horizontal offset.
+			//Sounds which would be inaudible are culled before a voice is started. Looped sounds follow the listener until they are stopped
+
+			//Validate handle
+			if (!this->IsValidHandle(hSound))
+				return false;
+
+			if (fFalloffDistance <= 0.0f)
+				return this->Play(hSound, iVolume, dwFlags, false, iPriority);
 
-			//Get position if desired
-			if (bOnPreviousPosition) {
-				this->m_vSounds[hSound].pSoundBuffer->GetCurrentPosition(&dwPlayPos, nullptr);
+			bool bLooping = (dwFlags & SND_PLAY_LOOPING) == SND_PLAY_LOOPING;
+
+			float fGain, fPan;
+			this->GetEmitterGain(iVolume, fPosX - this->m_fListenerX, fPosY - this->m_fListenerY, fFalloffDistance, fGain, fPan);
+
+			//Looped sounds are kept since they may come into range later
+			if ((fGain < SND_AUDIBLE_GAIN) && (!bLooping)) {
+				this->m_sFrameStats.uiCulled++;
+				return false;
 			}
 
-			//Set position
-			if (FAILED(this->m_vSounds[hSound].pSoundBuffer->SetCurrentPosition(dwPlayPos)))
+			if (bLooping) {
+				this->RemoveEmitter(hSound);
+			}
+
+			if (!this->PlayVoice(hSound, fGain, fPan, dwFlags, false, iPriority))
 				return false;
 
-			//Set volume
-			//if (FAILED(this->m_vSounds[hSound].pSoundBuffer->SetVolume(iVolume)))
-			//	return false;
-			#define SND_MAX_ATTENUATION 10000
-			#define SND_TO_ATTENUATION(indicator) (indicator * 10 * SND_MAX_ATTENUATION / 100 - SND_MAX_ATTENUATION)
-			this->m_vSounds[hSound].pSoundBuffer->SetVolume(SND_TO_ATTENUATION(((this->m_lGlobalVolume != -1) ? this->m_lGlobalVolume : iVolume)));
+			if (bLooping) {
+				emitter_s sEmitter;
+				sEmitter.hSound = hSound;
+				sEmitter.iVolume = iVolume;
+				sEmitter.fPosX = fPosX;
+				sEmitter.fPosY = fPosY;
+				sEmitter.fFalloffDistance = fFalloffDistance;
+				sEmitter.fGain = fGain;
+				sEmitter.fPan = fPan;
+				this->m_vEmitters.push_back(sEmitter);
+			}
 
-			//Play sound
-			return SUCCEEDED(this->m_vSounds[hSound].pSoundBuffer->Play(0, 0, dwFlags));
+			return true;
 		}
 
 		bool StopSound(HDXSOUND hSound)
 		{
-			//Stop playing given sound
+			//Stop all voices of given sound
 
 			//Validate handle
 			if (!this->IsValidHandle(hSound))
 				return false;
 
-			return SUCCEEDED(this->m_vSounds[hSound].pSoundBuffer->Stop());
+			this->RemoveEmitter(hSound);
+
+			//Sounds still being decoded have no voices
+			if ((!this->m_pMixer) || (!this->m_vSounds[hSound].pMixerSound))
+				return false;
+
+			return this->m_pMixer->StopSound(this->m_vSounds[hSound].pMixerSound);
 		}
 
 		void StopAll(void)
 		{
 			//Stop all sounds
 
-			for (size_t i = 0; i < this->m_vSounds.size(); i++) {
-				this->StopSound(i);
+			this->m_vEmitters.clear();
+
+			if (this->m_pMixer) {
+				this->m_pMixer->StopAll();
+			}
+		}
+
+		void Process(void)
+		{
+			//Update looped positional sounds and statistics once per frame
+
+			this->UpdateEmitters();
+
+			if (this->m_pMixer) {
+				//Mixer counters are cumulative
+				mixer_stats_s sMixerStats;
+				this->m_pMixer->GetStats(sMixerStats);
+
+				this->m_sFrameStats.uiActive = sMixerStats.uiActive;
+				this->m_sFrameStats.uiStarted = sMixerStats.uiStarted - this->m_sLastMixerStats.uiStarted;
+				this->m_sFrameStats.uiStolen = sMixerStats.uiStolen - this->m_sLastMixerStats.uiStolen;
+				this->m_sFrameStats.uiRejected += sMixerStats.uiRejected - this->m_sLastMixerStats.uiRejected;
+
+				this->m_sLastMixerStats = sMixerStats;
+			}
+
+			this->m_sFrameStats.uiPeak = (this->m_sFrameStats.uiActive > this->m_sLastFrameStats.uiPeak) ? this->m_sFrameStats.uiActive : this->m_sLastFrameStats.uiPeak;
+
+			this->m_sLastFrameStats = this->m_sFrameStats;
+
+			memset(&this->m_sFrameStats, 0x00, sizeof(voice_stats_s));
+		}
+
+		void ResetPeak(void)
+		{
+			//Reset peak voice count
+
+			this->m_sLastFrameStats.uiPeak = 0;
+		}
+
+		void SetMaxVoices(size_t uiMaxVoices)
+		{
+			//Set maximum amount of simultaneously playing voices
+
+			uiMaxVoices = (uiMaxVoices) ? uiMaxVoices : 1;
+
+			if ((this->m_pMixer) && (uiMaxVoices != this->m_uiMaxVoices)) {
+				this->m_pMixer->SetMaxVoices(uiMaxVoices);
+			}
+
+			this->m_uiMaxVoices = uiMaxVoices;
+		}
+
+		void SetListenerPosition(float fPosX, float fPosY)
+		{
+			//Set world position positional sounds are heard from
+
+			this->m_fListenerX = fPosX;
+			this->m_fListenerY = fPosY;
+		}
+
+		bool DetachArchive(const Pak::CArchive* pArchive)
+		{
+			//Copy file data of streams which is used in place from the archive, so that the archive can be unmounted. Playing streams continue
+
+			bool bResult = true;
+
+			for (size_t i = 0; i < this->m_vSounds.size() + this->m_vRetiredSounds.size(); i++) {
+				mixer_sound_s* pMixerSound = (i < this->m_vSounds.size()) ? this->m_vSounds[i].pMixerSound : this->m_vRetiredSounds[i - this->m_vSounds.size()];
+				if ((!pMixerSound) || (!pMixerSound->pStream))
+					continue;
+
+				std::lock_guard<std::mutex> oLock(pMixerSound->pStream->oSourceLock);
+
+				if (!((CStreamSource*)pMixerSound->pStream->pSource)->DetachArchive(pArchive)) {
+					bResult = false;
+				}
 			}
+
+			return bResult;
 		}
 
 		void SetGlobalVolume(const long iVolume)
@@ -335,7 +1079,21 @@ namespace DxSound {
 			this->m_lGlobalVolume = iVolume;
 		}
 
-		const long GetGlobalVolume(void) const { return this->m_lGlobalVolume; } //Getter
+		//Getters
+		const long GetGlobalVolume(void) const { return this->m_lGlobalVolume; }
+		const voice_stats_s& GetVoiceStats(void) const { return this->m_sLastFrameStats; }
+		size_t GetMaxVoices(void) const { return this->m_uiMaxVoices; }
+		const mixer_stats_s& GetMixerStats(void) const { return this->m_sLastMixerStats; }
+		size_t GetResidentMemory(void) const
+		{
+			size_t uiResult = 0;
+
+			for (size_t i = 0; i < this->m_vSounds.size(); i++) {
+				uiResult += this->m_vSounds[i].dwResidentSize;
+			}
+
+			return uiResult;
+		}
 	};
 }
 
@@ -419,4 +419,18 @@ namespace Utils {
 
 		return false;
 	}
+
+	unsigned int HashData(const void* pData, size_t uiSize, unsigned int uiHash)
+	{
+		//Hash data using FNV-1a
+
+		const byte* pBytes = (const byte*)pData;
+
+		for (size_t i = 0; i < uiSize; i++) {
+			uiHash ^= pBytes[i];
+			uiHash *= 16777619;
+		}
+
+		return uiHash;
+	}
 }
\ No newline at end of file
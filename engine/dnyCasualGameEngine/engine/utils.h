@@ -36,4 +36,46 @@ namespace Utils {
 	bool RemoveEntireDirectory(const std::wstring& wszDirectory);
 	bool CopyEntireDirectory(const std::wstring& wszFrom, const std::wstring& wszTo);
 	bool CreateRestartScript(void);
+	unsigned int HashData(const void* pData, size_t uiSize, unsigned int uiHash = 2166136261);
+
+	/* Seedable pseudo random number generator (xorshift32) */
+	class CRandom {
+	private:
+		unsigned int m_uiState;
+	public:
+		CRandom() : m_uiState(0x9E3779B9) {}
+		CRandom(unsigned int uiSeed) { this->Seed(uiSeed); }
+		~CRandom() {}
+
+		void Seed(unsigned int uiSeed)
+		{
+			//Set generator state. A state of zero would stick at zero
+
+			this->m_uiState = (uiSeed) ? uiSeed : 0x9E3779B9;
+		}
+
+		unsigned int Next(void)
+		{
+			//Generate next number
+
+			this->m_uiState ^= this->m_uiState << 13;
+			this->m_uiState ^= this->m_uiState >> 17;
+			this->m_uiState ^= this->m_uiState << 5;
+
+			return this->m_uiState;
+		}
+
+		int Range(int iStart, int iEnd)
+		{
+			//Generate number in range [iStart, iEnd)
+
+			if (iEnd <= iStart)
+				return iStart;
+
+			return (int)(this->Next() % (unsigned int)(iEnd - iStart)) + iStart;
+		}
+
+		//Getter
+		unsigned int GetState(void) const { return this->m_uiState; }
+	};
 }
\ No newline at end of file
@@ -33,6 +33,23 @@ ConfigMgr::CCVar::cvar_s* pGfxFullscreen = nullptr;
 ConfigMgr::CCVar::cvar_s* pSndVolume = nullptr;
 ConfigMgr::CCVar::cvar_s* pSndPlayMusic = nullptr;
 
+ConfigMgr::CCVar::cvar_s* pSimDeterministic = nullptr;
+ConfigMgr::CCVar::cvar_s* pSimTickRate = nullptr;
+ConfigMgr::CCVar::cvar_s* pSimSeed = nullptr;
+ConfigMgr::CCVar::cvar_s* pSimHashLog = nullptr;
+ConfigMgr::CCVar::cvar_s* pGameAutoSave = nullptr;
+ConfigMgr::CCVar::cvar_s* pGamePrefetch = nullptr;
+ConfigMgr::CCVar::cvar_s* pGameMapCache = nullptr;
+ConfigMgr::CCVar::cvar_s* pGameLoadWorkers = nullptr;
+ConfigMgr::CCVar::cvar_s* pGameResidentBudget = nullptr;
+ConfigMgr::CCVar::cvar_s* pRewindEnable = nullptr;
+ConfigMgr::CCVar::cvar_s* pRewindSeconds = nullptr;
+ConfigMgr::CCVar::cvar_s* pRewindInterval = nullptr;
+ConfigMgr::CCVar::cvar_s* pConLogFile = nullptr;
+ConfigMgr::CCVar::cvar_s* pSndMaxVoices = nullptr;
+ConfigMgr::CCVar::cvar_s* pSndDevice = nullptr;
+ConfigMgr::CCVar::cvar_s* pSndFalloffDist = nullptr;
+
 Input::CInputMgr g_oInputMgr;
 
 Achievements::CSteamAchievements* pAchievements = nullptr;
@@ -41,4 +58,6 @@ DxRenderer::d3dfont_s* pDefaultFont = nullptr;
 int iDefaultFontSize[2];
 
 Localization::CLocalizationMgr oEngineLocaleMgr;
-Localization::CLocalizationMgr oPackageLocaleMgr;
\ No newline at end of file
+Localization::CLocalizationMgr oPackageLocaleMgr;
+Pak::CArchiveSet oArchiveSet;
+Vfs::CFileSystem oFileSystem;
\ No newline at end of file
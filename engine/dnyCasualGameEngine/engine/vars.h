@@ -44,6 +44,23 @@ extern ConfigMgr::CCVar::cvar_s* pGfxFullscreen;
 extern ConfigMgr::CCVar::cvar_s* pSndVolume;
 extern ConfigMgr::CCVar::cvar_s* pSndPlayMusic;
 
+extern ConfigMgr::CCVar::cvar_s* pSimDeterministic;
+extern ConfigMgr::CCVar::cvar_s* pSimTickRate;
+extern ConfigMgr::CCVar::cvar_s* pSimSeed;
+extern ConfigMgr::CCVar::cvar_s* pSimHashLog;
+extern ConfigMgr::CCVar::cvar_s* pGameAutoSave;
+extern ConfigMgr::CCVar::cvar_s* pGamePrefetch;
+extern ConfigMgr::CCVar::cvar_s* pGameMapCache;
+extern ConfigMgr::CCVar::cvar_s* pGameLoadWorkers;
+extern ConfigMgr::CCVar::cvar_s* pGameResidentBudget;
+extern ConfigMgr::CCVar::cvar_s* pRewindEnable;
+extern ConfigMgr::CCVar::cvar_s* pRewindSeconds;
+extern ConfigMgr::CCVar::cvar_s* pRewindInterval;
+extern ConfigMgr::CCVar::cvar_s* pConLogFile;
+extern ConfigMgr::CCVar::cvar_s* pSndMaxVoices;
+extern ConfigMgr::CCVar::cvar_s* pSndDevice;
+extern ConfigMgr::CCVar::cvar_s* pSndFalloffDist;
+
 extern Input::CInputMgr g_oInputMgr;
 
 extern Achievements::CSteamAchievements* pAchievements;
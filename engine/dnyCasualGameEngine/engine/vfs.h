@@ -0,0 +1,252 @@
+#pragma once
+
+/*
+	Casual Game Engine (dnyCasualGameEngine) developed by Daniel Brendel
+
+	(C) 2021 - 2022 by Daniel Brendel
+
+	Contact: dbrendel1988<at>gmail<dot>com
+	GitHub: https://github.com/danielbrendel/
+
+	Released under the MIT license
+*/
+
+#include "shared.h"
+#include "utils.h"
+#include "configmgr.h"
+#include "pak.h"
+
+/* Virtual file system environment */
+namespace Vfs {
+	struct file_entry_s {
+		std::wstring wszPath; //Normalized path relative to the mount directory
+		std::wstring wszFullPath; //Full path on disk or below the directory an archive is mounted over
+		size_t uiMount; //Index of the mount that provides the file
+		size_t uiSize;
+	};
+
+	struct file_view_s {
+		const byte* pData; //Either owned or a view into a mapped archive
+		size_t uiSize;
+		bool bOwned;
+	};
+
+	/* Indexes mounted directories once and resolves files in mount order. Earlier mounts overlay later ones */
+	class CFileSystem {
+	private:
+		std::vector<std::wstring> m_vMounts;
+		std::vector<std::wstring> m_vMountKeys; //Normalized mount directories to match full paths against
+		std::vector<file_entry_s> m_vFiles;
+		ConfigMgr::CNameIndex m_oIndex; //Path hash index of m_vFiles
+		double m_dblIndexTime;
+
+		void IndexDirectory(const std::wstring& wszDir, const std::wstring& wszRelPath, size_t uiMount)
+		{
+			//Add all files of a directory and its sub directories that are not provided by an earlier mount
+
+			WIN32_FIND_DATA sFindData = { 0 };
+
+			HANDLE hFileSearch = FindFirstFile((wszDir + L"\\*.*").c_str(), &sFindData);
+			if (hFileSearch == INVALID_HANDLE_VALUE)
+				return;
+
+			do {
+				if ((!wcscmp(sFindData.cFileName, L".")) || (!wcscmp(sFindData.cFileName, L"..")))
+					continue;
+
+				std::wstring wszRelFile = wszRelPath + sFindData.cFileName;
+
+				if ((sFindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY) {
+					this->IndexDirectory(wszDir + L"\\" + sFindData.cFileName, wszRelFile + L"\\", uiMount);
+					continue;
+				}
+
+				file_entry_s sEntry;
+				sEntry.wszPath = Pak::NormalizePath(wszRelFile);
+
+				if (this->Find(sEntry.wszPath))
+					continue;
+
+				sEntry.wszFullPath = wszDir + L"\\" + sFindData.cFileName;
+				sEntry.uiMount = uiMount;
+				sEntry.uiSize = (size_t)(((unsigned long long)sFindData.nFileSizeHigh << 32) | sFindData.nFileSizeLow);
+
+				this->m_vFiles.push_back(sEntry);
+				this->m_oIndex.Insert(ConfigMgr::HashName(sEntry.wszPath), this->m_vFiles.size() - 1);
+			} while (FindNextFile(hFileSearch, &sFindData));
+
+			FindClose(hFileSearch);
+		}
+
+		void IndexArchive(const Pak::CArchive* pArchive, const std::wstring& wszDir, size_t uiMount)
+		{
+			//Add all entries of an archive that are not provided by an earlier mount
+
+			for (size_t i = 0; i < pArchive->GetEntryCount(); i++) {
+				const Pak::entry_s& rEntry = pArchive->GetEntry(i);
+
+				if (this->Find(rEntry.wszPath))
+					continue;
+
+				file_entry_s sEntry;
+				sEntry.wszPath = rEntry.wszPath;
+				sEntry.wszFullPath = wszDir + L"\\" + rEntry.wszPath;
+				sEntry.uiMount = uiMount;
+				sEntry.uiSize = rEntry.uiSize;
+
+				this->m_vFiles.push_back(sEntry);
+				this->m_oIndex.Insert(ConfigMgr::HashName(sEntry.wszPath), this->m_vFiles.size() - 1);
+			}
+		}
+	public:
+		CFileSystem() : m_dblIndexTime(0.0) {}
+		~CFileSystem() { this->Clear(); }
+
+		void Clear(void)
+		{
+			//Remove all mounts
+
+			this->m_vMounts.clear();
+			this->m_vMountKeys.clear();
+			this->m_vFiles.clear();
+			this->m_oIndex.Clear();
+			this->m_dblIndexTime = 0.0;
+		}
+
+		bool Mount(const std::wstring& wszDir)
+		{
+			//Index directory below all previous mounts. An archive mounted over the directory takes precedence over its loose files
+
+			std::wstring wszMountDir = wszDir;
+			while ((wszMountDir.length()) && ((wszMountDir[wszMountDir.length() - 1] == L'\\') || (wszMountDir[wszMountDir.length() - 1] == L'/'))) {
+				wszMountDir.pop_back();
+			}
+
+			const Pak::CArchive* pArchive = oArchiveSet.FindArchive(wszMountDir);
+
+			if ((!pArchive) && (!Utils::DirExists(wszMountDir)))
+				return false;
+
+			LONGLONG lFrequency, lStart, lEnd;
+			QueryPerformanceFrequency((LARGE_INTEGER*)&lFrequency);
+			QueryPerformanceCounter((LARGE_INTEGER*)&lStart);
+
+			this->m_vMounts.push_back(wszMountDir);
+			this->m_vMountKeys.push_back(Pak::NormalizePath(wszMountDir));
+
+			if (pArchive) {
+				this->IndexArchive(pArchive, wszMountDir, this->m_vMounts.size() - 1);
+			}
+
+			this->IndexDirectory(wszMountDir, L"", this->m_vMounts.size() - 1);
+
+			QueryPerformanceCounter((LARGE_INTEGER*)&lEnd);
+			this->m_dblIndexTime += (double)(lEnd - lStart) * 1000.0 / (double)lFrequency;
+
+			return true;
+		}
+
+		const file_entry_s* Find(const std::wstring& wszPath) const
+		{
+			//Find entry by normalized path
+
+			size_t uiEntry = this->m_oIndex.Find(ConfigMgr::HashName(wszPath), [&](size_t uiFile) { return this->m_vFiles[uiFile].wszPath == wszPath; });
+			if (uiEntry == CM_INVALID_LIST_ID)
+				return nullptr;
+
+			return &this->m_vFiles[uiEntry];
+		}
+
+		bool Exists(const std::wstring& wszPath) const
+		{
+			//Check if a file is provided by any mount
+
+			return this->Find(Pak::NormalizePath(wszPath)) != nullptr;
+		}
+
+		bool Resolve(const std::wstring& wszPath, std::wstring& wszFullPath) const
+		{
+			//Get full path of the file of the topmost mount providing it
+
+			const file_entry_s* pEntry = this->Find(Pak::NormalizePath(wszPath));
+			if (!pEntry)
+				return false;
+
+			wszFullPath = pEntry->wszFullPath;
+
+			return true;
+		}
+
+		bool ResolveRead(const std::wstring& wszPath, std::wstring& wszFullPath) const
+		{
+			//Get full path to read a file from. Paths relative to the mounts and full paths below a mount are answered by the index,
+			//other paths (e.g. menu media) are passed through to the disk
+
+			std::wstring wszNormPath = Pak::NormalizePath(wszPath);
+
+			for (size_t i = 0; i < this->m_vMountKeys.size(); i++) {
+				const std::wstring& rMount = this->m_vMountKeys[i];
+
+				if ((wszNormPath.length() > rMount.length()) && (wszNormPath[rMount.length()] == L'\\') && (!wszNormPath.compare(0, rMount.length(), rMount))) {
+					const file_entry_s* pEntry = this->Find(wszNormPath.substr(rMount.length() + 1));
+					if (!pEntry)
+						return false;
+
+					//A file of a lower mount that is overlaid by an earlier one is still read from where the caller expects it
+					wszFullPath = (pEntry->uiMount == i) ? pEntry->wszFullPath : wszPath;
+
+					return true;
+				}
+			}
+
+			const file_entry_s* pEntry = this->Find(wszNormPath);
+
+			wszFullPath = (pEntry) ? pEntry->wszFullPath : wszPath;
+
+			return true;
+		}
+
+		bool MapFile(const std::wstring& wszPath, file_view_s& rView) const
+		{
+			//Get data of a file by a path relative to the mounts or by a full path. Packed files are used in place, others are read from disk.
+			//The view must be passed to ReleaseView when done
+
+			rView.pData = nullptr;
+			rView.uiSize = 0;
+			rView.bOwned = false;
+
+			std::wstring wszFullPath;
+			if (!this->ResolveRead(wszPath, wszFullPath))
+				return false;
+
+			if (oArchiveSet.GetFile(wszFullPath, rView.pData, rView.uiSize))
+				return true;
+
+			rView.pData = Utils::ReadEntireFile(wszFullPath, rView.uiSize);
+			rView.bOwned = rView.pData != nullptr;
+
+			return rView.bOwned;
+		}
+
+		static void ReleaseView(file_view_s& rView)
+		{
+			//Free data of a view if it has been read from disk
+
+			if (rView.bOwned) {
+				free((void*)rView.pData);
+			}
+
+			rView.pData = nullptr;
+			rView.uiSize = 0;
+			rView.bOwned = false;
+		}
+
+		//Getters
+		size_t GetMountCount(void) const { return this->m_vMounts.size(); }
+		const std::wstring& GetMount(size_t uiMount) const { return this->m_vMounts[uiMount]; }
+		size_t GetFileCount(void) const { return this->m_vFiles.size(); }
+		double GetIndexTime(void) const { return this->m_dblIndexTime; }
+	};
+}
+
+extern Vfs::CFileSystem oFileSystem;
@@ -0,0 +1,296 @@
+#pragma once
+
+/*
+	Casual Game Engine (dnyCasualGameEngine) developed by Daniel Brendel
+
+	(C) 2021 - 2022 by Daniel Brendel
+
+	Contact: dbrendel1988<at>gmail<dot>com
+	GitHub: https://github.com/danielbrendel/
+
+	Released under the MIT license
+*/
+
+#include "shared.h"
+#include "entity.h"
+#include "configmgr.h"
+#include "vfs.h"
+
+/* Headless world environment */
+namespace Entity {
+	#define WR_MAX_WORLDS 64
+	#define WR_MAX_LOG_LINES 256
+	#define WR_PLACEHOLDER_SPRITE ((DxRenderer::HD3DSPRITE)1) //Handed to headless worlds, which keep sprite handles but never draw them
+
+	/* World simulated without window, sound device or HUD. It owns a script engine of its own, so several
+	   headless worlds can be ticked on separate threads */
+	class CHeadlessWorld : public IWorldHost {
+	private:
+		struct script_s {
+			std::wstring wszIdent;
+			Scripting::HSISCRIPT hScript;
+		};
+
+		Scripting::CScriptInt m_oScriptInt;
+		CWorld m_oWorld;
+		std::vector<script_s> m_vScripts;
+		std::vector<std::wstring> m_vLog;
+		size_t m_uiDroppedLines;
+		std::wstring m_wszPakPath;
+		unsigned long long m_ullTicks;
+		bool m_bPlayerRemoved;
+
+		static const std::wstring& Item(const ConfigMgr::CScriptParser::TExpression& rExpression, size_t uiId)
+		{
+			//Get expression item, missing items are empty
+
+			static const std::wstring wszEmpty;
+
+			return (uiId < rExpression.size()) ? rExpression[uiId] : wszEmpty;
+		}
+
+		Scripting::HSISCRIPT RequireScript(const std::wstring& wszIdent)
+		{
+			//Load entity script into the engine of this world if not already loaded
+
+			Scripting::HSISCRIPT hScript = this->ResolveScript(wszIdent);
+			if (hScript != SI_INVALID_ID)
+				return hScript;
+
+			std::wstring wszFullFilePath;
+			if (!oFileSystem.Resolve(L"entities\\" + wszIdent + L".as", wszFullFilePath)) {
+				this->Log(L"Entity script does not exist: " + wszIdent);
+				return SI_INVALID_ID;
+			}
+
+			hScript = this->m_oScriptInt.LoadScript(Utils::ConvertToAnsiString(wszFullFilePath));
+			if (hScript == SI_INVALID_ID) {
+				this->Log(L"Failed to load entity script: " + wszFullFilePath);
+				return SI_INVALID_ID;
+			}
+
+			script_s sScript;
+			sScript.wszIdent = wszIdent;
+			sScript.hScript = hScript;
+			this->m_vScripts.push_back(sScript);
+
+			return hScript;
+		}
+
+		bool SpawnEntity(const std::wstring& wszIdent, int x, int y, float rot, const std::wstring& wszProps)
+		{
+			//Let the entity script create the entity, same as map loading of the game does
+
+			Scripting::HSISCRIPT hScript = this->RequireScript(wszIdent);
+			if (hScript == SI_INVALID_ID)
+				return false;
+
+			Vector vecPos(x, y);
+			std::string szIdent = Utils::ConvertToAnsiString(wszIdent);
+			std::string szPath = Utils::ConvertToAnsiString(this->m_wszPakPath + L"\\");
+			std::string szProps = Utils::ConvertToAnsiString(wszProps);
+
+			BEGIN_PARAMS(vArgs);
+			PUSH_OBJECT(&vecPos);
+			PUSH_FLOAT(rot);
+			PUSH_OBJECT(&szIdent);
+			PUSH_OBJECT(&szPath);
+			PUSH_OBJECT(&szProps);
+
+			bool bResult = this->m_oScriptInt.CallScriptFunction(hScript, true, "CreateEntity", &vArgs, nullptr, Scripting::FA_VOID);
+
+			END_PARAMS(vArgs);
+
+			if (!bResult) {
+				this->Log(L"Failed to call CreateEntity() of " + wszIdent);
+			}
+
+			return bResult;
+		}
+	public:
+		CHeadlessWorld() : m_uiDroppedLines(0), m_ullTicks(0), m_bPlayerRemoved(false) {}
+		~CHeadlessWorld() { this->Release(); }
+
+		bool Initialize(void* pMessageCallback, const world_settings_s& sSettings, unsigned int uiSeed, const std::wstring& wszPakPath)
+		{
+			//Create script engine and register the scripting interface with it
+
+			if (!this->m_oScriptInt.Initialize("", pMessageCallback))
+				return false;
+
+			if (!RegisterScriptingInterface(&this->m_oScriptInt))
+				return false;
+
+			this->m_oWorld.Bind(&this->m_oScriptInt, this);
+			this->m_oWorld.Settings() = sSettings;
+			this->m_oWorld.ResetSimulation(uiSeed);
+			this->m_wszPakPath = wszPakPath;
+
+			return true;
+		}
+
+		void LoadMap(const std::vector<ConfigMgr::CScriptParser::TExpression>& vExpressions)
+		{
+			//Build world from a compiled map script. Expressions which only configure presentation are ignored.
+			//Like map loading of the game, entities which fail to spawn are logged and skipped
+
+			CWorld* pPrevWorld = GetActiveWorld();
+			SetActiveWorld(&this->m_oWorld);
+
+			for (size_t i = 0; i < vExpressions.size(); i++) {
+				const ConfigMgr::CScriptParser::TExpression& rExpression = vExpressions[i];
+				const std::wstring& wszCommand = Item(rExpression, 0);
+
+				if (wszCommand == L"ent_require") {
+					this->RequireScript(Item(rExpression, 1));
+				} else if (wszCommand == L"ent_spawn") {
+					this->SpawnEntity(Item(rExpression, 1), _wtoi(Item(rExpression, 2).c_str()), _wtoi(Item(rExpression, 3).c_str()), (float)_wtof(Item(rExpression, 4).c_str()), Item(rExpression, 5));
+				} else if (wszCommand == L"env_solidsprite") {
+					CSolidSprite oSprite;
+					oSprite.Initialize(_wtoi(Item(rExpression, 2).c_str()), _wtoi(Item(rExpression, 3).c_str()), _wtoi(Item(rExpression, 4).c_str()), _wtoi(Item(rExpression, 5).c_str()),
+						Item(rExpression, 1), _wtoi(Item(rExpression, 7).c_str()), _wtoi(Item(rExpression, 8).c_str()), (float)_wtof(Item(rExpression, 6).c_str()), Item(rExpression, 9) == L"true");
+
+					this->m_oWorld.AddSolidSprite(oSprite);
+				} else if (wszCommand == L"env_goal") {
+					this->m_oWorld.SpawnGoal(_wtoi(Item(rExpression, 1).c_str()), _wtoi(Item(rExpression, 2).c_str()), Item(rExpression, 3));
+				}
+			}
+
+			SetActiveWorld(pPrevWorld);
+		}
+
+		void Run(unsigned long long ullTicks)
+		{
+			//Tick world on the calling thread until the tick count is reached or the player has been removed
+
+			CWorld* pPrevWorld = GetActiveWorld();
+			SetActiveWorld(&this->m_oWorld);
+
+			while ((this->m_ullTicks < ullTicks) && (!this->m_bPlayerRemoved)) {
+				this->m_oWorld.Process();
+				this->m_ullTicks++;
+			}
+
+			SetActiveWorld(pPrevWorld);
+		}
+
+		void Release(void)
+		{
+			//Release entities while the world is bound, so their sprites go back to this host
+
+			CWorld* pPrevWorld = GetActiveWorld();
+			SetActiveWorld(&this->m_oWorld);
+
+			this->m_oWorld.Release();
+
+			SetActiveWorld(pPrevWorld);
+
+			for (size_t i = 0; i < this->m_vScripts.size(); i++) {
+				this->m_oScriptInt.UnloadScript(this->m_vScripts[i].hScript);
+			}
+
+			this->m_vScripts.clear();
+		}
+
+		//World host interface
+		virtual Scripting::HSISCRIPT ResolveScript(const std::wstring& wszIdent)
+		{
+			for (size_t i = 0; i < this->m_vScripts.size(); i++) {
+				if (this->m_vScripts[i].wszIdent == wszIdent)
+					return this->m_vScripts[i].hScript;
+			}
+
+			return SI_INVALID_ID;
+		}
+		virtual int GetFrameRate(void) { return this->m_oWorld.Settings().iTickRate; }
+		virtual bool IsPresenting(void) { return false; }
+		virtual DxRenderer::HD3DSPRITE LoadSprite(const std::wstring& wszFile, int iFrameCount, int iFrameWidth, int iFrameHeight, int iFramesPerLine, bool bForceCustomSize) { return WR_PLACEHOLDER_SPRITE; }
+		virtual bool FreeSprite(DxRenderer::HD3DSPRITE hSprite) { return true; }
+		virtual void OnPlayerRemoved(void) { this->m_bPlayerRemoved = true; }
+		virtual void Log(const std::wstring& wszText)
+		{
+			//Keep the first lines only, scripts may print on every tick
+
+			if (this->m_vLog.size() < WR_MAX_LOG_LINES) {
+				this->m_vLog.push_back(wszText);
+			} else {
+				this->m_uiDroppedLines++;
+			}
+		}
+
+		//Getters
+		inline CWorld& World(void) { return this->m_oWorld; }
+		inline unsigned long long GetTicks(void) const { return this->m_ullTicks; }
+		inline bool IsPlayerRemoved(void) const { return this->m_bPlayerRemoved; }
+		inline const std::vector<std::wstring>& GetLog(void) const { return this->m_vLog; }
+		inline size_t GetDroppedLines(void) const { return this->m_uiDroppedLines; }
+	};
+
+	/* Ticks several headless worlds in parallel, one thread per world. Worlds are set up on the calling thread before */
+	class CWorldRunner {
+	private:
+		std::vector<CHeadlessWorld*> m_vWorlds;
+	public:
+		CWorldRunner() {}
+		~CWorldRunner() { this->Clear(); }
+
+		CHeadlessWorld* AddWorld(void* pMessageCallback, const world_settings_s& sSettings, unsigned int uiSeed, const std::wstring& wszPakPath, const std::vector<ConfigMgr::CScriptParser::TExpression>& vExpressions)
+		{
+			//Create headless world and build it from the compiled map script
+
+			if (this->m_vWorlds.size() >= WR_MAX_WORLDS)
+				return nullptr;
+
+			//Script engines are used from the runner threads later on
+			asPrepareMultithread();
+
+			CHeadlessWorld* pWorld = new CHeadlessWorld();
+			if (!pWorld->Initialize(pMessageCallback, sSettings, uiSeed, wszPakPath)) {
+				delete pWorld;
+				return nullptr;
+			}
+
+			pWorld->LoadMap(vExpressions);
+
+			this->m_vWorlds.push_back(pWorld);
+
+			return pWorld;
+		}
+
+		void Run(unsigned long long ullTicks)
+		{
+			//Tick all worlds on threads of their own and wait for them to finish
+
+			std::vector<std::thread> vThreads;
+			vThreads.reserve(this->m_vWorlds.size());
+
+			for (size_t i = 0; i < this->m_vWorlds.size(); i++) {
+				CHeadlessWorld* pWorld = this->m_vWorlds[i];
+
+				vThreads.push_back(std::thread([pWorld, ullTicks]() {
+					pWorld->Run(ullTicks);
+					asThreadCleanup();
+				}));
+			}
+
+			for (size_t i = 0; i < vThreads.size(); i++) {
+				vThreads[i].join();
+			}
+		}
+
+		void Clear(void)
+		{
+			//Free worlds
+
+			for (size_t i = 0; i < this->m_vWorlds.size(); i++) {
+				delete this->m_vWorlds[i];
+			}
+
+			this->m_vWorlds.clear();
+		}
+
+		//Getters
+		inline size_t GetWorldCount(void) const { return this->m_vWorlds.size(); }
+		inline CHeadlessWorld* GetWorld(size_t uiId) { return (uiId < this->m_vWorlds.size()) ? this->m_vWorlds[uiId] : nullptr; }
+	};
+}
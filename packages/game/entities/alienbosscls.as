@@ -91,7 +91,7 @@ class CAlienBoss : IScriptedEntity
 			Ent_SpawnEntity("weapon_laserball", ball, this.m_vecPos);
 		}
 
-		S_PlaySound(this.m_hLaserSound, S_GetCurrentVolume());
+		S_PlaySoundAt(this.m_hLaserSound, S_GetCurrentVolume(), this.m_vecPos);
 	}
 
 	void FireLaser(IScriptedEntity@ pEntity)
@@ -127,7 +127,7 @@ class CAlienBoss : IScriptedEntity
 			Ent_SpawnEntity("weapon_laser", laser, vecBulletPos);
 		}
 
-		S_PlaySound(this.m_hLaserSound, S_GetCurrentVolume());
+		S_PlaySoundAt(this.m_hLaserSound, S_GetCurrentVolume(), this.m_vecPos);
 	}
 
 	void FireMissile(IScriptedEntity@ pEntity)
@@ -159,7 +159,7 @@ class CAlienBoss : IScriptedEntity
 			Ent_SpawnEntity("weapon_missile", missile, this.m_vecPos);
 		}
 
-		S_PlaySound(this.m_hMissileSound, S_GetCurrentVolume());
+		S_PlaySoundAt(this.m_hMissileSound, S_GetCurrentVolume(), this.m_vecPos);
 	}
 
 	void FireBolt(IScriptedEntity@ pEntity)
@@ -180,7 +180,7 @@ class CAlienBoss : IScriptedEntity
 		
 		Ent_SpawnEntity("weapon_bolt", @obj, Vector(this.m_vecPos[0] + 35, this.m_vecPos[1] + 130));
 
-		S_PlaySound(this.m_hBoltSound, S_GetCurrentVolume());
+		S_PlaySoundAt(this.m_hBoltSound, S_GetCurrentVolume(), this.m_vecPos);
 	}
 
 	void Fire(IScriptedEntity@ pEntity)
@@ -452,4 +452,16 @@ class CAlienBoss : IScriptedEntity
 			Props_CreateProperty("y", formatInt(this.m_vecPos[1])) +
 			Props_CreateProperty("rot", formatFloat(this.m_fRotation));
 	}
+	
+	//Return data stored in binary snapshots
+	string SaveSnapshot()
+	{
+		return Props_CreateProperty("health", formatInt(this.m_uiHealth));
+	}
+	
+	//Restore data from binary snapshots
+	void RestoreSnapshot(const string &in data)
+	{
+		this.m_uiHealth = parseInt(Props_ExtractValue(data, "health"));
+	}
 }
@@ -69,7 +69,7 @@ class CAlienInfantry : IScriptedEntity
 
 		Ent_SpawnEntity("weapon_missile", missile, this.m_vecPos);
 
-		S_PlaySound(this.m_hAttackSound, S_GetCurrentVolume());
+		S_PlaySoundAt(this.m_hAttackSound, S_GetCurrentVolume(), this.m_vecPos);
 	}
 	
 	void CheckForEnemiesInRange()
@@ -314,4 +314,16 @@ class CAlienInfantry : IScriptedEntity
 			Props_CreateProperty("y", formatInt(this.m_vecPos[1])) +
 			Props_CreateProperty("rot", formatFloat(this.m_fRotation));
 	}
+	
+	//Return data stored in binary snapshots
+	string SaveSnapshot()
+	{
+		return Props_CreateProperty("health", formatInt(this.m_uiHealth));
+	}
+	
+	//Restore data from binary snapshots
+	void RestoreSnapshot(const string &in data)
+	{
+		this.m_uiHealth = parseInt(Props_ExtractValue(data, "health"));
+	}
 }
@@ -84,7 +84,7 @@ class CAlienVehicle : IScriptedEntity
 			Ent_SpawnEntity("weapon_laserball", ball, this.m_vecPos);
 		}
 
-		S_PlaySound(this.m_hAttackSound, S_GetCurrentVolume());
+		S_PlaySoundAt(this.m_hAttackSound, S_GetCurrentVolume(), this.m_vecPos);
 	}
 	
 	void CheckForEnemiesInRange()
@@ -329,4 +329,16 @@ class CAlienVehicle : IScriptedEntity
 			Props_CreateProperty("y", formatInt(this.m_vecPos[1])) +
 			Props_CreateProperty("rot", formatFloat(this.m_fRotation));
 	}
+	
+	//Return data stored in binary snapshots
+	string SaveSnapshot()
+	{
+		return Props_CreateProperty("health", formatInt(this.m_uiHealth));
+	}
+	
+	//Restore data from binary snapshots
+	void RestoreSnapshot(const string &in data)
+	{
+		this.m_uiHealth = parseInt(Props_ExtractValue(data, "health"));
+	}
 }
@@ -72,7 +72,7 @@ class CBallista : IScriptedEntity
 		arrow.SetRotation(this.m_fRotation);
 		Ent_SpawnEntity("weapon_arrow", @arrow, this.m_vecPos);
 
-		S_PlaySound(this.m_hAttackSound, S_GetCurrentVolume());
+		S_PlaySoundAt(this.m_hAttackSound, S_GetCurrentVolume(), this.m_vecPos);
 	}
 	
 	void CheckForEnemiesInRange()
@@ -340,4 +340,16 @@ class CBallista : IScriptedEntity
 			Props_CreateProperty("y", formatInt(this.m_vecPos[1])) +
 			Props_CreateProperty("rot", formatFloat(this.m_fRotation));
 	}
+	
+	//Return data stored in binary snapshots
+	string SaveSnapshot()
+	{
+		return Props_CreateProperty("health", formatInt(this.m_uiHealth));
+	}
+	
+	//Restore data from binary snapshots
+	void RestoreSnapshot(const string &in data)
+	{
+		this.m_uiHealth = parseInt(Props_ExtractValue(data, "health"));
+	}
 }
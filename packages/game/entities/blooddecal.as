@@ -145,4 +145,15 @@ class CBloodSplash : IScriptedEntity
 			Props_CreateProperty("y", formatInt(this.m_vecPos[1])) +
 			Props_CreateProperty("rot", formatFloat(this.GetRotation()));
 	}
+	
+	//Decals carry no state besides the position, which is stored natively
+	string SaveSnapshot()
+	{
+		return "";
+	}
+	
+	//Implemented so that decals spawned during play are spawned again when a snapshot is restored
+	void RestoreSnapshot(const string &in data)
+	{
+	}
 }
\ No newline at end of file
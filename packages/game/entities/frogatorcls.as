@@ -80,7 +80,7 @@ class CFrogator : IScriptedEntity
 		
 		Ent_SpawnEntity("weapon_bolt", @obj, Vector(this.m_vecPos[0] + 35, this.m_vecPos[1] + 130));
 
-		S_PlaySound(this.m_hAttackSound, S_GetCurrentVolume());
+		S_PlaySoundAt(this.m_hAttackSound, S_GetCurrentVolume(), this.m_vecPos);
 	}
 	
 	void CheckForEnemiesInRange()
@@ -188,7 +188,7 @@ class CFrogator : IScriptedEntity
 		Ent_SpawnEntity("blooddecal", @obj, this.m_vecPos);
 		
 		SoundHandle hSplash = S_QuerySound(GetPackagePath() + "sound\\hc_splash.wav");
-		S_PlaySound(hSplash, S_GetCurrentVolume());
+		S_PlaySoundAt(hSplash, S_GetCurrentVolume(), this.m_vecPos);
 
 		for (int i = 0; i < 2; i++) {
 			CCoinItem@ coin = CCoinItem();
@@ -400,4 +400,16 @@ class CFrogator : IScriptedEntity
 			Props_CreateProperty("y", formatInt(this.m_vecPos[1])) +
 			Props_CreateProperty("rot", formatFloat(this.m_fRotation));
 	}
+	
+	//Return data stored in binary snapshots
+	string SaveSnapshot()
+	{
+		return Props_CreateProperty("health", formatInt(this.m_uiHealth));
+	}
+	
+	//Restore data from binary snapshots
+	void RestoreSnapshot(const string &in data)
+	{
+		this.m_uiHealth = parseInt(Props_ExtractValue(data, "health"));
+	}
 }
@@ -79,7 +79,7 @@ class CHeadcrabEntity : IScriptedEntity
 				this.m_oAttack.Update();
 				if (this.m_oAttack.IsElapsed()) {
 					pEntity.OnDamage(C_HEADGRAB_DAMAGE_VALUE);
-					S_PlaySound(this.m_hAttackSound, S_GetCurrentVolume());
+					S_PlaySoundAt(this.m_hAttackSound, S_GetCurrentVolume(), this.m_vecPos);
 					this.m_oAttack.Reset();
 				}
 			}
@@ -140,7 +140,7 @@ class CHeadcrabEntity : IScriptedEntity
 		Ent_SpawnEntity("blooddecal", @obj, this.m_vecPos);
 		
 		SoundHandle hSplash = S_QuerySound(GetPackagePath() + "sound\\hc_splash.wav");
-		S_PlaySound(hSplash, S_GetCurrentVolume());
+		S_PlaySoundAt(hSplash, S_GetCurrentVolume(), this.m_vecPos);
 
 		CCoinItem@ coin = CCoinItem();
 		coin.SetRandomPos(true);
@@ -172,7 +172,7 @@ class CHeadcrabEntity : IScriptedEntity
 		this.m_oWalkSound.Update();
 		if (this.m_oWalkSound.IsElapsed()) {
 			this.m_oWalkSound.Reset();
-			S_PlaySound(this.m_hWalkSound, S_GetCurrentVolume());
+			S_PlaySoundAt(this.m_hWalkSound, S_GetCurrentVolume(), this.m_vecPos);
 		}
 		
 		this.CheckForEnemiesInRange();
@@ -311,4 +311,16 @@ class CHeadcrabEntity : IScriptedEntity
 				Props_CreateProperty("rot", formatFloat(this.m_fRotation)) +
 				Props_CreateProperty("health", formatInt(this.m_uiHealth));
 	}
+	
+	//Return data stored in binary snapshots
+	string SaveSnapshot()
+	{
+		return Props_CreateProperty("health", formatInt(this.m_uiHealth));
+	}
+	
+	//Restore data from binary snapshots
+	void RestoreSnapshot(const string &in data)
+	{
+		this.m_uiHealth = parseInt(Props_ExtractValue(data, "health"));
+	}
 }
@@ -223,6 +223,18 @@ class CCoinItem : IScriptedEntity
 			Props_CreateProperty("y", formatInt(this.m_vecPos[1])) +
 			Props_CreateProperty("rot", formatFloat(this.GetRotation()));
 	}
+	
+	//Return data stored in binary snapshots
+	string SaveSnapshot()
+	{
+		return Props_CreateProperty("sprite", formatInt(this.m_iSpriteIndex));
+	}
+	
+	//Restore data from binary snapshots
+	void RestoreSnapshot(const string &in data)
+	{
+		this.m_iSpriteIndex = parseInt(Props_ExtractValue(data, "sprite"));
+	}
 }
 
 //Create coin entity
@@ -25,11 +25,13 @@ class CPlasmaBall : IScriptedEntity
 	int m_iSpriteIndex;
 	Timer m_tmrSpriteChange;
 	Timer m_tmrMayDamage;
+	CVarHandle m_hGameStarted;
 	
 	CPlasmaBall()
     {
 		this.m_vecSize = Vector(64, 64);
 		this.m_iSpriteIndex = 0;
+		this.m_hGameStarted = 0;
     }
 	
 	//Called when the entity gets spawned. The position in the map is passed as argument
@@ -59,7 +61,11 @@ class CPlasmaBall : IScriptedEntity
 	//Process entity stuff
 	void OnProcess()
 	{
-		if (CVar_GetBool("game_started", false) == false) {
+		if (this.m_hGameStarted == 0) {
+			this.m_hGameStarted = CVar_Find("game_started");
+		}
+
+		if (CVar_GetBool(this.m_hGameStarted, false) == false) {
 			return;
 		}
 		
@@ -132,7 +138,7 @@ class CPlasmaBall : IScriptedEntity
 				ref.OnDamage(PLASMA_BALL_DAMAGE);
 				
 				SoundHandle hHit = S_QuerySound(GetPackagePath() + "sound\\plasma_hit.wav");
-				S_PlaySound(hHit, S_GetCurrentVolume());
+				S_PlaySoundAt(hHit, S_GetCurrentVolume(), this.m_vecPos);
 			}
 		}
 	}
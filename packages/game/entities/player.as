@@ -12,6 +12,9 @@
 */
 
 string g_szPackagePath = "";
+CVarHandle g_hShowMapSelMenu = 0;
+CVarHandle g_hShowShopMenu = 0;
+CVarHandle g_hEnterWorld = 0;
 
 #include "weapon_laser.as"
 #include "weapon_laserball.as"
@@ -911,23 +914,23 @@ class CPlayerEntity : IScriptedEntity, IPlayerEntity, ICollectingEntity
 		}
 
 		//Map selection menu
-		if (CVar_GetBool("show_mapsel_menu", false)) {
+		if (CVar_GetBool(g_hShowMapSelMenu, false)) {
 			this.m_oSelectMenu.Start();
-			CVar_SetBool("show_mapsel_menu", false);
+			CVar_SetBool(g_hShowMapSelMenu, false);
 			this.m_uiButtons = 0;
 		}
 
 		//Shop menu
-		if (CVar_GetBool("show_shop_menu", false)) {
+		if (CVar_GetBool(g_hShowShopMenu, false)) {
 			this.m_oShopMenu.Start();
-			CVar_SetBool("show_shop_menu", false);
+			CVar_SetBool(g_hShowShopMenu, false);
 			this.m_uiButtons = 0;
 		}
 
 		//Enter world if requested
-		string szShallLoadMap = CVar_GetString("mapsel_enter_world", "");
+		string szShallLoadMap = CVar_GetString(g_hEnterWorld, "");
 		if (szShallLoadMap != "") {
-			CVar_SetString("mapsel_enter_world", "");
+			CVar_SetString(g_hEnterWorld, "");
 			LoadMap(szShallLoadMap);
 		}
 
@@ -1432,6 +1435,21 @@ class CPlayerEntity : IScriptedEntity, IPlayerEntity, ICollectingEntity
 			Props_CreateProperty("score", formatInt(this.m_iScore));
 	}
 	
+	//Return data stored in binary snapshots
+	string SaveSnapshot()
+	{
+		return Props_CreateProperty("health", formatInt(this.m_uiHealth)) +
+			Props_CreateProperty("score", formatInt(this.m_iScore));
+	}
+	
+	//Restore data from binary snapshots
+	void RestoreSnapshot(const string &in data)
+	{
+		this.m_uiHealth = parseInt(Props_ExtractValue(data, "health"));
+		this.m_iScore = parseInt(Props_ExtractValue(data, "score"));
+		HUD_UpdateHealth(this.m_uiHealth);
+	}
+	
 	//Add to player score
 	void AddPlayerScore(int amount)
 	{
@@ -1514,6 +1532,11 @@ void CreateEntity(const Vector &in vecPos, float fRot, const string &in szIdent,
 	CVar_Register("grenades_thrown", CVAR_TYPE_INT, "0");
 	CVar_Register("dodges_count", CVAR_TYPE_INT, "0");
 
+	//Resolve CVars which are polled every frame
+	g_hShowMapSelMenu = CVar_Find("show_mapsel_menu");
+	g_hShowShopMenu = CVar_Find("show_shop_menu");
+	g_hEnterWorld = CVar_Find("mapsel_enter_world");
+
 	CVar_SetString("mapsel_enter_world", "");
 	CVar_SetInt("enemies_defeated", 0);
 	CVar_SetInt("dodges_count", 0);
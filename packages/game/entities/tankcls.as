@@ -67,7 +67,7 @@ class CTankEntity : IScriptedEntity
 			return;
 		
 		//Play fire sound
-		S_PlaySound(this.m_hFireSound, S_GetCurrentVolume());
+		S_PlaySoundAt(this.m_hFireSound, S_GetCurrentVolume(), this.m_vecPos);
 		
 		Vector shotPos = Vector(this.m_vecPos[0] + this.m_vecSize[0] / 2, this.m_vecPos[1] + this.m_vecSize[1] / 2);
 		shotPos[0] += int(sin(this.m_fHeadRot + 0.014) * 50);
@@ -327,4 +327,16 @@ class CTankEntity : IScriptedEntity
 				Props_CreateProperty("rot", formatFloat(this.m_fRotation)) +
 				Props_CreateProperty("health", formatInt(this.m_uiHealth));
 	}
+	
+	//Return data stored in binary snapshots
+	string SaveSnapshot()
+	{
+		return Props_CreateProperty("health", formatInt(this.m_uiHealth));
+	}
+	
+	//Restore data from binary snapshots
+	void RestoreSnapshot(const string &in data)
+	{
+		this.m_uiHealth = parseInt(Props_ExtractValue(data, "health"));
+	}
 }
\ No newline at end of file
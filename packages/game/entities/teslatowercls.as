@@ -74,7 +74,7 @@ class CTeslaTower : IScriptedEntity
 				this.m_oAlpha.Reset();
 				this.m_oAlpha.SetActive(true);
 				this.m_ucAlpha = 255;
-				S_PlaySound(this.m_hCharge, S_GetCurrentVolume());
+				S_PlaySoundAt(this.m_hCharge, S_GetCurrentVolume(), this.m_vecPos);
 			}
 		} else {
 			if (this.m_oAttacking.IsActive())
@@ -105,7 +105,7 @@ class CTeslaTower : IScriptedEntity
 		
 		Ent_SpawnEntity("weapon_bolt", @obj, Vector(this.m_vecPos[0] - 15, this.m_vecPos[1] + 100));
 
-		S_PlaySound(this.m_hAttack, S_GetCurrentVolume());
+		S_PlaySoundAt(this.m_hAttack, S_GetCurrentVolume(), this.m_vecPos);
 	}
 	
 	//Called when the entity gets spawned. The position in the map is passed as argument
@@ -292,4 +292,16 @@ class CTeslaTower : IScriptedEntity
 			Props_CreateProperty("y", formatInt(this.m_vecPos[1])) +
 			Props_CreateProperty("rot", formatFloat(this.GetRotation()));
 	}
+	
+	//Return data stored in binary snapshots
+	string SaveSnapshot()
+	{
+		return Props_CreateProperty("health", formatInt(this.m_uiHealth));
+	}
+	
+	//Restore data from binary snapshots
+	void RestoreSnapshot(const string &in data)
+	{
+		this.m_uiHealth = parseInt(Props_ExtractValue(data, "health"));
+	}
 }
@@ -25,6 +25,7 @@ class CGunEntity : IScriptedEntity
 	float m_fRotation;
 	float m_fSpeed;
 	bool m_bRemove;
+	bool m_bMoving;
 	Timer m_tmrAlive;
 	IScriptedEntity@ m_pOwner;
 	bool m_bExplode;
@@ -34,6 +35,7 @@ class CGunEntity : IScriptedEntity
 		this.m_vecSize = Vector(5, 5);
 		this.m_fSpeed = 850.0;
 		this.m_bRemove = false;
+		this.m_bMoving = false;
 		@this.m_pOwner = null;
 		this.m_bExplode = false;
     }
@@ -66,7 +68,11 @@ class CGunEntity : IScriptedEntity
 	//Process entity stuff
 	void OnProcess()
 	{
-		Ent_Move(this, this.m_fSpeed, MOVE_FORWARD);
+		//Let the engine move the shot along its rotation
+		if (!this.m_bMoving) {
+			Ent_SetMovement(this, this.m_fSpeed, MOVE_FORWARD);
+			this.m_bMoving = true;
+		}
 		
 		this.m_tmrAlive.Update();
 		if (this.m_tmrAlive.IsElapsed()) {
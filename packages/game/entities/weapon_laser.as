@@ -25,6 +25,7 @@ class CLaserEntity : IScriptedEntity
 	float m_fRotation;
 	float m_fSpeed;
 	bool m_bRemove;
+	bool m_bMoving;
 	Timer m_tmrAlive;
 	IScriptedEntity@ m_pOwner;
 	bool m_bRandomColor;
@@ -46,6 +47,7 @@ class CLaserEntity : IScriptedEntity
 		this.m_vecSize = Vector(50, 35);
 		this.m_fSpeed = 650.0;
 		this.m_bRemove = false;
+		this.m_bMoving = false;
 		@this.m_pOwner = null;
 		this.m_bRandomColor = false;
     }
@@ -80,7 +82,11 @@ class CLaserEntity : IScriptedEntity
 	//Process entity stuff
 	void OnProcess()
 	{
-		Ent_Move(this, this.m_fSpeed, MOVE_FORWARD);
+		//Let the engine move the shot along its rotation
+		if (!this.m_bMoving) {
+			Ent_SetMovement(this, this.m_fSpeed, MOVE_FORWARD);
+			this.m_bMoving = true;
+		}
 		
 		this.m_tmrAlive.Update();
 		if (this.m_tmrAlive.IsElapsed()) {
@@ -25,6 +25,7 @@ class CLaserBallEntity : IScriptedEntity
 	float m_fRotation;
 	float m_fSpeed;
 	bool m_bRemove;
+	bool m_bMoving;
 	Timer m_tmrAlive;
 	IScriptedEntity@ m_pOwner;
 	
@@ -39,6 +40,7 @@ class CLaserBallEntity : IScriptedEntity
 		this.m_vecSize = Vector(32, 32);
 		this.m_fSpeed = 350.0;
 		this.m_bRemove = false;
+		this.m_bMoving = false;
 		@this.m_pOwner = null;
     }
 	
@@ -68,7 +70,11 @@ class CLaserBallEntity : IScriptedEntity
 	//Process entity stuff
 	void OnProcess()
 	{
-		Ent_Move(this, this.m_fSpeed, MOVE_FORWARD);
+		//Let the engine move the shot along its rotation
+		if (!this.m_bMoving) {
+			Ent_SetMovement(this, this.m_fSpeed, MOVE_FORWARD);
+			this.m_bMoving = true;
+		}
 		
 		this.m_tmrAlive.Update();
 		if (this.m_tmrAlive.IsElapsed()) {
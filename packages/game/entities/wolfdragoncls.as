@@ -88,7 +88,7 @@ class CWolfdragon : IScriptedEntity
 			Ent_SpawnEntity("weapon_laserball", ball, vecBulletPos);
 		}
 
-		S_PlaySound(this.m_hAttackSound, S_GetCurrentVolume());
+		S_PlaySoundAt(this.m_hAttackSound, S_GetCurrentVolume(), this.m_vecPos);
 	}
 	
 	void CheckForEnemiesInRange()
@@ -168,7 +168,7 @@ class CWolfdragon : IScriptedEntity
 		Ent_SpawnEntity("blooddecal", @obj, Vector(this.m_vecPos[0] + 134, this.m_vecPos[1] + 100));
 		
 		SoundHandle hSplash = S_QuerySound(GetPackagePath() + "sound\\hc_splash.wav");
-		S_PlaySound(hSplash, S_GetCurrentVolume());
+		S_PlaySoundAt(hSplash, S_GetCurrentVolume(), this.m_vecPos);
 
 		for (int i = 0; i < 3; i++) {
 			CCoinItem@ coin = CCoinItem();
@@ -350,4 +350,16 @@ class CWolfdragon : IScriptedEntity
 			Props_CreateProperty("y", formatInt(this.m_vecPos[1])) +
 			Props_CreateProperty("rot", formatFloat(this.m_fRotation));
 	}
+	
+	//Return data stored in binary snapshots
+	string SaveSnapshot()
+	{
+		return Props_CreateProperty("health", formatInt(this.m_uiHealth));
+	}
+	
+	//Restore data from binary snapshots
+	void RestoreSnapshot(const string &in data)
+	{
+		this.m_uiHealth = parseInt(Props_ExtractValue(data, "health"));
+	}
 }
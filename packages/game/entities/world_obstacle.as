@@ -135,7 +135,7 @@ class CWorldObstacle : IScriptedEntity
 			ref.OnDamage(this.m_uiDamageValue);
 			
 			if (this.m_bPlaySound) {
-				S_PlaySound(this.m_hDamage, S_GetCurrentVolume());
+				S_PlaySoundAt(this.m_hDamage, S_GetCurrentVolume(), this.m_vecPos);
 			
 				this.m_bPlaySound = false;
 				
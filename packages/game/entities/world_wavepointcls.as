@@ -37,12 +37,14 @@ class CWavePoint : IScriptedEntity
 	Timer m_tmrSpawnWave;
 	bool m_bRemove;
 	bool m_bInitialWave;
+	CVarHandle m_hGameStarted;
 	
 	CWavePoint()
     {
 		this.m_uiCurCount = 0;
 		this.m_bRemove = false;
 		this.m_bInitialWave = false;
+		this.m_hGameStarted = 0;
     }
 	
 	//Set target entity type
@@ -150,7 +152,11 @@ class CWavePoint : IScriptedEntity
 	//Process entity stuff
 	void OnProcess()
 	{
-		if (CVar_GetBool("game_started", false) == false) {
+		if (this.m_hGameStarted == 0) {
+			this.m_hGameStarted = CVar_Find("game_started");
+		}
+
+		if (CVar_GetBool(this.m_hGameStarted, false) == false) {
 			return;
 		} else {
 			if (!this.m_bInitialWave) {